@@ -658,105 +658,70 @@ afs_CheckBulkStatus(struct afs_conn *tc, int nFids, AFSBulkStats *statParm,
     return 0;
 }
 
+/*
+ * Status is prefetched for a directory's entries in a window that starts at
+ * AFS_BULKSTAT_MIN entries and doubles, up to AFS_BULKSTAT_MAX, for as long
+ * as lookups keep walking the directory in order.  A window is fetched with
+ * up to AFS_BULKSTAT_MAX / AFSCBMAX BulkStatus calls in flight at once.
+ */
+#define AFS_BULKSTAT_MIN	30
+#define AFS_BULKSTAT_MAX	(4 * AFSCBMAX)
+
 extern int BlobScan(struct dcache * afile, afs_int32 ablob, afs_int32 *ablobOut);
 
+/* Clear CBulkFetching on the files in fidsp that we marked with statSeqNo
+ * but are not going to fetch status for after all. */
+static void
+afs_BulkStatClear(struct vcache *adp, AFSFid *fidsp, int nfids,
+		  afs_size_t statSeqNo)
+{
+    struct VenusFid afid;
+    struct vcache *tvcp;
+    int i;
+
+    for (i = 0; i < nfids; i++) {
+	afid.Cell = adp->f.fid.Cell;
+	afid.Fid.Volume = adp->f.fid.Fid.Volume;
+	afid.Fid.Vnode = fidsp[i].Vnode;
+	afid.Fid.Unique = fidsp[i].Unique;
+
+	ObtainReadLock(&afs_xvcache);
+	tvcp = afs_FindVCache(&afid, 0 /* !stats&!lru */);
+	ReleaseReadLock(&afs_xvcache);
+	if (tvcp != NULL) {
+	    if ((tvcp->f.states & CBulkFetching)
+		&& (tvcp->f.m.Length == statSeqNo)) {
+		tvcp->f.states &= ~CBulkFetching;
+	    }
+	    afs_PutVCache(tvcp);
+	}
+    }
+}
+
 /* called with an unlocked directory and directory cookie.  Areqp
  * describes who is making the call.
- * Scans the next N (about 30, typically) directory entries, and does
- * a bulk stat call to stat them all.
- *
- * Must be very careful when merging in RPC responses, since we dont
- * want to overwrite newer info that was added by a file system mutating
- * call that ran concurrently with our bulk stat call.
- *
- * We do that, as described below, by not merging in our info (always
- * safe to skip the merge) if the status info is valid in the vcache entry.
- *
- * If adapt ever implements the bulk stat RPC, then this code will need to
- * ensure that vcaches created for failed RPC's to older servers have the
- * CForeign bit set.
+ * Scans the directory from dirCookie for up to nentries files that we
+ * don't have status for, marks them CBulkFetching with statSeqNo, and
+ * returns their fids in fidsp.  Also notes in adp how far we got, for
+ * afs_BulkStatWindow.
  */
-static struct vcache *BStvc = NULL;
-
-int
-afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
+static int
+afs_BulkStatScan(struct vcache *adp, long dirCookie, int nentries,
+		 AFSFid *fidsp, int *nfidsp, afs_size_t statSeqNo,
+		 struct vrequest *areqp)
 {
-    int nentries;		/* # of entries to prefetch */
-    int nskip;			/* # of slots in the LRU queue to skip */
-#ifdef AFS_DARWIN80_ENV
-    int npasses = 0;
-    struct vnode *lruvp;
-#endif
-    struct vcache *lruvcp;	/* vcache ptr of our goal pos in LRU queue */
     struct dcache *dcp;		/* chunk containing the dir block */
     afs_size_t temp;		/* temp for holding chunk length, &c. */
-    struct AFSFid *fidsp;	/* file IDs were collecting */
-    struct AFSCallBack *cbsp;	/* call back pointers */
-    struct AFSCallBack *tcbp;	/* temp callback ptr */
-    struct AFSFetchStatus *statsp;	/* file status info */
-    struct AFSVolSync volSync;	/* vol sync return info */
     struct vcache *tvcp;	/* temp vcp */
-    struct afs_q *tq;		/* temp queue variable */
-    AFSCBFids fidParm;		/* file ID parm for bulk stat */
-    AFSBulkStats statParm;	/* stat info parm for bulk stat */
     int fidIndex = 0;		/* which file were stating */
-    struct afs_conn *tcp = 0;	/* conn for call */
-    AFSCBs cbParm;		/* callback parm for bulk stat */
-    struct server *hostp = 0;	/* host we got callback from */
-    long startTime;		/* time we started the call,
-				 * for callback expiration base
-				 */
-#if defined(AFS_DARWIN_ENV)
-    int ftype[4] = {VNON, VREG, VDIR, VLNK}; /* verify type is as expected */
-#endif
-    afs_size_t statSeqNo = 0;	/* Valued of file size to detect races */
     int code;			/* error code */
     afs_int32 newIndex;		/* new index in the dir */
     struct DirBuffer entry;	/* Buffer for dir manipulation */
     struct DirEntry *dirEntryp;	/* dir entry we are examining */
-    int i;
-    struct VenusFid afid;	/* file ID we are using now */
     struct VenusFid tfid;	/* another temp. file ID */
-    afs_int32 retry;		/* handle low-level VFS race conditions */
-    long volStates;		/* flags from vol structure */
-    struct volume *volp = 0;	/* volume ptr */
-    struct VenusFid dotdot = {0, {0, 0, 0}};
-    int flagIndex = 0;		/* First file with bulk fetch flag set */
-    struct rx_connection *rxconn;
     int attempt_i;
-    XSTATS_DECLS;
-    dotdot.Cell = 0;
-    dotdot.Fid.Unique = 0;
-    dotdot.Fid.Vnode = 0;
-
-    /* first compute some basic parameters.  We dont want to prefetch more
-     * than a fraction of the cache in any given call, and we want to preserve
-     * a portion of the LRU queue in any event, so as to avoid thrashing
-     * the entire stat cache (we will at least leave some of it alone).
-     * presently dont stat more than 1/8 the cache in any one call.      */
-    nentries = afs_cacheStats / 8;
-
-    /* dont bother prefetching more than one calls worth of info */
-    if (nentries > AFSCBMAX)
-	nentries = AFSCBMAX;
-
-    /* heuristic to make sure that things fit in 4K.  This means that
-     * we shouldnt make it any bigger than 47 entries.  I am typically
-     * going to keep it a little lower, since we don't want to load
-     * too much of the stat cache.
-     */
-    if (nentries > 30)
-	nentries = 30;
-
-    /* now, to reduce the stack size, well allocate two 4K blocks,
-     * one for fids and callbacks, and one for stat info.  Well set
-     * up our pointers to the memory from there, too.
-     */
-    statsp = osi_Alloc(AFSCBMAX * sizeof(AFSFetchStatus));
-    fidsp = osi_AllocLargeSpace(nentries * sizeof(AFSFid));
-    cbsp = osi_Alloc(AFSCBMAX * sizeof(AFSCallBack));
 
-    /* next, we must iterate over the directory, starting from the specified
+    /* we must iterate over the directory, starting from the specified
      * cookie offset (dirCookie), and counting out nentries file entries.
      * We skip files that already have stat cache entries, since we
      * dont want to bulk stat files that are already in the cache.
@@ -764,13 +729,11 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
   tagain:
     code = afs_VerifyVCache(adp, areqp);
     if (code)
-	goto done2;
+	return code;
 
     dcp = afs_GetDCache(adp, (afs_size_t) 0, areqp, &temp, &temp, 1);
-    if (!dcp) {
-	code = EIO;
-	goto done2;
-    }
+    if (!dcp)
+	return EIO;
 
     /* lock the directory cache entry */
     ObtainReadLock(&adp->lock);
@@ -802,21 +765,9 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
 	goto tagain;
     }
 
-    /* Generate a sequence number so we can tell whether we should
-     * store the attributes when processing the response. This number is
-     * stored in the file size when we set the CBulkFetching bit. If the
-     * CBulkFetching is still set and this value hasn't changed, then
-     * we know we were the last to set CBulkFetching bit for this file,
-     * and it is safe to set the status information for this file.
-     */
-    statSeqNo = bulkStatCounter++;
-    /* ensure against wrapping */
-    if (statSeqNo == 0)
-	statSeqNo = bulkStatCounter++;
-
     /* now we have dir data in the cache, so scan the dir page */
     fidIndex = 0;
-    flagIndex = 0;
+    adp->bulkStatMark = dirCookie;
 
     /*
      * Only examine at most the next 'nentries*4' entries to find dir entries
@@ -867,7 +818,7 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
 	    tvcp = afs_FindVCache(&tfid, IS_SLOCK /* no stats | LRU */ );
 	    if (!tvcp) {	/* otherwise, create manually */
 		UpgradeSToWLock(&afs_xvcache, 129);
-		tvcp = afs_NewBulkVCache(&tfid, hostp, statSeqNo);
+		tvcp = afs_NewBulkVCache(&tfid, NULL, statSeqNo);
 		if (tvcp)
 		{
 		    ObtainWriteLock(&tvcp->lock, 505);
@@ -898,7 +849,10 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
 		ReleaseReadLock(&dcp->lock);
 		ReleaseReadLock(&adp->lock);
 		afs_PutDCache(dcp);
-		goto done;	/* can happen if afs_NewVCache fails */
+		/* can happen if afs_NewVCache fails */
+		afs_BulkStatClear(adp, fidsp, fidIndex, statSeqNo);
+		*nfidsp = 0;
+		return 0;
 	    }
 
 	    /* WARNING: afs_DoBulkStat uses the Length field to store a
@@ -944,6 +898,9 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
 		memcpy((char *)(fidsp + fidIndex), (char *)&tfid.Fid,
 		       sizeof(*fidsp));
 		fidIndex++;
+		/* lookups from about here on ask for the next lot */
+		if (fidIndex == nentries / 2)
+		    adp->bulkStatMark = dirCookie;
 	    }
 	    afs_PutVCache(tvcp);
 	}
@@ -966,17 +923,79 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
     /* release the chunk */
     afs_PutDCache(dcp);
 
-    /* dont make a null call */
-    if (fidIndex == 0)
-	goto done;
+    adp->bulkStatNext = dirCookie;
+    *nfidsp = fidIndex;
+    return 0;
+}
+
+/* Does a bulk stat call for the nfids files of adp in fidsp, as set up by
+ * afs_BulkStatScan, and merges the results into the stat cache.
+ *
+ * Must be very careful when merging in RPC responses, since we dont
+ * want to overwrite newer info that was added by a file system mutating
+ * call that ran concurrently with our bulk stat call.
+ *
+ * We do that, as described below, by not merging in our info (always
+ * safe to skip the merge) if the status info is valid in the vcache entry.
+ *
+ * If adapt ever implements the bulk stat RPC, then this code will need to
+ * ensure that vcaches created for failed RPC's to older servers have the
+ * CForeign bit set.
+ */
+static struct vcache *BStvc = NULL;
+
+static int
+afs_BulkStatFetch(struct vcache *adp, AFSFid *fidsp, int nfids,
+		  afs_size_t statSeqNo, struct vrequest *areqp)
+{
+    int nskip;			/* # of slots in the LRU queue to skip */
+#ifdef AFS_DARWIN80_ENV
+    int npasses = 0;
+    struct vnode *lruvp;
+#endif
+    struct vcache *lruvcp;	/* vcache ptr of our goal pos in LRU queue */
+    struct AFSCallBack *cbsp;	/* call back pointers */
+    struct AFSCallBack *tcbp;	/* temp callback ptr */
+    struct AFSFetchStatus *statsp;	/* file status info */
+    struct AFSVolSync volSync;	/* vol sync return info */
+    struct vcache *tvcp;	/* temp vcp */
+    struct afs_q *tq;		/* temp queue variable */
+    AFSCBFids fidParm;		/* file ID parm for bulk stat */
+    AFSBulkStats statParm;	/* stat info parm for bulk stat */
+    struct afs_conn *tcp = 0;	/* conn for call */
+    AFSCBs cbParm;		/* callback parm for bulk stat */
+    struct server *hostp = 0;	/* host we got callback from */
+    long startTime;		/* time we started the call,
+				 * for callback expiration base
+				 */
+#if defined(AFS_DARWIN_ENV)
+    int ftype[4] = {VNON, VREG, VDIR, VLNK}; /* verify type is as expected */
+#endif
+    int code;			/* error code */
+    int i;
+    struct VenusFid afid;	/* file ID we are using now */
+    afs_int32 retry;		/* handle low-level VFS race conditions */
+    long volStates;		/* flags from vol structure */
+    struct volume *volp = 0;	/* volume ptr */
+    struct VenusFid dotdot = {0, {0, 0, 0}};
+    int flagIndex = 0;		/* First file with bulk fetch flag set */
+    struct rx_connection *rxconn;
+    XSTATS_DECLS;
+    dotdot.Cell = 0;
+    dotdot.Fid.Unique = 0;
+    dotdot.Fid.Vnode = 0;
+
+    /* to reduce the stack size, allocate the results */
+    statsp = osi_Alloc(AFSCBMAX * sizeof(AFSFetchStatus));
+    cbsp = osi_Alloc(AFSCBMAX * sizeof(AFSCallBack));
 
     do {
 	/* setup the RPC parm structures */
-	fidParm.AFSCBFids_len = fidIndex;
+	fidParm.AFSCBFids_len = nfids;
 	fidParm.AFSCBFids_val = fidsp;
-	statParm.AFSBulkStats_len = fidIndex;
+	statParm.AFSBulkStats_len = nfids;
 	statParm.AFSBulkStats_val = statsp;
-	cbParm.AFSCBs_len = fidIndex;
+	cbParm.AFSCBs_len = nfids;
 	cbParm.AFSCBs_val = cbsp;
 
 	/* start the timer; callback expirations are relative to this */
@@ -986,7 +1005,7 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
 	if (tcp) {
 	    hostp = tcp->parent->srvr->server;
 
-	    for (i = 0; i < fidIndex; i++) {
+	    for (i = 0; i < nfids; i++) {
 		/* we must set tvcp->callback before the BulkStatus call, so
 		 * we can detect concurrent InitCallBackState's */
 
@@ -1038,7 +1057,7 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
 	    XSTATS_END_TIME;
 
 	    if (code == 0) {
-		code = afs_CheckBulkStatus(tcp, fidIndex, &statParm, &cbParm);
+		code = afs_CheckBulkStatus(tcp, nfids, &statParm, &cbParm);
 	    }
 	} else
 	    code = -1;
@@ -1146,7 +1165,7 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
      *
      * We also have to take into account racing token revocations.
      */
-    for (i = 0; i < fidIndex; i++) {
+    for (i = 0; i < nfids; i++) {
 	if ((&statsp[i])->errorCode)
 	    continue;
 	afid.Cell = adp->f.fid.Cell;
@@ -1325,33 +1344,133 @@ afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp)
 
   done:
     /* Be sure to turn off the CBulkFetching flags */
-    for (i = flagIndex; i < fidIndex; i++) {
-	afid.Cell = adp->f.fid.Cell;
-	afid.Fid.Volume = adp->f.fid.Fid.Volume;
-	afid.Fid.Vnode = fidsp[i].Vnode;
-	afid.Fid.Unique = fidsp[i].Unique;
-
-	ObtainReadLock(&afs_xvcache);
-	tvcp = afs_FindVCache(&afid, 0 /* !stats&!lru */);
-	ReleaseReadLock(&afs_xvcache);
-	if (tvcp != NULL) {
-	    if ((tvcp->f.states & CBulkFetching)
-		&& (tvcp->f.m.Length == statSeqNo)) {
-		tvcp->f.states &= ~CBulkFetching;
-	    }
-	    afs_PutVCache(tvcp);
-	}
-    }
+    afs_BulkStatClear(adp, fidsp + flagIndex, nfids - flagIndex, statSeqNo);
     if (volp)
 	afs_PutVolume(volp, READ_LOCK);
 
-  done2:
-    osi_FreeLargeSpace((char *)fidsp);
     osi_Free((char *)statsp, AFSCBMAX * sizeof(AFSFetchStatus));
     osi_Free((char *)cbsp, AFSCBMAX * sizeof(AFSCallBack));
     return code;
 }
 
+/*
+ * Decide how many entries of adp to prefetch status for after a lookup at
+ * dirCookie, and where to start.  A lookup in the back half of what we
+ * prefetched last time means the directory is being walked in order (say,
+ * "ls -l"), so double the window and carry on from where the last one
+ * stopped, before the walk gets there.  Any other lookup that found no
+ * status starts over with a small window at dirCookie.  The window also
+ * shrinks as the stat cache fills up, well before afs_VCacheStressed stops
+ * bulk stats altogether.
+ */
+static int
+afs_BulkStatWindow(struct vcache *adp, long dirCookie, int missed,
+		   long *startp)
+{
+    int nentries;
+    afs_int32 room;
+
+    if (adp->bulkStatNext != 0 && dirCookie >= adp->bulkStatMark
+	&& dirCookie < adp->bulkStatNext) {
+	nentries = adp->bulkStatWindow * 2;
+	*startp = adp->bulkStatNext;
+	adp->bulkStatMark = adp->bulkStatNext;	/* only once per window */
+    } else if (missed) {
+	nentries = AFS_BULKSTAT_MIN;
+	*startp = dirCookie;
+    } else {
+	return 0;
+    }
+
+    if (nentries > AFS_BULKSTAT_MAX)
+	nentries = AFS_BULKSTAT_MAX;
+    room = afs_cacheStats - afs_vcount;
+    if (room < 4 * nentries)
+	nentries = (room > 4 * AFS_BULKSTAT_MIN) ? room / 4 : AFS_BULKSTAT_MIN;
+    /* we dont want to prefetch more than a fraction of the cache in any
+     * given call, so as to avoid thrashing the entire stat cache.
+     * presently dont stat more than 1/8 the cache at once. */
+    if (nentries > afs_cacheStats / 8)
+	nentries = afs_cacheStats / 8;
+    adp->bulkStatWindow = nentries;
+    return nentries;
+}
+
+/*
+ * Prefetch status for the entries of adp following a lookup at dirCookie.
+ * If missed is set, the entry looked up has no status, so the caller is
+ * waiting for the first batch, and we fetch that one here.  The rest go to
+ * the background daemons, so that several bulk stat calls are in flight.
+ */
+int
+afs_DoBulkStat(struct vcache *adp, long dirCookie, struct vrequest *areqp,
+	       afs_ucred_t *acred, int missed)
+{
+    AFSFid *fidsp, *bfidsp;
+    afs_size_t statSeqNo;
+    long start;
+    int nentries, nfids, i, n;
+    int code;
+
+    nentries = afs_BulkStatWindow(adp, dirCookie, missed, &start);
+    if (nentries <= 0)
+	return 0;
+
+    /* Generate a sequence number so we can tell whether we should
+     * store the attributes when processing the response. This number is
+     * stored in the file size when we set the CBulkFetching bit. If the
+     * CBulkFetching is still set and this value hasn't changed, then
+     * we know we were the last to set CBulkFetching bit for this file,
+     * and it is safe to set the status information for this file.
+     */
+    statSeqNo = bulkStatCounter++;
+    /* ensure against wrapping */
+    if (statSeqNo == 0)
+	statSeqNo = bulkStatCounter++;
+
+    fidsp = osi_AllocLargeSpace(AFS_BULKSTAT_MAX * sizeof(AFSFid));
+    code = afs_BulkStatScan(adp, start, nentries, fidsp, &nfids, statSeqNo,
+			    areqp);
+    if (code || nfids == 0)
+	goto done;
+
+    for (i = (missed ? AFSCBMAX : 0); i < nfids; i += AFSCBMAX) {
+	n = nfids - i;
+	if (n > AFSCBMAX)
+	    n = AFSCBMAX;
+	bfidsp = osi_AllocLargeSpace(AFSCBMAX * sizeof(AFSFid));
+	memcpy(bfidsp, fidsp + i, n * sizeof(AFSFid));
+	if (!afs_BQueue(BOP_BULKSTAT, adp, B_DONTWAIT, 0, acred,
+			(afs_size_t) n, statSeqNo, bfidsp, NULL, NULL)) {
+	    afs_BulkStatClear(adp, bfidsp, n, statSeqNo);
+	    osi_FreeLargeSpace(bfidsp);
+	}
+    }
+    if (missed)
+	code = afs_BulkStatFetch(adp, fidsp, (nfids < AFSCBMAX) ? nfids :
+				 AFSCBMAX, statSeqNo, areqp);
+
+  done:
+    osi_FreeLargeSpace(fidsp);
+    return code;
+}
+
+/* Background daemon side of afs_DoBulkStat: fetch one batch of status. */
+void
+afs_BulkStatBkg(struct vcache *adp, AFSFid *fidsp, int nfids,
+		afs_size_t statSeqNo, afs_ucred_t *acred)
+{
+    struct vrequest *treq = NULL;
+
+    if (afs_CreateReq(&treq, acred) == 0) {
+	afs_BulkStatFetch(adp, fidsp, nfids, statSeqNo, treq);
+	afs_DestroyReq(treq);
+    } else {
+	afs_BulkStatClear(adp, fidsp, nfids, statSeqNo);
+    }
+    osi_FreeLargeSpace(fidsp);
+}
+
 #ifdef AFS_DARWIN80_ENV
 int AFSDOBULK = 0;
 #endif
@@ -1432,6 +1551,7 @@ afs_lookup(OSI_VC_DECL(adp), char *aname, struct vcache **avcp, afs_ucred_t *acr
     afs_hyper_t versionNo;
     int no_read_access = 0;
     struct sysname_info sysState;	/* used only for @sys checking */
+    int negok = 0;		/* may use/keep a negative DNLC entry */
     int dynrootRetry = 1;
     struct afs_fakestat_state fakestate;
     int tryEvalOnly = 0;
@@ -1668,6 +1788,20 @@ afs_lookup(OSI_VC_DECL(adp), char *aname, struct vcache **avcp, afs_ucred_t *acr
 #endif /* AFS_LINUX_ENV */
     }
 
+    /* Remember names that aren't there, so that programs probing search
+     * paths don't make us scan the directory again and again.  Only for
+     * plain names: what @sys expands to depends on who is asking, and a
+     * miss in the dynamic root may go and find a new cell.  The entry is
+     * tied to the directory's data version, so any change to the
+     * directory, local or signalled by a callback break, ends it. */
+    negok = (sysState.offset == -1 && !afs_IsDynroot(adp)
+	     && !AFS_IS_DISCONNECTED);
+    if (negok && osi_dnlc_lookup_negative(adp, aname)) {
+	code = ENOENT;
+	enoent_prohibited = 0;
+	goto done;
+    }
+
     {				/* sub-block just to reduce stack usage */
 	struct dcache *tdc;
 	afs_size_t dirOffset, dirLen;
@@ -1791,6 +1925,8 @@ afs_lookup(OSI_VC_DECL(adp), char *aname, struct vcache **avcp, afs_ucred_t *acr
 		/* The target name really doesn't exist (according to
 		 * afs_dir_LookupOffset, anyway). */
 		enoent_prohibited = 0;
+		if (negok)
+		    osi_dnlc_enter(adp, aname, NULL, &versionNo);
 	    }
 	    goto done;
 	}
@@ -1801,15 +1937,19 @@ afs_lookup(OSI_VC_DECL(adp), char *aname, struct vcache **avcp, afs_ucred_t *acr
 	if (afs_ShouldTryBulkStat(adp)) {
 	    /* if the entry is not in the cache, or is in the cache,
 	     * but hasn't been statd, then do a bulk stat operation.
+	     * Otherwise we may still want to read ahead of an in-order
+	     * walk of the directory.
 	     */
 	    ObtainReadLock(&afs_xvcache);
 	    tvc = afs_FindVCache(&tfid, 0 /* !stats,!lru */ );
 	    ReleaseReadLock(&afs_xvcache);
 
-	    if (!tvc || !(tvc->f.states & CStatd))
-		bulkcode = afs_DoBulkStat(adp, dirCookie, treq);
-	    else
+	    if (!tvc || !(tvc->f.states & CStatd)) {
+		bulkcode = afs_DoBulkStat(adp, dirCookie, treq, acred, 1);
+	    } else {
+		(void)afs_DoBulkStat(adp, dirCookie, treq, acred, 0);
 		bulkcode = 0;
+	    }
 
 	    /* if the vcache isn't usable, release it */
 	    if (tvc && !(tvc->f.states & CStatd)) {
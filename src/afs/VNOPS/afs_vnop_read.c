@@ -395,12 +395,103 @@ out:
     return code;
 }
 
+/* Work out how many chunks past achunk a read of achunk should prefetch.
+ * The window doubles, up to half the background request table, each time
+ * the file is read sequentially into the next chunk, and drops back to a
+ * single chunk when the reader seeks elsewhere.  afs_PrefetchChunk further
+ * limits the window to afs_maxReadAhead KB.
+ *
+ * The read-ahead fields are only a hint, so they are updated under the
+ * vcache read lock our callers hold; a lost update just resizes the window.
+ */
+static afs_int32
+afs_ReadAheadWindow(struct vcache *avc, afs_int32 achunk)
+{
+    afs_int32 window = avc->readAheadWindow;
+    /* leave room in the background request table for everybody else */
+    afs_int32 maxWindow = NBRS / 2;
+
+    if (achunk == avc->readAheadChunk + 1)
+	window *= 2;
+    else if (achunk != avc->readAheadChunk)
+	window = 1;
+    if (window < 1)
+	window = 1;
+    if (window > maxWindow)
+	window = maxWindow;
+
+    avc->readAheadChunk = achunk;
+    avc->readAheadWindow = window;
+    return window;
+}
+
+/* Queue a background fetch of the chunk at offset, unless it is already
+ * current or on its way.  Returns 0 if the chunk needs no more work, and
+ * -1 if the background request table is full.
+ */
+static int
+afs_PrefetchOneChunk(struct vcache *avc, afs_size_t offset,
+		     afs_ucred_t *acred, struct vrequest *areq)
+{
+    struct dcache *tdc;
+    struct brequest *bp;
+    afs_size_t j1, j2;		/* junk vbls for GetDCache to trash */
+    int code = 0;
+
+    tdc = afs_GetDCache(avc, offset, areq, &j1, &j2, 2);	/* type 2 never returns 0 */
+    /*
+     * In disconnected mode, type 2 can return 0 because it doesn't
+     * make any sense to allocate a dcache we can never fill
+     */
+    if (tdc == NULL)
+	return 0;
+
+    ObtainReadLock(&tdc->lock);
+    if ((tdc->dflags & DFFetching) || afs_IsDCacheFresh(tdc, avc)) {
+	/* already here, or already coming in */
+	ReleaseReadLock(&tdc->lock);
+	afs_PutDCache(tdc);
+	return 0;
+    }
+    ReleaseReadLock(&tdc->lock);
+
+    ObtainSharedLock(&tdc->mflock, 651);
+    if (!(tdc->mflags & DFFetchReq)) {
+	/* ask the daemon to do the work */
+	UpgradeSToWLock(&tdc->mflock, 652);
+	tdc->mflags |= DFFetchReq;	/* guaranteed to be cleared by BKG or GetDCache */
+	/* last parm (1) tells bkg daemon to do an afs_PutDCache when it is done,
+	 * since we don't want to wait for it to finish before doing so ourselves.
+	 */
+	bp = afs_BQueue(BOP_FETCH, avc, B_DONTWAIT, 0, acred,
+			(afs_size_t) offset, (afs_size_t) 1, tdc,
+			(void *)0, (void *)0);
+	if (!bp) {
+	    /* Bkg table full; just abort non-important prefetching to avoid deadlocks */
+	    tdc->mflags &= ~DFFetchReq;
+	    ReleaseWriteLock(&tdc->mflock);
+	    afs_PutDCache(tdc);
+	    code = -1;
+	} else {
+	    ReleaseWriteLock(&tdc->mflock);
+	}
+    } else {
+	ReleaseSharedLock(&tdc->mflock);
+	afs_PutDCache(tdc);
+    }
+    return code;
+}
+
 /* called with the dcache entry triggering the fetch, the vcache entry involved,
  * and a vrequest for the read call.  Marks the dcache entry as having already
  * triggered a prefetch, starts the prefetch going and sets the DFFetchReq
- * flag in the prefetched block, so that the next call to read knows to wait
+ * flag in the prefetched blocks, so that the next call to read knows to wait
  * for the daemon to start doing things.
  *
+ * While the file is being read sequentially, several chunks past adc are
+ * prefetched (see afs_ReadAheadWindow), so that the background daemons can
+ * have several fetches from the fileserver in flight at once.
+ *
  * This function must be called with the vnode at least read-locked, and
  * no locks on the dcache, because it plays around with dcache entries.
  */
@@ -408,66 +499,54 @@ void
 afs_PrefetchChunk(struct vcache *avc, struct dcache *adc,
 		  afs_ucred_t *acred, struct vrequest *areq)
 {
-    struct dcache *tdc;
     afs_size_t offset;
-    afs_size_t j1, j2;		/* junk vbls for GetDCache to trash */
+    afs_size_t queued, maxQueued;
+    afs_int32 chunk, window, i;
 
-    offset = adc->f.chunk + 1;	/* next chunk we'll need */
-    offset = AFS_CHUNKTOBASE(offset);	/* base of next chunk */
+    chunk = adc->f.chunk;
+    offset = AFS_CHUNKTOBASE(chunk + 1);	/* base of next chunk */
     ObtainReadLock(&adc->lock);
     ObtainSharedLock(&adc->mflock, 662);
     if (offset < avc->f.m.Length && !(adc->mflags & DFNextStarted)
 	&& !afs_BBusy()) {
-	struct brequest *bp;
 
 	UpgradeSToWLock(&adc->mflock, 663);
 	adc->mflags |= DFNextStarted;	/* we've tried to prefetch for this guy */
 	ReleaseWriteLock(&adc->mflock);
 	ReleaseReadLock(&adc->lock);
 
-	tdc = afs_GetDCache(avc, offset, areq, &j1, &j2, 2);	/* type 2 never returns 0 */
-        /*
-         * In disconnected mode, type 2 can return 0 because it doesn't
-         * make any sense to allocate a dcache we can never fill
-         */
-         if (tdc == NULL)
-             return;
-
-	ObtainSharedLock(&tdc->mflock, 651);
-	if (!(tdc->mflags & DFFetchReq)) {
-	    /* ask the daemon to do the work */
-	    UpgradeSToWLock(&tdc->mflock, 652);
-	    tdc->mflags |= DFFetchReq;	/* guaranteed to be cleared by BKG or GetDCache */
-	    /* last parm (1) tells bkg daemon to do an afs_PutDCache when it is done,
-	     * since we don't want to wait for it to finish before doing so ourselves.
-	     */
-	    bp = afs_BQueue(BOP_FETCH, avc, B_DONTWAIT, 0, acred,
-			    (afs_size_t) offset, (afs_size_t) 1, tdc,
-			    (void *)0, (void *)0);
-	    if (!bp) {
-		/* Bkg table full; just abort non-important prefetching to avoid deadlocks */
-		tdc->mflags &= ~DFFetchReq;
-		ReleaseWriteLock(&tdc->mflock);
-		afs_PutDCache(tdc);
+	/* Chunks can be large, so limit the window in bytes, and don't let
+	 * one reader's prefetches push much else out of the cache.  The next
+	 * chunk is always prefetched, whatever its size. */
+	maxQueued = (afs_size_t) afs_maxReadAhead << 10;
+	if (maxQueued > ((afs_size_t) afs_cacheBlocks << 10) / 8)
+	    maxQueued = ((afs_size_t) afs_cacheBlocks << 10) / 8;
+	queued = 0;
+	window = afs_ReadAheadWindow(avc, chunk);
+	for (i = 1; i <= window; i++) {
+	    offset = AFS_CHUNKTOBASE(chunk + i);
+	    if (offset >= avc->f.m.Length)
+		break;
+	    if (i > 1 && queued + AFS_CHUNKTOSIZE(chunk + i) > maxQueued)
+		break;
+	    if (afs_PrefetchOneChunk(avc, offset, acred, areq) < 0)
+		break;
+	    queued += AFS_CHUNKTOSIZE(chunk + i);
+	}
 
-		/*
-		 * DCLOCKXXX: This is a little sketchy, since someone else
-		 * could have already started a prefetch..  In practice,
-		 * this probably doesn't matter; at most it would cause an
-		 * extra slot in the BKG table to be used up when someone
-		 * prefetches this for the second time.
-		 */
-		ObtainReadLock(&adc->lock);
-		ObtainWriteLock(&adc->mflock, 664);
-		adc->mflags &= ~DFNextStarted;
-		ReleaseWriteLock(&adc->mflock);
-		ReleaseReadLock(&adc->lock);
-	    } else {
-		ReleaseWriteLock(&tdc->mflock);
-	    }
-	} else {
-	    ReleaseSharedLock(&tdc->mflock);
-	    afs_PutDCache(tdc);
+	if (i == 1) {
+	    /*
+	     * DCLOCKXXX: This is a little sketchy, since someone else
+	     * could have already started a prefetch..  In practice,
+	     * this probably doesn't matter; at most it would cause an
+	     * extra slot in the BKG table to be used up when someone
+	     * prefetches this for the second time.
+	     */
+	    ObtainReadLock(&adc->lock);
+	    ObtainWriteLock(&adc->mflock, 664);
+	    adc->mflags &= ~DFNextStarted;
+	    ReleaseWriteLock(&adc->mflock);
+	    ReleaseReadLock(&adc->lock);
 	}
     } else {
 	ReleaseSharedLock(&adc->mflock);
@@ -89,14 +89,17 @@ extern enum afs_shutdown_state afs_shuttingdown;
 /* generic undefined vice id */
 #define	UNDEFVID	    (-1)
 
-/* The basic defines for the Andrew file system
-    better keep things powers of two so "& (foo-1)" hack works for masking bits */
-#define	NBRS		15	/* max number of queued daemon requests */
+/* The basic defines for the Andrew file system.  Hash table sizes had
+    better be powers of two so "& (foo-1)" hack works for masking bits */
+#define	NBRS		30	/* max number of queued daemon requests */
+#define	AFS_MAXREADAHEAD 2048	/* default max KB to prefetch ahead */
+#define	AFS_STOREPARALLEL 4	/* default max # of StoreData calls per file */
 #define	NUSERS		2048	/* hash table size for unixuser table */
 #define	NSERVERS	16	/* hash table size for server table */
 #define	NVOLS		64	/* hash table size for volume table */
 #define	NFENTRIES	256	/* hash table size for disk volume table */
 #define VCSIZEBITS	16	/* log of stat cache hash table size */
+#define VCLOCKS		64	/* # of locks sharding the stat cache hash */
 #define CBRSIZE		512	/* call back returns hash table size */
 #define	PIGGYSIZE	1350	/* max piggyback size */
 #define	MAXVOLS		128	/* max vols we can store */
@@ -147,6 +150,7 @@ struct dcache;
 #include <opr/jhash.h>
 
 #define	VCSIZE		(opr_jhash_size(VCSIZEBITS))
+#define	VCHashLock(i)	(&afs_xvhash[(i) & (VCLOCKS - 1)])
 
 /* Store synchrony flags - SYNC means that data should be forced to server's
  * disk immediately upon completion. */
@@ -170,6 +174,9 @@ struct dcache;
 #endif
 #define BOP_PARTIAL_STORE 6     /* parm1 is chunk to store */
 #define BOP_INVALIDATE_SEGMENTS 7 /* no parms: just uses the 'bp->vc' vcache */
+#define BOP_STORE_RUN	8	/* parm1 is the afs_storeRun to store */
+#define BOP_BULKSTAT	9	/* parm1 is # of fids, parm2 the bulk stat seq
+				 * no, ptr1 the fids */
 
 #define	B_DONTWAIT	1	/* On failure return; don't wait */
 
@@ -868,6 +875,12 @@ struct vcache {
     struct vnode *v;
 #endif
     struct afs_q vlruq;		/* lru q next and prev */
+    char vlruRef;		/* looked up since last seen by the VLRU shaker */
+    struct nc *dnlcDir;		/* DNLC entries for names in this dir */
+    struct nc *dnlcVp;		/* DNLC entries naming this vcache */
+    long bulkStatNext;		/* dir cookie the last bulk stat stopped at */
+    long bulkStatMark;		/* lookups past here extend the bulk stat */
+    afs_int32 bulkStatWindow;	/* # of entries in the last bulk stat */
 #if !defined(AFS_LINUX_ENV)
     struct vcache *nextfree;	/* next on free list (if free) */
 #endif
@@ -946,6 +959,9 @@ struct vcache {
     char cachingStates;			/* Caching policies for this file */
     afs_uint32 cachingTransitions;		/* # of times file has flopped between caching and not */
 
+    afs_int32 readAheadChunk;	/* chunk of the last read that prefetched */
+    afs_int32 readAheadWindow;	/* # of chunks that read prefetched ahead */
+
 #if defined(AFS_LINUX_ENV)
     off_t next_seq_offset;	/* Next sequential offset (used by prefetch/readahead) */
 #elif defined(AFS_SUN5_ENV) || defined(AFS_SGI_ENV)
@@ -1165,12 +1181,23 @@ struct afs_fheader {
 #define AFS_FHMAGIC	    0x7635abaf	/* uses version number */
     afs_int32 magic;
 #define AFS_CI_VERSION 4
+#define AFS_CI_TIERED_VERSION 5	/* chunk tiers in use; see afs_chunkops.h */
     afs_int32 version;
     afs_uint32 dataSize;
     afs_int32 firstCSize;
     afs_int32 otherCSize;
+    /* Only present in AFS_CI_TIERED_VERSION headers, so that caches without
+     * chunk tiers keep the version 4 layout and survive an upgrade. */
+    afs_int32 maxCSize;		/* largest chunk */
+    afs_int32 spare;
 };
 
+/* The version and size of the header for the current chunk layout */
+#define AFS_FHEADER_VERSION \
+    (afs_ChunkTiers ? AFS_CI_TIERED_VERSION : AFS_CI_VERSION)
+#define AFS_FHEADER_SIZE \
+    (afs_ChunkTiers ? sizeof(struct afs_fheader) : 5 * sizeof(afs_int32))
+
 #if defined(AFS_CACHE_VNODE_PATH)
 typedef char *afs_ufs_dcache_id_t;
 #elif defined(AFS_SGI_ENV) || defined(AFS_SUN5_64BIT_ENV)
@@ -1284,6 +1311,7 @@ struct memCacheEntry {
   int dataSize;               /* size of allocated data area */
   afs_lock_t afs_memLock;
   char *data;                 /* bytes */
+  char *slab;                 /* this entry's block in the memcache arena */
 };
 
 struct afs_FetchOutput {
@@ -1493,8 +1521,14 @@ extern afs_event_t *afs_evhasht[AFS_EVHASHSIZE];	/* Hash table for events */
  * afs_WaitForCacheDrain if the cache is 98% (CM_WAITFORDRAINPCT) full.
  * afs_GetDownD wakes those processes once the cache is 95% full
  * (CM_CACHESIZEDRAINEDPCT).
+ * For a disk cache with more chunks than in-memory dcache entries, the cache
+ * truncation daemon also keeps CM_DSLOTFREEPCT of the in-memory entries free,
+ * so that reading a chunk's entry in from CacheItems seldom has to write
+ * another one out first.  It frees discarded chunks CM_DISCARDBATCH at a time.
  */
 #define CM_MAXDISCARDEDCHUNKS	16	/* # of chunks */
+#define CM_DISCARDBATCH		16	/* # of chunks */
+#define CM_DSLOTFREEPCT		 5	/* min pct of dcache entries free */
 #define CM_DCACHECOUNTFREEPCT	95	/* max pct of chunks in use */
 #define CM_DCACHESPACEFREEPCT	90	/* max pct of space in use */
 #define CM_DCACHEEXTRAPCT    	 5	/* extra to get when freeing */
@@ -1588,6 +1622,28 @@ struct fetchOps {
     int (*destroy)(void **rock, afs_int32 error);
 };
 
+/* One contiguous run of dirty chunks, stored with a single StoreData call.
+ * afs_CacheStoreVCache may hand runs to the background daemons, so that
+ * several of them are in flight at once; the dcaches stay share-locked by
+ * the thread that collected them until the run is finished.
+ */
+struct afs_storeRun {
+    struct vcache *avc;
+    struct dcache **dclist;	/* first dcache of the run */
+    afs_uint32 nchunks;
+    afs_size_t base;
+    afs_size_t bytes;
+    afs_size_t length;		/* file length to send to the fileserver */
+    int sync;
+    int nomore;			/* last run of the store */
+    struct brequest *bp;	/* background request, if queued */
+    struct vrequest req;	/* private copy of the request, for bkg */
+    afs_hyper_t newDV;		/* DV bumps done by this run */
+    int doProcessFS;
+    struct AFSFetchStatus OutStatus;
+    afs_int32 code;
+};
+
 /* fakestat support: opaque storage for afs_EvalFakeStat to remember
  * what vcache should be released.
  */
@@ -1627,6 +1627,23 @@ afs_syscall_call(long parm, long parm2, long parm3,
 	default:
 	    code = EINVAL;
 	}
+    } else if (parm == AFSOP_SET_MAXCHUNK) {
+	/* must come before AFSOP_CACHEINIT, which lays out the chunks */
+	if (afs_CacheInit_Done) {
+	    code = EBUSY;
+	} else if (parm2 < 0 || parm2 > 30) {
+	    code = EINVAL;
+	} else {
+	    afs_MaxLogChunk = parm2;
+	    code = 0;
+	}
+    } else if (parm == AFSOP_SET_READAHEAD) {
+	if (parm2 < 0 || parm2 > AFS_MAXREADAHEAD_LIMIT) {
+	    code = EINVAL;
+	} else {
+	    afs_maxReadAhead = parm2;
+	    code = 0;
+	}
     } else if (parm == AFSOP_SET_VOLUME_TTL) {
 	if ((parm2 < AFS_MIN_VOLUME_TTL) || (parm2 > AFS_MAX_VOLUME_TTL)) {
 	    code = EFAULT;
@@ -1846,6 +1863,8 @@ shutdown_afstest(void)
     afs_initState = afs_termState = 0;
     AFS_Running = afs_CB_Running = 0;
     afs_CacheInit_Done = afs_Go_Done = 0;
+    afs_MaxLogChunk = 0;
+    afs_maxReadAhead = AFS_MAXREADAHEAD;
     if (afs_cold_shutdown) {
 	*afs_rootVolumeName = 0;
     }
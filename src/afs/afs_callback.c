@@ -872,6 +872,7 @@ SRXAFSCB_GetXStats(struct rx_call *a_call, afs_int32 a_clientVersionNum,
 	 */
 	afs_stats_cmperf.numPerfCalls++;
 	afs_CountServers();
+	osi_dnlc_xstats();
 	dataBytes = sizeof(afs_stats_cmperf);
 	dataBuffP = (afs_int32 *) afs_osi_Alloc(dataBytes);
 	osi_Assert(dataBuffP != NULL);
@@ -893,6 +894,7 @@ SRXAFSCB_GetXStats(struct rx_call *a_call, afs_int32 a_clientVersionNum,
 	 */
 	afs_stats_cmperf.numPerfCalls++;
 	afs_CountServers();
+	osi_dnlc_xstats();
 	memcpy((char *)(&(afs_stats_cmfullperf.perf)),
 	       (char *)(&afs_stats_cmperf), sizeof(struct afs_stats_CMPerf));
 	afs_stats_cmfullperf.numFullPerfCalls++;
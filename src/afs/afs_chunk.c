@@ -25,3 +25,45 @@
 afs_int32 afs_FirstCSize = AFS_DEFAULTCSIZE;
 afs_int32 afs_OtherCSize = AFS_DEFAULTCSIZE;
 afs_int32 afs_LogChunk = AFS_DEFAULTLSIZE;
+
+/* log(2) of the largest chunk size, from afsd; 0 means all chunks after the
+ * first are afs_OtherCSize */
+afs_int32 afs_MaxLogChunk = 0;
+afs_int32 afs_ChunkTiers = 0;
+afs_size_t afs_ChunkTierBase[AFS_MAXCHUNKTIERS + 1] = { AFS_DEFAULTCSIZE };
+
+/* Keep the tier bases well clear of overflowing an afs_size_t. */
+#define AFS_MAXTIERBASE ((afs_uint64)1 << (sizeof(afs_size_t) * 8 - 2))
+
+/*
+ * Set up the chunk tiers described in afs_chunkops.h, growing chunks from
+ * afs_OtherCSize up to 2^afs_MaxLogChunk bytes.  No chunk may be more than
+ * a sixteenth of the cache (ablocks 1K blocks), so that a few large chunks
+ * cannot push everything else out of it.  The memory cache allocates every
+ * chunk at afs_FirstCSize, so it keeps to fixed size chunks.
+ */
+void
+afs_InitChunkTiers(afs_int32 ablocks, int amemcache)
+{
+    afs_uint64 base;
+    int maxlog = afs_MaxLogChunk;
+    int t, tiers;
+
+    while (maxlog > afs_LogChunk
+	   && (((afs_uint64)ablocks << 10) >> maxlog) < 16)
+	maxlog--;
+    tiers = maxlog - afs_LogChunk;
+    if (amemcache || tiers < 0)
+	tiers = 0;
+    if (tiers > AFS_MAXCHUNKTIERS)
+	tiers = AFS_MAXCHUNKTIERS;
+
+    afs_ChunkTierBase[0] = base = afs_FirstCSize;
+    for (t = 0; t < tiers; t++) {
+	base += (afs_uint64)AFS_TIERCHUNKS << (afs_LogChunk + t);
+	if (base > AFS_MAXTIERBASE)
+	    break;
+	afs_ChunkTierBase[t + 1] = base;
+    }
+    afs_ChunkTiers = t;
+}
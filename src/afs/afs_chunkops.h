@@ -15,37 +15,131 @@
     and AFS_CHUNKBASE gives the byte offset of the base of the chunk.
       AFS_CHUNKSIZE gives the size of the chunk containing an offset.
       AFS_CHUNKTOBASE converts a chunk # to a base position.
+      AFS_CHUNKTOSIZE gives the size of a chunk #.
       Chunks are 0 based and go up by exactly 1, covering the file.
       The other fields are internal and shouldn't be used */
+
+/*
+ * Chunk 0 is afs_FirstCSize bytes.  The chunks after it are afs_OtherCSize
+ * bytes, unless afs_ChunkTiers is set: then they come in tiers of
+ * AFS_TIERCHUNKS chunks, each tier with chunks twice the size of the one
+ * before, up to AFS_MAXCSIZE.  Tier t starts at afs_ChunkTierBase[t], and
+ * the last tier goes on to the end of the file.  So small files and the
+ * start of every file are cached in small chunks, and large files in far
+ * fewer, larger ones.  The layout depends only on the offset, so it is the
+ * same for every file.
+ */
 /* basic parameters */
 
 #define AFS_OTHERCSIZE  (afs_OtherCSize)
 #define AFS_LOGCHUNK    (afs_LogChunk)
 #define AFS_FIRSTCSIZE  (afs_FirstCSize)
+#define AFS_MAXCSIZE	(1 << (afs_LogChunk + afs_ChunkTiers))
 
 #define AFS_DEFAULTCSIZE 0x10000
 #define AFS_DEFAULTLSIZE 16
 
-#define AFS_CHUNKOFFSET(offset) ((offset < afs_FirstCSize) ? offset : \
-			 ((offset - afs_FirstCSize) & (afs_OtherCSize - 1)))
+#define AFS_LOGTIERCHUNKS	3
+#define AFS_TIERCHUNKS		(1 << AFS_LOGTIERCHUNKS)
+#define AFS_MAXCHUNKTIERS	16
+
+extern afs_int32 afs_FirstCSize;
+extern afs_int32 afs_OtherCSize;
+extern afs_int32 afs_LogChunk;
+extern afs_int32 afs_ChunkTiers;
+extern afs_size_t afs_ChunkTierBase[];
+
+/* tier of an offset past the first chunk */
+static_inline int
+afs_OffsetToTier(afs_size_t offset)
+{
+    int t;
+
+    for (t = afs_ChunkTiers; t > 0 && offset < afs_ChunkTierBase[t]; t--)
+	;
+    return t;
+}
+
+/* tier of a chunk # other than 0 */
+static_inline int
+afs_ChunkToTier(afs_int32 chunk)
+{
+    int t = (chunk - 1) >> AFS_LOGTIERCHUNKS;
+
+    return (t < afs_ChunkTiers) ? t : afs_ChunkTiers;
+}
+
+static_inline afs_int32
+afs_Chunk(afs_size_t offset)
+{
+    int t;
+
+    if (offset < afs_FirstCSize)
+	return 0;
+    t = afs_OffsetToTier(offset);
+    return 1 + (t << AFS_LOGTIERCHUNKS)
+	+ (afs_int32) ((offset - afs_ChunkTierBase[t]) >> (afs_LogChunk + t));
+}
+
+static_inline afs_size_t
+afs_ChunkBase(afs_size_t offset)
+{
+    int t;
+
+    if (offset < afs_FirstCSize)
+	return 0;
+    t = afs_OffsetToTier(offset);
+    return afs_ChunkTierBase[t]
+	+ ((offset - afs_ChunkTierBase[t])
+	   & ~(((afs_size_t) 1 << (afs_LogChunk + t)) - 1));
+}
+
+static_inline afs_int32
+afs_ChunkSize(afs_size_t offset)
+{
+    if (offset < afs_FirstCSize)
+	return afs_FirstCSize;
+    return 1 << (afs_LogChunk + afs_OffsetToTier(offset));
+}
+
+static_inline afs_size_t
+afs_ChunkToBase(afs_int32 chunk)
+{
+    int t;
+
+    if (chunk == 0)
+	return 0;
+    t = afs_ChunkToTier(chunk);
+    return afs_ChunkTierBase[t]
+	+ ((afs_size_t) (chunk - 1 - (t << AFS_LOGTIERCHUNKS))
+	   << (afs_LogChunk + t));
+}
+
+static_inline afs_int32
+afs_ChunkToSize(afs_int32 chunk)
+{
+    if (chunk == 0)
+	return afs_FirstCSize;
+    return 1 << (afs_LogChunk + afs_ChunkToTier(chunk));
+}
+
+#define AFS_CHUNKOFFSET(offset) ((offset) - afs_ChunkBase(offset))
 
-#define AFS_CHUNK(offset) ((offset < afs_FirstCSize) ? 0 : \
-	                 (((offset - afs_FirstCSize) >> afs_LogChunk) + 1))
+#define AFS_CHUNK(offset) afs_Chunk(offset)
 
-#define AFS_CHUNKBASE(offset) ((offset < afs_FirstCSize) ? 0 : \
-	(((offset - afs_FirstCSize) & ~(afs_OtherCSize - 1)) + afs_FirstCSize))
+#define AFS_CHUNKBASE(offset) afs_ChunkBase(offset)
 
-#define AFS_CHUNKSIZE(offset) ((offset < afs_FirstCSize) ? afs_FirstCSize : \
-			       afs_OtherCSize)
+#define AFS_CHUNKSIZE(offset) afs_ChunkSize(offset)
 
-#define AFS_CHUNKTOBASE(chunk) ((chunk == 0) ? 0 :               \
-	((afs_size_t) afs_FirstCSize + ((afs_size_t) (chunk - 1) << afs_LogChunk)))
+#define AFS_CHUNKTOBASE(chunk) afs_ChunkToBase(chunk)
 
-#define AFS_CHUNKTOSIZE(chunk) ((chunk == 0) ? afs_FirstCSize :	afs_OtherCSize)
+#define AFS_CHUNKTOSIZE(chunk) afs_ChunkToSize(chunk)
 
-/* sizes are a power of two */
+/* sizes are a power of two; this drops any tiers, which
+ * afs_InitChunkTiers sets up again */
 #define AFS_SETCHUNKSIZE(chunk) { afs_LogChunk = chunk; \
-		      afs_FirstCSize = afs_OtherCSize = (1 << chunk);  }
+		      afs_FirstCSize = afs_OtherCSize = (1 << chunk);  \
+		      afs_ChunkTierBase[0] = afs_FirstCSize; afs_ChunkTiers = 0; }
 
 /**
  * The states a dcache slot can be in.
@@ -48,6 +48,7 @@ afs_int32 afs_CheckServerDaemonStarted = 0;
 afs_int32 afs_probe_interval = DEFAULT_PROBE_INTERVAL;
 afs_int32 afs_probe_all_interval = 600;
 afs_int32 afs_preCache = 0;
+afs_int32 afs_maxReadAhead = AFS_MAXREADAHEAD;
 
 #define PROBE_WAIT() (1000 * (afs_probe_interval - ((afs_random() & 0x7fffffff) \
 		      % (afs_probe_interval/2))))
@@ -604,6 +605,32 @@ BInvalidateSegments(struct brequest *ab)
     }
 }
 
+static void
+BBulkStat(struct brequest *ab)
+{
+    afs_BulkStatBkg(ab->vc, (AFSFid *)ab->ptr_parm[0], (int)ab->size_parm[0],
+		    ab->size_parm[1], ab->cred);
+}
+
+static void
+BStoreRun(struct brequest *ab)
+{
+    struct afs_storeRun *run = (struct afs_storeRun *)ab->ptr_parm[0];
+
+    AFS_STATCNT(BStore);
+    /* the queueing thread holds the vnode and dcache locks for us */
+    afs_StoreRun(run, &run->req);
+
+    if ((ab->flags & BUVALID) == 0) {
+	ab->code_raw = ab->code_checkcode = run->code;
+	ab->flags |= BUVALID;
+	if (ab->flags & BUWAIT) {
+	    ab->flags &= ~BUWAIT;
+	    afs_osi_Wakeup(ab);
+	}
+    }
+}
+
 /* release a held request buffer */
 void
 afs_BRelease(struct brequest *ab)
@@ -994,6 +1021,25 @@ brequest_release(struct brequest *tb)
     afs_BRelease(tb);  /* this grabs and releases afs_xbrs lock */
 }
 
+/* Take back a request queued with ause 1 that no daemon has picked up yet,
+ * so that the caller can do the work itself.  Returns 1 if the request was
+ * reclaimed, in which case both references to it have been dropped.
+ */
+int
+afs_BCancel(struct brequest *ab)
+{
+    ObtainWriteLock(&afs_xbrs, 1211);
+    if (ab->flags & BSTARTED) {
+	ReleaseWriteLock(&afs_xbrs);
+	return 0;
+    }
+    ab->flags |= BSTARTED;	/* keep the daemons away from it */
+    ReleaseWriteLock(&afs_xbrs);
+    brequest_release(ab);
+    afs_BRelease(ab);
+    return 1;
+}
+
 #ifdef AFS_NEW_BKG
 static_inline int
 should_do_noop(int foundAny, int n_processed)
@@ -1149,6 +1195,10 @@ afs_BackgroundDaemon(void)
 		BPartialStore(tb);
 	    else if (tb->opcode == BOP_INVALIDATE_SEGMENTS)
 		BInvalidateSegments(tb);
+	    else if (tb->opcode == BOP_STORE_RUN)
+		BStoreRun(tb);
+	    else if (tb->opcode == BOP_BULKSTAT)
+		BBulkStat(tb);
 	    else
 		panic("background bop");
 	    brequest_release(tb);
@@ -23,8 +23,9 @@
 #include <opr/ffs.h>
 
 /* Forward declarations. */
-static void afs_GetDownD(int anumber, int *aneedSpace, afs_int32 buckethint);
-static int afs_FreeDiscardedDCache(void);
+static int afs_GetDownD(int anumber, int *aneedSpace, afs_int32 buckethint);
+static int afs_GetDownDSlot(int anumber);
+static int afs_FreeDiscardedDCache(int anumber);
 static void afs_DiscardDCache(struct dcache *);
 static void afs_FreeDCache(struct dcache *);
 /* For split cache */
@@ -53,6 +54,7 @@ afs_int32 afs_freeDCCount;	/*!< Count of elts in freeDCList */
 afs_int32 afs_discardDCList;	/*!< Discarded disk cache entries */
 afs_int32 afs_discardDCCount;	/*!< Count of elts in discardDCList */
 struct dcache *afs_freeDSList;	/*!< Free list for disk slots */
+afs_int32 afs_freeDSCount;	/*!< Count of elts in freeDSList */
 struct dcache *afs_Initial_freeDSList;	/*!< Initial list for above */
 afs_dcache_id_t cacheInode;               /*!< Inode for CacheItems file */
 struct osi_file *afs_cacheInodep = 0;	/*!< file for CacheItems inode */
@@ -99,6 +101,7 @@ afs_uint32 afs_CacheTooFullCount = 0;
 afs_uint32 afs_WaitForCacheDrainCount = 0;
 
 afs_int32 afs_dcentries;	/*!< In-memory dcache entries */
+static afs_int32 afs_freeDSLowat;	/*!< Free entries the truncate daemon keeps */
 
 
 int dcacheDisabled = 0;
@@ -408,7 +411,8 @@ afs_MaybeWakeupTruncateDaemon(void)
 	if (!afs_TruncateDaemonRunning)
 	    afs_osi_Wakeup((int *)afs_CacheTruncateDaemon);
     } else if (!afs_TruncateDaemonRunning
-	       && afs_blocksDiscarded > CM_MAXDISCARDEDCHUNKS) {
+	       && (afs_blocksDiscarded > CM_MAXDISCARDEDCHUNKS
+		   || afs_freeDSCount < afs_freeDSLowat)) {
 	afs_osi_Wakeup((int *)afs_CacheTruncateDaemon);
     }
 }
@@ -492,7 +496,8 @@ afs_CacheTruncateDaemon(void)
 		if (slots_needed < 0)
 		    slots_needed = 0;
 		if (slots_needed || space_needed)
-		    afs_GetDownD(slots_needed, &space_needed, 0);
+		    afs_stats_cmperf.dcacheBgEvictions +=
+			afs_GetDownD(slots_needed, &space_needed, 0);
 		if ((space_needed <= 0) && (slots_needed <= 0)) {
 		    break;
 		}
@@ -504,6 +509,13 @@ afs_CacheTruncateDaemon(void)
 		afs_WakeCacheWaitersIfDrained();
 	    }
 	}	/* end of cache cleanup */
+	if (afs_freeDSCount < afs_freeDSLowat) {
+	    /* Write back and free in-memory entries ahead of afs_GetDSlot
+	     * needing them, rather than leaving it to do so in the
+	     * foreground. */
+	    afs_stats_cmperf.dcacheBgEvictions +=
+		afs_GetDownDSlot(2 * afs_freeDSLowat);
+	}
 	ReleaseWriteLock(&afs_xdcache);
 
 	/*
@@ -523,7 +535,7 @@ afs_CacheTruncateDaemon(void)
 	 */
 	while (afs_blocksDiscarded && !afs_WaitForCacheDrain
 	       && (afs_termState != AFSOP_STOP_TRUNCDAEMON)) {
-	    int code = afs_FreeDiscardedDCache();
+	    int code = afs_FreeDiscardedDCache(CM_DISCARDBATCH);
 	    if (code) {
 		/* If we can't free any discarded dcache entries, that's okay.
 		 * We're just doing this in the background; if someone needs
@@ -585,7 +597,8 @@ afs_AdjustSize(struct dcache *adc, afs_int32 newSize)
 
     AFS_STATCNT(afs_AdjustSize);
 
-    if (newSize > afs_OtherCSize && !(adc->f.fid.Fid.Vnode & 1)) {
+    if (newSize > AFS_CHUNKTOSIZE(adc->f.chunk)
+	&& !(adc->f.fid.Fid.Vnode & 1)) {
         /* No non-dir cache files should be larger than the chunk size.
          * (Directory blobs are fetched in a single chunk file, so directories
          * can be larger.) If someone is requesting that a chunk is larger than
@@ -598,7 +611,7 @@ afs_AdjustSize(struct dcache *adc, afs_int32 newSize)
                      "should not happen, but trying to continue regardless. If "
                      "AFS starts hanging or behaving strangely, this might be "
                      "why.\n",
-                     adc->index, newSize, afs_OtherCSize);
+                     adc->index, newSize, AFS_CHUNKTOSIZE(adc->f.chunk));
         }
     }
 
@@ -626,6 +639,8 @@ afs_AdjustSize(struct dcache *adc, afs_int32 newSize)
  * \param anumber Number of entries that should ideally be moved.
  * \param aneedSpace How much space we need (1K blocks);
  *
+ * \return The number of entries moved.
+ *
  * \note Environment:
  *	The anumber parameter is just a hint; at least one entry MUST be
  *	moved, or we'll panic.  We must be called with afs_xdcache
@@ -642,7 +657,7 @@ afs_AdjustSize(struct dcache *adc, afs_int32 newSize)
  */
 
 #define	MAXATONCE   16		/* max we can obtain at once */
-static void
+static int
 afs_GetDownD(int anumber, int *aneedSpace, afs_int32 buckethint)
 {
 
@@ -660,6 +675,7 @@ afs_GetDownD(int anumber, int *aneedSpace, afs_int32 buckethint)
     afs_uint32 maxVictimPtr;	/* where it is */
     int discard;
     int curbucket;
+    int nevicted = 0;
 
     AFS_STATCNT(afs_GetDownD);
 
@@ -671,7 +687,7 @@ afs_GetDownD(int anumber, int *aneedSpace, afs_int32 buckethint)
     if (!aneedSpace || *aneedSpace <= 0) {
 	anumber -= afs_freeDCCount;
 	if (anumber <= 0) {
-	    return;		/* enough already free */
+	    return 0;		/* enough already free */
 	}
     }
 
@@ -932,6 +948,7 @@ afs_GetDownD(int anumber, int *aneedSpace, afs_int32 buckethint)
 			afs_FreeDCache(tdc);
 		    }
 		    anumber--;
+		    nevicted++;
 		    j = 1;	/* we reclaimed at least one victim */
 		}
 	    }
@@ -955,7 +972,7 @@ afs_GetDownD(int anumber, int *aneedSpace, afs_int32 buckethint)
 	}
     }				/* big while loop */
 
-    return;
+    return nevicted;
 
 }				/*afs_GetDownD */
 
@@ -1174,20 +1191,31 @@ afs_GetDSlotFromList(struct dcache **adc, afs_int32 *indexp)
 }
 
 /*!
- * Free the next element on the list of discarded cache elements.
+ * Free up to anumber elements from the list of discarded cache elements.
+ *
+ * The elements are taken off the list, truncated and put on the free list
+ * as a batch, so that afs_xdcache is obtained twice per batch rather than
+ * twice per element.
+ *
+ * \param anumber Most elements to free; at most CM_DISCARDBATCH.
  *
  * Returns -1 if we encountered an error preventing us from freeing a
  * discarded dcache, or 0 on success.
  */
 static int
-afs_FreeDiscardedDCache(void)
+afs_FreeDiscardedDCache(int anumber)
 {
     struct dcache *tdc;
+    struct dcache *victims[CM_DISCARDBATCH];
     struct osi_file *tfile;
     afs_int32 size;
+    int i, nvictims;
 
     AFS_STATCNT(afs_FreeDiscardedDCache);
 
+    if (anumber > CM_DISCARDBATCH)
+	anumber = CM_DISCARDBATCH;
+
     ObtainWriteLock(&afs_xdcache, 510);
     if (!afs_blocksDiscarded) {
 	ReleaseWriteLock(&afs_xdcache);
@@ -1195,41 +1223,51 @@ afs_FreeDiscardedDCache(void)
     }
 
     /*
-     * Get an entry from the list of discarded cache elements
+     * Get entries from the list of discarded cache elements
      */
-    (void)afs_GetDSlotFromList(&tdc, &afs_discardDCList);
-    if (!tdc) {
-	ReleaseWriteLock(&afs_xdcache);
-	return -1;
-    }
+    for (nvictims = 0; nvictims < anumber && afs_blocksDiscarded;
+	 nvictims++) {
+	(void)afs_GetDSlotFromList(&tdc, &afs_discardDCList);
+	if (!tdc)
+	    break;
 
-    afs_discardDCCount--;
-    size = afs_round_to_fsfragsize(tdc->f.chunkBytes);
-    afs_blocksDiscarded -= size;
+	afs_discardDCCount--;
+	size = afs_round_to_fsfragsize(tdc->f.chunkBytes);
+	afs_blocksDiscarded -= size;
+	/* We can lock because we just took it off the free list */
+	ObtainWriteLock(&tdc->lock, 626);
+	victims[nvictims] = tdc;
+    }
     afs_stats_cmperf.cacheBlocksDiscarded = afs_blocksDiscarded;
-    /* We can lock because we just took it off the free list */
-    ObtainWriteLock(&tdc->lock, 626);
     ReleaseWriteLock(&afs_xdcache);
+    if (nvictims == 0)
+	return -1;
 
     /*
-     * Truncate the element to reclaim its space
+     * Truncate the elements to reclaim their space
      */
-    tfile = afs_CFileOpen(&tdc->f.inode);
-    osi_Assert(tfile);
-    afs_CFileTruncate(tfile, 0);
-    afs_CFileClose(tfile);
-    afs_AdjustSize(tdc, 0);
-    afs_DCMoveBucket(tdc, 0, 0);
+    for (i = 0; i < nvictims; i++) {
+	tdc = victims[i];
+	tfile = afs_CFileOpen(&tdc->f.inode);
+	osi_Assert(tfile);
+	afs_CFileTruncate(tfile, 0);
+	afs_CFileClose(tfile);
+	afs_AdjustSize(tdc, 0);
+	afs_DCMoveBucket(tdc, 0, 0);
+    }
 
     /*
-     * Free the element we just truncated
+     * Free the elements we just truncated
      */
     ObtainWriteLock(&afs_xdcache, 511);
-    afs_indexFlags[tdc->index] &= ~IFDiscarded;
-    afs_FreeDCache(tdc);
-    tdc->f.states &= ~(DRO|DBackup|DRW);
-    ReleaseWriteLock(&tdc->lock);
-    afs_PutDCache(tdc);
+    for (i = 0; i < nvictims; i++) {
+	tdc = victims[i];
+	afs_indexFlags[tdc->index] &= ~IFDiscarded;
+	afs_FreeDCache(tdc);
+	tdc->f.states &= ~(DRO|DBackup|DRW);
+	ReleaseWriteLock(&tdc->lock);
+	afs_PutDCache(tdc);
+    }
     ReleaseWriteLock(&afs_xdcache);
 
     return 0;
@@ -1250,7 +1288,7 @@ afs_MaybeFreeDiscardedDCache(void)
     while (afs_blocksDiscarded
 	   && (afs_blocksUsed >
 	       PERCENT(CM_WAITFORDRAINPCT, afs_cacheBlocks))) {
-	int code = afs_FreeDiscardedDCache();
+	int code = afs_FreeDiscardedDCache(1);
 	if (code) {
 	    /* Callers depend on us to get the afs_blocksDiscarded count down.
 	     * If we cannot do that, the callers can spin by calling us over
@@ -1267,17 +1305,20 @@ afs_MaybeFreeDiscardedDCache(void)
  *
  * \param anumber Targeted number of disk slots to free up.
  *
+ * \return The number of disk slots freed.
+ *
  * \note Environment:
  *	Must be called with afs_xdcache write-locked.
  *
  */
-static void
+static int
 afs_GetDownDSlot(int anumber)
 {
     struct afs_q *tq, *nq;
     struct dcache *tdc;
     int ix;
     unsigned int cnt;
+    int nfreed = 0;
 
     AFS_STATCNT(afs_GetDownDSlot);
     if (cacheDiskType == AFS_FCACHE_TYPE_MEM)
@@ -1287,10 +1328,9 @@ afs_GetDownDSlot(int anumber)
 	osi_Panic("getdowndslot nolock");
 
     /* decrement anumber first for all dudes in free list */
-    for (tdc = afs_freeDSList; tdc; tdc = (struct dcache *)tdc->lruq.next)
-	anumber--;
+    anumber -= afs_freeDSCount;
     if (anumber <= 0)
-	return;			/* enough already free */
+	return 0;		/* enough already free */
 
     for (cnt = 0, tq = afs_DLRU.prev; tq != &afs_DLRU && anumber > 0;
 	 tq = nq, cnt++) {
@@ -1329,7 +1369,7 @@ afs_GetDownDSlot(int anumber)
 		     * if afs_WriteDCache() failed once it is likely to
 		     * continue failing for subsequent dcaches.
 		     */
-		    return;
+		    return nfreed;
 		}
 		tdc->dflags &= ~DFEntryMod;
 #endif
@@ -1342,9 +1382,12 @@ afs_GetDownDSlot(int anumber)
 	    tdc->index = NULLIDX;
 	    tdc->lruq.next = (struct afs_q *)afs_freeDSList;
 	    afs_freeDSList = tdc;
+	    afs_freeDSCount++;
 	    anumber--;
+	    nfreed++;
 	}
     }
+    return nfreed;
 }				/*afs_GetDownDSlot */
 
 
@@ -2172,7 +2215,8 @@ afs_GetDCache(struct vcache *avc, afs_size_t abyte,
 		if (!setLocks)
 		    avc->f.states |= CDCLock;
 		/* just need slots */
-		afs_GetDownD(5, (int *)0, afs_DCGetBucket(avc));
+		afs_stats_cmperf.dcacheFgEvictions +=
+		    afs_GetDownD(5, (int *)0, afs_DCGetBucket(avc));
 		if (!setLocks)
 		    avc->f.states &= ~CDCLock;
 	    }
@@ -2981,7 +3025,7 @@ afs_WriteThroughDSlots(void)
 	struct afs_fheader theader;
 
 	afs_InitFHeader(&theader);
-	afs_osi_Write(afs_cacheInodep, 0, &theader, sizeof(theader));
+	afs_osi_Write(afs_cacheInodep, 0, &theader, AFS_FHEADER_SIZE);
     }
     ReleaseWriteLock(&afs_xdcache);
     return 0;
@@ -3034,7 +3078,7 @@ afs_MemGetDSlot(afs_int32 aslot, dslot_state type)
     osi_Assert(type == DSLOT_NEW);
 
     if (!afs_freeDSList)
-	afs_GetDownDSlot(4);
+	afs_stats_cmperf.dcacheFgEvictions += afs_GetDownDSlot(4);
     if (!afs_freeDSList) {
 	/* none free, making one is better than a panic */
 	afs_stats_cmperf.dcacheXAllocs++;	/* count in case we have a leak */
@@ -3046,6 +3090,7 @@ afs_MemGetDSlot(afs_int32 aslot, dslot_state type)
     } else {
 	tdc = afs_freeDSList;
 	afs_freeDSList = (struct dcache *)tdc->lruq.next;
+	afs_freeDSCount--;
 	existing = 1;
     }
     tdc->dflags = 0;	/* up-to-date, not in free q */
@@ -3152,7 +3197,7 @@ afs_UFSGetDSlot(afs_int32 aslot, dslot_state type)
 
     /* otherwise we should read it in from the cache file */
     if (!afs_freeDSList)
-	afs_GetDownDSlot(4);
+	afs_stats_cmperf.dcacheFgEvictions += afs_GetDownDSlot(4);
     if (!afs_freeDSList) {
 	/* none free, making one is better than a panic */
 	afs_stats_cmperf.dcacheXAllocs++;	/* count in case we have a leak */
@@ -3164,7 +3209,10 @@ afs_UFSGetDSlot(afs_int32 aslot, dslot_state type)
     } else {
 	tdc = afs_freeDSList;
 	afs_freeDSList = (struct dcache *)tdc->lruq.next;
+	afs_freeDSCount--;
 	existing = 1;
+	if (afs_freeDSCount < afs_freeDSLowat)
+	    afs_MaybeWakeupTruncateDaemon();
     }
     tdc->dflags = 0;	/* up-to-date, not in free q */
     tdc->mflags = 0;
@@ -3175,7 +3223,7 @@ afs_UFSGetDSlot(afs_int32 aslot, dslot_state type)
     /*
      * Seek to the aslot'th entry and read it in.
      */
-    off = sizeof(struct fcache)*aslot + sizeof(struct afs_fheader);
+    off = sizeof(struct fcache)*aslot + AFS_FHEADER_SIZE;
     code =
 	afs_osi_Read(afs_cacheInodep,
 		     off, (char *)(&tdc->f),
@@ -3200,6 +3248,7 @@ afs_UFSGetDSlot(afs_int32 aslot, dslot_state type)
 	    tdc->index = NULLIDX;
 	    tdc->lruq.next = (struct afs_q *)afs_freeDSList;
 	    afs_freeDSList = tdc;
+	    afs_freeDSCount++;
 	    return NULL;
 	}
     }
@@ -3316,11 +3365,11 @@ afs_WriteDCache(struct dcache *adc, int atime)
     code =
 	afs_osi_Write(afs_cacheInodep,
 		      sizeof(struct fcache) * adc->index +
-		      sizeof(struct afs_fheader), (char *)(&adc->f),
+		      AFS_FHEADER_SIZE, (char *)(&adc->f),
 		      sizeof(struct fcache));
     if (code != sizeof(struct fcache)) {
 	afs_warn("afs: failed to write to CacheItems off %ld code %d/%d\n",
-	         (long)(sizeof(struct fcache) * adc->index + sizeof(struct afs_fheader)),
+	         (long)(sizeof(struct fcache) * adc->index + AFS_FHEADER_SIZE),
 	         (int)code, (int)sizeof(struct fcache));
 	return EIO;
     }
@@ -3546,6 +3595,7 @@ afs_dcacheInit(int afiles, int ablocks, int aDentries, int achunk, int aflags)
     afs_discardDCList = NULLIDX;
     afs_freeDCCount = 0;
     afs_freeDSList = NULL;
+    afs_freeDSCount = 0;
     hzero(afs_indexCounter);
 
     LOCK_INIT(&afs_xdcache, "afs_xdcache");
@@ -3558,6 +3608,7 @@ afs_dcacheInit(int afiles, int ablocks, int aDentries, int achunk, int aflags)
 	    achunk = 13;	/* Use default */
 	AFS_SETCHUNKSIZE(achunk);
     }
+    afs_InitChunkTiers(ablocks, aflags & AFSCALL_INIT_MEMCACHE);
 
     if (!aDentries)
 	aDentries = DDSIZE;
@@ -3624,6 +3675,7 @@ afs_dcacheInit(int afiles, int ablocks, int aDentries, int achunk, int aflags)
 #endif
 
     afs_freeDSList = &tdp[0];
+    afs_freeDSCount = aDentries;
     for (i = 0; i < aDentries - 1; i++) {
 	tdp[i].lruq.next = (struct afs_q *)(&tdp[i + 1]);
         AFS_RWLOCK_INIT(&tdp[i].lock, "dcache lock");
@@ -3640,6 +3692,13 @@ afs_dcacheInit(int afiles, int ablocks, int aDentries, int achunk, int aflags)
     afs_ComputeCacheParms();	/* compute parms based on cache size */
 
     afs_dcentries = aDentries;
+    if ((aflags & AFSCALL_INIT_MEMCACHE) || aDentries >= afiles)
+	afs_freeDSLowat = 0;	/* every entry fits in memory */
+    else {
+	afs_freeDSLowat = PERCENT(CM_DSLOTFREEPCT, aDentries);
+	if (afs_freeDSLowat < 4)
+	    afs_freeDSLowat = 4;
+    }
     afs_blocksUsed = 0;
     afs_stats_cmperf.cacheBucket0_Discarded =
 	afs_stats_cmperf.cacheBucket1_Discarded =
@@ -3730,6 +3789,7 @@ shutdown_dcache(void)
     afs_freeDCList = NULLIDX;
     afs_discardDCList = NULLIDX;
     afs_freeDSList = afs_Initial_freeDSList = 0;
+    afs_freeDSCount = afs_freeDSLowat = 0;
 
     LOCK_INIT(&afs_xdcache, "afs_xdcache");
     QInit(&afs_DLRU);
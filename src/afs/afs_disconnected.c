@@ -839,6 +839,7 @@ afs_ProcessOpCreate(struct vcache *avc, struct vrequest *areq,
     /* XXX: not checking array element contents. It shouldn't be empty.
      * If it oopses, then something else might be wrong.
      */
+    ObtainWriteLock(VCHashLock(hash), 1214);
     if (afs_vhashT[hash] == avc) {
         /* First in hash chain (might be the only one). */
 	afs_vhashT[hash] = avc->hnext;
@@ -851,11 +852,14 @@ afs_ProcessOpCreate(struct vcache *avc, struct vrequest *areq,
 	    }
         }
     }                           /* if (!afs_vhashT[i]->hnext) */
+    ReleaseWriteLock(VCHashLock(hash));
     QRemove(&avc->vhashq);
 
     /* Insert hash in new position. */
+    ObtainWriteLock(VCHashLock(new_hash), 1215);
     avc->hnext = afs_vhashT[new_hash];
     afs_vhashT[new_hash] = avc;
+    ReleaseWriteLock(VCHashLock(new_hash));
     QAdd(&afs_vhashTV[VCHashV(&newFid)], &avc->vhashq);
 
     ReleaseWriteLock(&afs_xvcache);
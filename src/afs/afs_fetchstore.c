@@ -510,9 +510,10 @@ afs_CacheStoreDCaches(struct vcache *avc, struct dcache **dclist,
 		    xferStartTime, bytesToXfer, bytesXferred);
 #endif /* AFS_NOSTATS */
 
-	if ((tdc->f.chunkBytes < afs_OtherCSize)
+	if ((tdc->f.chunkBytes < AFS_CHUNKTOSIZE(tdc->f.chunk))
 		&& (i < (nchunks - 1)) && code == 0) {
-	    code = (*ops->padd)(rock, afs_OtherCSize - tdc->f.chunkBytes);
+	    code = (*ops->padd)(rock, AFS_CHUNKTOSIZE(tdc->f.chunk)
+				      - tdc->f.chunkBytes);
 	}
 	stored += tdc->f.chunkBytes;
 	/* ideally, I'd like to unlock the dcache and turn
@@ -542,6 +543,138 @@ afs_CacheStoreDCaches(struct vcache *avc, struct dcache **dclist,
 }
 
 #define lmin(a,b) (((a) < (b)) ? (a) : (b))
+
+/* Max # of StoreData calls a single afs_CacheStoreVCache keeps in flight */
+afs_int32 afs_storeParallel = AFS_STOREPARALLEL;
+
+/*!
+ *	Store one run of contiguous chunks to the fileserver.
+ *
+ * \param run the run to store; the outcome is left in it
+ * \param areq Ptr to the request structure to use
+ *
+ * \note Called either by the thread that collected the run, or by a
+ *	 background daemon on its behalf.  The dcaches of the run must
+ *	 be share-locked, and the vcache at least share-locked, by the
+ *	 collecting thread.
+ */
+void
+afs_StoreRun(struct afs_storeRun *run, struct vrequest *areq)
+{
+    struct vcache *avc = run->avc;
+    struct storeOps *ops;
+    void *rock = NULL;
+    struct afs_conn *tc;
+    struct rx_connection *rxconn;
+    afs_int32 code;
+
+    afs_Trace4(afs_iclSetp, CM_TRACE_STOREDATA64,
+	       ICL_TYPE_FID, &avc->f.fid.Fid, ICL_TYPE_OFFSET,
+	       ICL_HANDLE_OFFSET(run->base), ICL_TYPE_OFFSET,
+	       ICL_HANDLE_OFFSET(run->bytes), ICL_TYPE_OFFSET,
+	       ICL_HANDLE_OFFSET(run->length));
+
+    do {
+	tc = afs_Conn(&avc->f.fid, areq, 0, &rxconn);
+
+#ifdef AFS_64BIT_CLIENT
+      restart:
+#endif
+	code = rxfs_storeInit(avc, tc, rxconn, run->base, run->bytes,
+			      run->length, run->sync, &ops, &rock);
+	if ( !code ) {
+	    code = afs_CacheStoreDCaches(avc, run->dclist, run->bytes,
+					 &run->newDV, &run->doProcessFS,
+					 &run->OutStatus, run->nchunks,
+					 run->nomore, ops, rock);
+	}
+
+#ifdef AFS_64BIT_CLIENT
+	if (code == RXGEN_OPCODE && !afs_serverHasNo64Bit(tc)) {
+	    afs_serverSetNo64Bit(tc);
+	    goto restart;
+	}
+#endif /* AFS_64BIT_CLIENT */
+    } while (afs_Analyze
+	     (tc, rxconn, code, &avc->f.fid, areq,
+	      AFS_STATS_FS_RPCIDX_STOREDATA, SHARED_LOCK,
+	      NULL));
+
+    run->code = code;
+}
+
+/*
+ * Put back the dcaches of a finished run, and remember its returned
+ * status if it is the newest one seen so far.  Frees the run.
+ */
+static afs_int32
+afs_StoreRunDone(struct afs_storeRun *run, struct vrequest *areq,
+		 int *ahaveStatus, struct AFSFetchStatus *aOutStatus,
+		 afs_hyper_t *anewDV)
+{
+    afs_int32 code = run->code;
+    afs_hyper_t dv, bestDV;
+    unsigned int i;
+
+    for (i = 0; i < run->nchunks; i++) {
+	struct dcache *tdc = run->dclist[i];
+	if (!code) {
+	    if (afs_indexFlags[tdc->index] & IFDataMod) {
+		/*
+		 * LOCKXXX -- should hold afs_xdcache(W) when
+		 * modifying afs_indexFlags.
+		 */
+		afs_indexFlags[tdc->index] &= ~IFDataMod;
+		afs_stats_cmperf.cacheCurrDirtyChunks--;
+		afs_indexFlags[tdc->index] &= ~IFDirtyPages;
+		if (run->sync & AFS_VMSYNC_INVAL) {
+		    /* since we have invalidated all the pages of this
+		     ** vnode by calling osi_VM_TryToSmush, we can
+		     ** safely mark this dcache entry as not having
+		     ** any pages. This vnode now becomes eligible for
+		     ** reclamation by getDownD.
+		     */
+		    afs_indexFlags[tdc->index] &= ~IFAnyPages;
+		}
+	    }
+	}
+	UpgradeSToWLock(&tdc->lock, 628);
+	tdc->f.states &= ~DWriting;	/* correct? */
+	tdc->dflags |= DFEntryMod;
+	ReleaseWriteLock(&tdc->lock);
+	afs_PutDCache(tdc);
+	/* Mark the entry as released */
+	run->dclist[i] = NULL;
+    }
+
+    /* every StoreData that got through bumped the DV once */
+    hadd32(*anewDV, hgetlo(run->newDV));
+
+    if (run->doProcessFS) {
+	/* runs may finish in any order; keep the status with the newest DV */
+	hset64(dv, run->OutStatus.dataVersionHigh, run->OutStatus.DataVersion);
+	hset64(bestDV, aOutStatus->dataVersionHigh, aOutStatus->DataVersion);
+	if (!*ahaveStatus || hcmp(dv, bestDV) > 0) {
+	    *aOutStatus = run->OutStatus;
+	    *ahaveStatus = 1;
+	}
+    }
+
+    afs_stats_cmperf.storeRuns++;
+    if (run->bp)
+	afs_stats_cmperf.storeRunsParallel++;
+    if (!code)
+	afs_stats_cmperf.storeKBytes += run->bytes >> 10;
+    else if (run->bp)
+	/* give our caller the error details the daemon saw */
+	*areq = run->req;
+
+    afs_Trace2(afs_iclSetp, CM_TRACE_STOREALLDCDONE,
+	       ICL_TYPE_POINTER, run->avc, ICL_TYPE_INT32, code);
+    afs_osi_Free(run, sizeof(struct afs_storeRun));
+    return code;
+}
+
 /*!
  *	Called upon store.
  *
@@ -556,6 +689,11 @@ afs_CacheStoreDCaches(struct vcache *avc, struct dcache **dclist,
  * \param amaxStoredLength Ptr to the amount of that is actually stored
  *
  * \note Environment: Nothing interesting.
+ *
+ * \note Long runs of dirty chunks are split, and all but the last run are
+ *	 offered to the background daemons, so that up to afs_storeParallel
+ *	 StoreData calls for the file are in flight at once.  Runs no daemon
+ *	 has picked up by the time we get to them are stored by this thread.
  */
 int
 afs_CacheStoreVCache(struct dcache **dcList, struct vcache *avc,
@@ -563,37 +701,58 @@ afs_CacheStoreVCache(struct dcache **dcList, struct vcache *avc,
 		     unsigned int high, unsigned int moredata,
 		     afs_hyper_t *anewDV, afs_size_t *amaxStoredLength)
 {
-    afs_int32 code = 0;
-    struct storeOps *ops;
-    void * rock = NULL;
-    unsigned int i, j;
+    afs_int32 code = 0, tcode;
+    unsigned int j;
 
     struct AFSFetchStatus OutStatus;
-    int doProcessFS = 0;
-    afs_size_t base, bytes, length;
-    int nomore;
+    int haveStatus = 0;
+    afs_size_t bytes;
     unsigned int first = 0;
-    struct afs_conn *tc;
-    struct rx_connection *rxconn;
+    unsigned int ndirty, runChunks;
+    int split, maxParallel, npending = 0;
+    struct afs_storeRun *run;
+    struct afs_storeRun *pending[AFS_STOREPARALLEL * 2];
+    osi_timeval32_t startTime, endTime;
+
+    osi_GetTime(&startTime);
+
+    /*
+     * Stores of the runs may reach the fileserver in any order, so only
+     * use more than one at a time when they all carry the same length;
+     * a pending truncation must go out first.
+     */
+    maxParallel = afs_storeParallel;
+    if (maxParallel > AFS_STOREPARALLEL * 2)
+	maxParallel = AFS_STOREPARALLEL * 2;
+    if (maxParallel > NBRS / 2)
+	maxParallel = NBRS / 2;
+    if (maxParallel < 1 || avc->f.truncPos != AFS_NOTRUNC)
+	maxParallel = 1;
+
+    for (ndirty = 0, j = 0; j <= high; j++) {
+	if (dcList[j])
+	    ndirty++;
+    }
+    runChunks = (ndirty + maxParallel - 1) / maxParallel;
 
     for (bytes = 0, j = 0; !code && j <= high; j++) {
+	split = 0;
 	if (dcList[j]) {
 	    ObtainSharedLock(&(dcList[j]->lock), 629);
 	    if (!bytes)
 		first = j;
 	    bytes += dcList[j]->f.chunkBytes;
-	    if ((dcList[j]->f.chunkBytes < afs_OtherCSize)
+	    split = (j + 1 - first >= runChunks);
+	    if (!split && (dcList[j]->f.chunkBytes
+			   < AFS_CHUNKTOSIZE(dcList[j]->f.chunk))
 			&& (dcList[j]->f.chunk - minj < high)
 			&& dcList[j + 1]) {
-		int sbytes = afs_OtherCSize - dcList[j]->f.chunkBytes;
+		int sbytes = AFS_CHUNKTOSIZE(dcList[j]->f.chunk)
+			     - dcList[j]->f.chunkBytes;
 		bytes += sbytes;
 	    }
 	}
-	if (bytes && (j == high || !dcList[j + 1])) {
-	    afs_uint32 nchunks;
-	    struct dcache **dclist = &dcList[first];
-	    /* base = AFS_CHUNKTOBASE(dcList[first]->f.chunk); */
-	    base = AFS_CHUNKTOBASE(first + minj);
+	if (bytes && (j == high || !dcList[j + 1] || split)) {
 	    /*
 	     *
 	     * take a list of dcache structs and send them all off to the server
@@ -608,84 +767,38 @@ afs_CacheStoreVCache(struct dcache **dcList, struct vcache *avc,
 	     * are doing the last RPC for this close, ie, storing back the last
 	     * set of contiguous chunks of a file.
 	     */
-
-	    nchunks = 1 + j - first;
-	    nomore = !(moredata || (j != high));
-	    length = lmin(avc->f.m.Length, avc->f.truncPos);
-	    afs_Trace4(afs_iclSetp, CM_TRACE_STOREDATA64,
-		       ICL_TYPE_FID, &avc->f.fid.Fid, ICL_TYPE_OFFSET,
-		       ICL_HANDLE_OFFSET(base), ICL_TYPE_OFFSET,
-		       ICL_HANDLE_OFFSET(bytes), ICL_TYPE_OFFSET,
-		       ICL_HANDLE_OFFSET(length));
-
-	    do {
-	        tc = afs_Conn(&avc->f.fid, areq, 0, &rxconn);
-
-#ifdef AFS_64BIT_CLIENT
-	      restart:
-#endif
-		code = rxfs_storeInit(avc, tc, rxconn, base, bytes, length,
-				      sync, &ops, &rock);
-		if ( !code ) {
-		    code = afs_CacheStoreDCaches(avc, dclist, bytes, anewDV,
-			                         &doProcessFS, &OutStatus,
-						 nchunks, nomore, ops, rock);
-		}
-
-#ifdef AFS_64BIT_CLIENT
-		if (code == RXGEN_OPCODE && !afs_serverHasNo64Bit(tc)) {
-		    afs_serverSetNo64Bit(tc);
-		    goto restart;
+	    run = afs_osi_Alloc(sizeof(struct afs_storeRun));
+	    if (!run) {
+		/* put back this run along with the rest */
+		code = ENOMEM;
+		j = first;
+		ReleaseSharedLock(&(dcList[j]->lock));
+		afs_PutDCache(dcList[j]);
+		dcList[j] = NULL;
+	    } else {
+		memset(run, 0, sizeof(struct afs_storeRun));
+		run->avc = avc;
+		run->dclist = &dcList[first];
+		run->nchunks = 1 + j - first;
+		/* base = AFS_CHUNKTOBASE(dcList[first]->f.chunk); */
+		run->base = AFS_CHUNKTOBASE(first + minj);
+		run->bytes = bytes;
+		run->length = lmin(avc->f.m.Length, avc->f.truncPos);
+		run->sync = sync;
+		run->nomore = !(moredata || (j != high));
+
+		if (j != high && npending < maxParallel - 1 && !afs_BBusy()) {
+		    run->req = *areq;
+		    run->bp = afs_BQueue(BOP_STORE_RUN, avc, B_DONTWAIT, 1, NULL,
+					 0, 0, run, NULL, NULL);
 		}
-#endif /* AFS_64BIT_CLIENT */
-	    } while (afs_Analyze
-		     (tc, rxconn, code, &avc->f.fid, areq,
-		      AFS_STATS_FS_RPCIDX_STOREDATA, SHARED_LOCK,
-		      NULL));
-
-	    /* put back all remaining locked dcache entries */
-	    for (i = 0; i < nchunks; i++) {
-		struct dcache *tdc = dclist[i];
-		if (!code) {
-		    if (afs_indexFlags[tdc->index] & IFDataMod) {
-			/*
-			 * LOCKXXX -- should hold afs_xdcache(W) when
-			 * modifying afs_indexFlags.
-			 */
-			afs_indexFlags[tdc->index] &= ~IFDataMod;
-			afs_stats_cmperf.cacheCurrDirtyChunks--;
-			afs_indexFlags[tdc->index] &= ~IFDirtyPages;
-			if (sync & AFS_VMSYNC_INVAL) {
-			    /* since we have invalidated all the pages of this
-			     ** vnode by calling osi_VM_TryToSmush, we can
-			     ** safely mark this dcache entry as not having
-			     ** any pages. This vnode now becomes eligible for
-			     ** reclamation by getDownD.
-			     */
-			    afs_indexFlags[tdc->index] &= ~IFAnyPages;
-			}
-		    }
+		if (run->bp) {
+		    pending[npending++] = run;
+		} else {
+		    afs_StoreRun(run, areq);
+		    code = afs_StoreRunDone(run, areq, &haveStatus, &OutStatus,
+					    anewDV);
 		}
-		UpgradeSToWLock(&tdc->lock, 628);
-		tdc->f.states &= ~DWriting;	/* correct? */
-		tdc->dflags |= DFEntryMod;
-		ReleaseWriteLock(&tdc->lock);
-		afs_PutDCache(tdc);
-		/* Mark the entry as released */
-		dclist[i] = NULL;
-	    }
-
-	    if (doProcessFS) {
-		/* Now copy out return params */
-		UpgradeSToWLock(&avc->lock, 28);	/* keep out others for a while */
-		afs_ProcessFS(avc, &OutStatus, areq);
-		/* Keep last (max) size of file on server to see if
-		 * we need to call afs_StoreMini to extend the file.
-		 */
-		if (!moredata)
-		    *amaxStoredLength = OutStatus.Length;
-		ConvertWToSLock(&avc->lock);
-		doProcessFS = 0;
 	    }
 
 	    if (code) {
@@ -698,13 +811,45 @@ afs_CacheStoreVCache(struct dcache **dcList, struct vcache *avc,
 		    }
 		}
 	    }
-
-	    afs_Trace2(afs_iclSetp, CM_TRACE_STOREALLDCDONE,
-		       ICL_TYPE_POINTER, avc, ICL_TYPE_INT32, code);
 	    bytes = 0;
 	}
     }
 
+    /* collect the runs we handed off, doing any not yet started ourselves */
+    for (j = 0; j < npending; j++) {
+	run = pending[j];
+	if (afs_BCancel(run->bp)) {
+	    run->bp = NULL;
+	    afs_StoreRun(run, areq);
+	} else {
+	    while ((run->bp->flags & BUVALID) == 0) {
+		run->bp->flags |= BUWAIT;
+		afs_osi_Sleep(run->bp);
+	    }
+	    afs_BRelease(run->bp);
+	}
+	tcode = afs_StoreRunDone(run, areq, &haveStatus, &OutStatus, anewDV);
+	if (!code)
+	    code = tcode;
+    }
+
+    if (haveStatus) {
+	/* Now copy out return params */
+	UpgradeSToWLock(&avc->lock, 28);	/* keep out others for a while */
+	afs_ProcessFS(avc, &OutStatus, areq);
+	/* Keep last (max) size of file on server to see if
+	 * we need to call afs_StoreMini to extend the file.
+	 */
+	if (!moredata)
+	    *amaxStoredLength = OutStatus.Length;
+	ConvertWToSLock(&avc->lock);
+    }
+
+    osi_GetTime(&endTime);
+    afs_stats_cmperf.storeMsecs +=
+	(endTime.tv_sec - startTime.tv_sec) * 1000 +
+	(endTime.tv_usec - startTime.tv_usec) / 1000;
+
     return code;
 }
 
@@ -132,7 +132,7 @@ afs_CacheInit(afs_int32 astatSize, afs_int32 afiles, afs_int32 ablocks,
     AFS_RWLOCK_INIT(&afs_disconDirtyLock, "afs_disconDirtyLock");
     QInit(&afs_disconDirty);
     QInit(&afs_disconShadow);
-    osi_dnlc_init();
+    osi_dnlc_init(astatSize, aDentries);
 
     /*
      * create volume list structure
@@ -347,10 +347,12 @@ afs_InitFHeader(struct afs_fheader *aheader)
 {
     memset(aheader, 0, sizeof(*aheader));
     aheader->magic = AFS_FHMAGIC;
-    aheader->version = AFS_CI_VERSION;
+    aheader->version = AFS_FHEADER_VERSION;
     aheader->dataSize = sizeof(struct fcache);
     aheader->firstCSize = AFS_FIRSTCSIZE;
     aheader->otherCSize = AFS_OTHERCSIZE;
+    if (aheader->version == AFS_CI_TIERED_VERSION)
+	aheader->maxCSize = AFS_MAXCSIZE;
 }
 
 /*
@@ -480,26 +482,29 @@ afs_InitCacheInfo(char *afile)
 
     afs_osi_Stat(tfile, &tstat);
     cacheInfoModTime = tstat.mtime;
-    code = afs_osi_Read(tfile, -1, &theader, sizeof(theader));
+    memset(&theader, 0, sizeof(theader));
+    code = afs_osi_Read(tfile, -1, &theader, AFS_FHEADER_SIZE);
     goodFile = 0;
-    if (code == sizeof(theader)) {
+    if (code == AFS_FHEADER_SIZE) {
 	/* read the header correctly */
 	if (theader.magic == AFS_FHMAGIC
 	    && theader.firstCSize == AFS_FIRSTCSIZE
 	    && theader.otherCSize == AFS_OTHERCSIZE
 	    && theader.dataSize == sizeof(struct fcache)
-	    && theader.version == AFS_CI_VERSION)
+	    && theader.version == AFS_FHEADER_VERSION
+	    && (theader.version != AFS_CI_TIERED_VERSION
+		|| theader.maxCSize == AFS_MAXCSIZE))
 	    goodFile = 1;
     }
     if (!goodFile) {
 	/* write out a good file label */
 	afs_InitFHeader(&theader);
-	afs_osi_Write(tfile, 0, &theader, sizeof(theader));
+	afs_osi_Write(tfile, 0, &theader, AFS_FHEADER_SIZE);
 	/*
 	 * Truncate the rest of the file, since it may be arbitrarily
 	 * wrong
 	 */
-	osi_UFSTruncate(tfile, sizeof(struct afs_fheader));
+	osi_UFSTruncate(tfile, AFS_FHEADER_SIZE);
     }
     /* Leave the file open now, since reopening the file makes public pool
      * vnode systems (like OSF/Alpha) much harder to handle, That's because
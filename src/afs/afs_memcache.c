@@ -20,32 +20,71 @@ static struct memCacheEntry *memCache;
 static int memCacheBlkSize = 8192;
 static int memMaxBlkNumber = 0;
 
+/*
+ * The blocks themselves are carved out of an arena of large segments, rather
+ * than allocated one at a time, so that a big memory cache neither fragments
+ * the kernel heap nor costs an allocation (and, on some platforms, allocator
+ * bookkeeping) per block.  An entry only gets memory of its own if it must
+ * grow past its block, as a big directory can; truncating it to nothing
+ * returns it to its block.
+ */
+#define MEMCACHE_SEGSIZE (1024 * 1024)	/* bytes per arena segment */
+
+static char **memCacheSegs;
+static int memCacheSegBlks;	/* blocks per segment */
+static int memCacheNSegs;
+
 extern int cacheDiskType;
 
+static void
+afs_MemFreeArena(void)
+{
+    int i;
+
+    for (i = 0; i < memCacheNSegs; i++) {
+	if (memCacheSegs[i] != NULL)
+	    afs_osi_Free(memCacheSegs[i], memCacheSegBlks * memCacheBlkSize);
+    }
+    afs_osi_Free(memCacheSegs, memCacheNSegs * sizeof(char *));
+    memCacheSegs = NULL;
+    memCacheNSegs = 0;
+}
+
 int
 afs_InitMemCache(int blkCount, int blkSize, int flags)
 {
-    int index;
+    int index, seg;
 
     AFS_STATCNT(afs_InitMemCache);
     if (blkSize)
 	memCacheBlkSize = blkSize;
 
+    memCacheSegBlks = MEMCACHE_SEGSIZE / memCacheBlkSize;
+    if (memCacheSegBlks < 1)
+	memCacheSegBlks = 1;
+    memCacheNSegs = (blkCount + memCacheSegBlks - 1) / memCacheSegBlks;
+    memCacheSegs = afs_osi_Alloc(memCacheNSegs * sizeof(char *));
+    osi_Assert(memCacheSegs != NULL);
+    memset(memCacheSegs, 0, memCacheNSegs * sizeof(char *));
+    for (seg = 0; seg < memCacheNSegs; seg++) {
+	memCacheSegs[seg] = afs_osi_Alloc(memCacheSegBlks * memCacheBlkSize);
+	if (memCacheSegs[seg] == NULL)
+	    goto nomem;
+	memset(memCacheSegs[seg], 0, memCacheSegBlks * memCacheBlkSize);
+    }
+
     memMaxBlkNumber = blkCount;
     memCache =
 	afs_osi_Alloc(memMaxBlkNumber * sizeof(struct memCacheEntry));
     osi_Assert(memCache != NULL);
 
     for (index = 0; index < memMaxBlkNumber; index++) {
-	char *blk;
 	(memCache + index)->size = 0;
 	(memCache + index)->dataSize = memCacheBlkSize;
 	LOCK_INIT(&((memCache + index)->afs_memLock), "afs_memLock");
-	blk = afs_osi_Alloc(memCacheBlkSize);
-	if (blk == NULL)
-	    goto nomem;
-	(memCache + index)->data = blk;
-	memset((memCache + index)->data, 0, memCacheBlkSize);
+	(memCache + index)->slab = memCacheSegs[index / memCacheSegBlks]
+	    + (index % memCacheSegBlks) * memCacheBlkSize;
+	(memCache + index)->data = (memCache + index)->slab;
     }
 #if defined(AFS_HAVE_VXFS)
     afs_InitDualFSCacheOps((struct vnode *)0);
@@ -56,11 +95,8 @@ afs_InitMemCache(int blkCount, int blkSize, int flags)
 
   nomem:
     afs_warn("afsd:  memCache allocation failure at %d KB.\n",
-	     (index * memCacheBlkSize) / 1024);
-    while (--index >= 0) {
-	afs_osi_Free((memCache + index)->data, memCacheBlkSize);
-	(memCache + index)->data = NULL;
-    }
+	     (seg * memCacheSegBlks * memCacheBlkSize) / 1024);
+    afs_MemFreeArena();
     return ENOMEM;
 
 }
@@ -185,7 +221,8 @@ _afs_MemExtendEntry(struct memCacheEntry *mceP, afs_uint32 size)
 	AFS_GUNLOCK();
 	memcpy(mceP->data, oldData, mceP->size);
 	AFS_GLOCK();
-	afs_osi_Free(oldData, mceP->dataSize);
+	if (oldData != mceP->slab)
+	    afs_osi_Free(oldData, mceP->dataSize);
 	mceP->dataSize = size;
     }
     return 0;
@@ -242,24 +279,11 @@ afs_MemWriteUIO(struct vcache *avc, afs_dcache_id_t *ainode, struct uio *uioP)
 
     AFS_STATCNT(afs_MemWriteUIO);
     ObtainWriteLock(&mceP->afs_memLock, 312);
-    if (AFS_UIO_RESID(uioP) + AFS_UIO_OFFSET(uioP) > mceP->dataSize) {
-	char *oldData = mceP->data;
-
-	mceP->data = afs_osi_Alloc(AFS_UIO_RESID(uioP) + AFS_UIO_OFFSET(uioP));
-	if (mceP->data == NULL) {	/* no available memory */
-	    mceP->data = oldData;	/* revert back change that was made */
-	    ReleaseWriteLock(&mceP->afs_memLock);
-	    afs_warn("afs: afs_MemWriteBlk mem alloc failure (%ld bytes)\n",
-		     (long)(AFS_UIO_RESID(uioP) + AFS_UIO_OFFSET(uioP)));
-	    return -ENOMEM;
-	}
-
-	AFS_GUNLOCK();
-	memcpy(mceP->data, oldData, mceP->size);
-	AFS_GLOCK();
-
-	afs_osi_Free(oldData, mceP->dataSize);
-	mceP->dataSize = AFS_UIO_RESID(uioP) + AFS_UIO_OFFSET(uioP);
+    code = _afs_MemExtendEntry(mceP,
+			       AFS_UIO_RESID(uioP) + AFS_UIO_OFFSET(uioP));
+    if (code) {
+	ReleaseWriteLock(&mceP->afs_memLock);
+	return code;
     }
     if (mceP->size < AFS_UIO_OFFSET(uioP))
 	memset(mceP->data + mceP->size, 0,
@@ -281,18 +305,10 @@ afs_MemCacheTruncate(struct osi_file *fP, int size)
 
     ObtainWriteLock(&mceP->afs_memLock, 313);
     /* old directory entry; g.c. */
-    if (size == 0 && mceP->dataSize > memCacheBlkSize) {
-	char *oldData = mceP->data;
-	mceP->data = afs_osi_Alloc(memCacheBlkSize);
-	if (mceP->data == NULL) {	/* no available memory */
-	    mceP->data = oldData;
-	    ReleaseWriteLock(&mceP->afs_memLock);
-	    afs_warn("afs: afs_MemWriteBlk mem alloc failure (%d bytes)\n",
-		     memCacheBlkSize);
-	} else {
-	    afs_osi_Free(oldData, mceP->dataSize);
-	    mceP->dataSize = memCacheBlkSize;
-	}
+    if (size == 0 && mceP->data != mceP->slab) {
+	afs_osi_Free(mceP->data, mceP->dataSize);
+	mceP->data = mceP->slab;
+	mceP->dataSize = memCacheBlkSize;
     }
 
     if (size < mceP->size)
@@ -319,12 +335,15 @@ shutdown_memcache(void)
 
     if (cacheDiskType != AFS_FCACHE_TYPE_MEM)
 	return;
-    memCacheBlkSize = 8192;
     for (index = 0; index < memMaxBlkNumber; index++) {
 	LOCK_INIT(&((memCache + index)->afs_memLock), "afs_memLock");
-	afs_osi_Free((memCache + index)->data, (memCache + index)->dataSize);
+	if ((memCache + index)->data != (memCache + index)->slab)
+	    afs_osi_Free((memCache + index)->data,
+			 (memCache + index)->dataSize);
     }
     afs_osi_Free((char *)memCache,
 		 memMaxBlkNumber * sizeof(struct memCacheEntry));
     memMaxBlkNumber = 0;
+    afs_MemFreeArena();
+    memCacheBlkSize = 8192;
 }
@@ -26,29 +26,47 @@
 #include "afs/afs_osidnlc.h"
 
 /* Things to do:
- *    also cache failed lookups.
  *    look into interactions of dnlc and readdir.
- *    cache larger names, perhaps by using a better,longer key (SHA) and discarding
- *    the actual name itself.
  *    precompute a key and stuff for \sys, and combine the HandleAtName function with
  *    this, since we're looking at the name anyway.
  */
 
+/*
+ * Locking: each hash chain is protected by one of the afs_xdnlchash locks,
+ * and afs_xdnlc protects the free list and the per-vcache chains of entries.
+ * Lock order is chain lock before afs_xdnlc; the few places that want them
+ * the other way around (scavenging, purging) only try for the chain lock.
+ * None of these locks is ever held across a sleep, so, as before, an entry
+ * may be invalidated under the global lock alone.
+ */
+#define NCLOCKS 64		/* # of locks sharding the hash chains */
 struct afs_lock afs_xdnlc;
+struct afs_lock afs_xdnlchash[NCLOCKS];
 extern struct afs_lock afs_xvcache;
 
 dnlcstats_t dnlcstats;
 
-#define NCSIZE 4096
-#define NHSIZE 256		/* must be power of 2. == NHASHENT in dir package */
+/*
+ * The cache is sized when the cache manager starts, from the number of stat
+ * cache and dcache entries afsd asked for.
+ */
+#define NCMINSIZE 4096
+#define NCMAXSIZE (1 << 18)
+#define NHMINSIZE 256		/* must be power of 2 */
+#define NHCHAIN 4		/* aim for this many entries per bucket */
+static unsigned int ncsize;
+static unsigned int nhsize;	/* power of 2 */
 struct nc *ncfreelist = NULL;
-static struct nc nameCache[NCSIZE];
-struct nc *nameHash[NHSIZE];
+static struct nc *nameCache;
+struct nc **nameHash;
 /* Hash table invariants:
  *     1.  If nameHash[i] is NULL, list is empty
  *     2.  A single element in a hash bucket has itself as prev and next.
  */
 
+#define NCHashLock(i)	(&afs_xdnlchash[(i) & (NCLOCKS - 1)])
+#define NCNAME(tnc)	((tnc)->lname ? (tnc)->lname : (char *)(tnc)->name)
+
 typedef enum { osi_dnlc_enterT, InsertEntryT, osi_dnlc_lookupT,
     ScavengeEntryT, osi_dnlc_removeT, RemoveEntryT, osi_dnlc_purgedpT,
     osi_dnlc_purgevpT, osi_dnlc_purgeT
@@ -68,12 +86,92 @@ int dnlct;
 
 #define dnlcHash(ts, hval) for (hval=0; *ts; ts++) { hval *= 173;  hval  += *ts;   }
 
+/* Mix the directory into the key, so that common names ("..", "Makefile")
+ * in many directories don't all pile up in one bucket. */
+#define dnlcKey(adp, hval) \
+    ((hval) ^ ((unsigned int)((uintptrsz)(adp) >> 4) * 2654435761U))
+
+static void
+LinkVC(struct nc **headp, struct nc *tnc, int which)
+{
+    struct nclink *l = &tnc->vclink[which];
+
+    l->next = *headp;
+    if (l->next)
+	l->next->vclink[which].pprev = &l->next;
+    l->pprev = headp;
+    *headp = tnc;
+}
+
+static void
+UnlinkVC(struct nc *tnc, int which)
+{
+    struct nclink *l = &tnc->vclink[which];
+
+    if (!l->pprev)
+	return;
+    *l->pprev = l->next;
+    if (l->next)
+	l->next->vclink[which].pprev = l->pprev;
+    l->next = NULL;
+    l->pprev = NULL;
+}
+
+/* Make an entry match nothing, and drop it from the vcache chains.  Called
+ * with afs_xdnlc held, or (see above) at least under the global lock. */
+static void
+InvalidateEntry(struct nc *tnc)
+{
+    UnlinkVC(tnc, NCDIRLINK);
+    UnlinkVC(tnc, NCVPLINK);
+    tnc->dirp = tnc->vp = NULL;
+}
+
+/* Put an unhashed entry on the free list; called with afs_xdnlc held. */
+static void
+FreeEntry(struct nc *tnc)
+{
+    if (tnc->lname) {
+	afs_osi_FreeStr(tnc->lname);
+	tnc->lname = NULL;
+    }
+    tnc->next = ncfreelist;
+    ncfreelist = tnc;
+}
+
+static void
+RemoveEntry(struct nc *tnc, unsigned int key)
+{
+    if (!tnc->prev)		/* things on freelist always have null prev ptrs */
+	osi_Panic("bogus free list");
+
+    TRACE(RemoveEntryT, key);
+    if (tnc == tnc->next) {	/* only one in list */
+	nameHash[key] = NULL;
+    } else {
+	if (tnc == nameHash[key])
+	    nameHash[key] = tnc->next;
+	tnc->prev->next = tnc->next;
+	tnc->next->prev = tnc->prev;
+    }
+
+    tnc->prev = NULL;		/* everything not in hash table has 0 prev */
+    tnc->key = 0;		/* just for safety's sake */
+}
+
+/*
+ * Find an entry to reuse, from the free list or else by evicting the oldest
+ * entry from some bucket.  Called with the lock for bucket skey and
+ * afs_xdnlc write-locked.  Returns NULL if every bucket we could steal from
+ * was busy.
+ */
 static struct nc *
-GetMeAnEntry(void)
+GetMeAnEntry(unsigned int skey)
 {
     static unsigned int nameptr = 0;	/* next bucket to pull something from */
     struct nc *tnc;
-    int j;
+    struct afs_lock *lock;
+    unsigned int j, b;
 
     if (ncfreelist) {
 	tnc = ncfreelist;
@@ -81,40 +179,35 @@ GetMeAnEntry(void)
 	return tnc;
     }
 
-    for (j = 0; j < NHSIZE + 2; j++, nameptr++) {
-	if (nameptr >= NHSIZE)
-	    nameptr = 0;
-	if (nameHash[nameptr])
-	    break;
-    }
-
-    if (nameptr >= NHSIZE)
-	nameptr = 0;
-
-    TRACE(ScavengeEntryT, nameptr);
-    tnc = nameHash[nameptr];
-    if (!tnc)			/* May want to consider changing this to return 0 */
-	osi_Panic("null tnc in GetMeAnEntry");
-
-    if (tnc->prev == tnc) {	/* only thing in list, don't screw around */
-	nameHash[nameptr] = NULL;
-	return (tnc);
+    for (j = 0; j < nhsize; j++) {
+	b = nameptr++ & (nhsize - 1);
+	if (!nameHash[b])
+	    continue;
+	lock = NCHashLock(b);
+	if (lock != NCHashLock(skey) && NBObtainWriteLock(lock, 1216))
+	    continue;
+
+	TRACE(ScavengeEntryT, b);
+	tnc = nameHash[b]->prev;	/* grab oldest one in this bucket */
+	RemoveEntry(tnc, b);
+	if (lock != NCHashLock(skey))
+	    ReleaseWriteLock(lock);
+	if (tnc->dirp)
+	    dnlcstats.evicts++;
+	InvalidateEntry(tnc);
+	if (tnc->lname) {
+	    afs_osi_FreeStr(tnc->lname);
+	    tnc->lname = NULL;
+	}
+	return tnc;
     }
 
-    tnc = tnc->prev;		/* grab oldest one in this bucket */
-    /* remove it from list */
-    tnc->next->prev = tnc->prev;
-    tnc->prev->next = tnc->next;
-
-    return (tnc);
+    return NULL;
 }
 
 static void
-InsertEntry(struct nc *tnc)
+InsertEntry(struct nc *tnc, unsigned int key)
 {
-    unsigned int key;
-    key = tnc->key & (NHSIZE - 1);
-
     TRACE(InsertEntryT, key);
     if (!nameHash[key]) {
 	nameHash[key] = tnc;
@@ -129,6 +222,18 @@ InsertEntry(struct nc *tnc)
 }
 
 
+/*!
+ * Remember that aname in directory adp is avc.
+ *
+ * If avc is NULL, remember instead that there is no such name.  Such a
+ * negative entry is only good while adp stays at data version *avno.
+ *
+ * \param adp  vcache entry for the directory
+ * \param aname  name within the directory
+ * \param avc  vcache entry aname refers to, or NULL
+ * \param avno  data version of adp the lookup was done against
+ * \return 0
+ */
 int
 osi_dnlc_enter(struct vcache *adp, char *aname, struct vcache *avc,
 	       afs_hyper_t * avno)
@@ -136,25 +241,35 @@ osi_dnlc_enter(struct vcache *adp, char *aname, struct vcache *avc,
     struct nc *tnc;
     unsigned int key, skey;
     char *ts = aname;
+    char *lname = NULL;
     int safety;
 
-    if (!afs_usednlc)
+    if (!afs_usednlc || !nameHash)
 	return 0;
 
     TRACE(osi_dnlc_enterT, 0);
     dnlcHash(ts, key);		/* leaves ts pointing at the NULL */
     if (ts - aname >= AFSNCNAMESIZE) {
-	return 0;
+	/* may drop the global lock, so do it before we look at anything */
+	lname = afs_osi_Alloc(ts - aname + 1);
+	if (!lname)
+	    return 0;
+	memcpy(lname, aname, ts - aname + 1);
     }
-    skey = key & (NHSIZE - 1);
+    key = dnlcKey(adp, key);
+    skey = key & (nhsize - 1);
     dnlcstats.enters++;
+    if (!avc)
+	dnlcstats.negenters++;
 
   retry:
-    ObtainWriteLock(&afs_xdnlc, 222);
+    ObtainWriteLock(NCHashLock(skey), 222);
 
     /* Only cache entries from the latest version of the directory */
     if (!(adp->f.states & CStatd) || !hsame(*avno, adp->f.m.DataVersion)) {
-	ReleaseWriteLock(&afs_xdnlc);
+	ReleaseWriteLock(NCHashLock(skey));
+	if (lname)
+	    afs_osi_FreeStr(lname);
 	return 0;
     }
 
@@ -162,36 +277,58 @@ osi_dnlc_enter(struct vcache *adp, char *aname, struct vcache *avc,
      * Make sure each directory entry gets cached no more than once.
      */
     for (tnc = nameHash[skey], safety = 0; tnc; tnc = tnc->next, safety++) {
-	if ((tnc->dirp == adp) && (!strcmp((char *)tnc->name, aname))) {
+	if ((tnc->key == key) && (tnc->dirp == adp)
+	    && (!strcmp(NCNAME(tnc), aname))) {
 	    /* duplicate entry */
 	    break;
 	} else if (tnc->next == nameHash[skey]) {	/* end of list */
 	    tnc = NULL;
 	    break;
-	} else if (safety > NCSIZE) {
+	} else if (safety > ncsize) {
 	    afs_warn("DNLC cycle");
 	    dnlcstats.cycles++;
-	    ReleaseWriteLock(&afs_xdnlc);
+	    ReleaseWriteLock(NCHashLock(skey));
 	    osi_dnlc_purge();
 	    goto retry;
 	}
     }
 
+    ObtainWriteLock(&afs_xdnlc, 1221);
     if (tnc == NULL) {
-	tnc = GetMeAnEntry();
-
-	tnc->dirp = adp;
-	tnc->vp = avc;
-	tnc->key = key;
-	memcpy((char *)tnc->name, aname, ts - aname + 1);	/* include the NULL */
+	tnc = GetMeAnEntry(skey);
+	if (tnc) {
+	    tnc->dirp = adp;
+	    tnc->vp = avc;
+	    tnc->key = key;
+	    tnc->dv = *avno;
+	    if (lname) {
+		tnc->lname = lname;
+		lname = NULL;
+	    } else {
+		/* include the NULL */
+		memcpy((char *)tnc->name, aname, ts - aname + 1);
+	    }
+	    LinkVC(&adp->dnlcDir, tnc, NCDIRLINK);
+	    if (avc)
+		LinkVC(&avc->dnlcVp, tnc, NCVPLINK);
 
-	InsertEntry(tnc);
-    } else {
+	    InsertEntry(tnc, skey);
+	}
+    } else if (tnc->vp != avc) {
 	/* duplicate */
+	UnlinkVC(tnc, NCVPLINK);
 	tnc->vp = avc;
+	tnc->dv = *avno;
+	if (avc)
+	    LinkVC(&avc->dnlcVp, tnc, NCVPLINK);
+    } else {
+	tnc->dv = *avno;
     }
     ReleaseWriteLock(&afs_xdnlc);
+    ReleaseWriteLock(NCHashLock(skey));
 
+    if (lname)
+	afs_osi_FreeStr(lname);
     return 0;
 }
 
@@ -208,39 +345,38 @@ osi_dnlc_lookup(struct vcache *adp, char *aname, int locktype)
     vnode_t tvp;
 #endif
 
-    if (!afs_usednlc)
+    if (!afs_usednlc || !nameHash)
       return 0;
 
     dnlcHash(ts, key);		/* leaves ts pointing at the NULL */
-    if (ts - aname >= AFSNCNAMESIZE)
-      return 0;
-    skey = key & (NHSIZE - 1);
+    key = dnlcKey(adp, key);
+    skey = key & (nhsize - 1);
 
     TRACE(osi_dnlc_lookupT, skey);
     dnlcstats.lookups++;
 
     ObtainReadLock(&afs_xvcache);
-    ObtainReadLock(&afs_xdnlc);
+    ObtainReadLock(NCHashLock(skey));
 
     for (tvc = NULL, tnc = nameHash[skey], safety = 0; tnc;
 	 tnc = tnc->next, safety++) {
-	if ( /* (tnc->key == key)  && */ (tnc->dirp == adp)
-	    && (!strcmp((char *)tnc->name, aname))) {
-	    tvc = tnc->vp;
+	if ((tnc->key == key) && (tnc->dirp == adp)
+	    && (!strcmp(NCNAME(tnc), aname))) {
+	    tvc = tnc->vp;	/* NULL for a negative entry */
 	    break;
 	} else if (tnc->next == nameHash[skey]) {	/* end of list */
 	    break;
-	} else if (safety > NCSIZE) {
+	} else if (safety > ncsize) {
 	    afs_warn("DNLC cycle");
 	    dnlcstats.cycles++;
-	    ReleaseReadLock(&afs_xdnlc);
+	    ReleaseReadLock(NCHashLock(skey));
 	    ReleaseReadLock(&afs_xvcache);
 	    osi_dnlc_purge();
 	    return (0);
 	}
     }
 
-    ReleaseReadLock(&afs_xdnlc);
+    ReleaseReadLock(NCHashLock(skey));
 
     if (!tvc) {
 	ReleaseReadLock(&afs_xvcache);
@@ -288,25 +424,44 @@ osi_dnlc_lookup(struct vcache *adp, char *aname, int locktype)
     return tvc;
 }
 
-
-static void
-RemoveEntry(struct nc *tnc, unsigned int key)
+/*!
+ * Check for a negative entry saying aname is not in directory adp.
+ *
+ * \param adp  vcache entry for the directory
+ * \param aname  name to look for
+ * \return 1 if aname is known not to exist in the current version of adp
+ */
+int
+osi_dnlc_lookup_negative(struct vcache *adp, char *aname)
 {
-    if (!tnc->prev)		/* things on freelist always have null prev ptrs */
-	osi_Panic("bogus free list");
+    unsigned int key, skey;
+    char *ts = aname;
+    struct nc *tnc;
+    int safety, found = 0;
 
-    TRACE(RemoveEntryT, key);
-    if (tnc == tnc->next) {	/* only one in list */
-	nameHash[key] = NULL;
-    } else {
-	if (tnc == nameHash[key])
-	    nameHash[key] = tnc->next;
-	tnc->prev->next = tnc->next;
-	tnc->next->prev = tnc->prev;
+    if (!afs_usednlc || !nameHash)
+	return 0;
+
+    dnlcHash(ts, key);		/* leaves ts pointing at the NULL */
+    key = dnlcKey(adp, key);
+    skey = key & (nhsize - 1);
+
+    ObtainReadLock(NCHashLock(skey));
+    for (tnc = nameHash[skey], safety = 0; tnc; tnc = tnc->next, safety++) {
+	if ((tnc->key == key) && (tnc->dirp == adp)
+	    && (!strcmp(NCNAME(tnc), aname))) {
+	    found = (tnc->vp == NULL && (adp->f.states & CStatd)
+		     && hsame(tnc->dv, adp->f.m.DataVersion));
+	    break;
+	} else if (tnc->next == nameHash[skey] || safety > ncsize) {
+	    break;
+	}
     }
+    ReleaseReadLock(NCHashLock(skey));
 
-    tnc->prev = NULL;		/* everything not in hash table has 0 prev */
-    tnc->key = 0;		/* just for safety's sake */
+    if (found)
+	dnlcstats.neghits++;
+    return found;
 }
 
 
@@ -317,53 +472,69 @@ osi_dnlc_remove(struct vcache *adp, char *aname, struct vcache *avc)
     char *ts = aname;
     struct nc *tnc;
 
-    if (!afs_usednlc)
+    if (!afs_usednlc || !nameHash)
 	return 0;
 
-    TRACE(osi_dnlc_removeT, skey);
     dnlcHash(ts, key);		/* leaves ts pointing at the NULL */
-    if (ts - aname >= AFSNCNAMESIZE) {
-	return 0;
-    }
-    skey = key & (NHSIZE - 1);
+    key = dnlcKey(adp, key);
+    skey = key & (nhsize - 1);
     TRACE(osi_dnlc_removeT, skey);
     dnlcstats.removes++;
-    ObtainReadLock(&afs_xdnlc);
+    ObtainWriteLock(NCHashLock(skey), 1217);
 
     for (tnc = nameHash[skey]; tnc; tnc = tnc->next) {
 	if ((tnc->dirp == adp) && (tnc->key == key)
-	    && (!strcmp((char *)tnc->name, aname))) {
-	    tnc->dirp = NULL;	/* now it won't match anything */
+	    && (!strcmp(NCNAME(tnc), aname))) {
 	    break;
 	} else if (tnc->next == nameHash[skey]) {	/* end of list */
 	    tnc = NULL;
 	    break;
 	}
     }
-    ReleaseReadLock(&afs_xdnlc);
 
-    if (!tnc)
-	return 0;
-
-    /* there is a little race condition here, but it's relatively
-     * harmless.  At worst, I wind up removing a mapping that I just
-     * created. */
-    if (EWOULDBLOCK == NBObtainWriteLock(&afs_xdnlc, 1)) {
-	return 0;		/* no big deal, tnc will get recycled eventually */
+    if (tnc) {
+	RemoveEntry(tnc, skey);
+	ObtainWriteLock(&afs_xdnlc, 1218);
+	InvalidateEntry(tnc);
+	FreeEntry(tnc);
+	ReleaseWriteLock(&afs_xdnlc);
     }
-    RemoveEntry(tnc, skey);
-    tnc->next = ncfreelist;
-    ncfreelist = tnc;
-    ReleaseWriteLock(&afs_xdnlc);
+    ReleaseWriteLock(NCHashLock(skey));
 
     return 0;
 }
 
+/*
+ * Invalidate every entry on one of a vcache's chains, and put those whose
+ * buckets we can lock straight away back on the free list.  The rest get
+ * recycled when GetMeAnEntry comes across them.
+ */
+static void
+PurgeChain(struct nc **headp, int writelocked)
+{
+    struct nc *tnc;
+    struct afs_lock *lock;
+    unsigned int skey;
+
+    while ((tnc = *headp) != NULL) {
+	InvalidateEntry(tnc);
+	if (!writelocked || !tnc->prev)
+	    continue;
+	skey = tnc->key & (nhsize - 1);
+	lock = NCHashLock(skey);
+	if (NBObtainWriteLock(lock, 1219) == 0) {
+	    RemoveEntry(tnc, skey);
+	    FreeEntry(tnc);
+	    ReleaseWriteLock(lock);
+	}
+    }
+}
+
 /*!
- * Remove anything pertaining to this directory.  I can invalidate
- * things without the lock, since I am just looking through the array,
- * but to move things off the lists or into the freelist, I need the
- * write lock
+ * Remove anything pertaining to this directory.  The entries are found
+ * through the vcache's own chains, rather than by looking through the
+ * whole cache.  I can invalidate things without the lock, but to move
+ * things off the lists or into the freelist, I need the write lock
  *
  * \param adp vcache entry for the directory to be purged.
  * \return 0
@@ -371,7 +542,6 @@ osi_dnlc_remove(struct vcache *adp, char *aname, struct vcache *avc)
 int
 osi_dnlc_purgedp(struct vcache *adp)
 {
-    int i;
     int writelocked;
 
 #ifdef AFS_DARWIN_ENV
@@ -383,23 +553,16 @@ osi_dnlc_purgedp(struct vcache *adp)
     cache_purge(AFSTOV(adp));
 #endif
 
-    if (!afs_usednlc)
+    if (!afs_usednlc || !nameHash)
 	return 0;
 
     dnlcstats.purgeds++;
     TRACE(osi_dnlc_purgedpT, 0);
     writelocked = (0 == NBObtainWriteLock(&afs_xdnlc, 2));
 
-    for (i = 0; i < NCSIZE; i++) {
-	if ((nameCache[i].dirp == adp) || (nameCache[i].vp == adp)) {
-	    nameCache[i].dirp = nameCache[i].vp = NULL;
-	    if (writelocked && nameCache[i].prev) {
-		RemoveEntry(&nameCache[i], nameCache[i].key & (NHSIZE - 1));
-		nameCache[i].next = ncfreelist;
-		ncfreelist = &nameCache[i];
-	    }
-	}
-    }
+    PurgeChain(&adp->dnlcDir, writelocked);
+    PurgeChain(&adp->dnlcVp, writelocked);
+
     if (writelocked)
 	ReleaseWriteLock(&afs_xdnlc);
 
@@ -415,7 +578,6 @@ osi_dnlc_purgedp(struct vcache *adp)
 int
 osi_dnlc_purgevp(struct vcache *avc)
 {
-    int i;
     int writelocked;
 
 #ifdef AFS_DARWIN_ENV
@@ -427,25 +589,16 @@ osi_dnlc_purgevp(struct vcache *avc)
     cache_purge(AFSTOV(avc));
 #endif
 
-    if (!afs_usednlc)
+    if (!afs_usednlc || !nameHash)
 	return 0;
 
     dnlcstats.purgevs++;
     TRACE(osi_dnlc_purgevpT, 0);
     writelocked = (0 == NBObtainWriteLock(&afs_xdnlc, 3));
 
-    for (i = 0; i < NCSIZE; i++) {
-	if (nameCache[i].vp == avc) {
-	    nameCache[i].dirp = nameCache[i].vp = NULL;
-	    /* can't simply break; because of hard links -- might be two */
-	    /* different entries with same vnode */
-	    if (writelocked && nameCache[i].prev) {
-		RemoveEntry(&nameCache[i], nameCache[i].key & (NHSIZE - 1));
-		nameCache[i].next = ncfreelist;
-		ncfreelist = &nameCache[i];
-	    }
-	}
-    }
+    /* there may be several entries, because of hard links */
+    PurgeChain(&avc->dnlcVp, writelocked);
+
     if (writelocked)
 	ReleaseWriteLock(&afs_xdnlc);
 
@@ -456,20 +609,31 @@ osi_dnlc_purgevp(struct vcache *avc)
 int
 osi_dnlc_purge(void)
 {
-    int i;
+    struct nc *tnc;
+    struct afs_lock *lock;
+    unsigned int i;
+    int writelocked;
+
+    if (!nameHash)
+	return 0;
 
     dnlcstats.purges++;
     TRACE(osi_dnlc_purgeT, 0);
-    if (EWOULDBLOCK == NBObtainWriteLock(&afs_xdnlc, 4)) {	/* couldn't get lock */
-	for (i = 0; i < NCSIZE; i++)
-	    nameCache[i].dirp = nameCache[i].vp = NULL;
-    } else {			/* did get the lock */
-	ncfreelist = NULL;
-	memset(nameCache, 0, sizeof(struct nc) * NCSIZE);
-	memset(nameHash, 0, sizeof(struct nc *) * NHSIZE);
-	for (i = 0; i < NCSIZE; i++) {
-	    nameCache[i].next = ncfreelist;
-	    ncfreelist = &nameCache[i];
+    writelocked = (0 == NBObtainWriteLock(&afs_xdnlc, 4));
+
+    for (i = 0; i < ncsize; i++)
+	InvalidateEntry(&nameCache[i]);
+
+    if (writelocked) {
+	for (i = 0; i < nhsize; i++) {
+	    lock = NCHashLock(i);
+	    if (!nameHash[i] || NBObtainWriteLock(lock, 1220))
+		continue;
+	    while ((tnc = nameHash[i]) != NULL) {
+		RemoveEntry(tnc, i);
+		FreeEntry(tnc);
+	    }
+	    ReleaseWriteLock(lock);
 	}
 	ReleaseWriteLock(&afs_xdnlc);
     }
@@ -488,20 +652,56 @@ osi_dnlc_purgevol(struct VenusFid *fidp)
     return 0;
 }
 
+/* Bring the DNLC numbers in the xstat performance collection up to date. */
+void
+osi_dnlc_xstats(void)
+{
+    afs_stats_cmperf.dnlcLookups = dnlcstats.lookups;
+    afs_stats_cmperf.dnlcMisses = dnlcstats.misses;
+    afs_stats_cmperf.dnlcEvictions = dnlcstats.evicts;
+    afs_stats_cmperf.dnlcNegHits = dnlcstats.neghits;
+}
+
+/*!
+ * Set up the name cache.  It gets a couple of entries per stat cache
+ * entry plus one per dcache entry, which is roughly how many names the
+ * rest of the cache can hold on to.
+ *
+ * \param astatSize  # of stat cache entries
+ * \param aDentries  # of dcache entries
+ * \return 0
+ */
 int
-osi_dnlc_init(void)
+osi_dnlc_init(afs_int32 astatSize, afs_int32 aDentries)
 {
     int i;
 
     Lock_Init(&afs_xdnlc);
+    for (i = 0; i < NCLOCKS; i++)
+	Lock_Init(&afs_xdnlchash[i]);
     memset(&dnlcstats, 0, sizeof(dnlcstats));
     memset(dnlctracetable, 0, sizeof(dnlctracetable));
     dnlct = 0;
+
+    ncsize = 2 * (astatSize > 0 ? astatSize : 0)
+	+ (aDentries > 0 ? aDentries : 0);
+    if (ncsize < NCMINSIZE)
+	ncsize = NCMINSIZE;
+    else if (ncsize > NCMAXSIZE)
+	ncsize = NCMAXSIZE;
+    for (nhsize = NHMINSIZE; nhsize * NHCHAIN < ncsize; nhsize <<= 1)
+	;
+
+    nameCache = afs_osi_Alloc(ncsize * sizeof(struct nc));
+    osi_Assert(nameCache != NULL);
+    nameHash = afs_osi_Alloc(nhsize * sizeof(struct nc *));
+    osi_Assert(nameHash != NULL);
+
     ObtainWriteLock(&afs_xdnlc, 223);
     ncfreelist = NULL;
-    memset(nameCache, 0, sizeof(struct nc) * NCSIZE);
-    memset(nameHash, 0, sizeof(struct nc *) * NHSIZE);
-    for (i = 0; i < NCSIZE; i++) {
+    memset(nameCache, 0, ncsize * sizeof(struct nc));
+    memset(nameHash, 0, nhsize * sizeof(struct nc *));
+    for (i = 0; i < ncsize; i++) {
 	nameCache[i].next = ncfreelist;
 	ncfreelist = &nameCache[i];
     }
@@ -513,5 +713,22 @@ osi_dnlc_init(void)
 int
 osi_dnlc_shutdown(void)
 {
+    struct nc **hash = nameHash;
+    unsigned int i;
+
+    if (!hash)
+	return 0;
+
+    /* The vcaches are gone by now, so don't touch their chains. */
+    nameHash = NULL;
+    for (i = 0; i < ncsize; i++) {
+	if (nameCache[i].lname)
+	    afs_osi_FreeStr(nameCache[i].lname);
+    }
+    afs_osi_Free(nameCache, ncsize * sizeof(struct nc));
+    afs_osi_Free(hash, nhsize * sizeof(struct nc *));
+    nameCache = NULL;
+    ncfreelist = NULL;
+
     return 0;
 }
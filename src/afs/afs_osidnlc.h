@@ -8,10 +8,22 @@
  */
 
 #define AFSNCNAMESIZE 36	/* multiple of 4 */
+
+/* Links on the per-vcache chains of entries; see dnlcDir/dnlcVp in vcache */
+#define NCDIRLINK 0		/* chained off dirp->dnlcDir */
+#define NCVPLINK 1		/* chained off vp->dnlcVp */
+struct nclink {
+    struct nc *next;
+    struct nc **pprev;
+};
+
 struct nc {
     unsigned int key;
     struct nc *next, *prev;
-    struct vcache *dirp, *vp;
+    struct vcache *dirp, *vp;	/* vp == NULL for a negative entry */
+    struct nclink vclink[2];
+    afs_hyper_t dv;		/* dir version a negative entry is valid for */
+    char *lname;		/* names too long for name[] live here */
     unsigned char name[AFSNCNAMESIZE];
     /* I think that we can avoid wasting a byte for NULL, with a
      * a little bit of thought.
@@ -22,4 +34,5 @@ typedef struct {
     unsigned int enters, lookups, misses, removes;
     unsigned int purgeds, purgevs, purgevols, purges;
     unsigned int cycles, lookuprace;
+    unsigned int evicts, negenters, neghits;
 } dnlcstats_t;
@@ -160,9 +160,8 @@ extern void afs_StopAFSDB(void);
 extern void afs_RemoveCellEntry(struct server *srvp);
 
 /* afs_chunk.c */
-extern afs_int32 afs_FirstCSize;
-extern afs_int32 afs_OtherCSize;
-extern afs_int32 afs_LogChunk;
+extern afs_int32 afs_MaxLogChunk;
+extern void afs_InitChunkTiers(afs_int32 ablocks, int amemcache);
 
 /* afs_cell.c */
 extern struct cell *afs_GetRealCellByIndex(afs_int32 cellindex,
@@ -212,6 +211,7 @@ extern afs_int32 afs_gcpags_procsize;
 extern afs_int32 afs_CheckServerDaemonStarted;
 extern afs_int32 afs_probe_interval;
 extern afs_int32 afs_preCache;
+extern afs_int32 afs_maxReadAhead;
 
 extern void afs_Daemon(void);
 extern struct brequest *afs_BQueue(short aopcode,
@@ -224,6 +224,7 @@ extern struct brequest *afs_BQueue(short aopcode,
 extern void afs_CheckServerDaemon(void);
 extern int afs_CheckRootVolume(void);
 extern void afs_BRelease(struct brequest *ab);
+extern int afs_BCancel(struct brequest *ab);
 extern int afs_BBusy(void);
 extern int afs_BioDaemon(afs_int32 nbiods);
 #ifdef AFS_NEW_BKG
@@ -470,6 +471,8 @@ extern void afs_MarinerLog(char *astring,
 extern void shutdown_mariner(void);
 
 /* afs_fetchstore.c */
+extern afs_int32 afs_storeParallel;
+extern void afs_StoreRun(struct afs_storeRun *run, struct vrequest *areq);
 extern int afs_CacheStoreVCache(struct dcache **dcList, struct vcache *avc,
 				struct vrequest *areq,
 				int sync, unsigned int minj,
@@ -872,7 +875,9 @@ extern int osi_dnlc_purgedp(struct vcache *adp);
 extern int osi_dnlc_purgevp(struct vcache *avc);
 extern int osi_dnlc_purge(void);
 extern int osi_dnlc_purgevol(struct VenusFid *fidp);
-extern int osi_dnlc_init(void);
+extern int osi_dnlc_lookup_negative(struct vcache *adp, char *aname);
+extern void osi_dnlc_xstats(void);
+extern int osi_dnlc_init(afs_int32 astatSize, afs_int32 aDentries);
 extern int osi_dnlc_shutdown(void);
 
 /* afs_pag_cred.c */
@@ -1028,6 +1033,7 @@ extern afs_int32 afs_vcount;
 extern int afsvnumbers;
 extern afs_rwlock_t afs_xvreclaim;
 extern afs_rwlock_t afs_xvcache;
+extern afs_rwlock_t afs_xvhash[VCLOCKS];
 extern afs_rwlock_t afs_xvcdirty;
 extern afs_lock_t afs_xvcb;
 extern struct afs_q VLRU;
@@ -1043,6 +1049,8 @@ extern struct osi_file *afs_vcacheMetaInodep;
 extern void afs_FlushReclaimedVcaches(void);
 void afs_vcacheInit(int astatSize);
 extern struct vcache *afs_FindVCache(struct VenusFid *afid, afs_int32 flag);
+extern struct vcache *afs_FastFindVCache(struct VenusFid *afid,
+					 afs_int32 flag);
 extern void afs_BadFetchStatus(struct afs_conn *tc);
 extern int afs_CheckFetchStatus(struct afs_conn *tc,
                                 struct AFSFetchStatus *status);
@@ -1244,7 +1252,10 @@ extern void Check_AtSys(struct vcache *avc, const char *aname,
 extern int Next_AtSys(struct vcache *avc, struct vrequest *areq,
 		      struct sysname_info *state);
 extern int afs_DoBulkStat(struct vcache *adp, long dirCookie,
-			  struct vrequest *areqp);
+			  struct vrequest *areqp, afs_ucred_t *acred,
+			  int missed);
+extern void afs_BulkStatBkg(struct vcache *adp, AFSFid *fidsp, int nfids,
+			    afs_size_t statSeqNo, afs_ucred_t *acred);
 
 #if defined(AFS_SUN5_ENV) || defined(AFS_SGI_ENV)
 extern int afs_lookup(OSI_VC_DECL(adp), char *aname, struct vcache **avcp,
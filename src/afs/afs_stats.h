@@ -834,9 +834,26 @@ struct afs_stats_CMPerf {
     afs_int32 cacheBucket2_Discarded;
 
     /*
-     * Spares for future expansion.
+     * Write-back of dirty chunks to the File Servers.
      */
-    afs_int32 spare[10];	/*Spares */
+    afs_uint32 storeRuns;	/*# StoreData calls made for dirty chunks */
+    afs_uint32 storeRunsParallel;	/*# of those done by bkg daemons */
+    afs_uint32 storeKBytes;	/*# KBytes stored */
+    afs_uint32 storeMsecs;	/*# msecs spent storing */
+
+    /*
+     * Directory name lookup cache.
+     */
+    afs_uint32 dnlcLookups;	/*# name lookups tried in the DNLC */
+    afs_uint32 dnlcMisses;	/*# of those not found */
+    afs_uint32 dnlcEvictions;	/*# live entries recycled for new names */
+    afs_uint32 dnlcNegHits;	/*# lookups answered ENOENT from the DNLC */
+
+    /*
+     * Cache replacement.
+     */
+    afs_uint32 dcacheFgEvictions;	/*# dcaches evicted by callers */
+    afs_uint32 dcacheBgEvictions;	/*# evicted by the truncate daemon */
 };
 
 
@@ -59,6 +59,7 @@ char *makesname();
 /* Exported variables */
 afs_rwlock_t afs_xvcdirty;	/*Lock: discon vcache dirty list mgmt */
 afs_rwlock_t afs_xvcache;	/*Lock: alloc new stat cache entries */
+afs_rwlock_t afs_xvhash[VCLOCKS];	/*Lock: shards of afs_vhashT */
 afs_rwlock_t afs_xvreclaim;	/*Lock: entries reclaimed, not on free list */
 afs_lock_t afs_xvcb;		/*Lock: fids on which there are callbacks */
 #if !defined(AFS_LINUX_ENV)
@@ -140,7 +141,9 @@ afs_InsertHashCBR(struct afs_cbr *cbr)
  * Environment:
  *	afs_xvcache lock must be held for writing upon entry to
  *	prevent people from changing the vrefCount field, and to
- *      protect the lruq and hnext fields.
+ *      protect the lruq and hnext fields.  The hash shard lock is held
+ *      from the start, so that afs_FastFindVCache cannot hand out a new
+ *      reference while we are deciding to get rid of the entry.
  * LOCK: afs_FlushVCache afs_xvcache W
  * REFCNT: vcache ref count must be zero on entry except for osf1
  * RACE: lock is dropped and reobtained, permitting race in caller
@@ -165,6 +168,9 @@ afs_FlushVCache(struct vcache *avc, int *slept)
     afs_Trace2(afs_iclSetp, CM_TRACE_FLUSHV, ICL_TYPE_POINTER, avc,
 	       ICL_TYPE_INT32, avc->f.states);
 
+    i = VCHash(&avc->f.fid);
+    ObtainWriteLock(VCHashLock(i), 1212);
+
     code = osi_VM_FlushVCache(avc);
     if (code)
 	goto bad;
@@ -189,7 +195,6 @@ afs_FlushVCache(struct vcache *avc, int *slept)
 	afs_bulkStatsLost++;
     vcachegen++;
     /* remove entry from the hash chain */
-    i = VCHash(&avc->f.fid);
     uvc = &afs_vhashT[i];
     for (wvc = *uvc; wvc; uvc = &wvc->hnext, wvc = *uvc) {
 	if (avc == wvc) {
@@ -198,6 +203,7 @@ afs_FlushVCache(struct vcache *avc, int *slept)
 	    break;
 	}
     }
+    ReleaseWriteLock(VCHashLock(i));
 
     /* remove entry from the volume hash table */
     QRemove(&avc->vhashq);
@@ -298,6 +304,7 @@ afs_FlushVCache(struct vcache *avc, int *slept)
     return 0;
 
   bad:
+    ReleaseWriteLock(VCHashLock(i));
     return code;
 }				/*afs_FlushVCache */
 
@@ -821,7 +828,7 @@ afs_ShakeLooseVCaches(afs_int32 anumber)
 
  retry:
     i = 0;
-    limit = afs_vcount;
+    limit = afs_vcount * 2;	/* entries given a second chance are seen twice */
     for (tq = VLRU.prev; tq != &VLRU && anumber > 0; tq = uq) {
 	tvc = QTOV(tq);
 	uq = QPrev(tq);
@@ -835,6 +842,13 @@ afs_ShakeLooseVCaches(afs_int32 anumber)
 	    refpanic("VLRU inconsistent");
 	} else if (tvc->f.states & CVInit) {
 	    continue;
+	} else if (tvc->vlruRef) {
+	    /* Lookups only mark the entries they find, rather than moving
+	     * them to the head of the VLRU themselves; do that now. */
+	    tvc->vlruRef = 0;
+	    QRemove(&tvc->vlruq);
+	    QAdd(&VLRU, &tvc->vlruq);
+	    continue;
 	}
 
 	fv_slept = 0;
@@ -985,6 +999,12 @@ afs_PrePopulateVCache(struct vcache *avc, struct VenusFid *afid,
     avc->f.fid = *afid;
     avc->asynchrony = -1;
     avc->vc_error = 0;
+    avc->readAheadChunk = -1;
+    avc->readAheadWindow = 0;
+    avc->vlruRef = 0;
+    avc->dnlcDir = avc->dnlcVp = NULL;
+    avc->bulkStatNext = avc->bulkStatMark = 0;
+    avc->bulkStatWindow = 0;
 
     hzero(avc->mapDV);
     avc->f.truncPos = AFS_NOTRUNC;   /* don't truncate until we need to */
@@ -1096,8 +1116,10 @@ afs_NewVCache_int(struct VenusFid *afid, struct server *serverp, int seq)
     i = VCHash(afid);
     j = VCHashV(afid);
 
+    ObtainWriteLock(VCHashLock(i), 1213);
     tvc->hnext = afs_vhashT[i];
     afs_vhashT[i] = tvc;
+    ReleaseWriteLock(VCHashLock(i));
     QAdd(&afs_vhashTV[j], &tvc->vhashq);
 
     if ((VLRU.next->prev != &VLRU) || (VLRU.prev->next != &VLRU)) {
@@ -1776,35 +1798,42 @@ afs_GetVCache(struct VenusFid *afid, struct vrequest *areq)
 
     AFS_STATCNT(afs_GetVCache);
 
-    ObtainSharedLock(&afs_xvcache, 5);
-
-    tvc = afs_FindVCache(afid, DO_STATS | DO_VLRU | IS_SLOCK);
+    tvc = afs_FastFindVCache(afid, DO_STATS | DO_VLRU);
     if (tvc) {
-	osi_Assert((tvc->f.states & CVInit) == 0);
 	/* If we are in readdir, return the vnode even if not statd */
-	if ((tvc->f.states & CStatd) || afs_InReadDir(tvc)) {
-	    ReleaseSharedLock(&afs_xvcache);
+	if ((tvc->f.states & CStatd) || afs_InReadDir(tvc))
 	    return tvc;
-	}
     } else {
-	UpgradeSToWLock(&afs_xvcache, 21);
+	ObtainSharedLock(&afs_xvcache, 5);
 
-	/* no cache entry, better grab one */
-	tvc = afs_NewVCache(afid, NULL);
-	newvcache = 1;
-
-	ConvertWToSLock(&afs_xvcache);
-	if (tvc == NULL)
-	{
+	tvc = afs_FindVCache(afid, DO_STATS | DO_VLRU | IS_SLOCK);
+	if (tvc) {
+	    osi_Assert((tvc->f.states & CVInit) == 0);
+	    /* If we are in readdir, return the vnode even if not statd */
+	    if ((tvc->f.states & CStatd) || afs_InReadDir(tvc)) {
 		ReleaseSharedLock(&afs_xvcache);
-		return NULL;
+		return tvc;
+	    }
+	} else {
+	    UpgradeSToWLock(&afs_xvcache, 21);
+
+	    /* no cache entry, better grab one */
+	    tvc = afs_NewVCache(afid, NULL);
+	    newvcache = 1;
+
+	    ConvertWToSLock(&afs_xvcache);
+	    if (tvc == NULL)
+	    {
+		    ReleaseSharedLock(&afs_xvcache);
+		    return NULL;
+	    }
+
+	    afs_stats_cmperf.vcacheMisses++;
 	}
 
-	afs_stats_cmperf.vcacheMisses++;
+	ReleaseSharedLock(&afs_xvcache);
     }
 
-    ReleaseSharedLock(&afs_xvcache);
-
     ObtainWriteLock(&tvc->lock, 54);
 
     if (tvc->f.states & CStatd) {
@@ -2621,8 +2650,8 @@ afs_RefVCache(struct vcache *tvc)
  *  set if FindVCache is called as part of internal bookkeeping.
  *
  * \note Environment: Must be called with the afs_xvcache lock at least held at
- * the read level.  In order to do the VLRU adjustment, the xvcache lock
- * must be shared-- we upgrade it here.
+ * the read level.  The VLRU adjustment only marks the entry as used;
+ * afs_ShakeLooseVCaches moves it when it next comes across it.
  */
 
 struct vcache *
@@ -2689,33 +2718,8 @@ afs_FindVCache(struct VenusFid *afid, afs_int32 flag)
 #endif
     }
     if (tvc) {
-	/*
-	 * only move to front of vlru if we have proper vcache locking)
-	 */
-	if (flag & DO_VLRU) {
-	    if ((VLRU.next->prev != &VLRU) || (VLRU.prev->next != &VLRU)) {
-		refpanic("FindVC VLRU inconsistent1");
-	    }
-	    if (tvc->vlruq.next->prev != &(tvc->vlruq)) {
-		refpanic("FindVC VLRU inconsistent1");
-	    }
-	    if (tvc->vlruq.prev->next != &(tvc->vlruq)) {
-		refpanic("FindVC VLRU inconsistent2");
-	    }
-	    UpgradeSToWLock(&afs_xvcache, 26);
-	    QRemove(&tvc->vlruq);
-	    QAdd(&VLRU, &tvc->vlruq);
-	    ConvertWToSLock(&afs_xvcache);
-	    if ((VLRU.next->prev != &VLRU) || (VLRU.prev->next != &VLRU)) {
-		refpanic("FindVC VLRU inconsistent1");
-	    }
-	    if (tvc->vlruq.next->prev != &(tvc->vlruq)) {
-		refpanic("FindVC VLRU inconsistent2");
-	    }
-	    if (tvc->vlruq.prev->next != &(tvc->vlruq)) {
-		refpanic("FindVC VLRU inconsistent3");
-	    }
-	}
+	if (flag & DO_VLRU)
+	    tvc->vlruRef = 1;
 	vcachegen++;
     }
 
@@ -2732,6 +2736,57 @@ afs_FindVCache(struct VenusFid *afid, afs_int32 flag)
     return tvc;
 }				/*afs_FindVCache */
 
+/*!
+ * Find a vcache entry given a fid, without taking afs_xvcache.
+ *
+ * Only the lock of the fid's hash shard is taken, so lookups of different
+ * files do not serialize on afs_xvcache.  Entries still being set up, and
+ * shards somebody is changing, are left to afs_FindVCache, which knows how
+ * to wait for them.
+ *
+ * \param afid Pointer to the fid whose cache entry we desire.
+ * \param flag DO_STATS to count a hit (misses are left to the caller's
+ *  afs_FindVCache), DO_VLRU to mark the entry as recently used.
+ *
+ * \return The entry with a reference held, or NULL.
+ */
+struct vcache *
+afs_FastFindVCache(struct VenusFid *afid, afs_int32 flag)
+{
+#ifdef AFS_DARWIN_ENV
+    /* getting a vnode reference may sleep here; use afs_FindVCache */
+    return NULL;
+#else
+    struct vcache *tvc;
+    afs_int32 i;
+
+    i = VCHash(afid);
+    if (NBObtainReadLock(VCHashLock(i)))
+	return NULL;
+    for (tvc = afs_vhashT[i]; tvc; tvc = tvc->hnext) {
+	if (FidMatches(afid, tvc))
+	    break;
+    }
+    if (tvc && ((tvc->f.states & (CVInit | CVFlushed))
+		|| osi_vnhold(tvc) != 0))
+	tvc = NULL;
+    ReleaseReadLock(VCHashLock(i));
+
+    if (tvc) {
+	if (flag & DO_VLRU)
+	    tvc->vlruRef = 1;
+	if (flag & DO_STATS) {
+	    afs_stats_cmperf.vcacheHits++;
+	    if (afs_IsPrimaryCellNum(afid->Cell))
+		afs_stats_cmperf.vlocalAccesses++;
+	    else
+		afs_stats_cmperf.vremoteAccesses++;
+	}
+    }
+    return tvc;
+#endif
+}				/*afs_FastFindVCache */
+
 /*!
  * Find a vcache entry given a fid. Does a wildcard match on what we
  * have for the fid. If more than one entry, don't return anything.
@@ -2893,6 +2948,8 @@ afs_vcacheInit(int astatSize)
 #endif
 
     AFS_RWLOCK_INIT(&afs_xvcache, "afs_xvcache");
+    for (i = 0; i < VCLOCKS; i++)
+	AFS_RWLOCK_INIT(&afs_xvhash[i], "afs_xvhash");
     LOCK_INIT(&afs_xvcb, "afs_xvcb");
 
 #if !defined(AFS_LINUX_ENV)
@@ -3043,6 +3100,8 @@ shutdown_vcache(void)
 #endif
 
     AFS_RWLOCK_INIT(&afs_xvcache, "afs_xvcache");
+    for (i = 0; i < VCLOCKS; i++)
+	AFS_RWLOCK_INIT(&afs_xvhash[i], "afs_xvhash");
     LOCK_INIT(&afs_xvcb, "afs_xvcb");
     QInit(&VLRU);
     for(i = 0; i < VCSIZE; ++i)
@@ -43,6 +43,10 @@
   *	-rmtsys	   Also fires up an afs remote sys call (e.g. pioctl, setpag)
   *                support daemon
   *     -chunksize [n]   2^n is the chunksize to be used.  0 is default.
+  *     -sweep-threads [n]  Sweep the cache subdirs with n threads.
+  *     -defer-sweep  Delete unwanted cache files after AFS has started.
+  *     -maxchunksize [n]  Chunks grow with file offset up to 2^n bytes.
+  *     -readahead [n]  Prefetch up to n KB ahead of sequential reads.
   *     -dcache    The number of data cache entries.
   *     -volumes    The number of volume entries.
   *     -biods     Number of bkg I/O daemons (AIX3.1 only)
@@ -96,6 +100,7 @@
 
 #include <sys/file.h>
 #include <sys/wait.h>
+#include <pthread.h>
 #include <hcrypto/rand.h>
 
 /* darwin dirent.h doesn't give us the prototypes we want if KERNEL is
@@ -260,6 +265,8 @@ static int nFilesPerDir = 2048;	/* # files per cache dir */
 #endif
 static int nDaemons = AFSD_NDAEMONS;	/* Number of background daemons */
 static int chunkSize = 0;	/* 2^chunkSize bytes per chunk */
+static int maxChunkSize = 0;	/* chunks grow up to 2^maxChunkSize bytes */
+static int readAhead = -1;	/* KB to prefetch ahead; -1 is the default */
 static int dCacheSize;		/* # of dcache entries */
 static int vCacheSize = 200;	/* # of volume cache entries */
 static int rootVolSet = 0;	/*True if root volume name explicitly set */
@@ -285,6 +292,8 @@ static int afsd_CloseSynch = 0;	/*Are closes synchronous or not? */
 static int rxmaxmtu = 0;       /* Are we forcing a limit on the mtu? */
 static int rxmaxfrags = 0;      /* Are we forcing a limit on frags? */
 static int volume_ttl = 0;      /* enable vldb cache timeout support */
+static int sweepThreads = 4;	/* # of threads sweeping cache subdirs */
+static int deferSweep = 0;	/* delete unwanted cache files later */
 
 #ifdef AFS_SGI_ENV
 #define AFSD_INO_T ino64_t
@@ -306,6 +315,28 @@ int *dir_for_V = NULL;		/* Array: dir of each cache file.
 AFSD_INO_T *inode_for_V;	/* Array of inodes for desired
 				 * cache files */
 #endif
+/* Cache subdirectories found at the top of the cache, to be swept by
+ * sweepThreads threads. */
+struct afsd_sweep_state {
+    char *directory;		/* /path/to/cache/directory */
+    struct afsd_sweep_dir {
+	int dirNum;
+	int maxDir;		/* 0 for a subdir we keep, -1 otherwise */
+    } *dirs;
+    int ndirs;
+    int next;			/* next of dirs to sweep */
+    int vFilesFound;
+    int code;
+    pthread_mutex_t lock;
+};
+static pthread_mutex_t sweepLock = PTHREAD_MUTEX_INITIALIZER;
+struct afsd_unwanted_file {
+    struct afsd_unwanted_file *next;
+    char path[1];		/* really longer */
+};
+/* Files found by the last sweep, to be deleted after startup, in order. */
+static struct afsd_unwanted_file *unwantedFiles = NULL;
+static struct afsd_unwanted_file **unwantedFilesTail = &unwantedFiles;
 int missing_DCacheFile = 1;	/*Is the DCACHEFILE missing? */
 int missing_VolInfoFile = 1;	/*Is the VOLINFOFILE missing? */
 int missing_CellInfoFile = 1;	/*Is the CELLINFOFILE missing? */
@@ -364,6 +395,10 @@ enum optionsList {
     OPT_rxmaxfrags,
     OPT_inumcalc,
     OPT_volume_ttl,
+    OPT_maxchunksize,
+    OPT_sweepthreads,
+    OPT_defersweep,
+    OPT_readahead,
 };
 
 #ifdef MACOS_EVENT_HANDLING
@@ -747,7 +782,7 @@ doGetXFileNumber(char *fname, char filechar, int maxNum)
      * Reject it if it's out of range, otherwise return it.
      */
     computedVNumber = atoi(++fname);
-    if (computedVNumber < cacheFiles)
+    if (computedVNumber < maxNum)
 	return (computedVNumber);
     else
 	return (-1);
@@ -937,6 +972,151 @@ UnlinkUnwantedFile(char *rn, char *fullpn_FileToDelete, char *fileToDelete)
     }
 }
 
+/*
+ * Delete a file or subdir that doesn't belong in the cache, or with
+ * -defer-sweep, remember to delete it once AFS has started.
+ */
+static void
+RemoveUnwantedFile(char *rn, char *fullpn_FileToDelete, char *fileToDelete)
+{
+    struct afsd_unwanted_file *tfile;
+    size_t len;
+
+    if (!deferSweep) {
+	if (afsd_verbose)
+	    printf("%s: Deleting '%s'\n", rn, fullpn_FileToDelete);
+	UnlinkUnwantedFile(rn, fullpn_FileToDelete, fileToDelete);
+	return;
+    }
+    len = strlen(fullpn_FileToDelete);
+    tfile = malloc(sizeof(*tfile) + len);
+    if (tfile == NULL) {
+	/* just delete it now */
+	UnlinkUnwantedFile(rn, fullpn_FileToDelete, fileToDelete);
+	return;
+    }
+    memcpy(tfile->path, fullpn_FileToDelete, len + 1);
+    tfile->next = NULL;
+    pthread_mutex_lock(&sweepLock);
+    *unwantedFilesTail = tfile;
+    unwantedFilesTail = &tfile->next;
+    pthread_mutex_unlock(&sweepLock);
+}
+
+static void
+FreeUnwantedFiles(void)
+{
+    struct afsd_unwanted_file *tfile;
+
+    while ((tfile = unwantedFiles) != NULL) {
+	unwantedFiles = tfile->next;
+	free(tfile);
+    }
+    unwantedFilesTail = &unwantedFiles;
+}
+
+/*
+ * Delete the files remembered by RemoveUnwantedFile.  Runs in the
+ * background after AFS has started; none of these files are cache files
+ * the kernel knows about.
+ */
+static void *
+RemoveUnwantedFiles(void *rock)
+{
+    static char rn[] = "RemoveUnwantedFiles";	/* Routine Name */
+    struct afsd_unwanted_file *tfile;
+    char *fileToDelete;
+    int nfiles = 0;
+
+    for (tfile = unwantedFiles; tfile; tfile = tfile->next) {
+	fileToDelete = strrchr(tfile->path, '/');
+	fileToDelete = fileToDelete ? fileToDelete + 1 : tfile->path;
+	UnlinkUnwantedFile(rn, tfile->path, fileToDelete);
+	nfiles++;
+    }
+    if (afsd_verbose)
+	printf("%s: Deleted %d unwanted files from the cache.\n", rn,
+	       nfiles);
+    FreeUnwantedFiles();
+    return NULL;
+}
+
+static int doSweepAFSCache(int *vFilesFound, char *directory, int dirNum,
+			   int maxDir);
+
+/* Sweep the cache subdirs in astate->dirs, until there are none left. */
+static void *
+SweepCacheSubDirs(void *rock)
+{
+    static char rn[] = "SweepCacheSubDirs";	/* Routine Name */
+    struct afsd_sweep_state *astate = rock;
+    char dir[1024];
+    int i, vFilesFound, code;
+
+    for (;;) {
+	pthread_mutex_lock(&astate->lock);
+	i = astate->next++;
+	if (astate->code)
+	    i = astate->ndirs;	/* give up */
+	pthread_mutex_unlock(&astate->lock);
+	if (i >= astate->ndirs)
+	    break;
+
+	snprintf(dir, sizeof(dir), "%s/D%d", astate->directory,
+		 astate->dirs[i].dirNum);
+	vFilesFound = 0;
+	code = doSweepAFSCache(&vFilesFound, dir, astate->dirs[i].dirNum,
+			       astate->dirs[i].maxDir);
+
+	pthread_mutex_lock(&astate->lock);
+	astate->vFilesFound += vFilesFound;
+	if (code && !astate->code) {
+	    printf("%s: Recursive sweep failed on directory %s\n", rn, dir);
+	    astate->code = code;
+	}
+	pthread_mutex_unlock(&astate->lock);
+    }
+    return NULL;
+}
+
+/*
+ * Sweep the cache subdirs found by doSweepAFSCache in parallel, with up to
+ * sweepThreads threads, one of which is this one.  Each subdir is swept by
+ * a single thread, so only the V-file arrays are shared between them.
+ */
+static int
+SweepCacheSubDirsParallel(int *vFilesFound, struct afsd_sweep_state *astate)
+{
+    static char rn[] = "SweepCacheSubDirsParallel";	/* Routine Name */
+    pthread_t *tids;
+    int nthreads, i;
+
+    nthreads = (sweepThreads < astate->ndirs) ? sweepThreads : astate->ndirs;
+    tids = NULL;
+    if (nthreads > 1)
+	tids = calloc(nthreads - 1, sizeof(*tids));
+    if (tids == NULL)
+	nthreads = 1;
+
+    pthread_mutex_init(&astate->lock, NULL);
+    for (i = 0; i < nthreads - 1; i++) {
+	if (pthread_create(&tids[i], NULL, SweepCacheSubDirs, astate) != 0) {
+	    printf("%s: Can't create sweep thread; continuing with %d\n", rn,
+		   i + 1);
+	    break;
+	}
+    }
+    nthreads = i + 1;
+    SweepCacheSubDirs(astate);
+    for (i = 0; i < nthreads - 1; i++)
+	pthread_join(tids[i], NULL);
+    pthread_mutex_destroy(&astate->lock);
+    free(tids);
+
+    *vFilesFound += astate->vFilesFound;
+    return astate->code;
+}
+
 /*-----------------------------------------------------------------------------
   * SweepAFSCache
   *
@@ -984,6 +1164,9 @@ doSweepAFSCache(int *vFilesFound,
     int vFileNum;		/*Data cache file's associated number */
     int thisDir;		/* A directory number */
     int highDir = 0;
+    struct afsd_sweep_state subdirs;	/* subdirs to sweep, if top-level */
+    struct afsd_sweep_dir *tdirs;
+    int code;
 
     if (afsd_debug)
 	printf("%s: Opening cache directory '%s'\n", rn, directory);
@@ -1008,6 +1191,8 @@ doSweepAFSCache(int *vFilesFound,
      */
     sprintf(fullpn_FileToDelete, "%s/", directory);
     fileToDelete = fullpn_FileToDelete + strlen(fullpn_FileToDelete);
+    memset(&subdirs, 0, sizeof(subdirs));
+    subdirs.directory = directory;
 
 #ifdef AFS_SGI_ENV
     for (currp = readdir64(cdirp); currp; currp = readdir64(cdirp))
@@ -1043,10 +1228,12 @@ doSweepAFSCache(int *vFilesFound,
 	     * file's inode, directory, and bump the number of files found
 	     * total and in this directory.
 	     */
+	    pthread_mutex_lock(&sweepLock);
 #if !defined(AFS_CACHE_VNODE_PATH) && !defined(AFS_LINUX_ENV)
 	    inode_for_V[vFileNum] = currp->d_ino;
 #endif
 	    dir_for_V[vFileNum] = dirNum;	/* remember this directory */
+	    pthread_mutex_unlock(&sweepLock);
 
 	    if (!maxDir) {
 		/* If we're in a real subdir, mark this file to be moved
@@ -1095,18 +1282,22 @@ doSweepAFSCache(int *vFilesFound,
 	    if (retval == 1)
 		cache_dir_list[vFileNum] = 0;
 
-	    /* Print the dirname for recursion */
-	    sprintf(fileToDelete, "%s", currp->d_name);
-
-	    /* Note: vFileNum is the directory number */
-	    retval =
-		doSweepAFSCache(vFilesFound, fullpn_FileToDelete, vFileNum,
-				(retval == 1 ? 0 : -1));
-	    if (retval) {
-		printf("%s: Recursive sweep failed on directory %s\n", rn,
-		       currp->d_name);
-		return retval;
+	    /* Remember the subdir to sweep once we have seen them all.
+	     * Note: vFileNum is the directory number */
+	    if (subdirs.ndirs % 64 == 0) {
+		tdirs = realloc(subdirs.dirs,
+				(subdirs.ndirs + 64) * sizeof(*tdirs));
+		if (tdirs == NULL) {
+		    printf("%s: Malloc Failed!\n", rn);
+		    free(subdirs.dirs);
+		    closedir(cdirp);
+		    return (-1);
+		}
+		subdirs.dirs = tdirs;
 	    }
+	    subdirs.dirs[subdirs.ndirs].dirNum = vFileNum;
+	    subdirs.dirs[subdirs.ndirs].maxDir = (retval == 1 ? 0 : -1);
+	    subdirs.ndirs++;
 	} else if (dirNum < 0 && strcmp(currp->d_name, DCACHEFILE) == 0) {
 	    /*
 	     * Found the file holding the dcache entries.
@@ -1140,14 +1331,22 @@ doSweepAFSCache(int *vFilesFound,
 	     * This file/directory doesn't belong in the cache.  Nuke it.
 	     */
 	    sprintf(fileToDelete, "%s", currp->d_name);
-	    if (afsd_verbose)
-		printf("%s: Deleting '%s'\n", rn, fullpn_FileToDelete);
-	    UnlinkUnwantedFile(rn, fullpn_FileToDelete, fileToDelete);
+	    RemoveUnwantedFile(rn, fullpn_FileToDelete, fileToDelete);
 	}
     }
 
     if (dirNum < 0) {
 
+	/*
+	 * Sweep the subdirs.
+	 */
+	code = SweepCacheSubDirsParallel(vFilesFound, &subdirs);
+	free(subdirs.dirs);
+	if (code) {
+	    closedir(cdirp);
+	    return code;
+	}
+
 	/*
 	 * Create all the cache files that are missing.
 	 */
@@ -1257,7 +1456,7 @@ doSweepAFSCache(int *vFilesFound,
 	/* Remove any directories >= maxDir -- they should be empty */
 	for (; highDir >= maxDir; highDir--) {
 	    sprintf(fileToDelete, "D%d", highDir);
-	    UnlinkUnwantedFile(rn, fullpn_FileToDelete, fileToDelete);
+	    RemoveUnwantedFile(rn, fullpn_FileToDelete, fileToDelete);
 	}
     }
 
@@ -1372,6 +1571,9 @@ SweepAFSCache(int *vFilesFound)
 	return 0;
     }
 
+    /* only the last sweep's list of files to delete is complete */
+    FreeUnwantedFiles();
+
     if (cache_dir_list == NULL) {
 	cache_dir_list = malloc(maxDir * sizeof(*cache_dir_list));
 	if (cache_dir_list == NULL) {
@@ -2216,6 +2418,32 @@ CheckOptions(struct cmd_syndesc *as)
 	}
     }
 
+    if (cmd_OptionAsInt(as, OPT_sweepthreads, &sweepThreads) == 0) {
+	if (sweepThreads < 1) {
+	    printf("afsd: invalid number of sweep threads, using 1\n");
+	    sweepThreads = 1;
+	}
+    }
+
+    if (cmd_OptionPresent(as, OPT_defersweep))
+	deferSweep = 1;
+
+    if (cmd_OptionAsInt(as, OPT_maxchunksize, &maxChunkSize) == 0) {
+	if (maxChunkSize < 0 || maxChunkSize > 30) {
+	    printf
+		("afsd:invalid max chunk size (not in range 0-30), ignored\n");
+	    maxChunkSize = 0;
+	}
+    }
+
+    if (cmd_OptionAsInt(as, OPT_readahead, &readAhead) == 0) {
+	if (readAhead < 0 || readAhead > AFS_MAXREADAHEAD_LIMIT) {
+	    printf("afsd:invalid readahead (not in range 0-%d), ignored\n",
+		   AFS_MAXREADAHEAD_LIMIT);
+	    readAhead = -1;
+	}
+    }
+
     if (cmd_OptionAsInt(as, OPT_dcache, &dCacheSize) == 0)
 	sawDCacheSize = 1;
 
@@ -2681,6 +2909,15 @@ afsd_run(void)
 	    ("%s: Calling AFSOP_CACHEINIT: %d stat cache entries, %d optimum cache files, %d blocks in the cache, flags = 0x%x, dcache entries %d\n",
 	     rn, cacheStatEntries, cacheFiles, cacheBlocks, cacheFlags,
 	     dCacheSize);
+    if (maxChunkSize) {
+	if (afsd_verbose)
+	    printf("%s: Setting max chunk size in kernel = %d\n", rn,
+		   maxChunkSize);
+	code = afsd_syscall(AFSOP_SET_MAXCHUNK, maxChunkSize);
+	if (code)
+	    printf("%s: Error setting max chunk size\n", rn);
+    }
+
     memset(&cparams, '\0', sizeof(cparams));
     cparams.cacheScaches = cacheStatEntries;
     cparams.cacheFiles = cacheFiles;
@@ -2720,6 +2957,9 @@ afsd_run(void)
     cacheIteration = 0;
     /* Memory-cache based system doesn't need any of this */
     if (!(cacheFlags & AFSCALL_INIT_MEMCACHE)) {
+	struct timeval sweepStart, sweepEnd;
+
+	gettimeofday(&sweepStart, NULL);
 	do {
 	    cacheIteration++;
 	    if (SweepAFSCache(&vFilesFound)) {
@@ -2733,6 +2973,12 @@ afsd_run(void)
 		     rn, vFilesFound, cacheFiles, cacheIteration);
 	} while ((vFilesFound < cacheFiles)
 		 && (cacheIteration < MAX_CACHE_LOOPS));
+	gettimeofday(&sweepEnd, NULL);
+	if (afsd_verbose)
+	    printf("%s: Cache sweep took %.3f seconds with %d threads.\n", rn,
+		   (sweepEnd.tv_sec - sweepStart.tv_sec)
+		   + (sweepEnd.tv_usec - sweepStart.tv_usec) / 1000000.0,
+		   sweepThreads);
     } else if (afsd_verbose)
 	printf("%s: Using memory cache, not swept\n", rn);
 
@@ -2894,6 +3140,16 @@ afsd_run(void)
 	}
     }
 
+    if (readAhead >= 0) {
+	if (afsd_verbose)
+	    printf("%s: Calling AFSOP_SET_READAHEAD with '%d'\n", rn,
+		   readAhead);
+	code = afsd_syscall(AFSOP_SET_READAHEAD, readAhead);
+	if (code)
+	    printf("%s: Error setting readahead to %d KB; code=%d.\n", rn,
+		   readAhead, code);
+    }
+
     /*
      * Pass the kernel the name of the workstation cache file holding the
      * volume information.
@@ -2964,6 +3220,12 @@ afsd_run(void)
      */
     printf("%s: All AFS daemons started.\n", rn);
 
+    if (unwantedFiles != NULL) {
+	if (afsd_verbose)
+	    printf("%s: Forking cache sweep cleanup.\n", rn);
+	afsd_fork(0, RemoveUnwantedFiles, NULL);
+    }
+
     if (afsd_verbose)
 	printf("%s: Forking trunc-cache daemon.\n", rn);
     fork_syscall(rn, AFSOP_START_TRUNCDAEMON);
@@ -3096,6 +3358,15 @@ afsd_init(void)
     cmd_AddParmAtOffset(ts, OPT_volume_ttl, "-volume-ttl", CMD_SINGLE,
 			CMD_OPTIONAL,
 			"Set the vldb cache timeout value in seconds.");
+    cmd_AddParmAtOffset(ts, OPT_maxchunksize, "-maxchunksize", CMD_SINGLE,
+			CMD_OPTIONAL, "log(2) of largest chunk size");
+    cmd_AddParmAtOffset(ts, OPT_sweepthreads, "-sweep-threads", CMD_SINGLE,
+			CMD_OPTIONAL, "number of threads sweeping the cache");
+    cmd_AddParmAtOffset(ts, OPT_defersweep, "-defer-sweep", CMD_FLAG,
+			CMD_OPTIONAL,
+			"delete unwanted cache files after startup");
+    cmd_AddParmAtOffset(ts, OPT_readahead, "-readahead", CMD_SINGLE,
+			CMD_OPTIONAL, "KB to prefetch ahead of sequential reads");
 }
 
 /**
@@ -3177,6 +3448,8 @@ afsd_syscall_populate(struct afsd_syscall_args *args, int syscall, va_list ap)
     case AFSOP_SET_RMTSYS_FLAG:
     case AFSOP_SET_INUMCALC:
     case AFSOP_SET_VOLUME_TTL:
+    case AFSOP_SET_MAXCHUNK:
+    case AFSOP_SET_READAHEAD:
 	params[0] = CAST_SYSCALL_PARAM((va_arg(ap, int)));
 	break;
     case AFSOP_SET_THISCELL:
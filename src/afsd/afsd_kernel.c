@@ -170,9 +170,11 @@ afsd_init_syscall_opcodes(void)
     add_opcode(AFSOP_SEED_ENTROPY);
     add_opcode(AFSOP_SET_INUMCALC);
     add_opcode(AFSOP_RXLISTENER_DAEMON);
+    add_opcode(AFSOP_SET_MAXCHUNK);
     add_opcode(AFSOP_CACHEBASEDIR);
     add_opcode(AFSOP_CACHEDIRS);
     add_opcode(AFSOP_CACHEFILES);
+    add_opcode(AFSOP_SET_READAHEAD);
     add_opcode(AFSOP_SETINT);
     add_opcode(AFSOP_GO);
     add_opcode(AFSOP_CHECKLOCKS);
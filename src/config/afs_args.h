@@ -61,10 +61,12 @@
 #define AFSOP_SET_VOLUME_TTL     47     /* set the vldb cache timeout */
 
 #define AFSOP_RXLISTENER_DAEMON  48	/* starts kernel RX listener */
+#define AFSOP_SET_MAXCHUNK	 49	/* set log(2) of the largest chunk */
 
 #define AFSOP_CACHEBASEDIR	 50	/* cache base dir */
 #define AFSOP_CACHEDIRS		 51	/* number of files per dir */
 #define AFSOP_CACHEFILES	 52	/* number of files */
+#define AFSOP_SET_READAHEAD	 53	/* set max KB to prefetch ahead */
 
 #define AFSOP_SETINT		 60	/* set key/value pairs for ints */
 
@@ -201,6 +203,9 @@ enum {
 #define AFS_MIN_VOLUME_TTL 600
 #define AFS_MAX_VOLUME_TTL MAX_AFS_INT32
 
+/* Largest AFSOP_SET_READAHEAD value, in KB. */
+#define AFS_MAXREADAHEAD_LIMIT (1024 * 1024)
+
 /*
  * Note that the AFS_*ALLOCSIZ values should be multiples of sizeof(void*) to
  * accomodate pointer alignment.
@@ -0,0 +1,210 @@
+/*
+ * This software has been released under the terms of the IBM Public
+ * License.  For details, see the LICENSE file in the top-level source
+ * directory or online at http://www.openafs.org/dl/license10.html
+ */
+
+/*
+ * lookupbench - measure how well cache manager lookups scale with threads.
+ *
+ * Reads the names in an AFS directory once, so that they are all in the
+ * stat cache, and then has 1, 2, 4, ... threads stat them over and over.
+ * For each thread count, prints the aggregate number of lookups per second.
+ *
+ * usage: lookupbench [-t maxthreads] [-s seconds] dir [-- afsd options]
+ */
+
+#include <afsconfig.h>
+#include <afs/param.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <netinet/in.h>
+#include <afs/sysincludes.h>
+#include <rx/rx.h>
+#include <afs_usrops.h>
+
+#include <pthread.h>
+
+#define MAXNAMES 100000
+
+static char **names;
+static int nnames;
+static volatile int stop;
+
+struct worker {
+    pthread_t tid;
+    int start;
+    unsigned long lookups;
+};
+
+static void
+usage(void)
+{
+    fprintf(stderr, "usage: lookupbench [-t maxthreads] [-s seconds] dir "
+	    "[-- afsd options]\n");
+    exit(1);
+}
+
+static void
+readnames(char *dir)
+{
+    usr_DIR *dirp;
+    struct usr_dirent *dp;
+    char *path;
+
+    dirp = uafs_opendir(dir);
+    if (dirp == NULL) {
+	fprintf(stderr, "lookupbench: cannot open %s: %s\n", dir,
+		strerror(errno));
+	exit(1);
+    }
+    names = calloc(MAXNAMES, sizeof(*names));
+    if (names == NULL) {
+	fprintf(stderr, "lookupbench: out of memory\n");
+	exit(1);
+    }
+    while (nnames < MAXNAMES && (dp = uafs_readdir(dirp)) != NULL) {
+	if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
+	    continue;
+	if (asprintf(&path, "%s/%s", dir, dp->d_name) < 0) {
+	    fprintf(stderr, "lookupbench: out of memory\n");
+	    exit(1);
+	}
+	names[nnames++] = path;
+    }
+    uafs_closedir(dirp);
+    if (nnames == 0) {
+	fprintf(stderr, "lookupbench: %s is empty\n", dir);
+	exit(1);
+    }
+}
+
+static void *
+worker(void *arg)
+{
+    struct worker *w = arg;
+    struct stat st;
+    int i = w->start;
+
+    uafs_InitThread();
+    while (!stop) {
+	if (uafs_lstat(names[i], &st) < 0) {
+	    fprintf(stderr, "lookupbench: %s: %s\n", names[i],
+		    strerror(errno));
+	    exit(1);
+	}
+	w->lookups++;
+	if (++i == nnames)
+	    i = 0;
+    }
+    return NULL;
+}
+
+static double
+run(int nthreads, int seconds)
+{
+    struct worker *workers;
+    struct timeval start, end;
+    unsigned long total = 0;
+    double elapsed;
+    int i;
+
+    workers = calloc(nthreads, sizeof(*workers));
+    if (workers == NULL) {
+	fprintf(stderr, "lookupbench: out of memory\n");
+	exit(1);
+    }
+    stop = 0;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nthreads; i++) {
+	workers[i].start = (i * (nnames / nthreads)) % nnames;
+	if (pthread_create(&workers[i].tid, NULL, worker, &workers[i]) != 0) {
+	    fprintf(stderr, "lookupbench: cannot create thread\n");
+	    exit(1);
+	}
+    }
+    sleep(seconds);
+    stop = 1;
+    for (i = 0; i < nthreads; i++) {
+	pthread_join(workers[i].tid, NULL);
+	total += workers[i].lookups;
+    }
+    gettimeofday(&end, NULL);
+    free(workers);
+
+    elapsed = (end.tv_sec - start.tv_sec)
+	+ (end.tv_usec - start.tv_usec) / 1000000.0;
+    return total / elapsed;
+}
+
+int
+main(int argc, char **argv)
+{
+    int maxthreads = 32, seconds = 5;
+    int nthreads, i, code;
+    char *dir = NULL;
+    char **afsargv;
+    int afsargc = 1;
+    double base = 0, rate;
+
+    afsargv = calloc(argc + 1, sizeof(*afsargv));
+    if (afsargv == NULL) {
+	fprintf(stderr, "lookupbench: out of memory\n");
+	return 1;
+    }
+    afsargv[0] = argv[0];
+    for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "--") == 0) {
+	    for (i++; i < argc; i++)
+		afsargv[afsargc++] = argv[i];
+	} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+	    maxthreads = atoi(argv[++i]);
+	} else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+	    seconds = atoi(argv[++i]);
+	} else if (argv[i][0] != '-' && dir == NULL) {
+	    dir = argv[i];
+	} else {
+	    usage();
+	}
+    }
+    if (dir == NULL || maxthreads < 1 || seconds < 1)
+	usage();
+
+    code = uafs_Setup("/afs");
+    if (code) {
+	fprintf(stderr, "lookupbench: uafs_Setup: %s\n", strerror(code));
+	return 1;
+    }
+    code = uafs_ParseArgs(afsargc, afsargv);
+    if (code) {
+	fprintf(stderr, "lookupbench: bad afsd options; code %d\n", code);
+	return 1;
+    }
+    code = uafs_Run();
+    if (code) {
+	fprintf(stderr, "lookupbench: uafs_Run: %s\n", strerror(code));
+	return 1;
+    }
+
+    readnames(dir);
+    /* warm the stat cache */
+    run(1, 1);
+
+    printf("%d names in %s, %d seconds per run\n", nnames, dir, seconds);
+    printf("%8s %14s %8s\n", "threads", "lookups/sec", "speedup");
+    for (nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+	rate = run(nthreads, seconds);
+	if (nthreads == 1)
+	    base = rate;
+	printf("%8d %14.0f %8.2f\n", nthreads, rate,
+	       base > 0 ? rate / base : 0);
+	fflush(stdout);
+    }
+
+    uafs_Shutdown();
+    return 0;
+}
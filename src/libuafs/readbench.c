@@ -0,0 +1,137 @@
+/*
+ * This software has been released under the terms of the IBM Public
+ * License.  For details, see the LICENSE file in the top-level source
+ * directory or online at http://www.openafs.org/dl/license10.html
+ */
+
+/*
+ * readbench - measure how fast the cache manager reads a file sequentially.
+ *
+ * Reads an AFS file from start to end in blocks of the given size.  With a
+ * memory cache, or a fresh disk cache, the first pass has to fetch the
+ * whole file from the fileserver, so it shows how well read-ahead keeps a
+ * sequential reader supplied; later passes read from the cache.  Compare
+ * read-ahead windows by passing -readahead in the afsd options.  For each
+ * pass, prints the time taken and the MB read per second.
+ *
+ * usage: readbench [-n passes] [-b blocksize] file [-- afsd options]
+ */
+
+#include <afsconfig.h>
+#include <afs/param.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <netinet/in.h>
+#include <afs/sysincludes.h>
+#include <rx/rx.h>
+#include <afs_usrops.h>
+
+static void
+usage(void)
+{
+    fprintf(stderr, "usage: readbench [-n passes] [-b blocksize] file "
+	    "[-- afsd options]\n");
+    exit(1);
+}
+
+static long long
+readfile(char *file, char *buf, int blocksize)
+{
+    long long total = 0;
+    int fd, code;
+
+    fd = uafs_open(file, O_RDONLY, 0);
+    if (fd < 0) {
+	fprintf(stderr, "readbench: cannot open %s: %s\n", file,
+		strerror(errno));
+	exit(1);
+    }
+    while ((code = uafs_read(fd, buf, blocksize)) > 0)
+	total += code;
+    if (code < 0) {
+	fprintf(stderr, "readbench: %s: %s\n", file, strerror(errno));
+	exit(1);
+    }
+    uafs_close(fd);
+    return total;
+}
+
+int
+main(int argc, char **argv)
+{
+    int passes = 3;
+    int blocksize = 65536;
+    int pass, i, code;
+    char *file = NULL;
+    char *buf;
+    char **afsargv;
+    int afsargc = 1;
+    long long nbytes;
+    struct timeval start, end;
+    double elapsed;
+
+    afsargv = calloc(argc + 1, sizeof(*afsargv));
+    if (afsargv == NULL) {
+	fprintf(stderr, "readbench: out of memory\n");
+	return 1;
+    }
+    afsargv[0] = argv[0];
+    for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "--") == 0) {
+	    for (i++; i < argc; i++)
+		afsargv[afsargc++] = argv[i];
+	} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+	    passes = atoi(argv[++i]);
+	} else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+	    blocksize = atoi(argv[++i]);
+	} else if (argv[i][0] != '-' && file == NULL) {
+	    file = argv[i];
+	} else {
+	    usage();
+	}
+    }
+    if (file == NULL || passes < 1 || blocksize < 1)
+	usage();
+
+    buf = malloc(blocksize);
+    if (buf == NULL) {
+	fprintf(stderr, "readbench: out of memory\n");
+	return 1;
+    }
+
+    code = uafs_Setup("/afs");
+    if (code) {
+	fprintf(stderr, "readbench: uafs_Setup: %s\n", strerror(code));
+	return 1;
+    }
+    code = uafs_ParseArgs(afsargc, afsargv);
+    if (code) {
+	fprintf(stderr, "readbench: bad afsd options; code %d\n", code);
+	return 1;
+    }
+    code = uafs_Run();
+    if (code) {
+	fprintf(stderr, "readbench: uafs_Run: %s\n", strerror(code));
+	return 1;
+    }
+
+    printf("%6s %14s %10s %10s\n", "pass", "bytes", "seconds", "MB/sec");
+    for (pass = 1; pass <= passes; pass++) {
+	gettimeofday(&start, NULL);
+	nbytes = readfile(file, buf, blocksize);
+	gettimeofday(&end, NULL);
+	elapsed = (end.tv_sec - start.tv_sec)
+	    + (end.tv_usec - start.tv_usec) / 1000000.0;
+	printf("%6d %14lld %10.3f %10.1f\n", pass, nbytes, elapsed,
+	       elapsed > 0 ? nbytes / elapsed / (1024 * 1024) : 0);
+	fflush(stdout);
+    }
+
+    free(buf);
+    uafs_Shutdown();
+    return 0;
+}
@@ -364,6 +364,8 @@ rxi_EnumGetIfInfo(struct hashbucket *h, caddr_t key, caddr_t arg1,
 	different++;
 	*(int *)arg1 = different;
     }
+    if (!rx_IsLoopbackAddr(ifinaddr) && rxmtu > rxi_maxIfMTU)
+        rxi_maxIfMTU = rxmtu;
     rxmtu = rxmtu * rxi_nRecvFrags + ((rxi_nRecvFrags - 1) * UDP_HDR_SIZE);
     if (!rx_IsLoopbackAddr(ifinaddr) && (rxmtu > rx_maxReceiveSize)) {
 	rx_maxReceiveSize = MIN(RX_MAX_PACKET_SIZE, rxmtu);
@@ -114,6 +114,8 @@ rxi_GetIFInfo()
 
 	    /* Copy interface MTU and address; adjust maxmtu */
 	    mtus[i] = rxmtu;
+	    if (!rx_IsLoopbackAddr(ifinaddr) && rxmtu > rxi_maxIfMTU)
+	        rxi_maxIfMTU = rxmtu;
 	    rxmtu = rxi_AdjustIfMTU(rxmtu);
 	    maxmtu = rxmtu * rxi_nRecvFrags +
 	        ((rxi_nRecvFrags - 1) * UDP_HDR_SIZE);
@@ -171,6 +173,8 @@ rxi_GetIFInfo()
 
 	    /* Copy interface MTU and address; adjust maxmtu */
 	    mtus[i] = rxmtu;
+	    if (!rx_IsLoopbackAddr(ifinaddr) && rxmtu > rxi_maxIfMTU)
+	        rxi_maxIfMTU = rxmtu;
 	    rxmtu = rxi_AdjustIfMTU(rxmtu);
 	    maxmtu =
 		rxmtu * rxi_nRecvFrags +
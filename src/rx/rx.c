@@ -200,22 +200,13 @@ struct clock rx_softAckDelay = {0, 100000};
 
 static unsigned int rxi_rpc_peer_stat_cnt;
 
-/*
- * rxi_rpc_process_stat_cnt counts the total number of local process stat
- * structures currently allocated within rx.  The number is used to allocate
- * the memory required to return the statistics when queried.
- * Protected by the rx_rpc_stats mutex.
- */
-
-static unsigned int rxi_rpc_process_stat_cnt;
+#ifdef RX_ENABLE_LOCKS
+static void rxi_InitProcessStatsLocks(void);
+#endif
 
 rx_atomic_t rx_nWaiting = RX_ATOMIC_INIT(0);
 rx_atomic_t rx_nWaited = RX_ATOMIC_INIT(0);
 
-/* Incoming calls wait on this queue when there are no available
- * server processes */
-struct opr_queue rx_incomingCallQueue;
-
 /* Server processes wait on this queue when there are no appropriate
  * calls to process */
 struct opr_queue rx_idleServerQueue;
@@ -302,6 +293,7 @@ rxi_InitPthread(void)
     osi_Assert(pthread_key_create(&rx_ts_info_key, NULL) == 0);
 
     MUTEX_INIT(&rx_rpc_stats, "rx_rpc_stats", MUTEX_DEFAULT, 0);
+    rxi_InitProcessStatsLocks();
     MUTEX_INIT(&rx_freePktQ_lock, "rx_freePktQ_lock", MUTEX_DEFAULT, 0);
     MUTEX_INIT(&rx_mallocedPktQ_lock, "rx_mallocedPktQ_lock", MUTEX_DEFAULT,
 	       0);
@@ -532,6 +524,7 @@ rx_InitHost(u_int host, u_int port)
     MUTEX_INIT(&rx_packets_mutex, "rx_packets_mutex", MUTEX_DEFAULT, 0);
     MUTEX_INIT(&rx_refcnt_mutex, "rx_refcnt_mutex", MUTEX_DEFAULT, 0);
     MUTEX_INIT(&rx_rpc_stats, "rx_rpc_stats", MUTEX_DEFAULT, 0);
+    rxi_InitProcessStatsLocks();
     MUTEX_INIT(&rx_freePktQ_lock, "rx_freePktQ_lock", MUTEX_DEFAULT, 0);
     MUTEX_INIT(&freeSQEList_lock, "freeSQEList lock", MUTEX_DEFAULT, 0);
     MUTEX_INIT(&rx_freeCallQueue_lock, "rx_freeCallQueue_lock", MUTEX_DEFAULT,
@@ -635,7 +628,6 @@ rx_InitHost(u_int host, u_int port)
     /* Initialize various global queues */
     opr_queue_Init(&rx_idleServerQueue);
     opr_queue_Init(&rx_freeServerQueue);
-    opr_queue_Init(&rx_incomingCallQueue);
     opr_queue_Init(&rx_freeCallQueue);
 
 #if defined(AFS_NT40_ENV) && !defined(KERNEL)
@@ -915,8 +907,129 @@ QuotaOK(struct rx_service *aservice)
     MUTEX_EXIT(&rx_quota_mutex);
     return rc;
 }
+
+/* Without fine grained locking, QuotaOK reserves nothing, so there is
+ * nothing to give back. */
+#define ReturnToServerPool(aservice)
 #endif /* RX_ENABLE_LOCKS */
 
+/* Could a call for this service start now?  Reserves nothing. */
+static int
+ServiceHasQuota(struct rx_service *aservice)
+{
+    if (!QuotaOK(aservice))
+	return 0;
+    ReturnToServerPool(aservice);
+    return 1;
+}
+
+/* Pick a call for a server thread from the incoming call queues.  Called
+ * with rx_serverPool_lock held; the caller must still take quota for the
+ * call's service before starting it.
+ *
+ * Each service queues its own incoming calls, so a service that is
+ * already running its maxProcs calls costs one quota check, not one per
+ * call it has waiting.  One thread (the FCFS thread) always takes the call
+ * that has waited longest, to prevent starvation, while the others may run
+ * ahead looking for calls which have all their input data available
+ * immediately.  This helps keep threads from blocking, waiting for data
+ * from the client.  If they find none, they take a second choice if one
+ * was identified, or else the most recently queued call they looked at. */
+static struct rx_call *
+rxi_ChooseIncomingCall(int fcfs)
+{
+    struct rx_service *service;
+    struct rx_call *tcall, *choice2 = NULL, *call = NULL;
+    struct rx_packet *rp;
+    struct opr_queue *cursor;
+    int i;
+
+    for (i = 0; i < RX_MAX_SERVICES; i++) {
+	service = rx_services[i];
+	if (service == NULL)
+	    break;
+	if (opr_queue_IsEmpty(&service->incomingCallQueue)
+	    || !ServiceHasQuota(service))
+	    continue;
+
+	if (fcfs) {
+	    tcall = opr_queue_First(&service->incomingCallQueue,
+				    struct rx_call, entry);
+	    if (call == NULL || clock_Lt(&tcall->queueTime, &call->queueTime))
+		call = tcall;
+	    continue;
+	}
+
+	for (opr_queue_Scan(&service->incomingCallQueue, cursor)) {
+	    tcall = opr_queue_Entry(cursor, struct rx_call, entry);
+	    if (opr_queue_IsEmpty(&tcall->rq))
+		continue;
+	    rp = opr_queue_First(&tcall->rq, struct rx_packet, entry);
+	    if (rp->header.seq != 1)
+		continue;
+	    if (!meltdown_1pkt || (rp->header.flags & RX_LAST_PACKET))
+		return tcall;
+	    if (rxi_2dchoice && !choice2 && !(tcall->flags & RX_CALL_CLEARED)
+		&& (tcall->rprev > rxi_HardAckRate))
+		choice2 = tcall;
+	    else
+		rxi_md2cnt++;
+	}
+	tcall = opr_queue_Last(&service->incomingCallQueue, struct rx_call,
+			       entry);
+	if (call == NULL || clock_Gt(&tcall->queueTime, &call->queueTime))
+	    call = tcall;
+    }
+    return choice2 ? choice2 : call;
+}
+
+/* Account for the time a call spent waiting for a server thread.  Called
+ * with rx_serverPool_lock held, as the call is handed to a thread. */
+static void
+rxi_CountDispatch(struct rx_service *service, struct rx_call *call)
+{
+    struct clock wait;
+    afs_uint32 usec;
+
+    clock_GetTime(&wait);
+    clock_Sub(&wait, &call->queueTime);
+    if (wait.sec < 0)
+	usec = 0;
+    else if (wait.sec >= 4294)
+	usec = 0xffffffff;
+    else
+	usec = wait.sec * 1000000 + wait.usec;
+
+    service->nDispatched++;
+    service->dispatchWaitSum += usec;
+    if (usec > service->dispatchWaitMax)
+	service->dispatchWaitMax = usec;
+}
+
+/* Sum up the dispatch statistics of all services, for rxdebug.  Called
+ * with rx_serverPool_lock held. */
+void
+rxi_GetDispatchStats(afs_uint32 *nDispatched, afs_uint32 *waitMean,
+		     afs_uint32 *waitMax)
+{
+    struct rx_service *service;
+    afs_uint64 n = 0, sum = 0;
+    int i;
+
+    *waitMax = 0;
+    for (i = 0; i < RX_MAX_SERVICES; i++) {
+	service = rx_services[i];
+	if (service == NULL)
+	    break;
+	n += service->nDispatched;
+	sum += service->dispatchWaitSum;
+	if (service->dispatchWaitMax > *waitMax)
+	    *waitMax = service->dispatchWaitMax;
+    }
+    *nDispatched = n;
+    *waitMean = n ? sum / n : 0;
+}
+
 #ifndef KERNEL
 /* Called by rx_StartServer to start up lwp's to service calls.
    NExistingProcs gives the number of procs already existing, and which
@@ -1821,6 +1934,7 @@ rx_NewServiceHost(afs_uint32 host, u_short port, u_short serviceId,
 	    service->checkReach = 0;
 	    service->nSpecific = 0;
 	    service->specific = NULL;
+	    opr_queue_Init(&service->incomingCallQueue);
 	    rx_services[i] = service;	/* not visible until now */
 	    USERPRI;
 	    return service;
@@ -2018,6 +2132,7 @@ rx_GetCall(int tno, struct rx_service *cur_service, osi_socket * socketp)
     struct rx_serverQueueEntry *sq;
     struct rx_call *call = (struct rx_call *)0;
     struct rx_service *service = NULL;
+    int fcfs;
 
     MUTEX_ENTER(&freeSQEList_lock);
 
@@ -2033,68 +2148,25 @@ rx_GetCall(int tno, struct rx_service *cur_service, osi_socket * socketp)
 	CV_INIT(&sq->cv, "server Queue lock", CV_DEFAULT, 0);
     }
 
+    MUTEX_ENTER(&rx_pthread_mutex);
+    fcfs = (tno == rxi_fcfs_thread_num);
+    MUTEX_EXIT(&rx_pthread_mutex);
+
     MUTEX_ENTER(&rx_serverPool_lock);
     if (cur_service != NULL) {
 	ReturnToServerPool(cur_service);
     }
     while (1) {
-	if (!opr_queue_IsEmpty(&rx_incomingCallQueue)) {
-	    struct rx_call *tcall, *choice2 = NULL;
-	    struct opr_queue *cursor;
-
-	    /* Scan for eligible incoming calls.  A call is not eligible
-	     * if the maximum number of calls for its service type are
-	     * already executing */
-	    /* One thread will process calls FCFS (to prevent starvation),
-	     * while the other threads may run ahead looking for calls which
-	     * have all their input data available immediately.  This helps
-	     * keep threads from blocking, waiting for data from the client. */
-	    for (opr_queue_Scan(&rx_incomingCallQueue, cursor)) {
-		tcall = opr_queue_Entry(cursor, struct rx_call, entry);
-
-		service = tcall->conn->service;
-		if (!QuotaOK(service)) {
-		    continue;
-		}
-		MUTEX_ENTER(&rx_pthread_mutex);
-		if (tno == rxi_fcfs_thread_num
-			|| opr_queue_IsLast(&rx_incomingCallQueue, cursor)) {
-		    MUTEX_EXIT(&rx_pthread_mutex);
-		    /* If we're the fcfs thread , then  we'll just use
-		     * this call. If we haven't been able to find an optimal
-		     * choice, and we're at the end of the list, then use a
-		     * 2d choice if one has been identified.  Otherwise... */
-		    call = (choice2 ? choice2 : tcall);
-		    service = call->conn->service;
-		} else {
-		    MUTEX_EXIT(&rx_pthread_mutex);
-		    if (!opr_queue_IsEmpty(&tcall->rq)) {
-			struct rx_packet *rp;
-			rp = opr_queue_First(&tcall->rq, struct rx_packet,
-					    entry);
-			if (rp->header.seq == 1) {
-			    if (!meltdown_1pkt
-				|| (rp->header.flags & RX_LAST_PACKET)) {
-				call = tcall;
-			    } else if (rxi_2dchoice && !choice2
-				       && !(tcall->flags & RX_CALL_CLEARED)
-				       && (tcall->rprev > rxi_HardAckRate)) {
-				choice2 = tcall;
-			    } else
-				rxi_md2cnt++;
-			}
-		    }
-		}
-		if (call) {
-		    break;
-		} else {
-		    ReturnToServerPool(service);
-		}
-	    }
+	call = rxi_ChooseIncomingCall(fcfs);
+	if (call) {
+	    service = call->conn->service;
+	    if (!QuotaOK(service))
+		call = NULL;
 	}
 
 	if (call) {
 	    opr_queue_Remove(&call->entry);
+	    rxi_CountDispatch(service, call);
 	    MUTEX_EXIT(&rx_serverPool_lock);
 	    MUTEX_ENTER(&call->lock);
 	    CLEAR_CALL_QUEUE_LOCK(call);
@@ -2189,7 +2261,7 @@ struct rx_call *
 rx_GetCall(int tno, struct rx_service *cur_service, osi_socket * socketp)
 {
     struct rx_serverQueueEntry *sq;
-    struct rx_call *call = (struct rx_call *)0, *choice2;
+    struct rx_call *call = (struct rx_call *)0;
     struct rx_service *service = NULL;
     SPLVAR;
 
@@ -2217,58 +2289,17 @@ rx_GetCall(int tno, struct rx_service *cur_service, osi_socket * socketp)
 	rxi_availProcs++;
         MUTEX_EXIT(&rx_quota_mutex);
     }
-    if (!opr_queue_IsEmpty(&rx_incomingCallQueue)) {
-	struct rx_call *tcall;
-	struct opr_queue *cursor;
-	/* Scan for eligible incoming calls.  A call is not eligible
-	 * if the maximum number of calls for its service type are
-	 * already executing */
-	/* One thread will process calls FCFS (to prevent starvation),
-	 * while the other threads may run ahead looking for calls which
-	 * have all their input data available immediately.  This helps
-	 * keep threads from blocking, waiting for data from the client. */
-	choice2 = (struct rx_call *)0;
-	for (opr_queue_Scan(&rx_incomingCallQueue, cursor)) {
-	    tcall = opr_queue_Entry(cursor, struct rx_call, entry);
-	    service = tcall->conn->service;
-	    if (QuotaOK(service)) {
-		MUTEX_ENTER(&rx_pthread_mutex);
-		if (tno == rxi_fcfs_thread_num
-			|| opr_queue_IsLast(&rx_incomingCallQueue, cursor)) {
-		    MUTEX_EXIT(&rx_pthread_mutex);
-		    /* If we're the fcfs thread, then  we'll just use
-		     * this call. If we haven't been able to find an optimal
-		     * choice, and we're at the end of the list, then use a
-		     * 2d choice if one has been identified.  Otherwise... */
-		    call = (choice2 ? choice2 : tcall);
-		    service = call->conn->service;
-		} else {
-		    MUTEX_EXIT(&rx_pthread_mutex);
-		    if (!opr_queue_IsEmpty(&tcall->rq)) {
-			struct rx_packet *rp;
-			rp = opr_queue_First(&tcall->rq, struct rx_packet,
-					    entry);
-			if (rp->header.seq == 1
-			    && (!meltdown_1pkt
-				|| (rp->header.flags & RX_LAST_PACKET))) {
-			    call = tcall;
-			} else if (rxi_2dchoice && !choice2
-				   && !(tcall->flags & RX_CALL_CLEARED)
-				   && (tcall->rprev > rxi_HardAckRate)) {
-			    choice2 = tcall;
-			} else
-			    rxi_md2cnt++;
-		    }
-		}
-	    }
-	    if (call)
-		break;
-	}
+    call = rxi_ChooseIncomingCall(tno == rxi_fcfs_thread_num);
+    if (call) {
+	service = call->conn->service;
+	if (!QuotaOK(service))
+	    call = NULL;
     }
 
     if (call) {
 	opr_queue_Remove(&call->entry);
 	CLEAR_CALL_QUEUE_LOCK(call);
+	rxi_CountDispatch(service, call);
 	/* we can't schedule a call if there's no data!!! */
 	/* send an ack if there's no data, if we're missing the
 	 * first packet, or we're missing something between first
@@ -2870,6 +2901,162 @@ rxi_Free(void *addr, size_t size)
     osi_Free(addr, size);
 }
 
+/*
+ * Path MTU discovery.
+ *
+ * Each peer searches for the largest packet that gets through to it, in the
+ * manner of packetization layer path MTU discovery (RFC 4821).
+ * rxi_GrowMTUEvent sends MTU pings padded out to a probe size, picked by a
+ * binary search between the largest size known to get through
+ * (maxPacketSize) and the smallest size thought too big (pmtuHigh).  The
+ * search never goes past what the peer says it can receive (maxMTU), nor
+ * past the MTU of our largest network interface (rxi_maxIfMTU), since a
+ * bigger probe would be fragmented before it even left us.  Where
+ * AFS_ADAPT_PMTU is in effect, the socket is left in IP_PMTUDISC_WANT mode,
+ * so probes that fit the route go out with DF set, and one too big for the
+ * path is dropped instead of being fragmented and answered anyway.
+ * Elsewhere probes may be fragmented on the way, and an answer is trusted
+ * as it always has been.  An answered probe raises maxPacketSize, and with
+ * it the peer's
+ * ifMTU and the number of packets we put in a jumbogram to it.  A size which
+ * goes unanswered RX_PMTU_MAX_LOST times in a row lowers pmtuHigh.  Only
+ * one probe to a peer is outstanding at a time, whichever connection it
+ * went out on.  While searching, a probe goes out once a retransmit
+ * timeout; once the bounds are within RX_PMTU_RESOLUTION bytes the search
+ * has converged, and is only started again, in case the path has grown,
+ * RX_PMTU_RAISE_INTERVAL seconds later.
+ */
+
+#define RX_PMTU_RESOLUTION 32
+#define RX_PMTU_MAX_LOST 2
+#define RX_PMTU_RAISE_INTERVAL 600
+
+/* The largest probe worth sending to a peer, without headers */
+static afs_int32
+rxi_PmtuCeiling(struct rx_peer *peer)
+{
+    afs_int32 mtu = MIN((afs_int32)rx_MyMaxSendSize, RX_MAX_PACKET_SIZE);
+
+    if (rxi_maxIfMTU > 0 && !rx_IsLoopbackAddr(ntohl(peer->host)))
+	mtu = MIN(mtu, rxi_maxIfMTU);
+    return MIN(mtu, peer->maxMTU) - RX_HEADER_SIZE;
+}
+
+static int
+rxi_PmtuSearching(struct rx_peer *peer)
+{
+    return peer->pmtuHigh > peer->maxPacketSize + RX_PMTU_RESOLUTION;
+}
+
+/* Note when the search has converged.  Called with the peer lock held. */
+static void
+rxi_PmtuCheckDone(struct rx_peer *peer)
+{
+    struct clock now;
+
+    if (peer->pmtuDone || peer->pmtuHigh == 0 || rxi_PmtuSearching(peer))
+	return;
+    clock_GetTime(&now);
+    peer->pmtuConvergeTime = clock_ElapsedTime(&peer->pmtuStart, &now);
+    peer->pmtuDone = 1;
+}
+
+/* The outstanding probe went unanswered.  Called with the peer lock held. */
+static void
+rxi_PmtuProbeLost(struct rx_peer *peer)
+{
+    afs_int32 size = peer->pmtuProbeSize;
+
+    clock_Zero(&peer->pmtuProbeTime);
+    peer->pmtuProbeSerial = 0;
+    peer->pmtuProbesLost++;
+    if (!rxi_PmtuSearching(peer) || size <= peer->maxPacketSize)
+	return;
+    if (++peer->pmtuLost >= RX_PMTU_MAX_LOST) {
+	peer->pmtuHigh = MIN(peer->pmtuHigh, size);
+	peer->pmtuLost = 0;
+	rxi_PmtuCheckDone(peer);
+    }
+}
+
+/*
+ * A ping of pktsize bytes with the given serial was answered on conn.  If
+ * it was the outstanding probe, or at least as big, the probe got through.
+ * Called with the peer lock held.
+ */
+static void
+rxi_PmtuProbeAnswered(struct rx_peer *peer, struct rx_connection *conn,
+		      afs_int32 serial, afs_int32 pktsize)
+{
+    if (clock_IsZero(&peer->pmtuProbeTime))
+	return;
+    if ((peer->pmtuProbeSerial != 0 && peer->pmtuProbeSerial == serial
+	 && peer->pmtuProbeCid == conn->cid)
+	|| pktsize >= peer->pmtuProbeSize) {
+	clock_Zero(&peer->pmtuProbeTime);
+	peer->pmtuProbeSerial = 0;
+	peer->pmtuLost = 0;
+    }
+}
+
+/*
+ * Pick the size of the next probe to send to a peer, without headers, or
+ * return 0 if there is nothing to probe for.  Called with the peer lock
+ * held.
+ */
+static afs_int32
+rxi_PmtuNextProbe(struct rx_peer *peer, struct clock *now)
+{
+    afs_int32 ceiling = rxi_PmtuCeiling(peer);
+
+    if (peer->pmtuCeiling > ceiling) {
+	/* the peer can't take as much as we were looking for */
+	peer->pmtuCeiling = ceiling;
+	peer->pmtuHigh = MIN(peer->pmtuHigh, ceiling + 1);
+	rxi_PmtuCheckDone(peer);
+    }
+    if (!rxi_PmtuSearching(peer)) {
+	/* start again if the peer will now take more, or in a while */
+	if (peer->pmtuHigh != 0
+	    && (peer->maxPacketSize + RX_PMTU_RESOLUTION >= ceiling
+		|| (ceiling <= peer->pmtuCeiling
+		    && now->sec - peer->pmtuStart.sec
+		       - peer->pmtuConvergeTime / 1000
+		       < RX_PMTU_RAISE_INTERVAL)))
+	    return 0;
+	peer->pmtuCeiling = ceiling;
+	peer->pmtuHigh = ceiling + 1;
+	peer->pmtuLost = 0;
+	peer->pmtuDone = 0;
+	peer->pmtuStart = *now;
+	if (!rxi_PmtuSearching(peer)) {
+	    rxi_PmtuCheckDone(peer);
+	    return 0;
+	}
+    }
+    peer->pmtuProbeSize = peer->maxPacketSize
+	+ (peer->pmtuHigh - peer->maxPacketSize) / 2;
+    peer->pmtuProbeTime = *now;
+    peer->pmtuProbeSerial = 0;
+    peer->pmtuProbes++;
+    return peer->pmtuProbeSize;
+}
+
+/* Size the packets and jumbograms we send to a peer to fit its ifMTU.
+ * Called with the peer lock held. */
+static void
+rxi_PeerMtuChanged(struct rx_peer *peer)
+{
+    peer->natMTU = rxi_AdjustIfMTU(peer->ifMTU);
+    peer->ifDgramPackets =
+	MIN(rxi_nDgramPackets,
+	    rxi_AdjustDgramPackets(rxi_nSendFrags, peer->ifMTU));
+    if (peer->maxDgramPackets > peer->ifDgramPackets)
+	peer->maxDgramPackets = peer->ifDgramPackets;
+    if (peer->nDgramPackets > peer->maxDgramPackets)
+	peer->nDgramPackets = peer->maxDgramPackets;
+}
+
 void
 rxi_SetPeerMtu(struct rx_peer *peer, afs_uint32 host, afs_uint32 port, int mtu)
 {
@@ -2912,7 +3099,7 @@ rxi_SetPeerMtu(struct rx_peer *peer, afs_uint32 host, afs_uint32 port, int mtu)
 	/* We don't handle dropping below min, so don't */
 	mtu = MAX(mtu, RX_MIN_PACKET_SIZE);
         peer->ifMTU=MIN(mtu, peer->ifMTU);
-        peer->natMTU = rxi_AdjustIfMTU(peer->ifMTU);
+	rxi_PeerMtuChanged(peer);
 	/* if we tweaked this down, need to tune our peer MTU too */
 	peer->MTU = MIN(peer->MTU, peer->natMTU);
 	/* if we discovered a sub-1500 mtu, degrade */
@@ -2921,6 +3108,9 @@ rxi_SetPeerMtu(struct rx_peer *peer, afs_uint32 host, afs_uint32 port, int mtu)
 	/* We no longer have valid peer packet information */
 	if (peer->maxPacketSize + RX_HEADER_SIZE > peer->ifMTU)
 	    peer->maxPacketSize = 0;
+	/* and there is no point probing for anything the path won't take */
+	if (peer->pmtuHigh > mtu - RX_HEADER_SIZE)
+	    peer->pmtuHigh = mtu - RX_HEADER_SIZE + 1;
         MUTEX_EXIT(&peer->peer_lock);
 
         MUTEX_ENTER(&rx_peerHashTable_lock);
@@ -4342,6 +4532,140 @@ ack_is_valid(struct rx_call *call, afs_uint32 first, afs_uint32 prev)
     return 1;
 }
 
+/*
+ * Congestion control.
+ *
+ * Slow start, fast recovery and the retransmit timeout are common to every
+ * algorithm; an algorithm decides how the congestion window grows once it
+ * has reached ssthresh, and what ssthresh becomes when a packet is lost.
+ * Each call picks up rx_congestionControl when it is reset.
+ */
+struct rx_ccops {
+    /* grow cwind for nAcked newly acked packets; cwind >= ssthresh */
+    void (*cc_avoid)(struct rx_call *call, int nAcked, struct clock *now);
+    /* a packet was lost; forget the epoch and return the new ssthresh */
+    int (*cc_loss)(struct rx_call *call);
+};
+
+/* Classic: one more packet for each window's worth of acks; halve on loss */
+static void
+rxi_ClassicAvoid(struct rx_call *call, int nAcked, struct clock *now)
+{
+    call->nCwindAcks += nAcked;
+    if (call->nCwindAcks >= call->cwind) {
+	call->nCwindAcks = 0;
+	call->cwind = MIN((int)(call->cwind + 1), rx_maxSendWindow);
+    }
+}
+
+static int
+rxi_ClassicLoss(struct rx_call *call)
+{
+    return MAX(4, MIN((int)call->cwind, (int)call->twind)) >> 1;
+}
+
+/*
+ * CUBIC: after a loss at window Wmax, the window follows
+ *	W(t) = C * (t - K)^3 + Wmax
+ * so it climbs back to Wmax quickly, lingers near it, and then probes beyond
+ * it.  t is taken in msecs and treated as 1/1024ths of a second, so that
+ * everything can be done with shifts and multiplies; there is no 64-bit
+ * division in some kernels.  C is 0.4, in units of 2^-10, and the window
+ * drops to 0.7 (BETA/1024) of its size on a loss.
+ */
+#define RX_CUBIC_C	410
+#define RX_CUBIC_BETA	717
+#define RX_CUBIC_KSCALE	2681735677U	/* 2^40 / RX_CUBIC_C */
+#define RX_CUBIC_TMAX	65535		/* don't let (t - K)^3 overflow */
+
+/* Largest x with x^3 <= a, for a < 2^42 */
+static afs_uint32
+rxi_CubeRoot(afs_uint64 a)
+{
+    afs_uint32 x = 0, bit;
+
+    for (bit = 1 << 14; bit != 0; bit >>= 1) {
+	afs_uint64 y = x | bit;
+	if (y * y * y <= a)
+	    x |= bit;
+    }
+    return x;
+}
+
+static void
+rxi_CubicAvoid(struct rx_call *call, int nAcked, struct clock *now)
+{
+    afs_int32 t;
+    afs_uint32 d;
+    afs_uint64 offset;
+    int target, cnt;
+
+    if (clock_IsZero(&call->ccEpoch)) {
+	call->ccEpoch = *now;
+	call->nCwindAcks = 0;
+	if (call->ccWmax > call->cwind) {
+	    call->ccOrigin = call->ccWmax;
+	    call->ccK = rxi_CubeRoot((afs_uint64)(call->ccWmax - call->cwind)
+				     * RX_CUBIC_KSCALE);
+	} else {
+	    call->ccOrigin = call->cwind;
+	    call->ccK = 0;
+	}
+    }
+
+    /* Aim for where the curve will be one round trip from now */
+    t = (now->sec - call->ccEpoch.sec) * 1000
+	+ (now->usec - call->ccEpoch.usec) / 1000 + (call->rtt >> 3);
+    if (t < 0)
+	t = 0;
+    if (t > (afs_int32)call->ccK) {
+	d = MIN(t - call->ccK, RX_CUBIC_TMAX);
+	offset = ((afs_uint64)d * d * d * RX_CUBIC_C) >> 40;
+	target = (int)MIN(call->ccOrigin + offset, (afs_uint64)rx_maxSendWindow);
+    } else {
+	d = MIN(call->ccK - t, RX_CUBIC_TMAX);
+	offset = ((afs_uint64)d * d * d * RX_CUBIC_C) >> 40;
+	target = offset >= call->ccOrigin ? 1 : (int)(call->ccOrigin - offset);
+    }
+
+    /* Spread the climb to the target over the next window's worth of acks,
+     * but never grow more slowly than the classic algorithm would. */
+    if (target > call->cwind)
+	cnt = call->cwind / (target - call->cwind);
+    else
+	cnt = call->cwind;
+    if (cnt > call->cwind)
+	cnt = call->cwind;
+    if (cnt < 1)
+	cnt = 1;
+
+    call->nCwindAcks += nAcked;
+    if (call->nCwindAcks >= cnt) {
+	call->nCwindAcks = 0;
+	call->cwind = MIN((int)(call->cwind + 1), rx_maxSendWindow);
+    }
+}
+
+static int
+rxi_CubicLoss(struct rx_call *call)
+{
+    int wind = MIN((int)call->cwind, (int)call->twind);
+
+    /* If we lost before getting back to the last Wmax, another flow is
+     * probably taking bandwidth; settle lower to give it room. */
+    if (wind < call->ccWmax)
+	call->ccWmax = (wind * (1024 + RX_CUBIC_BETA)) >> 11;
+    else
+	call->ccWmax = wind;
+    clock_Zero(&call->ccEpoch);
+    return MAX(2, (wind * RX_CUBIC_BETA) >> 10);
+}
+
+static struct rx_ccops rxi_ccops[] = {
+    { rxi_ClassicAvoid, rxi_ClassicLoss },	/* RX_CC_CLASSIC */
+    { rxi_CubicAvoid, rxi_CubicLoss },		/* RX_CC_CUBIC */
+};
+
 /* The real smarts of the whole thing.  */
 static struct rx_packet *
 rxi_ReceiveAckPacket(struct rx_call *call, struct rx_packet *np,
@@ -4364,6 +4688,7 @@ rxi_ReceiveAckPacket(struct rx_call *call, struct rx_packet *np,
     int newAckCount = 0;
     int maxDgramPackets = 0;	/* Set if peer supports AFS 3.5 jumbo datagrams */
     int pktsize = 0;            /* Set if we need to update the peer mtu */
+    afs_int32 pingserial = 0;	/* Set if pktsize came from a ping */
     int conn_data_locked = 0;
 
     *a_invalid = 1;
@@ -4412,6 +4737,7 @@ rxi_ReceiveAckPacket(struct rx_call *call, struct rx_packet *np,
 	if ((conn->lastPingSizeSer == serial) && (conn->lastPingSize)) {
 	    /* process mtu ping ack */
 	    pktsize = conn->lastPingSize;
+	    pingserial = serial;
 	    conn->lastPingSizeSer = conn->lastPingSize = 0;
 	}
     }
@@ -4470,11 +4796,13 @@ rxi_ReceiveAckPacket(struct rx_call *call, struct rx_packet *np,
 	if (!peer->maxPacketSize)
 	    peer->maxPacketSize = RX_MIN_PACKET_SIZE - RX_HEADER_SIZE;
 
+	rxi_PmtuProbeAnswered(peer, conn, pingserial, pktsize);
 	if (pktsize > peer->maxPacketSize) {
 	    peer->maxPacketSize = pktsize;
+	    rxi_PmtuCheckDone(peer);
 	    if ((pktsize + RX_HEADER_SIZE > peer->ifMTU)) {
 		peer->ifMTU = pktsize + RX_HEADER_SIZE;
-		peer->natMTU = rxi_AdjustIfMTU(peer->ifMTU);
+		rxi_PeerMtuChanged(peer);
 		rxi_ScheduleGrowMTUEvent(call, 1);
 	    }
 	}
@@ -4769,7 +5097,7 @@ rxi_ReceiveAckPacket(struct rx_call *call, struct rx_packet *np,
     } else if (nNacked && call->nNacks >= (u_short) rx_nackThreshold) {
 	/* Three negative acks in a row trigger congestion recovery */
 	call->flags |= RX_CALL_FAST_RECOVER;
-	call->ssthresh = MAX(4, MIN((int)call->cwind, (int)call->twind)) >> 1;
+	call->ssthresh = call->cc->cc_loss(call);
 	call->cwind =
 	    MIN((int)(call->ssthresh + rx_nackThreshold), rx_maxSendWindow);
 	call->nDgramPackets = MAX(2, (int)call->nDgramPackets) >> 1;
@@ -4809,12 +5137,8 @@ rxi_ReceiveAckPacket(struct rx_call *call, struct rx_packet *np,
 	    call->cwind =
 		MIN((int)call->ssthresh, (int)(call->cwind + newAckCount));
 	    call->nCwindAcks = 0;
-	} else {
-	    call->nCwindAcks += newAckCount;
-	    if (call->nCwindAcks >= call->cwind) {
-		call->nCwindAcks = 0;
-		call->cwind = MIN((int)(call->cwind + 1), rx_maxSendWindow);
-	    }
+	} else if (newAckCount > 0) {
+	    call->cc->cc_avoid(call, newAckCount, &now);
 	}
 	/*
 	 * If we have received several acknowledgements in a row then
@@ -5019,7 +5343,7 @@ rxi_AttachServerProc(struct rx_call *call,
 	    rx_atomic_inc(&rx_nWaited);
 	    rxi_calltrace(RX_CALL_ARRIVAL, call);
 	    SET_CALL_QUEUE_LOCK(call, &rx_serverPool_lock);
-	    opr_queue_Append(&rx_incomingCallQueue, &call->entry);
+	    opr_queue_Append(&service->incomingCallQueue, &call->entry);
 	}
     } else {
 	sq = opr_queue_Last(&rx_idleServerQueue,
@@ -5049,6 +5373,7 @@ rxi_AttachServerProc(struct rx_call *call,
 	    }
 	    CLEAR_CALL_QUEUE_LOCK(call);
 	}
+	rxi_CountDispatch(service, call);
 	call->state = RX_STATE_ACTIVE;
 	call->app.mode = RX_MODE_RECEIVING;
 #ifdef RX_KERNEL_TRACE
@@ -5476,6 +5801,9 @@ rxi_ResetCall(struct rx_call *call, int newcall)
     }
     call->cwind = MIN((int)peer->cwind, (int)peer->nDgramPackets);
     call->ssthresh = rx_maxSendWindow;
+    call->cc = &rxi_ccops[rx_congestionControl];
+    call->ccWmax = 0;
+    clock_Zero(&call->ccEpoch);
     call->nDgramPackets = peer->nDgramPackets;
     call->congestSeq = peer->congestSeq;
     call->rtt = peer->rtt;
@@ -5616,16 +5944,8 @@ rxi_SendAck(struct rx_call *call,
 
     /* Don't attempt to grow MTU if this is a critical ping */
     if (reason == RX_ACK_MTU) {
-	/* keep track of per-call attempts, if we're over max, do in small
-	 * otherwise in larger? set a size to increment by, decrease
-	 * on failure, here?
-	 */
-	if (call->conn->peer->maxPacketSize &&
-	    (call->conn->peer->maxPacketSize < OLD_MAX_PACKET_SIZE
-	     - RX_HEADER_SIZE))
-	    padbytes = call->conn->peer->maxPacketSize+16;
-	else
-	    padbytes = call->conn->peer->maxMTU + 128;
+	/* pad out to the size rxi_GrowMTUEvent picked to probe */
+	padbytes = call->conn->peer->pmtuProbeSize;
 
 	/* do always try a minimum size ping */
 	padbytes = MAX(padbytes, RX_MIN_PACKET_SIZE+RX_IPUDP_SIZE+4);
@@ -5787,6 +6107,11 @@ rxi_SendAck(struct rx_call *call,
     if (reason == RX_ACK_PING)
 	p->header.flags |= RX_REQUEST_ACK;
 
+    /* An MTU ping was padded for a full window of acks; make up for any
+     * we didn't need, so it comes out at exactly the size asked for */
+    if (padbytes > 0 && offset < call->rwind)
+	padbytes += rx_AckDataSize(call->rwind) - rx_AckDataSize(offset);
+
     while (padbytes > 0) {
 	if (padbytes > RX_ZEROS) {
 	    rx_packetwrite(p, p->length, RX_ZEROS, rx_zeros);
@@ -6176,7 +6501,7 @@ rxi_Resend(struct rxevent *event, void *arg0, void *arg1, int istack)
 	call->MTU = RX_JUMBOBUFFERSIZE + RX_HEADER_SIZE;
         call->MTU = MIN(peer->natMTU, peer->maxMTU);
     }
-    call->ssthresh = MAX(4, MIN((int)call->cwind, (int)call->twind)) >> 1;
+    call->ssthresh = call->cc->cc_loss(call);
     call->nDgramPackets = 1;
     call->cwind = 1;
     call->nextCwind = 1;
@@ -6702,6 +7027,9 @@ rxi_GrowMTUEvent(struct rxevent *event, void *arg1, void *dummy, int dummy2)
 {
     struct rx_call *call = arg1;
     struct rx_connection *conn;
+    struct rx_peer *peer;
+    struct clock now, due;
+    afs_int32 probe = 0;
 
     MUTEX_ENTER(&call->lock);
 
@@ -6716,15 +7044,44 @@ rxi_GrowMTUEvent(struct rxevent *event, void *arg1, void *dummy, int dummy2)
 	goto out;
 
     conn = call->conn;
+    peer = conn->peer;
 
     /*
-     * keep being scheduled, just don't do anything if we're at peak,
-     * or we're not set up to be properly handled (idle timeout required)
+     * keep being scheduled, just don't do anything if there's nothing to
+     * probe for, or we're not set up to be properly handled (idle timeout
+     * required)
      */
-    if ((conn->peer->maxPacketSize != 0) &&
-	(conn->peer->natMTU < RX_MAX_PACKET_SIZE) &&
-	conn->idleDeadTime)
-	(void)rxi_SendAck(call, NULL, 0, RX_ACK_MTU, 0);
+    if ((peer->maxPacketSize != 0) && conn->idleDeadTime) {
+	clock_GetTime(&now);
+	MUTEX_ENTER(&peer->peer_lock);
+	if (!clock_IsZero(&peer->pmtuProbeTime)) {
+	    /* give the outstanding probe a retransmit timeout to be answered */
+	    due = peer->pmtuProbeTime;
+	    clock_Add(&due, &call->rto);
+	    if (clock_Le(&due, &now))
+		rxi_PmtuProbeLost(peer);
+	}
+	if (clock_IsZero(&peer->pmtuProbeTime))
+	    probe = rxi_PmtuNextProbe(peer, &now);
+	MUTEX_EXIT(&peer->peer_lock);
+
+	if (probe) {
+	    (void)rxi_SendAck(call, NULL, 0, RX_ACK_MTU, 0);
+
+	    /* note which packet carried the probe, unless it has already
+	     * been answered */
+	    MUTEX_ENTER(&peer->peer_lock);
+	    MUTEX_ENTER(&conn->conn_data_lock);
+	    if (!clock_IsZero(&peer->pmtuProbeTime)
+		&& peer->pmtuProbeSize == probe
+		&& conn->lastPingSize == probe) {
+		peer->pmtuProbeCid = conn->cid;
+		peer->pmtuProbeSerial = conn->lastPingSizeSer;
+	    }
+	    MUTEX_EXIT(&conn->conn_data_lock);
+	    MUTEX_EXIT(&peer->peer_lock);
+	}
+    }
     rxi_ScheduleGrowMTUEvent(call, 0);
 out:
     MUTEX_EXIT(&call->lock);
@@ -6762,7 +7119,10 @@ rxi_ScheduleGrowMTUEvent(struct rx_call *call, int secs)
 
 	clock_GetTime(&now);
 	when = now;
-	if (!secs) {
+	if (!secs && rxi_PmtuSearching(call->conn->peer)) {
+	    /* probe again as soon as the last probe could be answered */
+	    clock_Add(&when, &call->rto);
+	} else if (!secs) {
 	    if (call->conn->secondsUntilPing)
 		secs = (6*call->conn->secondsUntilPing)-1;
 
@@ -7553,6 +7913,13 @@ rx_PrintTheseStats(FILE * file, struct rx_statistics *s, int size,
 	    s->nServerConns, s->nClientConns, s->nPeerStructs,
 	    s->nCallStructs, s->nFreeCallStructs);
 
+    if (version >= RX_DEBUGI_VERSION_W_PACKETPOOLS) {
+	fprintf(file,
+		"   packet pools: %u refilled to threads, %u spilled to global, "
+		"%u blocks allocated (%u huge)\n", s->fpqRefills, s->fpqSpills,
+		s->packetArenas, s->hugePacketArenas);
+    }
+
 #if	!defined(AFS_PTHREAD_ENV) && !defined(AFS_USE_GETTIMEOFDAY)
     fprintf(file, "   %d clock updates\n", clock_nUpdates);
 #endif
@@ -7758,6 +8125,12 @@ rx_GetServerDebug(osi_socket socket, afs_uint32 remoteAddr,
 	if (stat->version >= RX_DEBUGI_VERSION_W_PACKETS) {
 	    *supportedValues |= RX_SERVER_DEBUG_PACKETS_CNT;
 	}
+	if (stat->version >= RX_DEBUGI_VERSION_W_DISPATCH) {
+	    *supportedValues |= RX_SERVER_DEBUG_DISPATCH;
+	}
+	if (stat->version >= RX_DEBUGI_VERSION_W_PMTU) {
+	    *supportedValues |= RX_SERVER_DEBUG_PMTU;
+	}
 	stat->nFreePackets = ntohl(stat->nFreePackets);
 	stat->packetReclaims = ntohl(stat->packetReclaims);
 	stat->callsExecuted = ntohl(stat->callsExecuted);
@@ -7765,6 +8138,9 @@ rx_GetServerDebug(osi_socket socket, afs_uint32 remoteAddr,
 	stat->idleThreads = ntohl(stat->idleThreads);
         stat->nWaited = ntohl(stat->nWaited);
         stat->nPackets = ntohl(stat->nPackets);
+	stat->nDispatched = ntohl(stat->nDispatched);
+	stat->dispatchWaitMean = ntohl(stat->dispatchWaitMean);
+	stat->dispatchWaitMax = ntohl(stat->dispatchWaitMax);
     }
 #else
     afs_int32 rc = -1;
@@ -7967,6 +8343,11 @@ rx_GetServerPeers(osi_socket socket, afs_uint32 remoteAddr,
 	peer->bytesSent.low = ntohl(peer->bytesSent.low);
 	peer->bytesReceived.high = ntohl(peer->bytesReceived.high);
 	peer->bytesReceived.low = ntohl(peer->bytesReceived.low);
+	peer->maxPacketSize = ntohl(peer->maxPacketSize);
+	peer->pmtuHigh = ntohl(peer->pmtuHigh);
+	peer->pmtuConvergeTime = ntohl(peer->pmtuConvergeTime);
+	peer->pmtuProbes = ntohl(peer->pmtuProbes);
+	peer->pmtuProbesLost = ntohl(peer->pmtuProbesLost);
     }
 #else
     afs_int32 rc = -1;
@@ -8278,15 +8659,54 @@ rx_GetServiceSpecific(struct rx_service *svc, int key)
 #endif /* !KERNEL */
 
 /*
- * processStats is a queue used to store the statistics for the local
- * process.  Its contents are similar to the contents of the rpcStats
- * queue on a rx_peer structure, but the actual data stored within
- * this queue contains totals across the lifetime of the process (assuming
- * the stats have not been reset) - unlike the per peer structures
- * which can come and go based upon the peer lifetime.
+ * processStats is used to store the statistics for the local process.
+ * Its contents are similar to the contents of the rpcStats queue on a
+ * rx_peer structure, but the actual data stored within contains totals
+ * across the lifetime of the process (assuming the stats have not been
+ * reset) - unlike the per peer structures which can come and go based
+ * upon the peer lifetime.
+ *
+ * So that a busy server doesn't serialize every completed call on one
+ * lock, the process stats are split into RX_STATS_SHARDS shards, each
+ * with its own lock and its own copy of each interface in use.  A call
+ * updates the shard that its rx_call hashes to, and readers merge the
+ * shards back together.  Readers take rx_rpc_stats and then every shard
+ * lock, in order.
  */
 
-static struct opr_queue processStats = { &processStats, &processStats };
+#ifdef RX_ENABLE_LOCKS
+# define RX_STATS_SHARDS 8
+#else
+# define RX_STATS_SHARDS 1
+#endif
+
+struct rxi_statShard {
+    struct opr_queue stats;
+    unsigned int nfuncs;	/* function stats allocated in this shard */
+#ifdef RX_ENABLE_LOCKS
+    afs_kmutex_t lock;
+#endif
+};
+
+#define RXI_STATSHARD_INIT(n) \
+    { { &processStats[n].stats, &processStats[n].stats }, 0 }
+
+static struct rxi_statShard processStats[RX_STATS_SHARDS] = {
+    RXI_STATSHARD_INIT(0),
+#ifdef RX_ENABLE_LOCKS
+    RXI_STATSHARD_INIT(1), RXI_STATSHARD_INIT(2), RXI_STATSHARD_INIT(3),
+    RXI_STATSHARD_INIT(4), RXI_STATSHARD_INIT(5), RXI_STATSHARD_INIT(6),
+    RXI_STATSHARD_INIT(7),
+#endif
+};
+
+/*
+ * The execution time histogram for function func of a process stat.  It
+ * lives after the last function's stats in the same allocation.
+ */
+#define rxi_RpcStatHist(rpc_stat, func) \
+    ((afs_uint64 *)&(rpc_stat)->stats[(rpc_stat)->stats[0].func_total] \
+     + (func) * RX_STATS_HIST_BUCKETS)
 
 /*
  * peerStats is a queue used to store the statistics for all peer structs.
@@ -8308,6 +8728,76 @@ static int rxi_monitor_processStats = 0;
 
 static int rxi_monitor_peerStats = 0;
 
+#ifdef RX_ENABLE_LOCKS
+static void
+rxi_InitProcessStatsLocks(void)
+{
+    int i;
+
+    for (i = 0; i < RX_STATS_SHARDS; i++)
+	MUTEX_INIT(&processStats[i].lock, "rx_rpc_stats shard", MUTEX_DEFAULT,
+		   0);
+}
+#endif
+
+static struct rxi_statShard *
+rxi_ProcessStatShard(void *key)
+{
+    return &processStats[((size_t)key >> 8) % RX_STATS_SHARDS];
+}
+
+static void
+rxi_LockProcessStats(void)
+{
+    int i;
+
+    for (i = 0; i < RX_STATS_SHARDS; i++)
+	MUTEX_ENTER(&processStats[i].lock);
+}
+
+static void
+rxi_UnlockProcessStats(void)
+{
+    int i;
+
+    for (i = RX_STATS_SHARDS - 1; i >= 0; i--)
+	MUTEX_EXIT(&processStats[i].lock);
+}
+
+static size_t
+rxi_RpcStatSpace(afs_uint32 totalFunc, int withHist)
+{
+    size_t space;
+
+    space = sizeof(rx_interface_stat_t)
+	+ totalFunc * sizeof(rx_function_entry_v1_t);
+    if (withHist)
+	space += totalFunc * RX_STATS_HIST_BUCKETS * sizeof(afs_uint64);
+    return space;
+}
+
+/*
+ * Pick the histogram bucket for an execution time; see the description
+ * of RX_STATS_HIST_BUCKETS in rx.h.
+ */
+static int
+rxi_RpcStatHistBucket(struct clock *execTime)
+{
+    afs_uint32 usec;
+    int bucket = 0;
+
+    if (execTime->sec < 0)
+	return 0;
+    /* 2^31 microseconds is a little under 2148 seconds */
+    if (execTime->sec >= 2147)
+	return RX_STATS_HIST_BUCKETS - 1;
+    usec = execTime->sec * 1000000 + execTime->usec;
+    while (usec != 0 && bucket < RX_STATS_HIST_BUCKETS - 1) {
+	usec >>= 1;
+	bucket++;
+    }
+    return bucket;
+}
 
 void
 rxi_ClearRPCOpStat(rx_function_entry_v1_p rpc_stat)
@@ -8333,6 +8823,30 @@ rxi_ClearRPCOpStat(rx_function_entry_v1_p rpc_stat)
     rpc_stat->execution_time_max.usec = 0;
 }
 
+/*
+ * Add the totals for one function into another's, for merging the
+ * process stat shards.
+ */
+static void
+rxi_AddRPCOpStat(rx_function_entry_v1_p to, rx_function_entry_v1_p from)
+{
+    to->invocations += from->invocations;
+    to->bytes_sent += from->bytes_sent;
+    to->bytes_rcvd += from->bytes_rcvd;
+    clock_Add(&to->queue_time_sum, &from->queue_time_sum);
+    clock_Add(&to->queue_time_sum_sqr, &from->queue_time_sum_sqr);
+    if (clock_Lt(&from->queue_time_min, &to->queue_time_min))
+	to->queue_time_min = from->queue_time_min;
+    if (clock_Gt(&from->queue_time_max, &to->queue_time_max))
+	to->queue_time_max = from->queue_time_max;
+    clock_Add(&to->execution_time_sum, &from->execution_time_sum);
+    clock_Add(&to->execution_time_sum_sqr, &from->execution_time_sum_sqr);
+    if (clock_Lt(&from->execution_time_min, &to->execution_time_min))
+	to->execution_time_min = from->execution_time_min;
+    if (clock_Gt(&from->execution_time_max, &to->execution_time_max))
+	to->execution_time_max = from->execution_time_max;
+}
+
 /*!
  * Given all of the information for a particular rpc
  * call, find or create (if requested) the stat structure for the rpc.
@@ -8359,7 +8873,9 @@ rxi_ClearRPCOpStat(rx_function_entry_v1_p rpc_stat)
  *      and addToPeerList are true
  *
  * @param addToPeerList
- * 	if != 0, add newly created stat to the global peer list
+ * 	if != 0, add newly created stat to the global peer list.  Stats
+ * 	that are not on the peer list are process stats, and are allocated
+ * 	with room for execution time histograms
  *
  * @param counter
  * 	if a new stats structure is allocated, the counter will
@@ -8415,9 +8931,7 @@ rxi_FindRpcStat(struct opr_queue *stats, afs_uint32 rxInterface,
 	int i;
 	size_t space;
 
-	space =
-	    sizeof(rx_interface_stat_t) +
-	    totalFunc * sizeof(rx_function_entry_v1_t);
+	space = rxi_RpcStatSpace(totalFunc, !addToPeerList);
 
 	rpc_stat = rxi_Alloc(space);
 	if (rpc_stat == NULL)
@@ -8433,6 +8947,9 @@ rxi_FindRpcStat(struct opr_queue *stats, afs_uint32 rxInterface,
 	    rpc_stat->stats[i].func_total = totalFunc;
 	    rpc_stat->stats[i].func_index = i;
 	}
+	if (!addToPeerList)
+	    memset(rxi_RpcStatHist(rpc_stat, 0), 0,
+		   totalFunc * RX_STATS_HIST_BUCKETS * sizeof(afs_uint64));
 	opr_queue_Prepend(stats, &rpc_stat->entry);
 	if (addToPeerList) {
 	    opr_queue_Prepend(&peerStats, &rpc_stat->entryPeers);
@@ -8441,22 +8958,106 @@ rxi_FindRpcStat(struct opr_queue *stats, afs_uint32 rxInterface,
     return rpc_stat;
 }
 
+/*
+ * Returns true if rpc_stat, from the given process stat shard, is the
+ * first copy of its interface; that is, the one that merging starts from.
+ * The caller must hold every shard lock.
+ */
+static int
+rxi_FirstProcessStat(int shard, rx_interface_stat_p rpc_stat)
+{
+    int i;
+
+    for (i = 0; i < shard; i++) {
+	if (rxi_FindRpcStat(&processStats[i].stats,
+			    rpc_stat->stats[0].interfaceId, 0,
+			    rpc_stat->stats[0].remote_is_server,
+			    0, 0, 0, NULL, 0) != NULL)
+	    return 0;
+    }
+    return 1;
+}
+
+/*
+ * Merge the stats for one function of a process stat interface across
+ * the shards, starting from its first copy, which is in the given shard.
+ * If hist is not NULL, the merged execution time histogram is returned
+ * there too.  The caller must hold every shard lock.
+ */
+static void
+rxi_MergeProcessStat(int shard, rx_interface_stat_p rpc_stat,
+		     afs_uint32 func, rx_function_entry_v1_p stat,
+		     afs_uint64 *hist)
+{
+    rx_interface_stat_p other;
+    afs_uint32 totalFunc = rpc_stat->stats[0].func_total;
+    int i, b;
+
+    *stat = rpc_stat->stats[func];
+    if (hist)
+	memcpy(hist, rxi_RpcStatHist(rpc_stat, func),
+	       RX_STATS_HIST_BUCKETS * sizeof(afs_uint64));
+
+    for (i = shard + 1; i < RX_STATS_SHARDS; i++) {
+	other = rxi_FindRpcStat(&processStats[i].stats,
+				rpc_stat->stats[0].interfaceId, 0,
+				rpc_stat->stats[0].remote_is_server,
+				0, 0, 0, NULL, 0);
+	if (other == NULL || other->stats[0].func_total != totalFunc)
+	    continue;
+	rxi_AddRPCOpStat(stat, &other->stats[func]);
+	if (hist) {
+	    for (b = 0; b < RX_STATS_HIST_BUCKETS; b++)
+		hist[b] += rxi_RpcStatHist(other, func)[b];
+	}
+    }
+}
+
+/*
+ * Count the functions in the merged process stats.  The caller must hold
+ * every shard lock.
+ */
+static unsigned int
+rxi_CountProcessStats(void)
+{
+    struct opr_queue *cursor;
+    unsigned int count = 0;
+    int i;
+
+    for (i = 0; i < RX_STATS_SHARDS; i++) {
+	for (opr_queue_Scan(&processStats[i].stats, cursor)) {
+	    struct rx_interface_stat *rpc_stat
+		= opr_queue_Entry(cursor, struct rx_interface_stat, entry);
+
+	    if (rxi_FirstProcessStat(i, rpc_stat))
+		count += rpc_stat->stats[0].func_total;
+	}
+    }
+    return count;
+}
+
 void
 rx_ClearProcessRPCStats(afs_int32 rxInterface)
 {
     rx_interface_stat_p rpc_stat;
-    int totalFunc, i;
+    int totalFunc, i, shard;
 
     if (rxInterface == -1)
         return;
 
     MUTEX_ENTER(&rx_rpc_stats);
-    rpc_stat = rxi_FindRpcStat(&processStats, rxInterface, 0, 0,
-			       0, 0, 0, 0, 0);
-    if (rpc_stat) {
-	totalFunc = rpc_stat->stats[0].func_total;
-	for (i = 0; i < totalFunc; i++)
-	    rxi_ClearRPCOpStat(&(rpc_stat->stats[i]));
+    for (shard = 0; shard < RX_STATS_SHARDS; shard++) {
+	MUTEX_ENTER(&processStats[shard].lock);
+	rpc_stat = rxi_FindRpcStat(&processStats[shard].stats, rxInterface,
+				   0, 0, 0, 0, 0, 0, 0);
+	if (rpc_stat) {
+	    totalFunc = rpc_stat->stats[0].func_total;
+	    for (i = 0; i < totalFunc; i++)
+		rxi_ClearRPCOpStat(&(rpc_stat->stats[i]));
+	    memset(rxi_RpcStatHist(rpc_stat, 0), 0,
+		   totalFunc * RX_STATS_HIST_BUCKETS * sizeof(afs_uint64));
+	}
+	MUTEX_EXIT(&processStats[shard].lock);
     }
     MUTEX_EXIT(&rx_rpc_stats);
     return;
@@ -8496,6 +9097,7 @@ rx_CopyProcessRPCStats(afs_uint64 op)
 	rxi_Alloc(sizeof(rx_function_entry_v1_t));
     int currentFunc = (op & MAX_AFS_UINT32);
     afs_int32 rxInterface = (op >> 32);
+    int shard;
 
     if (!rxi_monitor_processStats)
         return NULL;
@@ -8507,11 +9109,17 @@ rx_CopyProcessRPCStats(afs_uint64 op)
         return NULL;
 
     MUTEX_ENTER(&rx_rpc_stats);
-    rpc_stat = rxi_FindRpcStat(&processStats, rxInterface, 0, 0,
-			       0, 0, 0, 0, 0);
-    if (rpc_stat)
-	memcpy(rpcop_stat, &(rpc_stat->stats[currentFunc]),
-	       sizeof(rx_function_entry_v1_t));
+    rxi_LockProcessStats();
+    for (shard = 0; shard < RX_STATS_SHARDS; shard++) {
+	rpc_stat = rxi_FindRpcStat(&processStats[shard].stats, rxInterface,
+				   0, 0, 0, 0, 0, 0, 0);
+	if (rpc_stat) {
+	    rxi_MergeProcessStat(shard, rpc_stat, currentFunc, rpcop_stat,
+				 NULL);
+	    break;
+	}
+    }
+    rxi_UnlockProcessStats();
     MUTEX_EXIT(&rx_rpc_stats);
     if (!rpc_stat) {
 	rxi_Free(rpcop_stat, sizeof(rx_function_entry_v1_t));
@@ -8564,6 +9172,36 @@ rx_ReleaseRPCStats(void *stats)
 	rxi_Free(stats, sizeof(rx_function_entry_v1_t));
 }
 
+/*
+ * Increment the stats for the currentFunc'th function of rpc_stat.
+ */
+static void
+rxi_UpdateRpcStat(rx_interface_stat_p rpc_stat, afs_uint32 currentFunc,
+		  struct clock *queueTime, struct clock *execTime,
+		  afs_uint64 bytesSent, afs_uint64 bytesRcvd)
+{
+    rpc_stat->stats[currentFunc].invocations++;
+    rpc_stat->stats[currentFunc].bytes_sent += bytesSent;
+    rpc_stat->stats[currentFunc].bytes_rcvd += bytesRcvd;
+    clock_Add(&rpc_stat->stats[currentFunc].queue_time_sum, queueTime);
+    clock_AddSq(&rpc_stat->stats[currentFunc].queue_time_sum_sqr, queueTime);
+    if (clock_Lt(queueTime, &rpc_stat->stats[currentFunc].queue_time_min)) {
+	rpc_stat->stats[currentFunc].queue_time_min = *queueTime;
+    }
+    if (clock_Gt(queueTime, &rpc_stat->stats[currentFunc].queue_time_max)) {
+	rpc_stat->stats[currentFunc].queue_time_max = *queueTime;
+    }
+    clock_Add(&rpc_stat->stats[currentFunc].execution_time_sum, execTime);
+    clock_AddSq(&rpc_stat->stats[currentFunc].execution_time_sum_sqr,
+		execTime);
+    if (clock_Lt(execTime, &rpc_stat->stats[currentFunc].execution_time_min)) {
+	rpc_stat->stats[currentFunc].execution_time_min = *execTime;
+    }
+    if (clock_Gt(execTime, &rpc_stat->stats[currentFunc].execution_time_max)) {
+	rpc_stat->stats[currentFunc].execution_time_max = *execTime;
+    }
+}
+
 /*!
  * Given all of the information for a particular rpc
  * call, create (if needed) and update the stat totals for the rpc.
@@ -8618,74 +9256,72 @@ rxi_AddRpcStat(struct opr_queue *stats, afs_uint32 rxInterface,
 	       afs_uint32 remoteHost, afs_uint32 remotePort,
 	       int addToPeerList, unsigned int *counter)
 {
-    int rc = 0;
     rx_interface_stat_p rpc_stat;
 
     rpc_stat = rxi_FindRpcStat(stats, rxInterface, totalFunc, isServer,
 			       remoteHost, remotePort, addToPeerList, counter,
 			       1);
-    if (!rpc_stat) {
-	rc = -1;
-	goto fail;
-    }
-
-    /*
-     * Increment the stats for this function
-     */
-
-    rpc_stat->stats[currentFunc].invocations++;
-    rpc_stat->stats[currentFunc].bytes_sent += bytesSent;
-    rpc_stat->stats[currentFunc].bytes_rcvd += bytesRcvd;
-    clock_Add(&rpc_stat->stats[currentFunc].queue_time_sum, queueTime);
-    clock_AddSq(&rpc_stat->stats[currentFunc].queue_time_sum_sqr, queueTime);
-    if (clock_Lt(queueTime, &rpc_stat->stats[currentFunc].queue_time_min)) {
-	rpc_stat->stats[currentFunc].queue_time_min = *queueTime;
-    }
-    if (clock_Gt(queueTime, &rpc_stat->stats[currentFunc].queue_time_max)) {
-	rpc_stat->stats[currentFunc].queue_time_max = *queueTime;
-    }
-    clock_Add(&rpc_stat->stats[currentFunc].execution_time_sum, execTime);
-    clock_AddSq(&rpc_stat->stats[currentFunc].execution_time_sum_sqr,
-		execTime);
-    if (clock_Lt(execTime, &rpc_stat->stats[currentFunc].execution_time_min)) {
-	rpc_stat->stats[currentFunc].execution_time_min = *execTime;
-    }
-    if (clock_Gt(execTime, &rpc_stat->stats[currentFunc].execution_time_max)) {
-	rpc_stat->stats[currentFunc].execution_time_max = *execTime;
-    }
+    if (!rpc_stat)
+	return -1;
 
-  fail:
-    return rc;
+    rxi_UpdateRpcStat(rpc_stat, currentFunc, queueTime, execTime, bytesSent,
+		      bytesRcvd);
+    if (!addToPeerList)
+	rxi_RpcStatHist(rpc_stat, currentFunc)[rxi_RpcStatHistBucket(execTime)]++;
+    return 0;
 }
 
+/*
+ * Record a completed call in the peer and process stats.
+ *
+ * Peer stats are updated under rx_rpc_stats and the peer_lock, since
+ * rx_RetrievePeerRPCStats and rx_clearPeerRPCStats walk every peer's
+ * stats under rx_rpc_stats alone.  Process stats do not need
+ * rx_rpc_stats; they are updated under the lock of the shard that the
+ * call hashes to.  call may be NULL, in which case the peer is hashed
+ * instead.
+ */
 void
-rxi_IncrementTimeAndCount(struct rx_peer *peer, afs_uint32 rxInterface,
+rxi_IncrementTimeAndCount(struct rx_peer *peer, struct rx_call *call,
+			  afs_uint32 rxInterface,
 			  afs_uint32 currentFunc, afs_uint32 totalFunc,
 			  struct clock *queueTime, struct clock *execTime,
 			  afs_uint64 bytesSent, afs_uint64 bytesRcvd,
 			  int isServer)
 {
+    struct rxi_statShard *shard;
 
     if (!(rxi_monitor_peerStats || rxi_monitor_processStats))
         return;
 
-    MUTEX_ENTER(&rx_rpc_stats);
-
     if (rxi_monitor_peerStats) {
-        MUTEX_ENTER(&peer->peer_lock);
-	rxi_AddRpcStat(&peer->rpcStats, rxInterface, currentFunc, totalFunc,
-		       queueTime, execTime, bytesSent, bytesRcvd, isServer,
-		       peer->host, peer->port, 1, &rxi_rpc_peer_stat_cnt);
-        MUTEX_EXIT(&peer->peer_lock);
+	MUTEX_ENTER(&rx_rpc_stats);
+	/* rx_disablePeerRPCStats clears this before freeing the peer stats */
+	if (rxi_monitor_peerStats) {
+	    MUTEX_ENTER(&peer->peer_lock);
+	    rxi_AddRpcStat(&peer->rpcStats, rxInterface, currentFunc,
+			   totalFunc, queueTime, execTime, bytesSent,
+			   bytesRcvd, isServer, peer->host, peer->port, 1,
+			   &rxi_rpc_peer_stat_cnt);
+	    MUTEX_EXIT(&peer->peer_lock);
+	}
+	MUTEX_EXIT(&rx_rpc_stats);
     }
 
     if (rxi_monitor_processStats) {
-	rxi_AddRpcStat(&processStats, rxInterface, currentFunc, totalFunc,
-		       queueTime, execTime, bytesSent, bytesRcvd, isServer,
-		       0xffffffff, 0xffffffff, 0, &rxi_rpc_process_stat_cnt);
+	if (call != NULL)
+	    shard = rxi_ProcessStatShard(call);
+	else
+	    shard = rxi_ProcessStatShard(peer);
+	MUTEX_ENTER(&shard->lock);
+	/* rx_disableProcessRPCStats clears this before emptying the shards */
+	if (rxi_monitor_processStats) {
+	    rxi_AddRpcStat(&shard->stats, rxInterface, currentFunc, totalFunc,
+			   queueTime, execTime, bytesSent, bytesRcvd, isServer,
+			   0xffffffff, 0xffffffff, 0, &shard->nfuncs);
+	}
+	MUTEX_EXIT(&shard->lock);
     }
-
-    MUTEX_EXIT(&rx_rpc_stats);
 }
 
 /*!
@@ -8736,8 +9372,8 @@ rx_IncrementTimeAndCount(struct rx_peer *peer, afs_uint32 rxInterface,
     sent64 = ((afs_uint64)bytesSent->high << 32) + bytesSent->low;
     rcvd64 = ((afs_uint64)bytesRcvd->high << 32) + bytesRcvd->low;
 
-    rxi_IncrementTimeAndCount(peer, rxInterface, currentFunc, totalFunc,
-			      queueTime, execTime, sent64, rcvd64,
+    rxi_IncrementTimeAndCount(peer, NULL, rxInterface, currentFunc,
+			      totalFunc, queueTime, execTime, sent64, rcvd64,
 			      isServer);
 }
 
@@ -8858,6 +9494,8 @@ rx_RetrieveProcessRPCStats(afs_uint32 callerVersion, afs_uint32 * myVersion,
     *clock_sec = now.sec;
     *clock_usec = now.usec;
 
+    rxi_LockProcessStats();
+
     /*
      * Allocate the space based upon the caller version
      *
@@ -8868,8 +9506,8 @@ rx_RetrieveProcessRPCStats(afs_uint32 callerVersion, afs_uint32 * myVersion,
      */
 
     if (callerVersion >= RX_STATS_RETRIEVAL_FIRST_EDITION) {
-	space = rxi_rpc_process_stat_cnt * sizeof(rx_function_entry_v1_t);
-	*statCount = rxi_rpc_process_stat_cnt;
+	*statCount = rxi_CountProcessStats();
+	space = *statCount * sizeof(rx_function_entry_v1_t);
     } else {
 	/*
 	 * This can't happen yet, but in the future version changes
@@ -8883,21 +9521,135 @@ rx_RetrieveProcessRPCStats(afs_uint32 callerVersion, afs_uint32 * myVersion,
 
 	if (ptr != NULL) {
 	    struct opr_queue *cursor;
+	    rx_function_entry_v1_t stat;
+	    afs_uint32 i;
+	    int shard;
+
+	    for (shard = 0; shard < RX_STATS_SHARDS; shard++) {
+		for (opr_queue_Scan(&processStats[shard].stats, cursor)) {
+		    struct rx_interface_stat *rpc_stat =
+			opr_queue_Entry(cursor, struct rx_interface_stat,
+					entry);
+
+		    if (!rxi_FirstProcessStat(shard, rpc_stat))
+			continue;
+		    /*
+		     * Copy the data based upon the caller version
+		     */
+		    for (i = 0; i < rpc_stat->stats[0].func_total; i++) {
+			rxi_MergeProcessStat(shard, rpc_stat, i, &stat, NULL);
+			rx_MarshallProcessRPCStats(callerVersion, 1, &stat,
+						   &ptr);
+		    }
+		}
+	    }
+	} else {
+	    rc = ENOMEM;
+	}
+    }
+    rxi_UnlockProcessStats();
+    MUTEX_EXIT(&rx_rpc_stats);
+    return rc;
+}
 
-	    for (opr_queue_Scan(&processStats, cursor)) {
-		struct rx_interface_stat *rpc_stat = 
-		    opr_queue_Entry(cursor, struct rx_interface_stat, entry);
-		/*
-		 * Copy the data based upon the caller version
-		 */
-		rx_MarshallProcessRPCStats(callerVersion,
-					   rpc_stat->stats[0].func_total,
-					   rpc_stat->stats, &ptr);
+/*
+ * rx_RetrieveProcessRPCHistograms - retrieve the execution time histograms
+ * for every function in the process rpc statistics
+ *
+ * PARAMETERS
+ *
+ * IN callerVersion - the rpc stat version of the caller
+ *
+ * OUT myVersion - the rpc stat version of this function
+ *
+ * OUT clock_sec - local time seconds
+ *
+ * OUT clock_usec - local time microseconds
+ *
+ * OUT allocSize - the number of bytes allocated to contain stats
+ *
+ * OUT statCount - the number of histograms retrieved from this process.
+ *
+ * OUT stats - the histograms, each RX_STATS_HIST_ENTRY_WORDS long.
+ *
+ * RETURN CODES
+ *
+ * Returns 0 or ENOMEM.  If there are any histograms, stats will != NULL.
+ */
+
+int
+rx_RetrieveProcessRPCHistograms(afs_uint32 callerVersion,
+				afs_uint32 * myVersion,
+				afs_uint32 * clock_sec,
+				afs_uint32 * clock_usec,
+				size_t * allocSize, afs_uint32 * statCount,
+				afs_uint32 ** stats)
+{
+    size_t space = 0;
+    afs_uint32 *ptr;
+    struct clock now;
+    int rc = 0;
+
+    *stats = 0;
+    *allocSize = 0;
+    *statCount = 0;
+    *myVersion = RX_STATS_RETRIEVAL_VERSION;
+
+    MUTEX_ENTER(&rx_rpc_stats);
+    if (!rxi_monitor_processStats) {
+	MUTEX_EXIT(&rx_rpc_stats);
+	return rc;
+    }
+
+    clock_GetTime(&now);
+    *clock_sec = now.sec;
+    *clock_usec = now.usec;
+
+    rxi_LockProcessStats();
+
+    if (callerVersion >= RX_STATS_RETRIEVAL_FIRST_EDITION) {
+	*statCount = rxi_CountProcessStats();
+	space = *statCount * RX_STATS_HIST_ENTRY_WORDS * sizeof(afs_uint32);
+    }
+
+    if (space > (size_t) 0) {
+	*allocSize = space;
+	ptr = *stats = rxi_Alloc(space);
+
+	if (ptr != NULL) {
+	    struct opr_queue *cursor;
+	    rx_function_entry_v1_t stat;
+	    afs_uint64 hist[RX_STATS_HIST_BUCKETS];
+	    afs_uint32 i;
+	    int shard, b;
+
+	    for (shard = 0; shard < RX_STATS_SHARDS; shard++) {
+		for (opr_queue_Scan(&processStats[shard].stats, cursor)) {
+		    struct rx_interface_stat *rpc_stat =
+			opr_queue_Entry(cursor, struct rx_interface_stat,
+					entry);
+
+		    if (!rxi_FirstProcessStat(shard, rpc_stat))
+			continue;
+		    for (i = 0; i < rpc_stat->stats[0].func_total; i++) {
+			rxi_MergeProcessStat(shard, rpc_stat, i, &stat, hist);
+			*(ptr++) = stat.interfaceId;
+			*(ptr++) = stat.remote_is_server;
+			*(ptr++) = stat.func_total;
+			*(ptr++) = stat.func_index;
+			*(ptr++) = RX_STATS_HIST_BUCKETS;
+			for (b = 0; b < RX_STATS_HIST_BUCKETS; b++) {
+			    *(ptr++) = hist[b] >> 32;
+			    *(ptr++) = hist[b] & MAX_AFS_UINT32;
+			}
+		    }
+		}
 	    }
 	} else {
 	    rc = ENOMEM;
 	}
     }
+    rxi_UnlockProcessStats();
     MUTEX_EXIT(&rx_rpc_stats);
     return rc;
 }
@@ -9119,6 +9871,7 @@ rx_disableProcessRPCStats(void)
 {
     struct opr_queue *cursor, *store;
     size_t space;
+    int i;
 
     MUTEX_ENTER(&rx_rpc_stats);
 
@@ -9132,20 +9885,22 @@ rx_disableProcessRPCStats(void)
 	rx_enable_stats = 0;
     }
 
-    for (opr_queue_ScanSafe(&processStats, cursor, store)) {
-    	unsigned int num_funcs = 0;
-	struct rx_interface_stat *rpc_stat
-	    = opr_queue_Entry(cursor, struct rx_interface_stat, entry);
+    for (i = 0; i < RX_STATS_SHARDS; i++) {
+	MUTEX_ENTER(&processStats[i].lock);
+	for (opr_queue_ScanSafe(&processStats[i].stats, cursor, store)) {
+	    unsigned int num_funcs = 0;
+	    struct rx_interface_stat *rpc_stat
+		= opr_queue_Entry(cursor, struct rx_interface_stat, entry);
 
-	opr_queue_Remove(&rpc_stat->entry);
+	    opr_queue_Remove(&rpc_stat->entry);
 
-	num_funcs = rpc_stat->stats[0].func_total;
-	space =
-	    sizeof(rx_interface_stat_t) +
-	    rpc_stat->stats[0].func_total * sizeof(rx_function_entry_v1_t);
+	    num_funcs = rpc_stat->stats[0].func_total;
+	    space = rxi_RpcStatSpace(num_funcs, 1);
 
-	rxi_Free(rpc_stat, space);
-	rxi_rpc_process_stat_cnt -= num_funcs;
+	    rxi_Free(rpc_stat, space);
+	    processStats[i].nfuncs -= num_funcs;
+	}
+	MUTEX_EXIT(&processStats[i].lock);
     }
     MUTEX_EXIT(&rx_rpc_stats);
 }
@@ -9254,60 +10009,68 @@ void
 rx_clearProcessRPCStats(afs_uint32 clearFlag)
 {
     struct opr_queue *cursor;
+    int shard;
 
     MUTEX_ENTER(&rx_rpc_stats);
 
-    for (opr_queue_Scan(&processStats, cursor)) {
-	unsigned int num_funcs = 0, i;
-	struct rx_interface_stat *rpc_stat
-	     = opr_queue_Entry(cursor, struct rx_interface_stat, entry);
-
-	num_funcs = rpc_stat->stats[0].func_total;
-	for (i = 0; i < num_funcs; i++) {
-	    if (clearFlag & AFS_RX_STATS_CLEAR_INVOCATIONS) {
-		rpc_stat->stats[i].invocations = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_BYTES_SENT) {
-		rpc_stat->stats[i].bytes_sent = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_BYTES_RCVD) {
-		rpc_stat->stats[i].bytes_rcvd = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_SUM) {
-		rpc_stat->stats[i].queue_time_sum.sec = 0;
-		rpc_stat->stats[i].queue_time_sum.usec = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_SQUARE) {
-		rpc_stat->stats[i].queue_time_sum_sqr.sec = 0;
-		rpc_stat->stats[i].queue_time_sum_sqr.usec = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_MIN) {
-		rpc_stat->stats[i].queue_time_min.sec = 9999999;
-		rpc_stat->stats[i].queue_time_min.usec = 9999999;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_MAX) {
-		rpc_stat->stats[i].queue_time_max.sec = 0;
-		rpc_stat->stats[i].queue_time_max.usec = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_SUM) {
-		rpc_stat->stats[i].execution_time_sum.sec = 0;
-		rpc_stat->stats[i].execution_time_sum.usec = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_SQUARE) {
-		rpc_stat->stats[i].execution_time_sum_sqr.sec = 0;
-		rpc_stat->stats[i].execution_time_sum_sqr.usec = 0;
-	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_MIN) {
-		rpc_stat->stats[i].execution_time_min.sec = 9999999;
-		rpc_stat->stats[i].execution_time_min.usec = 9999999;
+    for (shard = 0; shard < RX_STATS_SHARDS; shard++) {
+	MUTEX_ENTER(&processStats[shard].lock);
+	for (opr_queue_Scan(&processStats[shard].stats, cursor)) {
+	    unsigned int num_funcs = 0, i;
+	    struct rx_interface_stat *rpc_stat
+		 = opr_queue_Entry(cursor, struct rx_interface_stat, entry);
+
+	    num_funcs = rpc_stat->stats[0].func_total;
+	    for (i = 0; i < num_funcs; i++) {
+		if (clearFlag & AFS_RX_STATS_CLEAR_INVOCATIONS) {
+		    rpc_stat->stats[i].invocations = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_BYTES_SENT) {
+		    rpc_stat->stats[i].bytes_sent = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_BYTES_RCVD) {
+		    rpc_stat->stats[i].bytes_rcvd = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_SUM) {
+		    rpc_stat->stats[i].queue_time_sum.sec = 0;
+		    rpc_stat->stats[i].queue_time_sum.usec = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_SQUARE) {
+		    rpc_stat->stats[i].queue_time_sum_sqr.sec = 0;
+		    rpc_stat->stats[i].queue_time_sum_sqr.usec = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_MIN) {
+		    rpc_stat->stats[i].queue_time_min.sec = 9999999;
+		    rpc_stat->stats[i].queue_time_min.usec = 9999999;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_QUEUE_TIME_MAX) {
+		    rpc_stat->stats[i].queue_time_max.sec = 0;
+		    rpc_stat->stats[i].queue_time_max.usec = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_SUM) {
+		    rpc_stat->stats[i].execution_time_sum.sec = 0;
+		    rpc_stat->stats[i].execution_time_sum.usec = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_SQUARE) {
+		    rpc_stat->stats[i].execution_time_sum_sqr.sec = 0;
+		    rpc_stat->stats[i].execution_time_sum_sqr.usec = 0;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_MIN) {
+		    rpc_stat->stats[i].execution_time_min.sec = 9999999;
+		    rpc_stat->stats[i].execution_time_min.usec = 9999999;
+		}
+		if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_MAX) {
+		    rpc_stat->stats[i].execution_time_max.sec = 0;
+		    rpc_stat->stats[i].execution_time_max.usec = 0;
+		}
 	    }
-	    if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_MAX) {
-		rpc_stat->stats[i].execution_time_max.sec = 0;
-		rpc_stat->stats[i].execution_time_max.usec = 0;
+	    if (clearFlag & AFS_RX_STATS_CLEAR_EXEC_TIME_HIST) {
+		memset(rxi_RpcStatHist(rpc_stat, 0), 0,
+		       num_funcs * RX_STATS_HIST_BUCKETS * sizeof(afs_uint64));
 	    }
 	}
+	MUTEX_EXIT(&processStats[shard].lock);
     }
-
     MUTEX_EXIT(&rx_rpc_stats);
 }
 
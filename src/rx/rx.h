@@ -271,6 +271,11 @@ returned with an error code of RX_CALL_DEAD ( transient error ) */
 #define rx_Writev(call, iov, nio, nbytes) \
    rx_WritevProc(call, iov, nio, nbytes)
 
+/* Fills or drains the iovecs of one step of rx_WriteBulk or rx_ReadBulk */
+struct iovec;
+typedef int (*rx_bulkproc_t)(void *rock, struct iovec *iov, int nio,
+			     int nbytes);
+
 /* This is the maximum size data packet that can be sent on this connection, accounting for security module-specific overheads. */
 #define rx_MaxUserDataSize(call) ((call)->MTU - RX_HEADER_SIZE - \
 				  (call)->conn->securityHeaderSize - \
@@ -331,7 +336,11 @@ struct rx_service {
 #ifdef RX_ENABLE_LOCKS
     afs_kmutex_t svc_data_lock;	/* protect specific data */
 #endif
-
+    /* The rest are protected by rx_serverPool_lock */
+    struct opr_queue incomingCallQueue;	/* Calls waiting for a server thread */
+    afs_uint32 nDispatched;	/* Calls handed to a server thread */
+    afs_uint64 dispatchWaitSum;	/* Total usecs those calls waited */
+    afs_uint32 dispatchWaitMax;	/* Longest wait, in usecs */
 };
 
 /* Flag bits for connection structure */
@@ -353,6 +362,10 @@ struct rx_service {
 /* Maximum number of acknowledgements in an acknowledge packet */
 #define RX_MAXACKS 255
 
+/* Congestion control algorithms, for rx_SetCongestionControl */
+#define RX_CC_CLASSIC	0	/* halve on loss, grow one packet per window */
+#define RX_CC_CUBIC	1	/* CUBIC (RFC 8312) */
+
 /* The structure of the data portion of an acknowledge packet: An acknowledge
  * packet is in network byte order at all times.  An acknowledgement is always
  * prompted for a specific reason by a specific incoming packet.  This reason
@@ -666,7 +679,10 @@ struct rx_statistics {		/* General rx statistics */
     int receiveCbufPktAllocFailures;
     int sendCbufPktAllocFailures;
     int nBusies;
-    int spares[4];
+    int fpqRefills;		/* packets moved from the global free queue to thread caches */
+    int fpqSpills;		/* packets moved from thread caches to the global free queue */
+    int packetArenas;		/* blocks of packets allocated */
+    int hugePacketArenas;	/* blocks of packets marked for huge pages */
 };
 
 /* structures for debug input and output packets */
@@ -681,7 +697,7 @@ struct rx_debugIn {
 #define RX_DEBUGI_BADTYPE (-8)
 
 #define RX_DEBUGI_VERSION_MINIMUM ('L')	/* earliest real version */
-#define RX_DEBUGI_VERSION ('S')    		/* Latest version */
+#define RX_DEBUGI_VERSION ('V')    		/* Latest version */
     /* first version w/ secStats */
 #define RX_DEBUGI_VERSION_W_SECSTATS ('L')
     /* version M is first supporting GETALLCONN and RXSTATS type */
@@ -695,6 +711,9 @@ struct rx_debugIn {
 #define RX_DEBUGI_VERSION_W_GETPEER ('Q')
 #define RX_DEBUGI_VERSION_W_WAITED ('R')
 #define RX_DEBUGI_VERSION_W_PACKETS ('S')
+#define RX_DEBUGI_VERSION_W_DISPATCH ('T')
+#define RX_DEBUGI_VERSION_W_PACKETPOOLS ('U')
+#define RX_DEBUGI_VERSION_W_PMTU ('V')
 
 #define RX_DEBUGI_GETSTATS	1	/* get basic rx stats */
 #define RX_DEBUGI_GETCONN	2	/* get connection info */
@@ -714,7 +733,10 @@ struct rx_debugStats {
     afs_int32 idleThreads;	/* Number of server threads that are idle */
     afs_int32 nWaited;
     afs_int32 nPackets;
-    afs_int32 spare2[6];
+    afs_int32 nDispatched;	/* Calls handed to server threads */
+    afs_int32 dispatchWaitMean;	/* Mean usecs they waited for a thread */
+    afs_int32 dispatchWaitMax;	/* Longest wait, in usecs */
+    afs_int32 spare2[3];
 };
 
 struct rx_debugConn_vL {
@@ -785,7 +807,12 @@ struct rx_debugPeer {
     u_short congestSeq;
     afs_hyper_t bytesSent;
     afs_hyper_t bytesReceived;
-    afs_int32 sparel[10];
+    afs_int32 maxPacketSize;	/* largest packet known to get through */
+    afs_int32 pmtuHigh;		/* smallest packet thought too big */
+    afs_uint32 pmtuConvergeTime; /* msec the last path MTU search took */
+    afs_uint32 pmtuProbes;	/* path MTU probes sent */
+    afs_uint32 pmtuProbesLost;	/* path MTU probes unanswered */
+    afs_int32 sparel[5];
 };
 
 #define RX_OTHER_IN	1	/* packets avail in in queue */
@@ -801,6 +828,8 @@ struct rx_debugPeer {
 #define RX_SERVER_DEBUG_ALL_PEER		0x80
 #define RX_SERVER_DEBUG_WAITED_CNT		0x100
 #define RX_SERVER_DEBUG_PACKETS_CNT		0x200
+#define RX_SERVER_DEBUG_DISPATCH		0x400
+#define RX_SERVER_DEBUG_PMTU			0x800
 
 #define AFS_RX_STATS_CLEAR_ALL			0xffffffff
 #define AFS_RX_STATS_CLEAR_INVOCATIONS		0x1
@@ -814,6 +843,7 @@ struct rx_debugPeer {
 #define AFS_RX_STATS_CLEAR_EXEC_TIME_SQUARE	0x100
 #define AFS_RX_STATS_CLEAR_EXEC_TIME_MIN	0x200
 #define AFS_RX_STATS_CLEAR_EXEC_TIME_MAX	0x400
+#define AFS_RX_STATS_CLEAR_EXEC_TIME_HIST	0x800
 
 typedef struct rx_function_entry_v1 {
     afs_uint32 remote_peer;
@@ -853,6 +883,20 @@ typedef struct rx_interface_stat {
     rx_function_entry_v1_t stats[1];	/* make sure this is aligned correctly */
 } rx_interface_stat_t, *rx_interface_stat_p;
 
+/*
+ * Process stats also keep a histogram of execution times for each function.
+ * Bucket 0 counts calls that took less than a microsecond, and bucket n
+ * counts calls that took between 2^(n-1) and 2^n microseconds; the last
+ * bucket also takes everything slower than that.
+ *
+ * rx_RetrieveProcessRPCHistograms marshals each function as
+ * RX_STATS_HIST_ENTRY_WORDS words: interfaceId, remote_is_server,
+ * func_total, func_index, the number of buckets, and then each bucket as
+ * a high and low word.
+ */
+#define RX_STATS_HIST_BUCKETS 32
+#define RX_STATS_HIST_ENTRY_WORDS (5 + 2 * RX_STATS_HIST_BUCKETS)
+
 #define RX_STATS_SERVICE_ID 409
 
 #ifdef AFS_NT40_ENV
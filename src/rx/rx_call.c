@@ -68,9 +68,9 @@ rx_RecordCallStatistics(struct rx_call *call, unsigned int rxInterface,
     queue = call->startTime;
     clock_Sub(&queue, &call->queueTime);
 
-    rxi_IncrementTimeAndCount(call->conn->peer, rxInterface, currentFunc,
-			     totalFunc, &queue, &exec, call->app.bytesSent,
-			     call->app.bytesRcvd, isServer);
+    rxi_IncrementTimeAndCount(call->conn->peer, call, rxInterface,
+			     currentFunc, totalFunc, &queue, &exec,
+			     call->app.bytesSent, call->app.bytesRcvd, isServer);
 }
 
 /*
@@ -80,6 +80,11 @@ struct rx_call {
     u_short nSoftAcks;		/* The number of delayed soft acks */
     u_short nHardAcks;		/* The number of delayed hard acks */
     u_short congestSeq;		/* Peer's congestion sequence counter */
+    struct rx_ccops *cc;	/* Congestion control algorithm */
+    u_short ccWmax;		/* CUBIC: cwind when loss was last seen */
+    u_short ccOrigin;		/* CUBIC: cwind this epoch's curve is centred on */
+    afs_uint32 ccK;		/* CUBIC: msecs from epoch start to ccOrigin */
+    struct clock ccEpoch;	/* CUBIC: when the current epoch began */
     int rtt;
     int rtt_dev;
     struct clock rto;		/* The round trip timeout calculated for this call */
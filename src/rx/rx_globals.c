@@ -89,6 +89,17 @@ int rx_GetMinPeerTimeout(void)
     return rx_minPeerTimeout;
 }
 
+void rx_SetCongestionControl(int algorithm)
+{
+    if (algorithm == RX_CC_CLASSIC || algorithm == RX_CC_CUBIC)
+	rx_congestionControl = algorithm;
+}
+
+int rx_GetCongestionControl(void)
+{
+    return rx_congestionControl;
+}
+
 #ifdef AFS_NT40_ENV
 
 void rx_SetRxDeadTime(int seconds)
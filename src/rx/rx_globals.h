@@ -119,8 +119,13 @@ EXT int rx_maxReceiveWindow GLOBALSINIT(32);	/* how much to accept */
 EXT int rx_initSendWindow GLOBALSINIT(16);
 EXT int rx_maxSendWindow GLOBALSINIT(32);
 EXT int rx_nackThreshold GLOBALSINIT(3);	/* Number NACKS to trigger congestion recovery */
+EXT int rx_congestionControl GLOBALSINIT(RX_CC_CLASSIC);	/* for new calls */
 EXT int rx_nDgramThreshold GLOBALSINIT(4);	/* Number of packets before increasing
                                                  * packets per datagram */
+/* IP fragments a jumbogram may be split into.  This does not hold back
+ * jumbo frame networks: RX_MAX_DGRAM_PACKETS packets already fit in a
+ * single 9000-byte frame, and allowing more fragments would only fragment
+ * jumbograms further on 1500-byte paths. */
 #define RX_MAX_FRAGS 4
 EXT int rxi_nSendFrags GLOBALSINIT(RX_MAX_FRAGS);	/* max fragments in a datagram */
 EXT int rxi_nRecvFrags GLOBALSINIT(RX_MAX_FRAGS);
@@ -152,6 +157,8 @@ typedef struct rx_ts_info_t {
         struct opr_queue queue;
         int len;                /* local queue length */
         int delta;              /* number of new packets alloc'd locally since last sync w/ global queue */
+        int localmax;           /* this thread's limit on len, if above rx_TSFPQLocalMax */
+        int refilled;           /* pulled packets from the global queue since the last spill */
 
         /* FPQ stats */
         int checkin_ops;
@@ -275,6 +282,31 @@ EXT int rx_TSFPQMaxProcs GLOBALSINIT(0); /* max number of threads expected */
         rx_TSFPQLocalMax = newmax; \
         rx_TSFPQGlobSize = newglob; \
     } while(0)
+/*
+ * the local queue limit for one thread.  this starts out as the shared
+ * rx_TSFPQLocalMax, but a thread which keeps cycling packets through the
+ * global queue (for instance, because it alternates between being the
+ * listener and running calls) is allowed to keep more of them.
+ */
+#define RX_TS_FPQ_MAX_GROWTH 4
+#define RX_TS_FPQ_LOCAL_MAX(rx_ts_info_p) \
+    MAX((rx_ts_info_p)->_FPQ.localmax, rx_TSFPQLocalMax)
+/* adjust the local queue limit, as a thread is about to spill packets to
+ * the global queue.  if it has had to refill from the global queue since
+ * it last spilled, double its limit, up to RX_TS_FPQ_MAX_GROWTH times the
+ * shared limit.  otherwise, fall back halfway towards the shared limit. */
+#define RX_TS_FPQ_ADAPT(rx_ts_info_p) \
+    do { \
+        if ((rx_ts_info_p)->_FPQ.refilled) { \
+            (rx_ts_info_p)->_FPQ.localmax = \
+                MIN(2 * RX_TS_FPQ_LOCAL_MAX(rx_ts_info_p), \
+                    RX_TS_FPQ_MAX_GROWTH * rx_TSFPQLocalMax); \
+        } else if ((rx_ts_info_p)->_FPQ.localmax > rx_TSFPQLocalMax) { \
+            (rx_ts_info_p)->_FPQ.localmax -= \
+                ((rx_ts_info_p)->_FPQ.localmax - rx_TSFPQLocalMax + 1) / 2; \
+        } \
+        (rx_ts_info_p)->_FPQ.refilled = 0; \
+    } while(0)
 /* record the number of packets allocated by this thread
  * and stored in the thread local queue */
 #define RX_TS_FPQ_LOCAL_ALLOC(rx_ts_info_p,num_alloc) \
@@ -295,7 +327,9 @@ EXT int rx_TSFPQMaxProcs GLOBALSINIT(0); /* max number of threads expected */
     do { \
         int i; \
         struct rx_packet * p; \
-        int tsize = MIN((rx_ts_info_p)->_FPQ.len, (rx_ts_info_p)->_FPQ.len - rx_TSFPQLocalMax + 3 *  rx_TSFPQGlobSize); \
+        int tsize; \
+        RX_TS_FPQ_ADAPT(rx_ts_info_p); \
+        tsize = MIN((rx_ts_info_p)->_FPQ.len, (rx_ts_info_p)->_FPQ.len - RX_TS_FPQ_LOCAL_MAX(rx_ts_info_p) + 3 *  rx_TSFPQGlobSize); \
 	if (tsize <= 0) break; \
         for (i=0,p=opr_queue_Last(&((rx_ts_info_p)->_FPQ.queue), \
 				 struct rx_packet, entry); \
@@ -307,6 +341,8 @@ EXT int rx_TSFPQMaxProcs GLOBALSINIT(0); /* max number of threads expected */
         rx_nFreePackets += tsize; \
         (rx_ts_info_p)->_FPQ.ltog_ops++; \
         (rx_ts_info_p)->_FPQ.ltog_xfer += tsize; \
+        if (rx_stats_active) \
+            rx_atomic_add(&rx_stats.fpqSpills, tsize); \
         if ((rx_ts_info_p)->_FPQ.delta) { \
             MUTEX_ENTER(&rx_packets_mutex); \
             RX_TS_FPQ_COMPUTE_LIMITS; \
@@ -330,6 +366,8 @@ EXT int rx_TSFPQMaxProcs GLOBALSINIT(0); /* max number of threads expected */
         rx_nFreePackets += (num_transfer); \
         (rx_ts_info_p)->_FPQ.ltog_ops++; \
         (rx_ts_info_p)->_FPQ.ltog_xfer += (num_transfer); \
+        if (rx_stats_active) \
+            rx_atomic_add(&rx_stats.fpqSpills, (num_transfer)); \
         if ((rx_ts_info_p)->_FPQ.delta) { \
             MUTEX_ENTER(&rx_packets_mutex); \
             RX_TS_FPQ_COMPUTE_LIMITS; \
@@ -355,6 +393,9 @@ EXT int rx_TSFPQMaxProcs GLOBALSINIT(0); /* max number of threads expected */
         rx_nFreePackets -= i; \
         (rx_ts_info_p)->_FPQ.gtol_ops++; \
         (rx_ts_info_p)->_FPQ.gtol_xfer += i; \
+        (rx_ts_info_p)->_FPQ.refilled = 1; \
+        if (rx_stats_active) \
+            rx_atomic_add(&rx_stats.fpqRefills, i); \
     } while(0)
 /* same as above, except user has direct control over number to transfer */
 #define RX_TS_FPQ_GTOL2(rx_ts_info_p,num_transfer) \
@@ -373,6 +414,9 @@ EXT int rx_TSFPQMaxProcs GLOBALSINIT(0); /* max number of threads expected */
         rx_nFreePackets -= i; \
         (rx_ts_info_p)->_FPQ.gtol_ops++; \
         (rx_ts_info_p)->_FPQ.gtol_xfer += i; \
+        (rx_ts_info_p)->_FPQ.refilled = 1; \
+        if (rx_stats_active) \
+            rx_atomic_add(&rx_stats.fpqRefills, i); \
     } while(0)
 /* checkout a packet from the thread-specific free packet queue */
 #define RX_TS_FPQ_CHECKOUT(rx_ts_info_p,p) \
@@ -453,6 +497,10 @@ EXT afs_uint32 rx_maxReceiveSizeUser GLOBALSINIT(0xffffffff);
  */
 EXT afs_uint32 rx_MyMaxSendSize GLOBALSINIT(8588);
 
+/* The largest MTU of our non-loopback network interfaces, less the IP and
+ * UDP headers, or 0 if we don't know it.  MTU probes never go past it. */
+EXT int rxi_maxIfMTU GLOBALSINIT(0);
+
 /* Maximum size of a jumbo datagram we can receive */
 EXT afs_uint32 rx_maxJumboRecvSize GLOBALSINIT(RX_MAX_PACKET_SIZE);
 
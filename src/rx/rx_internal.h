@@ -24,6 +24,8 @@ extern rx_atomic_t rx_nWaited;
 
 /* rx.c */
 extern int rxi_IsRunning(void);
+extern void rxi_GetDispatchStats(afs_uint32 *nDispatched,
+				 afs_uint32 *waitMean, afs_uint32 *waitMax);
 extern void rxi_CancelDelayedAckEvent(struct rx_call *);
 extern void rxi_PacketsUnWait(void);
 extern void rxi_SetPeerMtu(struct rx_peer *peer, afs_uint32 host,
@@ -55,6 +57,7 @@ extern struct rx_packet *rxi_SendConnectionAbort(struct rx_connection *conn,
 						 struct rx_packet *packet,
 						 int istack, int force);
 extern void rxi_IncrementTimeAndCount(struct rx_peer *peer,
+				      struct rx_call *call,
 				      afs_uint32 rxInterface,
 				      afs_uint32 currentFunc,
 				      afs_uint32 totalFunc,
@@ -509,6 +509,8 @@ rxi_GetcbiInfo(void)
 	    different++;
 
 	mtus[i] = rxmtu;
+	if (!rx_IsLoopbackAddr(ifinaddr) && rxmtu > rxi_maxIfMTU)
+	    rxi_maxIfMTU = rxmtu;
 	rxmtu = rxi_AdjustIfMTU(rxmtu);
 	maxmtu =
 	    rxmtu * rxi_nRecvFrags + ((rxi_nRecvFrags - 1) * UDP_HDR_SIZE);
@@ -634,6 +636,8 @@ rxi_GetIFInfo(void)
 			    different++;
 			}
 			mtus[i] = rxmtu;
+			if (!rx_IsLoopbackAddr(ifinaddr) && rxmtu > rxi_maxIfMTU)
+			    rxi_maxIfMTU = rxmtu;
 			rxmtu = rxi_AdjustIfMTU(rxmtu);
 			maxmtu =
 			    rxmtu * rxi_nRecvFrags +
@@ -698,6 +702,8 @@ rxi_GetIFInfo(void)
 		    different++;
 		}
 		mtus[i] = rxmtu;
+		if (!rx_IsLoopbackAddr(ifinaddr) && rxmtu > rxi_maxIfMTU)
+		    rxi_maxIfMTU = rxmtu;
 		rxmtu = rxi_AdjustIfMTU(rxmtu);
 		maxmtu =
 		    rxmtu * rxi_nRecvFrags +
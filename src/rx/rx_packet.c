@@ -50,6 +50,8 @@
 #  endif
 #  include "rx_user.h"
 #  include "rx_xmit_nt.h"
+# else
+#  include <sys/mman.h>
 # endif
 # include <lwp.h>
 #endif /* KERNEL */
@@ -79,8 +81,15 @@ struct rx_mallocedPacket {
     struct opr_queue entry;	/*!< chained using opr_queue */
     struct rx_packet *addr;	/*!< address of the first element */
     afs_uint32 size;		/*!< array size in bytes */
+    int mapped;			/*!< array was mapped, rather than allocated */
 };
 
+#if !defined(KERNEL) && !defined(AFS_NT40_ENV) && defined(MAP_ANONYMOUS)
+/* Large blocks of packets are mapped in multiples of the huge page size */
+# define RX_PACKET_ARENA_MMAP
+# define RX_PACKET_ARENA_ALIGN (2 * 1024 * 1024)
+#endif
+
 #ifdef RX_LOCKS_DB
 /* rxdb_fileID is used to identify the lock location, along with line#. */
 static int rxdb_fileID = RXDB_FILE_RX_PACKET;
@@ -400,7 +409,7 @@ rxi_FreePackets(int num_pkts, struct opr_queue * q)
 	RX_TS_FPQ_QCHECKIN(rx_ts_info, num_pkts, q);
     }
 
-    if (rx_ts_info->_FPQ.len > rx_TSFPQLocalMax) {
+    if (rx_ts_info->_FPQ.len > RX_TS_FPQ_LOCAL_MAX(rx_ts_info)) {
         NETPRI;
 	MUTEX_ENTER(&rx_freePktQ_lock);
 
@@ -548,13 +557,14 @@ rxi_AllocDataBuf(struct rx_packet *p, int nb, int class)
 /**
  * Register allocated packets.
  *
- * @param[in] addr array of packets
- * @param[in] npkt number of packets
+ * @param[in] addr   array of packets
+ * @param[in] size   size of the array in bytes
+ * @param[in] mapped whether the array was mapped with mmap
  *
  * @return none
  */
 static void
-registerPackets(struct rx_packet *addr, afs_uint32 npkt)
+registerPackets(struct rx_packet *addr, afs_uint32 size, int mapped)
 {
     struct rx_mallocedPacket *mp;
 
@@ -564,14 +574,84 @@ registerPackets(struct rx_packet *addr, afs_uint32 npkt)
     memset(mp, 0, sizeof(*mp));
 
     mp->addr = addr;
-    mp->size = npkt * sizeof(struct rx_packet);
-    osi_Assert(npkt <= MAX_AFS_UINT32 / sizeof(struct rx_packet));
+    mp->size = size;
+    mp->mapped = mapped;
 
     MUTEX_ENTER(&rx_mallocedPktQ_lock);
     opr_queue_Append(&rx_mallocedPacketQueue, &mp->entry);
     MUTEX_EXIT(&rx_mallocedPktQ_lock);
 }
 
+/**
+ * Allocate, zero and register a block of packets.
+ *
+ * In userspace, blocks of at least half a huge page are mapped directly,
+ * aligned to and rounded up to whole huge pages, and the space left by
+ * the rounding is used for more packets.  Where the system has
+ * transparent huge pages, the block is marked for them, so that walking
+ * the packet pool does not thrash the TLB.  The block is zeroed by the
+ * calling thread, which under a first-touch NUMA policy places it on the
+ * node of the thread that is about to use the packets.
+ *
+ * @param[inout] apackets number of packets wanted; on return, the number
+ *                        of packets in the block
+ *
+ * @return the block of packets, or NULL if no memory is available
+ */
+static struct rx_packet *
+rxi_AllocPacketArena(int *apackets)
+{
+    struct rx_packet *p = NULL;
+    afs_uint32 getme;
+    int mapped = 0;
+
+    osi_Assert(*apackets > 0
+	       && *apackets <= MAX_AFS_UINT32 / sizeof(struct rx_packet));
+    getme = *apackets * sizeof(struct rx_packet);
+
+#ifdef RX_PACKET_ARENA_MMAP
+    if (getme >= RX_PACKET_ARENA_ALIGN / 2
+	&& getme <= MAX_AFS_UINT32 - 2 * RX_PACKET_ARENA_ALIGN) {
+	afs_uint32 len;
+	char *base, *start;
+
+	len = (getme + RX_PACKET_ARENA_ALIGN - 1)
+	    & ~(afs_uint32)(RX_PACKET_ARENA_ALIGN - 1);
+	/* map an extra huge page, so we can trim the block to alignment */
+	base = mmap(NULL, len + RX_PACKET_ARENA_ALIGN, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base != MAP_FAILED) {
+	    start = (char *)(((uintptr_t)base + RX_PACKET_ARENA_ALIGN - 1)
+			     & ~(uintptr_t)(RX_PACKET_ARENA_ALIGN - 1));
+	    if (start > base)
+		munmap(base, start - base);
+	    munmap(start + len, base + RX_PACKET_ARENA_ALIGN - start);
+# ifdef MADV_HUGEPAGE
+	    if (madvise(start, len, MADV_HUGEPAGE) == 0 && rx_stats_active)
+		rx_atomic_inc(&rx_stats.hugePacketArenas);
+# endif
+	    p = (struct rx_packet *)start;
+	    getme = len;
+	    *apackets = len / sizeof(struct rx_packet);
+	    mapped = 1;
+	}
+    }
+#endif /* RX_PACKET_ARENA_MMAP */
+
+    if (p == NULL) {
+	p = osi_Alloc(getme);
+	if (p == NULL)
+	    return NULL;
+	PIN(p, getme);		/* XXXXX */
+    }
+    memset(p, 0, getme);
+    registerPackets(p, getme, mapped);
+    if (rx_stats_active)
+	rx_atomic_inc(&rx_stats.packetArenas);
+
+    return p;
+}
+
 /* Add more packet buffers */
 #ifdef RX_ENABLE_TSFPQ
 void
@@ -579,16 +659,10 @@ rxi_MorePackets(int apackets)
 {
     struct rx_packet *p, *e;
     struct rx_ts_info_t * rx_ts_info;
-    int getme;
     SPLVAR;
 
-    getme = apackets * sizeof(struct rx_packet);
-    p = osi_Alloc(getme);
+    p = rxi_AllocPacketArena(&apackets);
     osi_Assert(p);
-    registerPackets(p, apackets);
-
-    PIN(p, getme);		/* XXXXX */
-    memset(p, 0, getme);
     RX_TS_INFO_GET(rx_ts_info);
 
     RX_TS_FPQ_LOCAL_ALLOC(rx_ts_info,apackets);
@@ -617,7 +691,7 @@ rxi_MorePackets(int apackets)
     }
     rx_ts_info->_FPQ.delta += apackets;
 
-    if (rx_ts_info->_FPQ.len > rx_TSFPQLocalMax) {
+    if (rx_ts_info->_FPQ.len > RX_TS_FPQ_LOCAL_MAX(rx_ts_info)) {
         NETPRI;
 	MUTEX_ENTER(&rx_freePktQ_lock);
 
@@ -634,16 +708,10 @@ void
 rxi_MorePackets(int apackets)
 {
     struct rx_packet *p, *e;
-    int getme;
     SPLVAR;
 
-    getme = apackets * sizeof(struct rx_packet);
-    p = osi_Alloc(getme);
+    p = rxi_AllocPacketArena(&apackets);
     osi_Assert(p);
-    registerPackets(p, apackets);
-
-    PIN(p, getme);		/* XXXXX */
-    memset(p, 0, getme);
     NETPRI;
     MUTEX_ENTER(&rx_freePktQ_lock);
 
@@ -678,15 +746,10 @@ rxi_MorePacketsTSFPQ(int apackets, int flush_global, int num_keep_local)
 {
     struct rx_packet *p, *e;
     struct rx_ts_info_t * rx_ts_info;
-    int getme;
     SPLVAR;
 
-    getme = apackets * sizeof(struct rx_packet);
-    p = osi_Alloc(getme);
-    registerPackets(p, apackets);
-
-    PIN(p, getme);		/* XXXXX */
-    memset(p, 0, getme);
+    p = rxi_AllocPacketArena(&apackets);
+    osi_Assert(p);
     RX_TS_INFO_GET(rx_ts_info);
 
     RX_TS_FPQ_LOCAL_ALLOC(rx_ts_info,apackets);
@@ -737,22 +800,18 @@ rxi_MorePacketsNoLock(int apackets)
     struct rx_ts_info_t * rx_ts_info;
 #endif /* RX_ENABLE_TSFPQ */
     struct rx_packet *p, *e;
-    int getme;
 
     /* allocate enough packets that 1/4 of the packets will be able
      * to hold maximal amounts of data */
     apackets += (apackets / 4)
 	* ((rx_maxJumboRecvSize - RX_FIRSTBUFFERSIZE) / RX_CBUFFERSIZE);
     do {
-        getme = apackets * sizeof(struct rx_packet);
-        p = osi_Alloc(getme);
+        p = rxi_AllocPacketArena(&apackets);
 	if (p == NULL) {
             apackets -= apackets / 4;
             osi_Assert(apackets > 0);
         }
     } while(p == NULL);
-    memset(p, 0, getme);
-    registerPackets(p, apackets);
 
 #ifdef RX_ENABLE_TSFPQ
     RX_TS_INFO_GET(rx_ts_info);
@@ -797,8 +856,15 @@ rxi_FreeAllPackets(void)
 	mp = opr_queue_First(&rx_mallocedPacketQueue,
 			     struct rx_mallocedPacket, entry);
 	opr_queue_Remove(&mp->entry);
-	osi_Free(mp->addr, mp->size);
-	UNPIN(mp->addr, mp->size);
+#ifdef RX_PACKET_ARENA_MMAP
+	if (mp->mapped) {
+	    munmap(mp->addr, mp->size);
+	} else
+#endif
+	{
+	    osi_Free(mp->addr, mp->size);
+	    UNPIN(mp->addr, mp->size);
+	}
 	osi_Free(mp, sizeof(*mp));
     }
     MUTEX_EXIT(&rx_mallocedPktQ_lock);
@@ -823,8 +889,9 @@ rxi_AdjustLocalPacketsTSFPQ(int num_keep_local, int allow_overcommit)
 	    rxi_PacketsUnWait();
         } else {
             xfer = num_keep_local - rx_ts_info->_FPQ.len;
-            if ((num_keep_local > rx_TSFPQLocalMax) && !allow_overcommit)
-                xfer = rx_TSFPQLocalMax - rx_ts_info->_FPQ.len;
+            if ((num_keep_local > RX_TS_FPQ_LOCAL_MAX(rx_ts_info))
+		&& !allow_overcommit)
+                xfer = RX_TS_FPQ_LOCAL_MAX(rx_ts_info) - rx_ts_info->_FPQ.len;
             if (rx_nFreePackets < xfer) {
 		rxi_MorePacketsNoLock(MAX(xfer - rx_nFreePackets, 4 * rx_initSendWindow));
             }
@@ -889,7 +956,7 @@ rxi_FreePacketTSFPQ(struct rx_packet *p, int flush_global)
     RX_TS_INFO_GET(rx_ts_info);
     RX_TS_FPQ_CHECKIN(rx_ts_info,p);
 
-    if (flush_global && (rx_ts_info->_FPQ.len > rx_TSFPQLocalMax)) {
+    if (flush_global && (rx_ts_info->_FPQ.len > RX_TS_FPQ_LOCAL_MAX(rx_ts_info))) {
         NETPRI;
 	MUTEX_ENTER(&rx_freePktQ_lock);
 
@@ -994,7 +1061,7 @@ rxi_FreeDataBufsTSFPQ(struct rx_packet *p, afs_uint32 first, int flush_global)
     p->length = 0;
     p->niovecs = 0;
 
-    if (flush_global && (rx_ts_info->_FPQ.len > rx_TSFPQLocalMax)) {
+    if (flush_global && (rx_ts_info->_FPQ.len > RX_TS_FPQ_LOCAL_MAX(rx_ts_info))) {
         NETPRI;
 	MUTEX_ENTER(&rx_freePktQ_lock);
 
@@ -1068,7 +1135,7 @@ rxi_TrimDataBufs(struct rx_packet *p, int first)
 	RX_TS_FPQ_CHECKIN(rx_ts_info,RX_CBUF_TO_PACKET(iov->iov_base, p));
 	p->niovecs--;
     }
-    if (rx_ts_info->_FPQ.len > rx_TSFPQLocalMax) {
+    if (rx_ts_info->_FPQ.len > RX_TS_FPQ_LOCAL_MAX(rx_ts_info)) {
         NETPRI;
         MUTEX_ENTER(&rx_freePktQ_lock);
 
@@ -1806,6 +1873,7 @@ rxi_ReceiveDebugPacket(struct rx_packet *ap, osi_socket asocket,
     switch (tin.type) {
     case RX_DEBUGI_GETSTATS:{
 	    struct rx_debugStats tstat;
+	    afs_uint32 nDispatched, waitMean, waitMax;
 
 	    /* get basic stats */
 	    memset(&tstat, 0, sizeof(tstat));	/* make sure spares are zero */
@@ -1822,8 +1890,12 @@ rxi_ReceiveDebugPacket(struct rx_packet *ap, osi_socket asocket,
 	    tstat.nWaiting = htonl(rx_atomic_read(&rx_nWaiting));
 	    tstat.nWaited = htonl(rx_atomic_read(&rx_nWaited));
 	    tstat.idleThreads = opr_queue_Count(&rx_idleServerQueue);
+	    rxi_GetDispatchStats(&nDispatched, &waitMean, &waitMax);
 	    MUTEX_EXIT(&rx_serverPool_lock);
 	    tstat.idleThreads = htonl(tstat.idleThreads);
+	    tstat.nDispatched = htonl(nDispatched);
+	    tstat.dispatchWaitMean = htonl(waitMean);
+	    tstat.dispatchWaitMax = htonl(waitMax);
 	    tl = sizeof(struct rx_debugStats) - ap->length;
 	    if (tl > 0)
 		tl = rxi_AllocDataBuf(ap, tl, RX_PACKET_CLASS_SEND_CBUF);
@@ -2023,6 +2095,11 @@ rxi_ReceiveDebugPacket(struct rx_packet *ap, osi_socket asocket,
 			    htonl(tp->bytesReceived >> 32);
 			tpeer.bytesReceived.low =
 			    htonl(tp->bytesReceived & MAX_AFS_UINT32);
+			tpeer.maxPacketSize = htonl(tp->maxPacketSize);
+			tpeer.pmtuHigh = htonl(tp->pmtuHigh);
+			tpeer.pmtuConvergeTime = htonl(tp->pmtuConvergeTime);
+			tpeer.pmtuProbes = htonl(tp->pmtuProbes);
+			tpeer.pmtuProbesLost = htonl(tp->pmtuProbesLost);
                         MUTEX_EXIT(&tp->peer_lock);
 
                         MUTEX_ENTER(&rx_peerHashTable_lock);
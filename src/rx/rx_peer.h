@@ -58,6 +58,20 @@ struct rx_peer {
     struct opr_queue rpcStats;	/* rpc statistic list */
     int lastReachTime;		/* Last time we verified reachability */
     afs_int32 maxPacketSize;    /* Max size we sent that got acked (w/o hdrs) */
+
+    /* Path MTU search, by probing between maxPacketSize and pmtuHigh */
+    afs_int32 pmtuHigh;		/* smallest size thought too big (w/o hdrs) */
+    afs_int32 pmtuCeiling;	/* largest size this search may try */
+    afs_int32 pmtuProbeSize;	/* size of the probe being tried */
+    struct clock pmtuProbeTime;	/* when it was sent; zero once answered */
+    afs_uint32 pmtuProbeCid;	/* connection the probe was sent on */
+    afs_int32 pmtuProbeSerial;	/* and its serial number there */
+    u_short pmtuLost;		/* probes of this size lost in a row */
+    u_short pmtuDone;		/* search has converged */
+    struct clock pmtuStart;	/* when the search started */
+    afs_uint32 pmtuConvergeTime; /* msec the last search took to converge */
+    afs_uint32 pmtuProbes;	/* probes sent to this peer */
+    afs_uint32 pmtuProbesLost;	/* probes to this peer which went unanswered */
 #ifdef AFS_RXERRQ_ENV
     rx_atomic_t neterrs;
 
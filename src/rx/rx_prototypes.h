@@ -143,6 +143,13 @@ extern int rx_RetrieveProcessRPCStats(afs_uint32 callerVersion,
 				      size_t * allocSize,
 				      afs_uint32 * statCount,
 				      afs_uint32 ** stats);
+extern int rx_RetrieveProcessRPCHistograms(afs_uint32 callerVersion,
+					   afs_uint32 * myVersion,
+					   afs_uint32 * clock_sec,
+					   afs_uint32 * clock_usec,
+					   size_t * allocSize,
+					   afs_uint32 * statCount,
+					   afs_uint32 ** stats);
 extern int rx_RetrievePeerRPCStats(afs_uint32 callerVersion,
 				   afs_uint32 * myVersion,
 				   afs_uint32 * clock_sec,
@@ -237,6 +244,8 @@ extern void rx_SetMaxReceiveWindow(int packets);
 extern void rx_SetMaxSendWindow(int packets);
 extern int rx_GetMinPeerTimeout(void);
 extern void rx_SetMinPeerTimeout(int msecs);
+extern int rx_GetCongestionControl(void);
+extern void rx_SetCongestionControl(int algorithm);
 
 #ifdef KERNEL
 /* rx_kcommon.c */
@@ -466,6 +475,7 @@ extern int rxi_ReadProc(struct rx_call *call, char *buf,
 			int nbytes);
 extern int rx_ReadProc(struct rx_call *call, char *buf, int nbytes);
 extern int rx_ReadProc32(struct rx_call *call, afs_int32 * value);
+extern void *rxi_ReadInline(struct rx_call *call, int nbytes);
 extern int rxi_FillReadVec(struct rx_call *call, afs_uint32 serial);
 extern int rxi_ReadvProc(struct rx_call *call, struct iovec *iov, int *nio,
 			 int maxio, int nbytes);
@@ -476,6 +486,7 @@ extern int rxi_WriteProc(struct rx_call *call, char *buf,
 extern int rx_WriteProc(struct rx_call *call, char *buf, int nbytes);
 extern int rx_WriteProc32(struct rx_call *call,
 			  afs_int32 * value);
+extern void *rxi_WriteInline(struct rx_call *call, int nbytes);
 extern int rx_WritevAlloc(struct rx_call *call, struct iovec *iov, int *nio,
 			  int maxio, int nbytes);
 extern int rxi_WritevProc(struct rx_call *call, struct iovec *iov, int nio,
@@ -485,6 +496,10 @@ extern int rx_WritevProc(struct rx_call *call, struct iovec *iov, int nio,
 extern void rxi_FlushWrite(struct rx_call *call);
 extern void rxi_FlushWriteLocked(struct rx_call *call);
 extern void rx_FlushWrite(struct rx_call *call);
+extern int rx_WriteBulk(struct rx_call *call, afs_int64 nbytes,
+			rx_bulkproc_t proc, void *rock, afs_int64 *adone);
+extern int rx_ReadBulk(struct rx_call *call, afs_int64 nbytes,
+		       rx_bulkproc_t proc, void *rock, afs_int64 *adone);
 
 
 
@@ -379,6 +379,38 @@ rx_ReadProc32(struct rx_call *call, afs_int32 * value)
     return bytes;
 }
 
+/*
+ * Hand out a pointer to the next nbytes of received data, so that the
+ * caller can unmarshal a fixed-size block in place.  Only succeeds when
+ * the whole block sits, 32-bit aligned, in the current iovec, and there
+ * is data left in the packet after it, so the packet cannot be freed out
+ * from under the caller; otherwise returns NULL and the caller must fall
+ * back to rx_Read.
+ */
+void *
+rxi_ReadInline(struct rx_call *call, int nbytes)
+{
+    char *tcurpos;
+
+    if (!opr_queue_IsEmpty(&call->app.iovq)) {
+#ifdef RXDEBUG_PACKET
+        call->iovqc -=
+#endif /* RXDEBUG_PACKET */
+            rxi_FreePackets(0, &call->app.iovq);
+    }
+
+    tcurpos = call->app.curpos;
+    if (call->error || nbytes <= 0 || call->app.curlen < nbytes
+	|| call->app.nLeft <= nbytes
+	|| ((size_t)tcurpos & (sizeof(afs_int32) - 1)))
+	return NULL;
+
+    call->app.curpos = tcurpos + nbytes;
+    call->app.curlen -= nbytes;
+    call->app.nLeft -= nbytes;
+    return tcurpos;
+}
+
 /* rxi_FillReadVec
  *
  * Uses packets in the receive queue to fill in as much of the
@@ -860,6 +892,36 @@ rx_WriteProc32(struct rx_call *call, afs_int32 * value)
     return bytes;
 }
 
+/*
+ * Hand out a pointer to room for the next nbytes of data to send, so that
+ * the caller can marshal a fixed-size block in place.  Only succeeds when
+ * the block fits, 32-bit aligned, in the current iovec; otherwise returns
+ * NULL and the caller must fall back to rx_Write.
+ */
+void *
+rxi_WriteInline(struct rx_call *call, int nbytes)
+{
+    char *tcurpos;
+
+    if (!opr_queue_IsEmpty(&call->app.iovq)) {
+#ifdef RXDEBUG_PACKET
+        call->iovqc -=
+#endif /* RXDEBUG_PACKET */
+            rxi_FreePackets(0, &call->app.iovq);
+    }
+
+    tcurpos = call->app.curpos;
+    if (call->error || nbytes <= 0 || call->app.curlen < nbytes
+	|| call->app.nFree < nbytes
+	|| ((size_t)tcurpos & (sizeof(afs_int32) - 1)))
+	return NULL;
+
+    call->app.curpos = tcurpos + nbytes;
+    call->app.curlen = (u_short)(call->app.curlen - nbytes);
+    call->app.nFree = (u_short)(call->app.nFree - nbytes);
+    return tcurpos;
+}
+
 /* rxi_WritevAlloc -- internal version.
  *
  * Fill in an iovec to point to data in packet buffers. The application
@@ -1063,23 +1125,28 @@ rxi_WritevProc(struct rx_call *call, struct iovec *iov, int nio, int nbytes)
     tmpqc = 0;
 #endif /* RXDEBUG_PACKET */
     do {
-	if (call->app.nFree == 0 && call->app.currentPacket) {
-	    clock_NewTime();	/* Bogus:  need new time package */
-	    /* The 0, below, specifies that it is not the last packet:
-	     * there will be others. PrepareSendPacket may
-	     * alter the packet length by up to
-	     * conn->securityMaxTrailerSize */
-	    call->app.bytesSent += call->app.currentPacket->length;
-	    rxi_PrepareSendPacket(call, call->app.currentPacket, 0);
-            /* PrepareSendPacket drops the call lock */
-            rxi_WaitforTQBusy(call);
-	    opr_queue_Append(&tmpq, &call->app.currentPacket->entry);
+	if (call->app.nFree == 0) {
+	    if (call->app.currentPacket) {
+		clock_NewTime();	/* Bogus:  need new time package */
+		/* The 0, below, specifies that it is not the last packet:
+		 * there will be others. PrepareSendPacket may
+		 * alter the packet length by up to
+		 * conn->securityMaxTrailerSize */
+		call->app.bytesSent += call->app.currentPacket->length;
+		rxi_PrepareSendPacket(call, call->app.currentPacket, 0);
+		/* PrepareSendPacket drops the call lock */
+		rxi_WaitforTQBusy(call);
+		opr_queue_Append(&tmpq, &call->app.currentPacket->entry);
 #ifdef RXDEBUG_PACKET
-            tmpqc++;
+		tmpqc++;
 #endif /* RXDEBUG_PACKET */
-            call->app.currentPacket = NULL;
+		call->app.currentPacket = NULL;
+	    }
 
-	    /* The head of the iovq is now the current packet */
+	    /* The head of the iovq is now the current packet. If nothing
+	     * has been written on the call yet, there was no current packet
+	     * to begin with, and the first one rxi_WritevAlloc set up is
+	     * still at the head of the iovq. */
 	    if (nbytes) {
 		if (opr_queue_IsEmpty(&call->app.iovq)) {
                     MUTEX_EXIT(&call->lock);
@@ -1334,3 +1401,99 @@ rx_FlushWrite(struct rx_call *call)
     FlushWrite(call, 0);
     USERPRI;
 }
+
+/* Bulk transfers.
+ *
+ * These move a known number of bytes over a call without the caller having
+ * to run its own copy loop. The caller's proc is handed iovecs which point
+ * straight into the call's packet buffers: when sending, it must fill all
+ * nbytes of them; when receiving, it must consume all nbytes of them. Rx
+ * paces the transfer with the call's flow control window, just as for
+ * rx_Writev and rx_Readv.
+ */
+
+static int
+BulkCallError(struct rx_call *call)
+{
+    int code = rx_Error(call);
+
+    return code ? code : RX_PROTOCOL_ERROR;
+}
+
+/**
+ * Send data produced by a callback over a call.
+ *
+ * @param[in] call    the call to send on
+ * @param[in] nbytes  the number of bytes to send
+ * @param[in] proc    fills the iovecs it is given; returns 0, or an error
+ *                    code to stop the transfer
+ * @param[in] rock    passed to proc
+ * @param[out] adone  if not NULL, the number of bytes handed to Rx
+ *
+ * @return 0 on success; the error returned by proc, if it fails; or the
+ *         call's error (RX_PROTOCOL_ERROR if there is none) if Rx could not
+ *         send everything
+ */
+int
+rx_WriteBulk(struct rx_call *call, afs_int64 nbytes, rx_bulkproc_t proc,
+	     void *rock, afs_int64 *adone)
+{
+    struct iovec iov[RX_MAXIOVECS];
+    int nio, len, code;
+
+    if (adone != NULL)
+	*adone = 0;
+    while (nbytes > 0) {
+	len = rx_WritevAlloc(call, iov, &nio, RX_MAXIOVECS,
+			     (int)MIN(nbytes, MAX_AFS_INT32));
+	if (len <= 0)
+	    return BulkCallError(call);
+	code = (*proc)(rock, iov, nio, len);
+	if (code)
+	    return code;
+	if (rx_Writev(call, iov, nio, len) != len)
+	    return BulkCallError(call);
+	if (adone != NULL)
+	    *adone += len;
+	nbytes -= len;
+    }
+    return 0;
+}
+
+/**
+ * Receive data from a call and hand it to a callback.
+ *
+ * @param[in] call    the call to receive from
+ * @param[in] nbytes  the number of bytes to receive
+ * @param[in] proc    consumes the iovecs it is given; returns 0, or an
+ *                    error code to stop the transfer
+ * @param[in] rock    passed to proc
+ * @param[out] adone  if not NULL, the number of bytes received from Rx
+ *
+ * @return 0 on success; the error returned by proc, if it fails; or the
+ *         call's error (RX_PROTOCOL_ERROR if there is none, because the
+ *         peer sent too little) if Rx could not receive everything
+ */
+int
+rx_ReadBulk(struct rx_call *call, afs_int64 nbytes, rx_bulkproc_t proc,
+	    void *rock, afs_int64 *adone)
+{
+    struct iovec iov[RX_MAXIOVECS];
+    int nio, len, code;
+
+    if (adone != NULL)
+	*adone = 0;
+    while (nbytes > 0) {
+	len = rx_Readv(call, iov, &nio, RX_MAXIOVECS,
+		       (int)MIN(nbytes, MAX_AFS_INT32));
+	if (len <= 0)
+	    return BulkCallError(call);
+	if (adone != NULL)
+	    *adone += len;
+	code = (*proc)(rock, iov, nio, len);
+	if (code)
+	    return code;
+	nbytes -= len;
+    }
+    return 0;
+}
@@ -399,7 +399,10 @@ rx_GetIFInfo(void)
                            myNetMasks, myNetMTUs, myNetFlags);
 
     for (i = 0; i < rxi_numNetAddrs; i++) {
-        rxsize = rxi_AdjustIfMTU(myNetMTUs[i] - RX_IPUDP_SIZE);
+        rxsize = myNetMTUs[i] - RX_IPUDP_SIZE;
+        if (!rx_IsLoopbackAddr(rxi_NetAddrs[i]) && (int)rxsize > rxi_maxIfMTU)
+            rxi_maxIfMTU = rxsize;
+        rxsize = rxi_AdjustIfMTU(rxsize);
         maxsize =
             rxi_nRecvFrags * rxsize + (rxi_nRecvFrags - 1) * UDP_HDR_SIZE;
         maxsize = rxi_AdjustMaxMTU(rxsize, maxsize);
@@ -641,6 +644,8 @@ rx_GetIFInfo(void)
 	    maxsize =
 		rxi_nRecvFrags * (myNetMTUs[rxi_numNetAddrs] - RX_IP_SIZE);
 	    maxsize -= UDP_HDR_SIZE;	/* only the first frag has a UDP hdr */
+	    if (myNetMTUs[rxi_numNetAddrs] - RX_IPUDP_SIZE > rxi_maxIfMTU)
+		rxi_maxIfMTU = myNetMTUs[rxi_numNetAddrs] - RX_IPUDP_SIZE;
 	    if (rx_maxReceiveSize < maxsize)
 		rx_maxReceiveSize = MIN(RX_MAX_PACKET_SIZE, maxsize);
 	    ++rxi_numNetAddrs;
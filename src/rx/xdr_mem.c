@@ -171,7 +171,8 @@ xdrmem_inline(XDR *xdrs, u_int len)
 {
     afs_int32 *buf = 0;
 
-    if (xdrs->x_handy >= len) {
+    if (xdrs->x_handy >= len
+	&& !((size_t)xdrs->x_private & (BYTES_PER_XDR_UNIT - 1))) {
 	xdrs->x_handy -= len;
 	buf = (afs_int32 *) xdrs->x_private;
 	xdrs->x_private += len;
@@ -226,6 +226,18 @@ xdrrx_putbytes(XDR *axdrs, caddr_t addr, u_int len)
 static afs_int32 *
 xdrrx_inline(XDR *axdrs, u_int len)
 {
-    /* I don't know what this routine is supposed to do, but the stdio module returns null, so we will, too */
-    return (0);
+    XDR * xdrs = (XDR *)axdrs;
+    struct rx_call *call = ((struct rx_call *)(xdrs)->x_private);
+
+    /*
+     * Point the caller straight at the packet data when the whole block
+     * is contiguous, so the IXDR_ macros can marshal it without a call
+     * per word.  Returning NULL makes the caller fall back to the
+     * ordinary per-field routines.
+     */
+    if (xdrs->x_op == XDR_DECODE)
+	return rxi_ReadInline(call, len);
+    if (xdrs->x_op == XDR_ENCODE)
+	return rxi_WriteInline(call, len);
+    return NULL;
 }
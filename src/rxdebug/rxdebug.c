@@ -21,6 +21,8 @@
 #include <rx/rx_queue.h>
 #include <rx/rx.h>
 #include <rx/rx_globals.h>
+#include <rx/rx_null.h>
+#include <rx/rxstat.h>
 
 #ifdef ENABLE_RXGK
 # include <rx/rxgk.h>
@@ -55,6 +57,111 @@ PortName(char *aname)
     return ts->s_port;		/* returns it in network byte order */
 }
 
+/*
+ * Format the upper bound of an execution time histogram bucket.
+ */
+static void
+BucketTime(char *buf, size_t len, int bucket, int nbuckets)
+{
+    double usec = (double)((afs_uint64)1 << bucket);
+
+    if (bucket == nbuckets - 1)
+	snprintf(buf, len, "slower");
+    else if (usec < 1000)
+	snprintf(buf, len, "%.0fus", usec);
+    else if (usec < 1000000)
+	snprintf(buf, len, "%.1fms", usec / 1000);
+    else
+	snprintf(buf, len, "%.1fs", usec / 1000000);
+}
+
+/*
+ * Fetch the execution time histograms from the server's rxstat service,
+ * and print percentiles for each function that has been called.  Each
+ * percentile is the upper bound of the histogram bucket it falls in.
+ */
+static void
+ShowRPCHistograms(afs_uint32 host, short port)
+{
+    static const int pcts[] = { 50, 90, 99 };
+    struct rx_securityClass *sc;
+    struct rx_connection *conn;
+    afs_uint32 version, clock_sec, clock_usec, count, i, nbuckets;
+    afs_int32 on, code;
+    afs_uint64 calls, sum, bucket[64];
+    rpcStats stats;
+    afs_uint32 *ptr;
+    char buf[3][16];
+    int b, p;
+
+    code = rx_Init(0);
+    if (code) {
+	printf("rxdebug: rx_Init failed with code %d\n", code);
+	exit(1);
+    }
+    sc = rxnull_NewClientSecurityObject();
+    conn = rx_NewConnection(host, port, RX_STATS_SERVICE_ID, sc,
+			    RX_SECIDX_NULL);
+
+    code = RXSTATS_QueryProcessRPCStats(conn, &on);
+    if (code) {
+	printf("rxdebug: can't query RPC statistics; code %d\n", code);
+	exit(1);
+    }
+    if (!on) {
+	printf("Process RPC statistics are not enabled\n");
+	exit(0);
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    code = RXSTATS_RetrieveProcessRPCHistograms(conn,
+						RX_STATS_RETRIEVAL_VERSION,
+						&version, &clock_sec,
+						&clock_usec, &count, &stats);
+    if (code == RXGEN_OPCODE) {
+	printf("Server does not keep RPC execution time histograms\n");
+	exit(1);
+    } else if (code) {
+	printf("rxdebug: can't retrieve RPC histograms; code %d\n", code);
+	exit(1);
+    }
+
+    printf("%10s %6s %5s %12s %8s %8s %8s\n", "interface", "role", "func",
+	   "calls", "p50", "p90", "p99");
+    ptr = stats.rpcStats_val;
+    for (i = 0; i < count; i++) {
+	if (ptr + 5 > stats.rpcStats_val + stats.rpcStats_len)
+	    break;
+	nbuckets = ptr[4];
+	if (nbuckets > sizeof(bucket) / sizeof(bucket[0])
+	    || ptr + 5 + 2 * nbuckets > stats.rpcStats_val + stats.rpcStats_len)
+	    break;
+	calls = 0;
+	for (b = 0; b < nbuckets; b++) {
+	    bucket[b] = ((afs_uint64)ptr[5 + 2 * b] << 32) | ptr[6 + 2 * b];
+	    calls += bucket[b];
+	}
+	if (calls > 0) {
+	    for (p = 0; p < sizeof(pcts) / sizeof(pcts[0]); p++) {
+		sum = 0;
+		for (b = 0; b < nbuckets - 1; b++) {
+		    sum += bucket[b];
+		    if (sum * 100 >= calls * pcts[p])
+			break;
+		}
+		BucketTime(buf[p], sizeof(buf[p]), b, nbuckets);
+	    }
+	    printf("%10u %6s %5u %12llu %8s %8s %8s\n", ptr[0],
+		   ptr[1] ? "client" : "server", ptr[3],
+		   (unsigned long long)calls, buf[0], buf[1], buf[2]);
+	}
+	ptr += 5 + 2 * nbuckets;
+    }
+    free(stats.rpcStats_val);
+    rx_DestroyConnection(conn);
+    rx_Finalize();
+}
+
 int
 MainCommand(struct cmd_syndesc *as, void *arock)
 {
@@ -84,6 +191,8 @@ MainCommand(struct cmd_syndesc *as, void *arock)
     int withWaited;
     int withPeers;
     int withPackets;
+    int withDispatch;
+    int withPmtu;
     struct rx_debugStats tstats;
     char *portName, *hostName;
     char hoststr[20];
@@ -92,6 +201,7 @@ MainCommand(struct cmd_syndesc *as, void *arock)
     short showPeers;
     short showLong;
     int version_flag;
+    int rpcHist;
     char version[64];
     afs_int32 length = 64;
 
@@ -111,6 +221,7 @@ MainCommand(struct cmd_syndesc *as, void *arock)
     noConns = (as->parms[11].items ? 1 : 0);
     showPeers = (as->parms[12].items ? 1 : 0);
     showLong = (as->parms[13].items ? 1 : 0);
+    rpcHist = (as->parms[14].items ? 1 : 0);
 
     if (as->parms[0].items)
 	hostName = as->parms[0].items->data;
@@ -220,6 +331,11 @@ MainCommand(struct cmd_syndesc *as, void *arock)
 	exit(1);
     }
 
+    if (rpcHist) {
+	ShowRPCHistograms(host, port);
+	exit(0);
+    }
+
     if (version_flag) {
         memset(version, 0, sizeof(version));
 
@@ -252,6 +368,8 @@ MainCommand(struct cmd_syndesc *as, void *arock)
     withWaited = (supportedDebugValues & RX_SERVER_DEBUG_WAITED_CNT);
     withPeers = (supportedDebugValues & RX_SERVER_DEBUG_ALL_PEER);
     withPackets = (supportedDebugValues & RX_SERVER_DEBUG_PACKETS_CNT);
+    withDispatch = (supportedDebugValues & RX_SERVER_DEBUG_DISPATCH);
+    withPmtu = (supportedDebugValues & RX_SERVER_DEBUG_PMTU);
 
     if (withPackets)
         printf("Free packets: %d/%d, packet reclaims: %d, calls: %d, used FDs: %d\n",
@@ -270,6 +388,10 @@ MainCommand(struct cmd_syndesc *as, void *arock)
 	printf("%d threads are idle\n", tstats.idleThreads);
     if (withWaited)
 	printf("%d calls have waited for a thread\n", tstats.nWaited);
+    if (withDispatch)
+	printf("%u calls dispatched to threads, waiting %u usec on average, "
+	       "%u usec at most\n", tstats.nDispatched,
+	       tstats.dispatchWaitMean, tstats.dispatchWaitMax);
 
     if (rxstats) {
 	if (!withRxStats) {
@@ -627,6 +749,13 @@ MainCommand(struct cmd_syndesc *as, void *arock)
 	    printf("\tcurrent/if/max jumbogram size: %d/%d/%d\n",
 		   tpeer.nDgramPackets, tpeer.ifDgramPackets,
 		   tpeer.maxDgramPackets);
+	    if (withPmtu) {
+		printf("\tlargest packet acked %d, path MTU search bound %d\n",
+		       tpeer.maxPacketSize, tpeer.pmtuHigh);
+		printf("\tpath MTU probes sent %u, lost %u, last search "
+		       "converged in %u msec\n", tpeer.pmtuProbes,
+		       tpeer.pmtuProbesLost, tpeer.pmtuConvergeTime);
+	    }
 	}
     }
     exit(0);
@@ -676,6 +805,8 @@ main(int argc, char **argv)
 		"show no connections");
     cmd_AddParm(ts, "-peers", CMD_FLAG, CMD_OPTIONAL, "show peers");
     cmd_AddParm(ts, "-long", CMD_FLAG, CMD_OPTIONAL, "detailed output");
+    cmd_AddParm(ts, "-rpchistograms", CMD_FLAG, CMD_OPTIONAL,
+		"show RPC execution time percentiles");
 
     cmd_Dispatch(argc, argv);
     exit(0);
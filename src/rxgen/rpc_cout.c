@@ -37,6 +37,8 @@
 
 #include <roken.h>
 
+#include <ctype.h>
+
 #include "rpc_scan.h"
 #include "rpc_parse.h"
 #include "rpc_util.h"
@@ -64,6 +66,15 @@ static void print_cout(declaration * dec);
 static void print_rxifopen(char *typename);
 static void print_rxifarg(char *amp, char *arg, int costant);
 static void print_rxifsizeof(char *prefix, char *type);
+static definition *find_typedef(char *type);
+static struct inline_type *find_inline_type(char *type);
+static definition *find_flat_struct(char *type);
+static long flat_vector_len(char *amax);
+static long flat_decl_words(declaration * dec, int *depth);
+static long flat_struct_words(definition * def, int *depth);
+static void print_inline_decls(definition * def, char *obj, int depth,
+			       int decode);
+static int emit_inline(definition * def);
 
 
 /*
@@ -386,11 +397,250 @@ emit_union(definition * def)
 
 
 
+/*
+ * Fixed-layout structs.
+ *
+ * A struct made up only of integers that XDR encodes as one 32-bit unit
+ * each, fixed-size vectors of them, and other structs of the same kind
+ * always takes the same number of bytes on the wire.  For those we emit
+ * a fast path that asks the stream for the whole block with XDR_INLINE
+ * and converts it with the IXDR_ macros, rather than calling through the
+ * stream ops once per field.  When the stream can't hand out the block
+ * (it straddles a packet boundary, say, or the stream doesn't support
+ * inlining), the ordinary per-field code that follows it runs instead.
+ */
+struct inline_type {
+    char *type;
+    char *get;
+    char *put;
+};
+
+static struct inline_type inline_types[] = {
+    {"char", "(char)IXDR_GET_INT32", "IXDR_PUT_INT32"},
+    {"u_char", "(u_char)IXDR_GET_U_INT32", "IXDR_PUT_U_INT32"},
+    {"short", "IXDR_GET_SHORT", "IXDR_PUT_SHORT"},
+    {"u_short", "IXDR_GET_U_SHORT", "IXDR_PUT_U_SHORT"},
+    {"int", "IXDR_GET_INT32", "IXDR_PUT_INT32"},
+    {"u_int", "IXDR_GET_U_INT32", "IXDR_PUT_U_INT32"},
+    {"afs_int32", "IXDR_GET_INT32", "IXDR_PUT_INT32"},
+    {"afs_uint32", "IXDR_GET_U_INT32", "IXDR_PUT_U_INT32"},
+    {"bool", "IXDR_GET_BOOL", "IXDR_PUT_BOOL"},
+    {NULL, NULL, NULL}
+};
+
+/* Don't bother inlining structs any bigger than this many units */
+#define MAX_INLINE_WORDS 1024
+
+/* Deepest nesting of vectors we will write loops for */
+#define MAX_INLINE_DEPTH 4
+
+static int
+findconst(definition * def, char *name)
+{
+    return (def->def_kind == DEF_CONST && streq(def->def_name, name));
+}
+
+static definition *
+find_typedef(char *type)
+{
+    return (definition *) FINDVAL(defined, type, findtype);
+}
+
+static struct inline_type *
+find_inline_type(char *type)
+{
+    struct inline_type *it;
+    definition *def;
+
+    for (;;) {
+	for (it = inline_types; it->type != NULL; it++) {
+	    if (streq(it->type, type))
+		return it;
+	}
+	def = find_typedef(type);
+	if (def == NULL || def->def_kind != DEF_TYPEDEF
+	    || def->def.ty.rel != REL_ALIAS)
+	    return NULL;
+	type = def->def.ty.old_type;
+    }
+}
+
+static definition *
+find_flat_struct(char *type)
+{
+    definition *def;
+    int depth;
+
+    for (;;) {
+	def = find_typedef(type);
+	if (def == NULL)
+	    return NULL;
+	if (def->def_kind == DEF_STRUCT)
+	    break;
+	if (def->def_kind != DEF_TYPEDEF || def->def.ty.rel != REL_ALIAS)
+	    return NULL;
+	type = def->def.ty.old_type;
+    }
+    if (flat_struct_words(def, &depth) < 0)
+	return NULL;
+    return def;
+}
+
+/* The element count of a fixed vector, if we can tell it at compile time */
+static long
+flat_vector_len(char *amax)
+{
+    definition *def;
+    char *end;
+    long n;
+
+    while (!isdigit((unsigned char)*amax)) {
+	def = (definition *) FINDVAL(defined, amax, findconst);
+	if (def == NULL)
+	    return -1;
+	amax = def->def.co;
+    }
+    n = strtol(amax, &end, 0);
+    if (*end != '\0' || n <= 0)
+	return -1;
+    return n;
+}
+
+/*
+ * Return the number of XDR units taken by a struct member, or -1 if it
+ * can't be inlined.  *depth is set to the number of nested loops needed
+ * to marshal it.
+ */
+static long
+flat_decl_words(declaration * dec, int *depth)
+{
+    definition *sub;
+    long words, n;
+
+    *depth = 0;
+    if (dec->rel != REL_ALIAS && dec->rel != REL_VECTOR)
+	return -1;
+    if (find_inline_type(dec->type)) {
+	words = 1;
+    } else if ((sub = find_flat_struct(dec->type)) != NULL) {
+	words = flat_struct_words(sub, depth);
+    } else {
+	return -1;
+    }
+    if (dec->rel == REL_VECTOR) {
+	n = flat_vector_len(dec->array_max);
+	if (n < 0 || ++*depth > MAX_INLINE_DEPTH)
+	    return -1;
+	words *= n;
+    }
+    if (words > MAX_INLINE_WORDS)
+	return -1;
+    return words;
+}
+
+static long
+flat_struct_words(definition * def, int *depth)
+{
+    decl_list *dl;
+    long words = 0, n;
+    int d;
+
+    *depth = 0;
+    for (dl = def->def.st.decls; dl != NULL; dl = dl->next) {
+	n = flat_decl_words(&dl->decl, &d);
+	if (n < 0)
+	    return -1;
+	words += n;
+	if (words > MAX_INLINE_WORDS)
+	    return -1;
+	if (d > *depth)
+	    *depth = d;
+    }
+    return words;
+}
+
+static void
+print_inline_decls(definition * def, char *obj, int depth, int decode)
+{
+    decl_list *dl;
+    declaration *dec;
+    struct inline_type *it;
+    char name[256];
+    int indent = 3 + depth;
+
+    for (dl = def->def.st.decls; dl != NULL; dl = dl->next) {
+	dec = &dl->decl;
+	if (dec->rel == REL_VECTOR) {
+	    tabify(fout, indent);
+	    f_print(fout, "for (__i%d = 0; __i%d < %s; __i%d++) {\n", depth,
+		    depth, dec->array_max, depth);
+	    s_print(name, "%s%s[__i%d]", obj, dec->name, depth);
+	    indent++;
+	} else {
+	    s_print(name, "%s%s", obj, dec->name);
+	}
+	it = find_inline_type(dec->type);
+	if (it == NULL) {
+	    strcat(name, ".");
+	    print_inline_decls(find_flat_struct(dec->type), name,
+			       depth + (dec->rel == REL_VECTOR), decode);
+	} else {
+	    tabify(fout, indent);
+	    if (decode) {
+		f_print(fout, "%s = %s(buf);\n", name, it->get);
+	    } else {
+		f_print(fout, "%s(buf, %s);\n", it->put, name);
+	    }
+	}
+	if (dec->rel == REL_VECTOR) {
+	    indent--;
+	    tabify(fout, indent);
+	    f_print(fout, "}\n");
+	}
+    }
+}
+
+/*
+ * Emit the inline fast path for a fixed-layout struct; return 0 if the
+ * struct doesn't qualify.
+ */
+static int
+emit_inline(definition * def)
+{
+    long words;
+    int depth, i, decode;
+
+    if (noinline_flag)
+	return 0;
+    words = flat_struct_words(def, &depth);
+    if (words <= 0)
+	return 0;
+
+    f_print(fout, "\tafs_int32 *buf;\n");
+    for (i = 0; i < depth; i++)
+	f_print(fout, "\tu_int __i%d;\n", i);
+    f_print(fout, "\n");
+    for (decode = 0; decode < 2; decode++) {
+	f_print(fout, decode ? " else if (xdrs->x_op == XDR_DECODE) {\n"
+			     : "\tif (xdrs->x_op == XDR_ENCODE) {\n");
+	f_print(fout, "\t\tbuf = XDR_INLINE(xdrs, %ld * BYTES_PER_XDR_UNIT);\n",
+		words);
+	f_print(fout, "\t\tif (buf != NULL) {\n");
+	print_inline_decls(def, "objp->", 0, decode);
+	f_print(fout, "\t\t\treturn (TRUE);\n");
+	f_print(fout, "\t\t}\n");
+	f_print(fout, "\t}");
+    }
+    f_print(fout, "\n");
+    return 1;
+}
+
 static void
 emit_struct(definition * def)
 {
     decl_list *dl;
 
+    emit_inline(def);
     for (dl = def->def.st.decls; dl != NULL; dl = dl->next) {
 	print_stat(&dl->decl);
     }
@@ -78,6 +78,7 @@ char brief_flag = 0;		/* If set, shorten names */
 char zflag = 0;			/* If set, abort server stub if rpc call returns non-zero */
 char xflag = 0;			/* if set, add stats code to stubs */
 char yflag = 0;			/* if set, only emit function name arrays to xdr file */
+char noinline_flag = 0;		/* if set, don't inline fixed-layout structs */
 int debug = 0;
 static int pclose_fin = 0;
 static char *cmdname;
@@ -152,7 +153,7 @@ main(int argc, char *argv[])
     if (!parseargs(argc, argv, &cmd)) {
 	f_print(stderr, "usage: %s infile\n", cmdname);
 	f_print(stderr,
-		"       %s [-c | -h | -C | -S | -r | -b | -k | -p | -d | -z | -u] [-Pprefix] [-Idir] [-o outfile] [infile]\n",
+		"       %s [-c | -h | -C | -S | -r | -b | -k | -p | -d | -z | -u | -n] [-Pprefix] [-Idir] [-o outfile] [infile]\n",
 		cmdname);
 	f_print(stderr, "       %s [-o outfile] [infile]\n",
 		cmdname);
@@ -737,6 +738,7 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
 		case 'x':
 		case 'y':
 		case 'z':
+		case 'n':
 		    if (flag[(int)c]) {
 			return (0);
 		    }
@@ -791,6 +793,7 @@ parseargs(int argc, char *argv[], struct commandline *cmd)
     cmd->pflag = flag['p'];
     cmd->dflag = debug = flag['d'];
     zflag = flag['z'];
+    noinline_flag = flag['n'];
     if (cmd->pflag)
 	combinepackages = 1;
     nflags =
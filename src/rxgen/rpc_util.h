@@ -62,6 +62,7 @@ extern char brief_flag;
 extern char zflag;
 extern char xflag;
 extern char yflag;
+extern char noinline_flag;
 extern int debug;
 
 
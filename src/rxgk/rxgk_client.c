@@ -115,6 +115,7 @@ rxgk_NewClientConnection(struct rx_securityClass *aobj,
      * class in each packet. */
     if (rxgk_security_overhead(aconn, cp->level, cp->k0) != 0)
 	goto error;
+    rxgk_tkcache_init(&cc->tkcache);
     rx_SetSecurityData(aconn, cc);
     obj_ref(aobj);
     return 0;
@@ -150,8 +151,8 @@ rxgk_ClientPreparePacket(struct rx_securityClass *aobj, struct rx_call *acall,
     if (cp->level == RXGK_LEVEL_CLEAR)
         return 0;
 
-    ret = rxgk_derive_tk(&tk, cp->k0, rx_GetConnectionEpoch(aconn),
-			 rx_GetConnectionId(aconn), cc->start_time, lkvno);
+    ret = rxgk_tkcache_get(&cc->tkcache, &tk, cp->k0, aconn, cc->start_time,
+			   lkvno);
     if (ret != 0)
 	return ret;
 
@@ -406,7 +407,7 @@ rxgk_ClientCheckPacket(struct rx_securityClass *aobj, struct rx_call *acall,
 
     lkvno = kvno = cc->key_number;
     ret = rxgk_check_packet(0, aconn, apacket, cp->level, cc->start_time,
-                            &kvno, cp->k0);
+                            &kvno, cp->k0, &cc->tkcache);
     if (ret != 0)
 	return ret;
 
@@ -428,6 +429,7 @@ rxgk_DestroyClientConnection(struct rx_securityClass *aobj,
     }
     rx_SetSecurityData(aconn, NULL);
 
+    rxgk_tkcache_destroy(&cc->tkcache);
     rxi_Free(cc, sizeof(*cc));
     obj_rele(aobj);
 }
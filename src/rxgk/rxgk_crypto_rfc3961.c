@@ -55,6 +55,7 @@
 #endif
 
 #include <rx/rx.h>
+#include <rx/rx_atomic.h>
 #include <rx/rxgk.h>
 #include <afs/rfc3961.h>
 #include <afs/opr.h>
@@ -72,6 +73,16 @@ struct rxgk_keyblock {
      * threads at the same time. */
     krb5_context init_ctx;
     krb5_keyblock key;
+
+    /* Number of references to this key; see rxgk_hold_key. */
+    rx_atomic_t refcount;
+
+    /* The krb5_crypto for this key, set up on first use.  It holds the key
+     * schedules and derived keys for each key usage it has seen, so using it
+     * again saves redoing that work for every operation, but only one thread
+     * may use it at a time.  Use lock_crypto() to get at it. */
+    afs_kmutex_t crypto_lock;
+    krb5_crypto crypto;
 };
 
 struct rxgk_key_s {
@@ -95,6 +106,42 @@ keyblock2key(struct rxgk_keyblock *keyblock)
     return (rxgk_key)keyblock;
 }
 
+/**
+ * Get the krb5_crypto for a key, creating it if need be.
+ *
+ * On success the key's crypto_lock is held, and the caller must release it
+ * with unlock_crypto when done with the krb5_crypto.
+ *
+ * @param[in] keyblock	The key to use.
+ * @param[out] crypto	The krb5_crypto for the key.
+ * @return krb5 error codes.
+ */
+static krb5_error_code
+lock_crypto(struct rxgk_keyblock *keyblock, krb5_crypto *crypto)
+{
+    krb5_error_code ret = 0;
+
+    MUTEX_ENTER(&keyblock->crypto_lock);
+    if (keyblock->crypto == NULL) {
+	ret = krb5_crypto_init(keyblock->init_ctx, &keyblock->key,
+			       deref_keyblock_enctype(&keyblock->key),
+			       &keyblock->crypto);
+	if (ret != 0) {
+	    keyblock->crypto = NULL;
+	    MUTEX_EXIT(&keyblock->crypto_lock);
+	    return ret;
+	}
+    }
+    *crypto = keyblock->crypto;
+    return 0;
+}
+
+static_inline void
+unlock_crypto(struct rxgk_keyblock *keyblock)
+{
+    MUTEX_EXIT(&keyblock->crypto_lock);
+}
+
 /**
  * Convert krb5 error code to RXGK error code.  Don't let the krb5 codes escape.
  */
@@ -229,6 +276,8 @@ rxgk_make_key(rxgk_key *key_out, void *raw_key, afs_uint32 length,
     }
     if (ret != 0)
 	goto done;
+    rx_atomic_set(&new_key->refcount, 1);
+    MUTEX_INIT(&new_key->crypto_lock, "rxgk key", MUTEX_DEFAULT, 0);
     *key_out = keyblock2key(new_key);
  done:
     if (ret != 0 && new_key != NULL) {
@@ -297,11 +346,24 @@ rxgk_random_key(afs_int32 *enctype, rxgk_key *key_out)
     return ret;
 }
 
+/**
+ * Take another reference to an rxgk key
+ *
+ * Each reference must be dropped with rxgk_release_key; the key is only
+ * freed when the last one is.
+ */
+void
+rxgk_hold_key(rxgk_key key)
+{
+    rx_atomic_inc(&key2keyblock(key)->refcount);
+}
+
 /**
  * Release the storage underlying an rxgk key
  *
- * Call into the underlying library to release any storage allocated for
- * the rxgk_key, and null out the key pointer.
+ * Drop a reference to the rxgk_key, and null out the key pointer.  If that
+ * was the last reference, call into the underlying library to release any
+ * storage allocated for the key.
  */
 void
 rxgk_release_key(rxgk_key *key)
@@ -311,13 +373,18 @@ rxgk_release_key(rxgk_key *key)
     if (*key == NULL)
 	return;
     keyblock = key2keyblock(*key);
+    *key = NULL;
+    if (rx_atomic_dec_and_read(&keyblock->refcount) > 0)
+	return;
 
+    if (keyblock->crypto != NULL)
+	krb5_crypto_destroy(keyblock->init_ctx, keyblock->crypto);
+    MUTEX_DESTROY(&keyblock->crypto_lock);
     krb5_free_keyblock_contents(keyblock->init_ctx, &keyblock->key);
     if (keyblock->init_ctx != NULL) {
         krb5_free_context(keyblock->init_ctx);
     }
     rxi_Free(keyblock, sizeof(*keyblock));
-    *key = NULL;
 }
 
 /**
@@ -407,7 +474,7 @@ rxgk_mic_in_key(rxgk_key key, afs_int32 usage, RXGK_Data *in,
     ret = krb5_checksumsize(ctx, cstype, &len);
     if (ret != 0)
 	goto done;
-    ret = krb5_crypto_init(ctx, &keyblock->key, enctype, &crypto);
+    ret = lock_crypto(keyblock, &crypto);
     if (ret != 0)
 	goto done;
     ret = krb5_create_checksum(ctx, crypto, usage, cstype, in->val,
@@ -424,7 +491,7 @@ rxgk_mic_in_key(rxgk_key key, afs_int32 usage, RXGK_Data *in,
  done:
     free_Checksum(&cksum);
     if (crypto != NULL)
-	krb5_crypto_destroy(ctx, crypto);
+	unlock_crypto(keyblock);
     if (ctx != NULL) {
         krb5_free_context(ctx);
     }
@@ -464,7 +531,7 @@ rxgk_check_mic_in_key(rxgk_key key, afs_int32 usage, RXGK_Data *in,
 
     enctype = deref_keyblock_enctype(&keyblock->key);
     cksum.cksumtype = etoc(enctype);
-    ret = krb5_crypto_init(ctx, &keyblock->key, enctype, &crypto);
+    ret = lock_crypto(keyblock, &crypto);
     if (ret != 0)
 	goto done;
     cksum.checksum.data = mic->val;
@@ -481,13 +548,65 @@ rxgk_check_mic_in_key(rxgk_key key, afs_int32 usage, RXGK_Data *in,
  done:
     free_Checksum(&cksum);
     if (crypto != NULL)
-	krb5_crypto_destroy(ctx, crypto);
+	unlock_crypto(keyblock);
     if (ctx != NULL) {
         krb5_free_context(ctx);
     }
     return ktor(ret);
 }
 
+/*
+ * Encrypt or decrypt inlen bytes at in, leaving the result in out, which the
+ * caller must free with krb5_data_free().
+ */
+static krb5_error_code
+crypt_data(rxgk_key key, afs_int32 usage, int encrypt, void *in, size_t inlen,
+	   krb5_data *out)
+{
+    krb5_context ctx = NULL;
+    krb5_crypto crypto = NULL;
+    krb5_error_code ret;
+    struct rxgk_keyblock *keyblock = key2keyblock(key);
+
+    memset(out, 0, sizeof(*out));
+
+    ret = krb5_init_context(&ctx);
+    if (ret != 0)
+        goto done;
+    ret = lock_crypto(keyblock, &crypto);
+    if (ret != 0)
+	goto done;
+    if (encrypt) {
+	ret = krb5_encrypt(ctx, crypto, usage, in, inlen, out);
+    } else {
+	ret = krb5_decrypt(ctx, crypto, usage, in, inlen, out);
+	if (ret != 0)
+	    ret = RXGK_SEALED_INCON;
+    }
+
+ done:
+    if (crypto != NULL)
+	unlock_crypto(keyblock);
+    if (ctx != NULL) {
+        krb5_free_context(ctx);
+    }
+    return ret;
+}
+
+/*
+ * Copy the result of crypt_data into the caller's buffer, which has room for
+ * *outlen bytes, and set *outlen to the length of the result.
+ */
+static krb5_error_code
+copy_out(krb5_data *data, void *out, size_t *outlen)
+{
+    if (data->length > *outlen)
+	return RXGK_INCONSISTENCY;
+    memcpy(out, data->data, data->length);
+    *outlen = data->length;
+    return 0;
+}
+
 /**
  * Encrypt a buffer in a key using the RFC 3961 framework
  *
@@ -509,36 +628,15 @@ afs_int32
 rxgk_encrypt_in_key(rxgk_key key, afs_int32 usage, RXGK_Data *in,
 		    RXGK_Data *out)
 {
-    krb5_context ctx = NULL;
-    krb5_crypto crypto = NULL;
     krb5_data kd_out;
-    krb5_enctype enctype;
     krb5_error_code ret;
-    struct rxgk_keyblock *keyblock = key2keyblock(key);
 
-    memset(&kd_out, 0, sizeof(kd_out));
     memset(out, 0, sizeof(*out));
 
-    ret = krb5_init_context(&ctx);
-    if (ret != 0)
-        goto done;
-
-    enctype = deref_keyblock_enctype(&keyblock->key);
-    ret = krb5_crypto_init(ctx, &keyblock->key, enctype, &crypto);
-    if (ret != 0)
-	goto done;
-    ret = krb5_encrypt(ctx, crypto, usage, in->val, in->len, &kd_out);
-    if (ret != 0)
-	goto done;
-    ret = rx_opaque_populate(out, kd_out.data, kd_out.length);
-
- done:
-    if (crypto != NULL)
-	krb5_crypto_destroy(ctx, crypto);
+    ret = crypt_data(key, usage, 1, in->val, in->len, &kd_out);
+    if (ret == 0)
+	ret = rx_opaque_populate(out, kd_out.data, kd_out.length);
     krb5_data_free(&kd_out);
-    if (ctx != NULL) {
-        krb5_free_context(ctx);
-    }
     return ktor(ret);
 }
 
@@ -563,38 +661,73 @@ afs_int32
 rxgk_decrypt_in_key(rxgk_key key, afs_int32 usage, RXGK_Data *in,
 		    RXGK_Data *out)
 {
-    krb5_context ctx = NULL;
-    krb5_crypto crypto = NULL;
     krb5_data kd_out;
-    krb5_enctype enctype;
     krb5_error_code ret;
-    struct rxgk_keyblock *keyblock = key2keyblock(key);
 
     memset(out, 0, sizeof(*out));
-    memset(&kd_out, 0, sizeof(kd_out));
 
-    ret = krb5_init_context(&ctx);
-    if (ret != 0)
-        goto done;
+    ret = crypt_data(key, usage, 0, in->val, in->len, &kd_out);
+    if (ret == 0)
+	ret = rx_opaque_populate(out, kd_out.data, kd_out.length);
+    krb5_data_free(&kd_out);
+    return ktor(ret);
+}
 
-    enctype = deref_keyblock_enctype(&keyblock->key);
-    ret = krb5_crypto_init(ctx, &keyblock->key, enctype, &crypto);
-    if (ret != 0)
-	goto done;
-    ret = krb5_decrypt(ctx, crypto, usage, in->val, in->len, &kd_out);
-    if (ret != 0) {
-        ret = RXGK_SEALED_INCON;
-	goto done;
-    }
-    ret = rx_opaque_populate(out, kd_out.data, kd_out.length);
+/**
+ * Encrypt a buffer into caller-supplied storage
+ *
+ * Like rxgk_encrypt_in_key, but the ciphertext is written to out, which
+ * may be the same buffer as in, rather than to newly allocated memory.
+ *
+ * @param[in] key	The key used to encrypt the message.
+ * @param[in] usage	The key usage for the encryption.
+ * @param[in] in	The buffer being encrypted.
+ * @param[in] inlen	The length of in.
+ * @param[out] out	Where to put the encrypted form of the message.
+ * @param[in,out] outlen	On entry, the space available at out; on
+ *				return, the length of the ciphertext.
+ * @return rxgk error codes.
+ */
+afs_int32
+rxgk_encrypt_buf(rxgk_key key, afs_int32 usage, void *in, size_t inlen,
+		 void *out, size_t *outlen)
+{
+    krb5_data kd_out;
+    krb5_error_code ret;
 
- done:
-    if (crypto != NULL)
-	krb5_crypto_destroy(ctx, crypto);
+    ret = crypt_data(key, usage, 1, in, inlen, &kd_out);
+    if (ret == 0)
+	ret = copy_out(&kd_out, out, outlen);
+    krb5_data_free(&kd_out);
+    return ktor(ret);
+}
+
+/**
+ * Decrypt a buffer into caller-supplied storage
+ *
+ * Like rxgk_decrypt_in_key, but the plaintext is written to out, which
+ * may be the same buffer as in, rather than to newly allocated memory.
+ *
+ * @param[in] key	The key to use for the decryption.
+ * @param[in] usage	The key usage used for the encryption.
+ * @param[in] in	The encrypted message.
+ * @param[in] inlen	The length of in.
+ * @param[out] out	Where to put the decrypted message.
+ * @param[in,out] outlen	On entry, the space available at out; on
+ *				return, the length of the plaintext.
+ * @return rxgk error codes.
+ */
+afs_int32
+rxgk_decrypt_buf(rxgk_key key, afs_int32 usage, void *in, size_t inlen,
+		 void *out, size_t *outlen)
+{
+    krb5_data kd_out;
+    krb5_error_code ret;
+
+    ret = crypt_data(key, usage, 0, in, inlen, &kd_out);
+    if (ret == 0)
+	ret = copy_out(&kd_out, out, outlen);
     krb5_data_free(&kd_out);
-    if (ctx != NULL) {
-        krb5_free_context(ctx);
-    }
     return ktor(ret);
 }
 
@@ -623,7 +756,7 @@ PRFplus(krb5_data *out, krb5_enctype enctype, rxgk_key k0,
     if (ret != 0)
         goto done;
 
-    ret = krb5_crypto_init(ctx, &keyblock->key, enctype, &crypto);
+    ret = lock_crypto(keyblock, &crypto);
     if (ret != 0)
 	goto done;
     prf_in.length = sizeof(n_iter) + seed_len;
@@ -658,7 +791,7 @@ PRFplus(krb5_data *out, krb5_enctype enctype, rxgk_key k0,
 
  done:
     if (crypto != NULL)
-	krb5_crypto_destroy(ctx, crypto);
+	unlock_crypto(keyblock);
     krb5_data_free(&prf_out);
     if (ctx != NULL) {
         krb5_free_context(ctx);
@@ -758,18 +891,16 @@ rxgk_cipher_expansion(rxgk_key k0, afs_uint32 *len_out)
 {
     krb5_context ctx = NULL;
     krb5_crypto crypto = NULL;
-    krb5_enctype enctype;
     krb5_error_code ret;
     struct rxgk_keyblock *keyblock = key2keyblock(k0);
     size_t len;
 
     *len_out = 0;
 
-    enctype = deref_keyblock_enctype(&keyblock->key);
     ret = krb5_init_context(&ctx);
     if (ret != 0)
         goto done;
-    ret = krb5_crypto_init(ctx, &keyblock->key, enctype, &crypto);
+    ret = lock_crypto(keyblock, &crypto);
     if (ret != 0)
 	goto done;
     len = krb5_crypto_overhead(ctx, crypto);
@@ -777,7 +908,7 @@ rxgk_cipher_expansion(rxgk_key k0, afs_uint32 *len_out)
 
  done:
     if (crypto != NULL)
-	krb5_crypto_destroy(ctx, crypto);
+	unlock_crypto(keyblock);
     if (ctx != NULL) {
         krb5_free_context(ctx);
     }
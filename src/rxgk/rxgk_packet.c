@@ -145,6 +145,10 @@ rxgk_check_mic_packet(rxgk_key tk, afs_int32 keyusage,
  * Take an encrypted packet and decrypt it with the specified key and
  * key usage.  Put the plaintext back in the packet.
  *
+ * When the packet data is all in its first buffer, as it is for most packets,
+ * it is decrypted where it lies; otherwise it is gathered into a temporary
+ * buffer first.
+ *
  * @param[in] tk	The transport key to use.
  * @param[in] keyusage	The key usage used to encrypt the packet.
  * @param[in] aconn	The rx connection on which the packet was received.
@@ -155,34 +159,40 @@ static int
 rxgk_decrypt_packet(rxgk_key tk, afs_int32 keyusage,
 		    struct rx_connection *aconn, struct rx_packet *apacket)
 {
-    struct rx_opaque plain = RX_EMPTY_OPAQUE, crypt = RX_EMPTY_OPAQUE;
-    struct rxgk_header *header = NULL, *cryptheader;
+    struct rxgk_header header, *cryptheader;
+    void *buf = NULL;
     afs_int32 ret;
-    afs_uint32 len;
+    afs_uint32 len, buflen = 0;
+    size_t plainlen;
 
     len = rx_GetDataSize(apacket);
 
-    if (rx_GetSecurityHeaderSize(aconn) != sizeof(*header)) {
+    if (rx_GetSecurityHeaderSize(aconn) != sizeof(header)) {
         ret = RXGK_INCONSISTENCY;
         goto done;
     }
 
-    header = rxi_Alloc(sizeof(*header));
-    if (header == NULL) {
-	ret = ENOMEM;
-        goto done;
+    if (rx_Contiguous(apacket) >= len) {
+	cryptheader = (struct rxgk_header *)rx_DataOf(apacket);
+    } else {
+	buflen = len;
+	buf = rxi_Alloc(buflen);
+	if (buf == NULL) {
+	    ret = ENOMEM;
+	    goto done;
+	}
+	rx_packetread(apacket, 0, len, buf);
+	cryptheader = buf;
     }
-    ret = rx_opaque_alloc(&crypt, len);
-    if (ret != 0)
-	goto done;
-    rx_packetread(apacket, 0, len, crypt.val);
 
-    /* The actual decryption */
-    ret = rxgk_decrypt_in_key(tk, keyusage, &crypt, &plain);
+    /* The actual decryption; the plaintext is never longer than the input */
+    plainlen = len;
+    ret = rxgk_decrypt_buf(tk, keyusage, cryptheader, len, cryptheader,
+			   &plainlen);
     if (ret != 0)
 	goto done;
 
-    if (plain.len < sizeof(*cryptheader)) {
+    if (plainlen < sizeof(*cryptheader)) {
         /*
 	 * Our decrypted contents must have an rxgk_header at the start. If we
          * don't even have enough bytes for an rxgk_header, something is
@@ -191,54 +201,54 @@ rxgk_decrypt_packet(rxgk_key tk, afs_int32 keyusage,
         ret = RXGK_DATA_LEN;
         goto done;
     }
-    cryptheader = plain.val;
 
     /*
      * cryptheader->length indicates the length of the decrypted plaintext of
      * this packet. We must rely on this value, and we cannot calculate it
-     * ourselves from e.g. plain.len, since the encryption routines may have
+     * ourselves from e.g. plainlen, since the encryption routines may have
      * padded the plaintext. However, we also must not blindly trust the
      * cryptheader->length value, since if it is set to larger than the actual
-     * plaintext length, we could read beyond the end of the buffer in
-     * plain.val. So check that cryptheader->length is not larger than the max
-     * size of the plaintext in our decrypted buffer.
+     * plaintext length, we could read beyond the end of the decrypted data.
+     * So check that cryptheader->length is not larger than the max size of
+     * the plaintext in our decrypted buffer.
      */
-    if (ntohl(cryptheader->length) > plain.len - sizeof(*cryptheader)) {
+    if (ntohl(cryptheader->length) > plainlen - sizeof(*cryptheader)) {
         ret = RXGK_DATA_LEN;
         goto done;
     }
 
-    populate_header(header, apacket, rx_SecurityClassOf(aconn),
+    populate_header(&header, apacket, rx_SecurityClassOf(aconn),
                     ntohl(cryptheader->length));
 
     /* Verify the encrypted header. Note the constant-time memcmp here, since
      * this is a security-sensitive comparison. */
-    ret = ct_memcmp(header, cryptheader, sizeof(*header));
+    ret = ct_memcmp(&header, cryptheader, sizeof(header));
     if (ret != 0) {
 	ret = RXGK_SEALED_INCON;
 	goto done;
     }
 
-    len = ntohl(cryptheader->length) + sizeof(*header);
+    len = ntohl(cryptheader->length) + sizeof(header);
     if (len > 0xffffu) {
 	ret = RXGK_DATA_LEN;
 	goto done;
     }
 
     /*
-     * Now, write the plain data back to the packet. Note that we write back
-     * the decrypted packet payload, and the rxgk_header contents. We don't
-     * really need the rxgk_header in there anymore, but the Rx API does not
-     * let us skip it (Rx will skip the first N bytes when reading the packet
-     * payload, where N is our security header size).
+     * Now, write the plain data back to the packet, if it was not decrypted
+     * in place. Note that we write back the decrypted packet payload, and the
+     * rxgk_header contents. We don't really need the rxgk_header in there
+     * anymore, but the Rx API does not let us skip it (Rx will skip the first
+     * N bytes when reading the packet payload, where N is our security header
+     * size).
      */
-    rx_packetwrite(apacket, 0, len, plain.val);
+    if (buf != NULL)
+	rx_packetwrite(apacket, 0, len, buf);
     rx_SetDataSize(apacket, ntohl(cryptheader->length));
 
  done:
-    rx_opaque_freeContents(&plain);
-    rx_opaque_freeContents(&crypt);
-    rxi_Free(header, sizeof(*header));
+    if (buf != NULL)
+	rxi_Free(buf, buflen);
     return ret;
 }
 
@@ -299,7 +309,8 @@ rxgk_mic_packet(rxgk_key tk, afs_int32 keyusage, struct rx_connection *aconn,
  *
  * Take a packet, prefix it with the rxgk pseudoheader, encrypt the whole
  * thing with specified key and key usage, then rewrite the packet payload
- * to be the encrypted version.
+ * to be the encrypted version.  As with decryption, small packets are
+ * encrypted in place.
  *
  * @param[in] tk	The transport key to use.
  * @param[in] keyusage	The key usage for the encryption.
@@ -311,42 +322,60 @@ int
 rxgk_enc_packet(rxgk_key tk, afs_int32 keyusage, struct rx_connection *aconn,
 		struct rx_packet *apacket)
 {
-    struct rx_opaque plain = RX_EMPTY_OPAQUE, crypt = RX_EMPTY_OPAQUE;
     struct rxgk_header *header;
+    void *buf = NULL;
     afs_int32 ret;
-    afs_uint32 len;
+    afs_uint32 len, plainlen, buflen = 0;
+    size_t cryptlen;
 
     len = rx_GetDataSize(apacket);
     if (rx_GetSecurityHeaderSize(aconn) != sizeof(*header)) {
         ret = RXGK_INCONSISTENCY;
         goto done;
     }
-    ret = rx_opaque_alloc(&plain, sizeof(*header) + len);
-    if (ret != 0)
-	goto done;
-    header = plain.val;
+    plainlen = sizeof(*header) + len;
+    cryptlen = plainlen + rx_GetSecurityMaxTrailerSize(aconn);
+
+    /*
+     * If the header and payload are all in the first buffer, and the
+     * ciphertext will fit there too, encrypt them where they lie.
+     * Otherwise, gather them into a temporary buffer.
+     */
+    if (apacket->wirevec[1].iov_len >= plainlen
+	&& cryptlen <= RX_FIRSTBUFFERSIZE) {
+	header = (struct rxgk_header *)rx_DataOf(apacket);
+    } else {
+	buflen = cryptlen;
+	buf = rxi_Alloc(buflen);
+	if (buf == NULL) {
+	    ret = ENOMEM;
+	    goto done;
+	}
+	header = buf;
+	rx_packetread(apacket, sizeof(*header), len,
+		      (unsigned char *)buf + sizeof(*header));
+    }
     populate_header(header, apacket, rx_SecurityClassOf(aconn), len);
-    rx_packetread(apacket, sizeof(*header), len,
-		  (unsigned char *)plain.val + sizeof(*header));
 
     /* The actual encryption */
-    ret = rxgk_encrypt_in_key(tk, keyusage, &plain, &crypt);
+    ret = rxgk_encrypt_buf(tk, keyusage, header, plainlen, header, &cryptlen);
     if (ret != 0)
 	goto done;
-    if (crypt.len > 0xffffu) {
+    if (cryptlen > 0xffffu) {
 	ret = RXGK_DATA_LEN;
 	goto done;
     }
 
     /* Now, put the data back. */
-    if (crypt.len > plain.len)
-        rxi_RoundUpPacket(apacket, crypt.len - plain.len);
-    rx_packetwrite(apacket, 0, crypt.len, crypt.val);
-    rx_SetDataSize(apacket, crypt.len);
+    if (cryptlen > plainlen)
+        rxi_RoundUpPacket(apacket, cryptlen - plainlen);
+    if (buf != NULL)
+	rx_packetwrite(apacket, 0, cryptlen, buf);
+    rx_SetDataSize(apacket, cryptlen);
 
  done:
-    rx_opaque_freeContents(&plain);
-    rx_opaque_freeContents(&crypt);
+    if (buf != NULL)
+	rxi_Free(buf, buflen);
     return ret;
 }
 
@@ -354,13 +383,14 @@ rxgk_enc_packet(rxgk_key tk, afs_int32 keyusage, struct rx_connection *aconn,
  * Server/client common bits for the packet receipt routine.
  * Wrap the appropriate check_mic/decrypt routines for the given level
  * and client/server role, using the given start_time/kvno/k0 to generate
- * the transport key needed.  Since the kvno may have been updated by the
+ * the transport key needed, or the one already in 'tkcache'.  Since the kvno may have been updated by the
  * peer, 'a_kvno' is set to the new kvno on return, if it has changed.
  */
 int
 rxgk_check_packet(int server, struct rx_connection *aconn,
 		  struct rx_packet *apacket, RXGK_Level level,
-		  rxgkTime start_time, afs_uint32 *a_kvno, rxgk_key k0)
+		  rxgkTime start_time, afs_uint32 *a_kvno, rxgk_key k0,
+		  struct rxgk_tkcache *tkcache)
 {
     afs_uint16 wkvno;
     afs_uint32 lkvno;
@@ -389,8 +419,7 @@ rxgk_check_packet(int server, struct rx_connection *aconn,
 	rxgk_key tk;
 	afs_uint32 keyusage;
 
-	ret = rxgk_derive_tk(&tk, k0, rx_GetConnectionEpoch(aconn),
-			     rx_GetConnectionId(aconn), start_time, *a_kvno);
+	ret = rxgk_tkcache_get(tkcache, &tk, k0, aconn, start_time, *a_kvno);
 	if (ret != 0)
 	    return ret;
 
@@ -44,6 +44,23 @@ struct rxgkStats {
     afs_uint32 psent;
 };
 
+/**
+ * The transport key most recently used on a connection.
+ *
+ * A transport key depends on the connection's master key, start time and
+ * key number, and deriving one means running the PRF and setting up a new
+ * key schedule.  Rather than derive one for every packet, a connection keeps
+ * the last one it derived along with the start time and key number it was
+ * derived for.  The generation counts changes of master key.
+ */
+struct rxgk_tkcache {
+    afs_kmutex_t lock;
+    rxgk_key tk;
+    rxgkTime start_time;
+    afs_uint32 key_number;
+    afs_uint32 generation;
+};
+
 /* The packet pseudoheader used for auth and crypt connections. */
 struct rxgk_header {
     afs_uint32 epoch;
@@ -87,6 +104,7 @@ struct rxgk_sconn {
     struct rx_identity *client;
     afs_uint32 key_number;
     rxgk_key k0;
+    struct rxgk_tkcache tkcache;
 };
 
 /*
@@ -120,10 +138,16 @@ struct rxgk_cconn {
     rxgkTime start_time;
     afs_uint32 key_number;
     struct rxgkStats stats;
+    struct rxgk_tkcache tkcache;
 };
 
 /* rxgk_crypto_IMPL.c (currently rfc3961 is the only IMPL) */
 ssize_t rxgk_etype_to_len(int etype);
+void rxgk_hold_key(rxgk_key key);
+afs_int32 rxgk_encrypt_buf(rxgk_key key, afs_int32 usage, void *in,
+			   size_t inlen, void *out, size_t *outlen);
+afs_int32 rxgk_decrypt_buf(rxgk_key key, afs_int32 usage, void *in,
+			   size_t inlen, void *out, size_t *outlen);
 
 /* rxgk_token.c */
 afs_int32 rxgk_extract_token(RXGK_Data *tc, RXGK_Token *out,
@@ -134,6 +158,12 @@ afs_int32 rxgk_extract_token(RXGK_Data *tc, RXGK_Token *out,
 afs_int32 rxgk_security_overhead(struct rx_connection *aconn, RXGK_Level level,
 				 rxgk_key k0);
 afs_int32 rxgk_key_number(afs_uint16 wire, afs_uint32 local, afs_uint32 *real);
+void rxgk_tkcache_init(struct rxgk_tkcache *cache);
+void rxgk_tkcache_flush(struct rxgk_tkcache *cache);
+void rxgk_tkcache_destroy(struct rxgk_tkcache *cache);
+afs_int32 rxgk_tkcache_get(struct rxgk_tkcache *cache, rxgk_key *tk,
+			   rxgk_key k0, struct rx_connection *aconn,
+			   rxgkTime start_time, afs_uint32 key_number);
 
 /* rxgk_packet.c */
 int rxgk_mic_packet(rxgk_key tk, afs_int32 keyusage,
@@ -142,6 +172,7 @@ int rxgk_enc_packet(rxgk_key tk, afs_int32 keyusage,
 		    struct rx_connection *aconn, struct rx_packet *apacket);
 int rxgk_check_packet(int server, struct rx_connection *aconn,
                       struct rx_packet *apacket, RXGK_Level level,
-                      rxgkTime start_time, afs_uint32 *a_kvno, rxgk_key k0);
+                      rxgkTime start_time, afs_uint32 *a_kvno, rxgk_key k0,
+                      struct rxgk_tkcache *tkcache);
 
 #endif /* RXGK_PRIVATE_H */
@@ -91,6 +91,7 @@ static void
 sconn_set_noauth(struct rxgk_sconn *sc)
 {
     rxgk_release_key(&sc->k0);
+    rxgk_tkcache_flush(&sc->tkcache);
     if (sc->client != NULL)
         rx_identity_free(&sc->client);
     sc->start_time = 0;
@@ -122,6 +123,7 @@ rxgk_NewServerConnection(struct rx_securityClass *aobj,
     if (sc == NULL)
 	goto error;
 
+    rxgk_tkcache_init(&sc->tkcache);
     sconn_set_noauth(sc);
     rx_SetSecurityData(aconn, sc);
     obj_ref(aobj);
@@ -163,8 +165,8 @@ rxgk_ServerPreparePacket(struct rx_securityClass *aobj, struct rx_call *acall,
     if (sc->level == RXGK_LEVEL_CLEAR)
 	return 0;
 
-    ret = rxgk_derive_tk(&tk, sc->k0, rx_GetConnectionEpoch(aconn),
-			 rx_GetConnectionId(aconn), sc->start_time, lkvno);
+    ret = rxgk_tkcache_get(&sc->tkcache, &tk, sc->k0, aconn, sc->start_time,
+			   lkvno);
     if (ret != 0)
 	return ret;
 
@@ -377,6 +379,7 @@ process_token(RXGK_Data *tc, struct rxgk_sprivate *sp, struct rxgk_sconn *sc)
     /* Stash the token master key in the per-connection data. */
     rxgk_release_key(&sc->k0);
     ret = rxgk_make_key(&sc->k0, token.K0.val, token.K0.len, token.enctype);
+    rxgk_tkcache_flush(&sc->tkcache);
     if (ret != 0)
 	goto done;
 
@@ -619,7 +622,7 @@ rxgk_ServerCheckPacket(struct rx_securityClass *aobj, struct rx_call *acall,
 
     lkvno = kvno = sc->key_number;
     ret = rxgk_check_packet(1, aconn, apacket, sc->level, sc->start_time,
-			    &kvno, sc->k0);
+			    &kvno, sc->k0, &sc->tkcache);
     if (ret != 0)
 	return ret;
 
@@ -645,6 +648,7 @@ rxgk_DestroyServerConnection(struct rx_securityClass *aobj,
     rx_SetSecurityData(aconn, NULL);
 
     rxgk_release_key(&sc->k0);
+    rxgk_tkcache_destroy(&sc->tkcache);
     if (sc->client != NULL)
 	rx_identity_free(&sc->client);
     rxi_Free(sc, sizeof(*sc));
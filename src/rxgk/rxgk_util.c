@@ -33,7 +33,7 @@
  * @file
  * Utility functions for RXGK use. Compute the security overhead for a
  * connection at a given security level, and helpers for maintaining key
- * version numbers for connections.
+ * version numbers and transport keys for connections.
  */
 
 #include <afsconfig.h>
@@ -144,3 +144,100 @@ rxgk_key_number(afs_uint16 wire, afs_uint32 local, afs_uint32 *real)
     }
     return 0;
 }
+
+/**
+ * Set up an empty transport key cache
+ */
+void
+rxgk_tkcache_init(struct rxgk_tkcache *cache)
+{
+    MUTEX_INIT(&cache->lock, "rxgk tkcache", MUTEX_DEFAULT, 0);
+    cache->tk = NULL;
+    cache->start_time = 0;
+    cache->key_number = 0;
+    cache->generation = 0;
+}
+
+/**
+ * Forget the cached transport key
+ *
+ * This must be called whenever the master key for the connection changes.
+ */
+void
+rxgk_tkcache_flush(struct rxgk_tkcache *cache)
+{
+    rxgk_key tk;
+
+    MUTEX_ENTER(&cache->lock);
+    tk = cache->tk;
+    cache->tk = NULL;
+    cache->generation++;
+    MUTEX_EXIT(&cache->lock);
+    rxgk_release_key(&tk);
+}
+
+/**
+ * Tear down a transport key cache
+ */
+void
+rxgk_tkcache_destroy(struct rxgk_tkcache *cache)
+{
+    rxgk_release_key(&cache->tk);
+    MUTEX_DESTROY(&cache->lock);
+}
+
+/**
+ * Get the transport key for a connection
+ *
+ * Return the cached transport key if it was derived for the given start time
+ * and key number, or else derive a new one from k0 and cache that instead.
+ * The caller must release the returned key with rxgk_release_key.
+ *
+ * @param[in] cache	The connection's transport key cache.
+ * @param[out] tk	The transport key.
+ * @param[in] k0	The master key for the connection.
+ * @param[in] aconn	The connection.
+ * @param[in] start_time	The start_time of the connection.
+ * @param[in] key_number	The key number to get the transport key for.
+ * @return rxgk error codes.
+ */
+afs_int32
+rxgk_tkcache_get(struct rxgk_tkcache *cache, rxgk_key *tk, rxgk_key k0,
+		 struct rx_connection *aconn, rxgkTime start_time,
+		 afs_uint32 key_number)
+{
+    rxgk_key old = NULL;
+    afs_uint32 generation;
+    afs_int32 ret;
+
+    MUTEX_ENTER(&cache->lock);
+    if (cache->tk != NULL && cache->start_time == start_time
+	&& cache->key_number == key_number) {
+	*tk = cache->tk;
+	rxgk_hold_key(*tk);
+	MUTEX_EXIT(&cache->lock);
+	return 0;
+    }
+    generation = cache->generation;
+    MUTEX_EXIT(&cache->lock);
+
+    /* Derive the key without the lock held; it is not quick. */
+    ret = rxgk_derive_tk(tk, k0, rx_GetConnectionEpoch(aconn),
+			 rx_GetConnectionId(aconn), start_time, key_number);
+    if (ret != 0)
+	return ret;
+
+    MUTEX_ENTER(&cache->lock);
+    /* Don't cache a key made from a master key that has since been replaced */
+    if (cache->generation == generation) {
+	old = cache->tk;
+	cache->tk = *tk;
+	cache->start_time = start_time;
+	cache->key_number = key_number;
+	rxgk_hold_key(*tk);
+    }
+    MUTEX_EXIT(&cache->lock);
+
+    rxgk_release_key(&old);
+    return 0;
+}
@@ -38,6 +38,7 @@
 
 #include "rxkad.h"
 #include <rx/rx.h>
+#include <rx/rx_packet.h>
 #include "private_data.h"
 
 #define ROUNDS 16
@@ -75,6 +76,46 @@ const char ciph2[] = {
 #define rxkad_EncryptPacket _afs_bpwQbdoghO
 #endif
 
+static double
+elapsed(struct timeval *start, struct timeval *stop)
+{
+    return stop->tv_sec - start->tv_sec +
+	(stop->tv_usec - start->tv_usec) / 1e6;
+}
+
+/* Print the throughput of fc_cbc_encrypt for a range of packet sizes */
+static void
+time_cbc(int32 *sched)
+{
+    static const int sizes[] = { 64, 256, 1024, 1412, 8192 };
+    static char buf[8192];
+    struct timeval start, stop;
+    u_int32 iv[2];
+    double mb;
+    int i, j, n, size;
+
+    printf("%6s %12s %12s\n", "bytes", "encrypt MB/s", "decrypt MB/s");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+	size = sizes[i];
+	n = (16 << 20) / size;
+	mb = (double)n * size / (1 << 20);
+	memset(iv, 0, sizeof(iv));
+
+	printf("%6d", size);
+	gettimeofday(&start, NULL);
+	for (j = 0; j < n; j++)
+	    fc_cbc_encrypt(buf, buf, size, sched, iv, ENCRYPT);
+	gettimeofday(&stop, NULL);
+	printf(" %12.1f", mb / elapsed(&start, &stop));
+
+	gettimeofday(&start, NULL);
+	for (j = 0; j < n; j++)
+	    fc_cbc_encrypt(buf, buf, size, sched, iv, DECRYPT);
+	gettimeofday(&stop, NULL);
+	printf(" %12.1f\n", mb / elapsed(&start, &stop));
+    }
+}
+
 int
 main(void)
 {
@@ -82,15 +123,22 @@ main(void)
     char ciph[100], clear[100];
     u_int32 data[2];
     u_int32 iv[2];
-    struct rx_connection conn;
-    struct rx_securityClass obj;
-    struct rxkad_cprivate cpriv;
+    char ticket[MINKTCTICKETLEN];
+    struct rx_connection *conn;
+    struct rx_securityClass *obj;
     struct rx_packet packet;
     int fail = 0;
 
-    conn.securityObject = &obj;
-    obj.privateData = (void *)&cpriv;
-    cpriv.type = 0;
+    /* The packet routines only want the connection's security object */
+    if (rx_Init(0) != 0) {
+	fprintf(stderr, "error: rx_Init failed\n");
+	exit(1);
+    }
+    memset(ticket, 0, sizeof(ticket));
+    obj = rxkad_NewClientSecurityObject(rxkad_crypt,
+					(struct ktc_encryptionKey *)key1, 0,
+					sizeof(ticket), ticket);
+    conn = rx_NewConnection(htonl(INADDR_LOOPBACK), 0, 1, obj, 2);
 
     if (sizeof(int32) != 4) {
 	fprintf(stderr, "error: sizeof(int32) != 4\n");
@@ -145,8 +193,12 @@ main(void)
     packet.wirevec[2].iov_len = 0;
 
     /* For unknown reasons bytes 4-7 are zeroed in rxkad_EncryptPacket */
-    rxkad_EncryptPacket(&conn, sched, iv, sizeof(the_quick), &packet);
-    rxkad_DecryptPacket(&conn, sched, iv, sizeof(the_quick), &packet);
+    rxkad_EncryptPacket(conn, (const fc_KeySchedule *)sched,
+			(const fc_InitializationVector *)iv,
+			sizeof(the_quick), &packet);
+    rxkad_DecryptPacket(conn, (const fc_KeySchedule *)sched,
+			(const fc_InitializationVector *)iv,
+			sizeof(the_quick), &packet);
     clear[4] ^= 'q';
     clear[5] ^= 'u';
     clear[6] ^= 'i';
@@ -187,7 +239,11 @@ main(void)
 	       (stop.tv_sec - start.tv_sec +
 		(stop.tv_usec - start.tv_usec) / 1e6) * 10);
 
+	time_cbc(sched);
     }
 
+    rx_DestroyConnection(conn);
+    rx_Finalize();
+
     exit(fail);
 }
@@ -94,75 +94,186 @@ fc_keysched(struct ktc_encryptionKey *key, fc_KeySchedule schedule)
     return 0;
 }
 
+/*
+ * The round function.  Each round looks up the four bytes of S in the
+ * S-boxes, places the results in P (sbox0 in bits 8-15, sbox1 in 0-7,
+ * sbox2 in 16-23 and sbox3 in 24-31) and rotates P right 5 bits.  The
+ * placement and the rotation are folded into a shift of each S-box
+ * output, so a round is four table lookups and some register arithmetic.
+ */
+static_inline afs_uint32
+fc_f(afs_uint32 S)
+{
+    afs_uint32 s1 = sbox1[(S >> 16) & 0xff];
+
+    return ((afs_uint32)sbox0[S >> 24] << 3)
+	| (s1 >> 5) | (s1 << 27)
+	| ((afs_uint32)sbox2[(S >> 8) & 0xff] << 11)
+	| ((afs_uint32)sbox3[S & 0xff] << 19);
+}
+
+static_inline void
+fc_ecb_enc(afs_uint32 *Lp, afs_uint32 *Rp, const afs_int32 *schedule)
+{
+    afs_uint32 L = *Lp, R = *Rp;
+    int i;
+
+    for (i = 0; i < (ROUNDS / 2); i++) {
+	L ^= fc_f(*schedule++ ^ R);
+	R ^= fc_f(*schedule++ ^ L);
+    }
+    *Lp = L;
+    *Rp = R;
+}
+
+static_inline void
+fc_ecb_dec(afs_uint32 *Lp, afs_uint32 *Rp, const afs_int32 *schedule)
+{
+    afs_uint32 L = *Lp, R = *Rp;
+    int i;
+
+    schedule = &schedule[ROUNDS - 1];	/* start at end of key schedule */
+    for (i = 0; i < (ROUNDS / 2); i++) {
+	R ^= fc_f(*schedule-- ^ L);
+	L ^= fc_f(*schedule-- ^ R);
+    }
+    *Lp = L;
+    *Rp = R;
+}
+
+/*
+ * Run FC_LANES independent blocks through the decryption together.  Every
+ * round of one block depends on the round before it, so a single block
+ * leaves most of the processor idle waiting on table lookups; working on
+ * several at once, round by round, lets their lookups overlap.
+ */
+#define FC_LANES 4
+
+static_inline void
+fc_ecb_dec_lanes(afs_uint32 *L, afs_uint32 *R, const afs_int32 *schedule)
+{
+    int i, j;
+
+    schedule = &schedule[ROUNDS - 1];
+    for (i = 0; i < (ROUNDS / 2); i++, schedule -= 2) {
+	for (j = 0; j < FC_LANES; j++)
+	    R[j] ^= fc_f(schedule[0] ^ L[j]);
+	for (j = 0; j < FC_LANES; j++)
+	    L[j] ^= fc_f(schedule[-1] ^ R[j]);
+    }
+}
+
 /* IN int encrypt; * 0 ==> decrypt, else encrypt */
 afs_int32
 fc_ecb_encrypt(void * clear, void * cipher,
 	       const fc_KeySchedule schedule, int encrypt)
 {
     afs_uint32 L, R;
-    volatile afs_uint32 S, P;
-    volatile unsigned char *Pchar = (unsigned char *)&P;
-    volatile unsigned char *Schar = (unsigned char *)&S;
-    int i;
-
-#ifndef WORDS_BIGENDIAN
-#define Byte0 3
-#define Byte1 2
-#define Byte2 1
-#define Byte3 0
-#else
-#define Byte0 0
-#define Byte1 1
-#define Byte2 2
-#define Byte3 3
-#endif
 
     L = ntohl(*((afs_uint32 *)clear));
     R = ntohl(*((afs_uint32 *)clear + 1));
 
     if (encrypt) {
 	INC_RXKAD_STATS(fc_encrypts[ENCRYPT]);
-	for (i = 0; i < (ROUNDS / 2); i++) {
-	    S = *schedule++ ^ R;	/* xor R with key bits from schedule */
-	    Pchar[Byte2] = sbox0[Schar[Byte0]];	/* do 8-bit S Box subst. */
-	    Pchar[Byte3] = sbox1[Schar[Byte1]];	/* and permute the result */
-	    Pchar[Byte1] = sbox2[Schar[Byte2]];
-	    Pchar[Byte0] = sbox3[Schar[Byte3]];
-	    P = (P >> 5) | ((P & ((1 << 5) - 1)) << (32 - 5));	/* right rot 5 bits */
-	    L ^= P;		/* we're done with L, so save there */
-	    S = *schedule++ ^ L;	/* this time xor with L */
-	    Pchar[Byte2] = sbox0[Schar[Byte0]];
-	    Pchar[Byte3] = sbox1[Schar[Byte1]];
-	    Pchar[Byte1] = sbox2[Schar[Byte2]];
-	    Pchar[Byte0] = sbox3[Schar[Byte3]];
-	    P = (P >> 5) | ((P & ((1 << 5) - 1)) << (32 - 5));	/* right rot 5 bits */
-	    R ^= P;
-	}
+	fc_ecb_enc(&L, &R, schedule);
     } else {
 	INC_RXKAD_STATS(fc_encrypts[DECRYPT]);
-	schedule = &schedule[ROUNDS - 1];	/* start at end of key schedule */
-	for (i = 0; i < (ROUNDS / 2); i++) {
-	    S = *schedule-- ^ L;	/* xor R with key bits from schedule */
-	    Pchar[Byte2] = sbox0[Schar[Byte0]];	/* do 8-bit S Box subst. and */
-	    Pchar[Byte3] = sbox1[Schar[Byte1]];	/* permute the result */
-	    Pchar[Byte1] = sbox2[Schar[Byte2]];
-	    Pchar[Byte0] = sbox3[Schar[Byte3]];
-	    P = (P >> 5) | ((P & ((1 << 5) - 1)) << (32 - 5));	/* right rot 5 bits */
-	    R ^= P;		/* we're done with L, so save there */
-	    S = *schedule-- ^ R;	/* this time xor with L */
-	    Pchar[Byte2] = sbox0[Schar[Byte0]];
-	    Pchar[Byte3] = sbox1[Schar[Byte1]];
-	    Pchar[Byte1] = sbox2[Schar[Byte2]];
-	    Pchar[Byte0] = sbox3[Schar[Byte3]];
-	    P = (P >> 5) | ((P & ((1 << 5) - 1)) << (32 - 5));	/* right rot 5 bits */
-	    L ^= P;
-	}
+	fc_ecb_dec(&L, &R, schedule);
     }
     *((afs_int32 *)cipher) = htonl(L);
     *((afs_int32 *)cipher + 1) = htonl(R);
     return 0;
 }
 
+/* Fetch the next block to encrypt, zero padding a short final block */
+static_inline void
+fc_get_block(afs_uint32 *block, const char *input, afs_int32 length)
+{
+    if (length < 8) {
+	memset(block, 0, 2 * sizeof(afs_uint32));
+	memcpy(block, input, length);
+    } else {
+	memcpy(block, input, 2 * sizeof(afs_uint32));
+    }
+}
+
+static void
+fc_cbc_enc(char *input, char *output, afs_int32 length,
+	   const fc_KeySchedule key, afs_uint32 * xor)
+{
+    afs_uint32 t_input[2];
+    afs_uint32 t_output[2];
+    afs_uint32 L, R;
+
+    for (; length > 0; length -= 8) {
+	fc_get_block(t_input, input, length);
+	input += sizeof(t_input);
+
+	/* do the xor for cbc, and encrypt */
+	L = ntohl(xor[0] ^ t_input[0]);
+	R = ntohl(xor[1] ^ t_input[1]);
+	fc_ecb_enc(&L, &R, key);
+	t_output[0] = htonl(L);
+	t_output[1] = htonl(R);
+
+	/* copy output and save it for cbc */
+	memcpy(output, t_output, sizeof(t_output));
+	output += sizeof(t_output);
+
+	/* calculate xor value for next round from plain & cipher text */
+	xor[0] = t_input[0] ^ t_output[0];
+	xor[1] = t_input[1] ^ t_output[1];
+    }
+}
+
+/*
+ * PCBC decryption: each block's cipher output depends only on its own
+ * ciphertext, so decrypt FC_LANES blocks at a time and then unwind the
+ * chaining, which is just xors, in order.
+ */
+static void
+fc_cbc_dec(char *input, char *output, afs_int32 length,
+	   const fc_KeySchedule key, afs_uint32 * xor)
+{
+    afs_uint32 t_input[FC_LANES][2];
+    afs_uint32 t_output[2];
+    afs_uint32 L[FC_LANES], R[FC_LANES];
+    int j, n;
+
+    while (length > 0) {
+	n = (length + 7) / 8;
+	if (n >= FC_LANES) {
+	    n = FC_LANES;
+	    for (j = 0; j < n; j++) {
+		memcpy(t_input[j], input + 8 * j, sizeof(t_input[j]));
+		L[j] = ntohl(t_input[j][0]);
+		R[j] = ntohl(t_input[j][1]);
+	    }
+	    fc_ecb_dec_lanes(L, R, key);
+	} else {
+	    for (j = 0; j < n; j++) {
+		memcpy(t_input[j], input + 8 * j, sizeof(t_input[j]));
+		L[j] = ntohl(t_input[j][0]);
+		R[j] = ntohl(t_input[j][1]);
+		fc_ecb_dec(&L[j], &R[j], key);
+	    }
+	}
+	for (j = 0; j < n; j++) {
+	    /* do the xor for cbc into the output */
+	    t_output[0] = htonl(L[j]) ^ xor[0];
+	    t_output[1] = htonl(R[j]) ^ xor[1];
+	    memcpy(output, t_output, sizeof(t_output));
+	    output += sizeof(t_output);
+
+	    /* calculate xor value for next round from plain & cipher text */
+	    xor[0] = t_input[j][0] ^ t_output[0];
+	    xor[1] = t_input[j][1] ^ t_output[1];
+	}
+	input += 8 * n;
+	length -= 8 * n;
+    }
+}
+
 /* Crypting can be done in segments by recycling xor.  All but the final segment must
  * be multiples of 8 bytes.
  * NOTE: fc_cbc_encrypt now modifies its 5th argument, to permit chaining over
@@ -178,61 +289,15 @@ afs_int32
 fc_cbc_encrypt(void *input, void *output, afs_int32 length,
 	       const fc_KeySchedule key, afs_uint32 * xor, int encrypt)
 {
-    afs_uint32 i, j;
-    afs_uint32 t_input[2];
-    afs_uint32 t_output[2];
-    unsigned char *t_in_p = (unsigned char *)t_input;
+    if (length <= 0)
+	return 0;
 
     if (encrypt) {
-	for (i = 0; length > 0; i++, length -= 8) {
-	    /* get input */
-	    memcpy(t_input, input, sizeof(t_input));
-	    input=((char *)input) + sizeof(t_input);
-
-	    /* zero pad */
-	    for (j = length; j <= 7; j++)
-		*(t_in_p + j) = 0;
-
-	    /* do the xor for cbc into the temp */
-	    xor[0] ^= t_input[0];
-	    xor[1] ^= t_input[1];
-	    /* encrypt */
-	    fc_ecb_encrypt(xor, t_output, key, encrypt);
-
-	    /* copy temp output and save it for cbc */
-	    memcpy(output, t_output, sizeof(t_output));
-	    output=(char *)output + sizeof(t_output);
-
-	    /* calculate xor value for next round from plain & cipher text */
-	    xor[0] = t_input[0] ^ t_output[0];
-	    xor[1] = t_input[1] ^ t_output[1];
-
-
-	}
-	t_output[0] = 0;
-	t_output[1] = 0;
+	ADD_RXKAD_STATS(fc_encrypts[ENCRYPT], (length + 7) / 8);
+	fc_cbc_enc(input, output, length, key, xor);
     } else {
-	/* decrypt */
-	for (i = 0; length > 0; i++, length -= 8) {
-	    /* get input */
-	    memcpy(t_input, input, sizeof(t_input));
-	    input=((char *)input) + sizeof(t_input);
-
-	    /* no padding for decrypt */
-	    fc_ecb_encrypt(t_input, t_output, key, encrypt);
-
-	    /* do the xor for cbc into the output */
-	    t_output[0] ^= xor[0];
-	    t_output[1] ^= xor[1];
-
-	    /* copy temp output */
-	    memcpy(output, t_output, sizeof(t_output));
-	    output=((char *)output) + sizeof(t_output);
-
-	    /* calculate xor value for next round from plain & cipher text */
-	    xor[0] = t_input[0] ^ t_output[0];
-	    xor[1] = t_input[1] ^ t_output[1];
-	}
+	ADD_RXKAD_STATS(fc_encrypts[DECRYPT], (length + 7) / 8);
+	fc_cbc_dec(input, output, length, key, xor);
     }
     return 0;
 }
@@ -164,3 +164,23 @@ MRXSTATS_ClearPeerRPCStats(struct rx_call * call, IN afs_uint32 clearFlag)
     }
     return rc;
 }
+
+
+afs_int32
+MRXSTATS_RetrieveProcessRPCHistograms(struct rx_call *call,
+				      IN afs_uint32 clientVersion,
+				      OUT afs_uint32 * serverVersion,
+				      OUT afs_uint32 * clock_sec,
+				      OUT afs_uint32 * clock_usec,
+				      OUT afs_uint32 * stat_count,
+				      OUT rpcStats * stats)
+{
+    afs_int32 rc;
+    size_t allocSize;
+
+    rc = rx_RetrieveProcessRPCHistograms(clientVersion, serverVersion,
+					 clock_sec, clock_usec, &allocSize,
+					 stat_count, &stats->rpcStats_val);
+    stats->rpcStats_len = (u_int)(allocSize / sizeof(afs_uint32));
+    return rc;
+}
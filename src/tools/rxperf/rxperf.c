@@ -46,6 +46,9 @@ nn * We are using getopt since we want it to be possible to link to
 #ifdef HAVE_SYS_FILE_H
 #include <sys/file.h>
 #endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
 
 #include <assert.h>
 
@@ -139,6 +142,70 @@ end_and_print_timer(char *str, long long bytes)
         printf("\t[%.4g kbit/s]\n", kbps);
 }
 
+/*
+ * What the client has used so far: CPU time, and the packets it has sent
+ * and received.
+ */
+
+struct usage {
+    long long cpu;		/* usec */
+    long long packets;
+    long long resent;
+};
+
+static void
+get_usage(struct usage *u)
+{
+    struct rx_statistics *stats;
+#ifdef HAVE_SYS_RESOURCE_H
+    struct rusage ru;
+#endif
+    int i;
+
+    memset(u, 0, sizeof(*u));
+#ifdef HAVE_SYS_RESOURCE_H
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+	u->cpu = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL
+	    + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+#endif
+    stats = rx_GetStatistics();
+    if (stats != NULL) {
+	for (i = 0; i < RX_N_PACKET_TYPES; i++)
+	    u->packets += stats->packetsSent[i] + stats->packetsRead[i];
+	u->resent = stats->dataPacketsReSent;
+	rx_FreeStatistics(&stats);
+    }
+}
+
+/*
+ * Print the results of the last timed test as a single line of
+ * name=value pairs, for scripts to pick up.  Packets and CPU time are
+ * the client's own; packet counts are zero if statistics are disabled.
+ */
+
+static void
+print_results(const char *test, int threads, long long calls,
+	      long long bytes, struct usage *start, struct usage *stop)
+{
+    long long usec, cpu;
+    double secs;
+
+    usec = (timer_stop.tv_sec - timer_start.tv_sec) * 1000000LL
+	+ timer_stop.tv_usec - timer_start.tv_usec;
+    if (usec <= 0)
+	usec = 1;
+    secs = usec / 1000000.0;
+    cpu = stop->cpu - start->cpu;
+
+    printf("result test=%s threads=%d calls=%lld bytes=%lld msec=%lld"
+	   " calls_per_sec=%.1f mbytes_per_sec=%.2f packets_per_sec=%.0f"
+	   " resent=%lld cpu_usec_per_call=%.1f cpu_usec_per_mb=%.1f\n",
+	   test, threads, calls, bytes, usec / 1000, calls / secs,
+	   bytes / secs / 1000000.0, (stop->packets - start->packets) / secs,
+	   stop->resent - start->resent, calls > 0 ? (double)cpu / calls : 0,
+	   bytes > 0 ? cpu * 1000000.0 / bytes : 0);
+}
+
 /*
  *
  */
@@ -163,6 +230,223 @@ str2addr(const char *s)
 }
 
 
+#if defined(AFS_PTHREAD_ENV) && !defined(AFS_NT40_ENV)
+/*
+ * Loss and delay emulation.
+ *
+ * A UDP relay, run in a thread of the client process, sits between the
+ * client and the server.  The client sends to the relay instead of the
+ * server, and the relay forwards packets each way, dropping and delaying
+ * them as netem would: each packet is dropped with the given percentage
+ * chance, and the rest are held for the given delay before being sent on.
+ */
+
+#define RELAY_MAXPACKET 65536
+
+struct relay_packet {
+    struct relay_packet *next;
+    struct timeval due;
+    int len;
+    char data[1];
+};
+
+struct relay_queue {
+    struct relay_packet *head;
+    struct relay_packet *tail;
+};
+
+struct relay {
+    int near;			/* the client sends to this */
+    int far;			/* this sends to the server */
+    struct sockaddr_in client;
+    struct sockaddr_in server;
+    int loss;			/* percent of packets dropped */
+    int delay;			/* msec each packet is held */
+    struct relay_queue toserver;
+    struct relay_queue toclient;
+};
+
+static void
+relay_send(int fd, struct sockaddr_in *to, char *data, int len)
+{
+    /* A failed send is just another lost packet */
+    (void)sendto(fd, data, len, 0, (struct sockaddr *)to, sizeof(*to));
+}
+
+static void
+relay_recv(struct relay *r, int fd, struct relay_queue *q, int fromclient)
+{
+    struct relay_packet *rp;
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    char buf[RELAY_MAXPACKET];
+    int len;
+
+    for (;;) {
+	fromlen = sizeof(from);
+	len = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from,
+		       &fromlen);
+	if (len < 0)
+	    return;
+	if (fromclient)
+	    r->client = from;
+	if (r->loss > 0 && random() % 100 < r->loss)
+	    continue;
+	if (r->delay == 0) {
+	    if (fromclient)
+		relay_send(r->far, &r->server, buf, len);
+	    else
+		relay_send(r->near, &r->client, buf, len);
+	    continue;
+	}
+
+	rp = malloc(sizeof(*rp) + len);
+	if (rp == NULL)
+	    continue;
+	gettimeofday(&rp->due, NULL);
+	rp->due.tv_sec += r->delay / 1000;
+	rp->due.tv_usec += (r->delay % 1000) * 1000;
+	if (rp->due.tv_usec >= 1000000) {
+	    rp->due.tv_sec++;
+	    rp->due.tv_usec -= 1000000;
+	}
+	rp->len = len;
+	memcpy(rp->data, buf, len);
+	rp->next = NULL;
+	if (q->tail != NULL)
+	    q->tail->next = rp;
+	else
+	    q->head = rp;
+	q->tail = rp;
+    }
+}
+
+/* Send on everything in the queue which is due; the delay is constant, so
+ * the queue is in order of due time */
+static void
+relay_flush(int fd, struct sockaddr_in *to, struct relay_queue *q,
+	    struct timeval *now)
+{
+    struct relay_packet *rp;
+
+    while ((rp = q->head) != NULL && !timercmp(now, &rp->due, <)) {
+	relay_send(fd, to, rp->data, rp->len);
+	q->head = rp->next;
+	if (q->head == NULL)
+	    q->tail = NULL;
+	free(rp);
+    }
+}
+
+/* How long to wait before something in the queue is due */
+static void
+relay_timeout(struct relay_queue *q, struct timeval *now,
+	      struct timeval **tvp, struct timeval *tv)
+{
+    struct timeval wait;
+
+    if (q->head == NULL)
+	return;
+    timersub(&q->head->due, now, &wait);
+    if (*tvp == NULL || timercmp(&wait, tv, <)) {
+	*tv = wait;
+	*tvp = tv;
+    }
+}
+
+static void *
+relay_thread(void *arg)
+{
+    struct relay *r = arg;
+    struct timeval now, tv, *tvp;
+    fd_set fds;
+    int maxfd = MAX(r->near, r->far);
+
+    for (;;) {
+	gettimeofday(&now, NULL);
+	tvp = NULL;
+	relay_timeout(&r->toserver, &now, &tvp, &tv);
+	relay_timeout(&r->toclient, &now, &tvp, &tv);
+
+	FD_ZERO(&fds);
+	FD_SET(r->near, &fds);
+	FD_SET(r->far, &fds);
+	if (select(maxfd + 1, &fds, NULL, NULL, tvp) > 0) {
+	    if (FD_ISSET(r->near, &fds))
+		relay_recv(r, r->near, &r->toserver, 1);
+	    if (FD_ISSET(r->far, &fds))
+		relay_recv(r, r->far, &r->toclient, 0);
+	}
+
+	gettimeofday(&now, NULL);
+	relay_flush(r->far, &r->server, &r->toserver, &now);
+	relay_flush(r->near, &r->client, &r->toclient, &now);
+    }
+    AFS_UNREACHED(return NULL);
+}
+
+static int
+relay_socket(int udpbufsz)
+{
+    struct sockaddr_in sin;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+	err(1, "socket");
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0)
+	err(1, "bind");
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &udpbufsz, sizeof(udpbufsz));
+    (void)setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &udpbufsz, sizeof(udpbufsz));
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0)
+	err(1, "fcntl");
+    return fd;
+}
+
+/*
+ * Start a relay to the server at addr and port (both in network byte
+ * order), and return the port the client should send to instead.
+ */
+static u_short
+start_relay(afs_uint32 addr, u_short port, int loss, int delay,
+	    int udpbufsz)
+{
+    struct relay *r;
+    struct sockaddr_in sin;
+    socklen_t len = sizeof(sin);
+    pthread_attr_t tattr;
+    pthread_t tid;
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL)
+	err(1, "calloc");
+    r->near = relay_socket(udpbufsz);
+    r->far = relay_socket(udpbufsz);
+    r->server.sin_family = AF_INET;
+    r->server.sin_addr.s_addr = addr;
+    r->server.sin_port = port;
+    r->loss = loss;
+    r->delay = delay;
+
+    if (getsockname(r->near, (struct sockaddr *)&sin, &len) < 0)
+	err(1, "getsockname");
+
+    /* Use the same drops from run to run */
+    srandom(1);
+
+    pthread_attr_init(&tattr);
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&tid, &tattr, relay_thread, r) != 0)
+	errx(1, "cannot start relay thread");
+    pthread_attr_destroy(&tattr);
+
+    return sin.sin_port;
+}
+#endif /* AFS_PTHREAD_ENV && !AFS_NT40_ENV */
+
 /*
  *
  */
@@ -405,8 +689,8 @@ rxperf_ExecuteRequest(struct rx_call *call)
  */
 
 static void
-do_server(short port, int nojumbo, int maxmtu, int maxwsize, int minpeertimeout,
-          int udpbufsz, int nostats, int hotthread,
+do_server(short port, int nojumbo, int maxmtu, int maxwsize, int ccalgo,
+          int minpeertimeout, int udpbufsz, int nostats, int hotthread,
           int minprocs, int maxprocs)
 {
     struct rx_service *service;
@@ -444,6 +728,8 @@ do_server(short port, int nojumbo, int maxmtu, int maxwsize, int minpeertimeout,
         rx_SetMaxSendWindow(maxwsize);
     }
 
+    rx_SetCongestionControl(ccalgo);
+
     if (minpeertimeout)
         rx_SetMinPeerTimeout(minpeertimeout);
 
@@ -684,11 +970,16 @@ client_thread( void *vparams)
 static void
 do_client(const char *server, short port, char *filename, afs_int32 command,
 	  afs_int32 times, afs_int32 bytes, afs_int32 sendbytes, afs_int32 readbytes,
-          int dumpstats, int nojumbo, int maxmtu, int maxwsize, int minpeertimeout,
-          int udpbufsz, int nostats, int hotthread, int threads)
+          int dumpstats, int nojumbo, int maxmtu, int maxwsize, int ccalgo,
+          int minpeertimeout, int udpbufsz, int nostats, int hotthread,
+          int threads, int loss, int delay, int results)
 {
     struct rx_connection *conn;
     afs_uint32 addr;
+    u_short nport;
+    struct usage ustart, ustop;
+    char *test = NULL;
+    long long calls, nbytes = 0;
     struct rx_securityClass *secureobj;
     int secureindex;
     int ret;
@@ -718,6 +1009,7 @@ do_client(const char *server, short port, char *filename, afs_int32 command,
         rx_enable_stats = 0;
 
     addr = str2addr(server);
+    nport = htons(port);
 
     rx_SetUdpBufSize(udpbufsz);
 
@@ -736,12 +1028,23 @@ do_client(const char *server, short port, char *filename, afs_int32 command,
         rx_SetMaxSendWindow(maxwsize);
     }
 
+    rx_SetCongestionControl(ccalgo);
+
     if (minpeertimeout)
         rx_SetMinPeerTimeout(minpeertimeout);
 
 
     get_sec(0, &secureobj, &secureindex);
 
+    if (loss || delay) {
+#if defined(AFS_PTHREAD_ENV) && !defined(AFS_NT40_ENV)
+	nport = start_relay(addr, nport, loss, delay, udpbufsz);
+	addr = htonl(INADDR_LOOPBACK);
+#else
+	errx(1, "loss and delay emulation needs pthreads");
+#endif
+    }
+
     switch (command) {
     case RX_PERF_RPC:
         sprintf(stamp, "RPC: threads\t%d, times\t%d, write bytes\t%d, read bytes\t%d",
@@ -761,7 +1064,7 @@ do_client(const char *server, short port, char *filename, afs_int32 command,
         break;
     }
 
-    conn = rx_NewConnection(addr, htons(port), RX_SERVER_ID, secureobj, secureindex);
+    conn = rx_NewConnection(addr, nport, RX_SERVER_ID, secureobj, secureindex);
     if (conn == NULL)
 	errx(1, "failed to contact server");
 
@@ -778,13 +1081,14 @@ do_client(const char *server, short port, char *filename, afs_int32 command,
     params->sendbytes = sendbytes;
     params->readbytes = readbytes;
 
+    get_usage(&ustart);
     start_timer();
 
 #ifdef AFS_PTHREAD_ENV
     for ( i=0; i<threads; i++) {
         pthread_create(&thread[i], &tattr, client_thread, params);
         if ( (i + 1) % RX_MAXCALLS == 0 ) {
-            conn = rx_NewConnection(addr, htons(port), RX_SERVER_ID, secureobj, secureindex);
+            conn = rx_NewConnection(addr, nport, RX_SERVER_ID, secureobj, secureindex);
             if (conn != NULL) {
                 struct client_data *new_params = malloc(sizeof(struct client_data));
                 memcpy(new_params, params, sizeof(struct client_data));
@@ -802,16 +1106,29 @@ do_client(const char *server, short port, char *filename, afs_int32 command,
         pthread_join(thread[i], &status);
 #endif
 
+    get_usage(&ustop);
+    calls = (long long)threads * times;
     switch (command) {
     case RX_PERF_RPC:
-        end_and_print_timer(stamp, (long long)threads*times*(sendbytes+readbytes));
+        test = "rpc";
+        nbytes = calls * (sendbytes + readbytes);
         break;
     case RX_PERF_RECV:
+        test = "recv";
+        nbytes = calls * bytes;
+        break;
     case RX_PERF_SEND:
+        test = "send";
+        nbytes = calls * bytes;
+        break;
     case RX_PERF_FILE:
-        end_and_print_timer(stamp, (long long)threads*times*bytes);
+        test = "file";
+        nbytes = calls * bytes;
         break;
     }
+    end_and_print_timer(stamp, nbytes);
+    if (results)
+        print_results(test, threads, calls, nbytes, &ustart, &ustop);
 
     DBFPRINT(("done for good\n"));
 
@@ -828,6 +1145,16 @@ do_client(const char *server, short port, char *filename, afs_int32 command,
     free(params);
 }
 
+static int
+parse_cc(const char *name)
+{
+    if (strcmp(name, "classic") == 0)
+	return RX_CC_CLASSIC;
+    if (strcmp(name, "cubic") == 0)
+	return RX_CC_CUBIC;
+    errx(1, "unknown congestion control algorithm %s", name);
+}
+
 static void
 usage(void)
 {
@@ -843,7 +1170,15 @@ usage(void)
 	    "%s: usage:	common option to the client "
 	    "-w <write-bytes> -r <read-bytes> -T times -p port -s server -D\n",
 	    getprogname());
+    fprintf(stderr,
+	    "%s: usage:	testing options to the client "
+	    "-l <loss-percent> -L <delay-msec> -o\n",
+	    getprogname());
     fprintf(stderr, "usage: %s server -p port\n", getprogname());
+    fprintf(stderr,
+	    "%s: usage:	common option to the client and server "
+	    "-W <max-window-packets> -C classic|cubic\n",
+	    getprogname());
 #undef COMMMON
     exit(1);
 }
@@ -866,11 +1201,12 @@ rxperf_server(int argc, char **argv)
     int minprocs = 2;
     int maxprocs = 20;
     int maxwsize = 0;
+    int ccalgo = RX_CC_CLASSIC;
     int minpeertimeout = 0;
     char *ptr;
     int ch;
 
-    while ((ch = getopt(argc, argv, "r:d:p:P:w:W:HNjm:u:4:s:S:V")) != -1) {
+    while ((ch = getopt(argc, argv, "r:d:p:P:w:W:C:HNjm:u:4:s:S:V")) != -1) {
 	switch (ch) {
 	case 'd':
 #ifdef RXDEBUG
@@ -944,6 +1280,9 @@ rxperf_server(int argc, char **argv)
 	    if (ptr && *ptr != '\0')
 		errx(1, "can't resolve max send/recv window size (packets)");
 	    break;
+	case 'C':
+	    ccalgo = parse_cc(optarg);
+	    break;
 	case '4':
 	  RX_IPUDP_SIZE = 28;
 	  break;
@@ -955,8 +1294,8 @@ rxperf_server(int argc, char **argv)
     if (optind != argc)
 	usage();
 
-    do_server(port, nojumbo, maxmtu, maxwsize, minpeertimeout, udpbufsz,
-              nostats, hotthreads, minprocs, maxprocs);
+    do_server(port, nojumbo, maxmtu, maxwsize, ccalgo, minpeertimeout,
+              udpbufsz, nostats, hotthreads, minprocs, maxprocs);
 
     return 0;
 }
@@ -984,13 +1323,17 @@ rxperf_client(int argc, char **argv)
     int threads = 1;
     int udpbufsz = 64 * 1024;
     int maxwsize = 0;
+    int ccalgo = RX_CC_CLASSIC;
     int minpeertimeout = 0;
+    int loss = 0;
+    int delay = 0;
+    int results = 0;
     char *ptr;
     int ch;
 
     cmd = RX_PERF_UNKNOWN;
 
-    while ((ch = getopt(argc, argv, "T:S:R:b:c:d:p:P:r:s:w:W:f:HDNjm:u:4:t:V")) != -1) {
+    while ((ch = getopt(argc, argv, "T:S:R:b:c:d:p:P:r:s:w:W:C:f:HDNjm:u:4:t:Vl:L:o")) != -1) {
 	switch (ch) {
 	case 'b':
 	    bytes = strtol(optarg, &ptr, 0);
@@ -1057,6 +1400,9 @@ rxperf_client(int argc, char **argv)
 	    if (ptr && *ptr != '\0')
 		errx(1, "can't resolve max send/recv window size (packets)");
 	    break;
+	case 'C':
+	    ccalgo = parse_cc(optarg);
+	    break;
 	case 'T':
 	    times = strtol(optarg, &ptr, 0);
 	    if (ptr && *ptr != '\0')
@@ -1089,6 +1435,19 @@ rxperf_client(int argc, char **argv)
 	case 'D':
 	    dumpstats = 1;
 	    break;
+	case 'l':
+	    loss = strtol(optarg, &ptr, 0);
+	    if ((ptr && *ptr != '\0') || loss < 0 || loss > 100)
+		errx(1, "can't resolve percentage of packets to lose");
+	    break;
+	case 'L':
+	    delay = strtol(optarg, &ptr, 0);
+	    if ((ptr && *ptr != '\0') || delay < 0)
+		errx(1, "can't resolve packet delay (msec)");
+	    break;
+	case 'o':
+	    results = 1;
+	    break;
 	case 'N':
 	    nostats = 1;
 	    break;
@@ -1129,8 +1488,9 @@ rxperf_client(int argc, char **argv)
 	errx(1, "no command given to the client");
 
     do_client(host, port, filename, cmd, times, bytes, sendbytes,
-	      readbytes, dumpstats, nojumbo, maxmtu, maxwsize, minpeertimeout,
-              udpbufsz, nostats, hotthreads, threads);
+	      readbytes, dumpstats, nojumbo, maxmtu, maxwsize, ccalgo,
+              minpeertimeout, udpbufsz, nostats, hotthreads, threads,
+              loss, delay, results);
 
     return 0;
 }
@@ -0,0 +1,315 @@
+/*
+ * This software has been released under the terms of the IBM Public
+ * License.  For details, see the LICENSE file in the top-level source
+ * directory or online at http://www.openafs.org/dl/license10.html
+ */
+
+/*
+ * xdrperf - measure what inline marshalling saves in the rxgen stubs.
+ *
+ * The XDR routines rxgen generates for fixed-layout structs try to encode
+ * or decode the whole struct in place with XDR_INLINE before falling back
+ * to one call per field.  This runs the same stubs both ways, by hiding
+ * the inline op from the stream for the "per-field" runs, over two sets
+ * of types: the AFSBulkStats a fileserver returns from InlineBulkStatus,
+ * and the bulkentries a vlserver returns from ListAttributes.
+ *
+ * Each type is run over a memory stream, which shows the marshalling
+ * cost alone, and over an Rx call to a server in the same process, which
+ * encodes into and decodes out of real Rx packets.  For each, prints the
+ * time per round trip (encode and decode, or a call that echoes its
+ * argument back) with and without inlining.
+ *
+ * usage: xdrperf [-e entries] [-n iterations] [-p port]
+ */
+
+#include <afsconfig.h>
+#include <afs/param.h>
+#include <roken.h>
+
+#include <rx/xdr.h>
+#include <rx/rx.h>
+#include <rx/rx_null.h>
+#include <afs/afsint.h>
+#include <afs/vldbint.h>
+#include <afs/voldefs.h>
+
+#define XDRPERF_SERVICE_ID 148
+
+static int useinline;
+
+struct xdrtype {
+    char *name;
+    xdrproc_t proc;
+    void *obj;
+    size_t size;
+};
+
+static struct xdrtype types[2];
+
+union xdrobj {
+    AFSBulkStats stats;
+    bulkentries vlentries;
+};
+
+static afs_int32 *
+noinline(XDR *xdrs, u_int len)
+{
+    return NULL;
+}
+
+/* Make the stream refuse inline requests, unless we are using them */
+static void
+setinline(XDR *xdrs, struct xdr_ops *ops)
+{
+    if (!useinline) {
+	*ops = *xdrs->x_ops;
+	ops->x_inline = noinline;
+	xdrs->x_ops = ops;
+    }
+}
+
+static void
+fill(int entries)
+{
+    AFSBulkStats *stats;
+    bulkentries *vlentries;
+    int i, j;
+
+    stats = calloc(1, sizeof(*stats));
+    vlentries = calloc(1, sizeof(*vlentries));
+    if (stats == NULL || vlentries == NULL)
+	goto nomem;
+    stats->AFSBulkStats_len = entries;
+    stats->AFSBulkStats_val = calloc(entries, sizeof(AFSFetchStatus));
+    vlentries->bulkentries_len = entries;
+    vlentries->bulkentries_val = calloc(entries, sizeof(vldbentry));
+    if (stats->AFSBulkStats_val == NULL || vlentries->bulkentries_val == NULL)
+	goto nomem;
+
+    for (i = 0; i < entries; i++) {
+	AFSFetchStatus *st = &stats->AFSBulkStats_val[i];
+	vldbentry *ve = &vlentries->bulkentries_val[i];
+
+	st->InterfaceVersion = 1;
+	st->FileType = File;
+	st->LinkCount = 1;
+	st->Length = 4096 * i;
+	st->DataVersion = i;
+	st->Author = st->Owner = 1000 + i;
+	st->CallerAccess = st->AnonymousAccess = 0x7f;
+	st->UnixModeBits = 0644;
+	st->ParentVnode = 1;
+	st->ParentUnique = 1;
+	st->ClientModTime = st->ServerModTime = 1700000000 + i;
+
+	snprintf(ve->name, sizeof(ve->name), "user.volume%d", i);
+	ve->nServers = 3;
+	for (j = 0; j < ve->nServers; j++) {
+	    ve->serverNumber[j] = 0x0a000001 + j;
+	    ve->serverPartition[j] = j;
+	    ve->serverFlags[j] = (j == 0) ? VLSF_RWVOL : VLSF_ROVOL;
+	}
+	ve->volumeId[RWVOL] = 536870912 + 3 * i;
+	ve->volumeId[ROVOL] = ve->volumeId[RWVOL] + 1;
+	ve->volumeId[BACKVOL] = ve->volumeId[RWVOL] + 2;
+	ve->flags = VLF_RWEXISTS | VLF_ROEXISTS;
+    }
+
+    types[0].name = "AFSBulkStats";
+    types[0].proc = (xdrproc_t) xdr_AFSBulkStats;
+    types[0].obj = stats;
+    types[0].size = sizeof(*stats);
+    types[1].name = "bulkentries";
+    types[1].proc = (xdrproc_t) xdr_bulkentries;
+    types[1].obj = vlentries;
+    types[1].size = sizeof(*vlentries);
+    return;
+
+  nomem:
+    fprintf(stderr, "xdrperf: out of memory\n");
+    exit(1);
+}
+
+/* Encode the object into a buffer and decode it back out again */
+static void
+memtrip(struct xdrtype *t, char *buf, u_int buflen, void *out)
+{
+    XDR xdrs;
+    struct xdr_ops ops;
+
+    xdrmem_create(&xdrs, buf, buflen, XDR_ENCODE);
+    setinline(&xdrs, &ops);
+    if (!(*t->proc)(&xdrs, t->obj)) {
+	fprintf(stderr, "xdrperf: cannot encode %s\n", t->name);
+	exit(1);
+    }
+    xdrmem_create(&xdrs, buf, buflen, XDR_DECODE);
+    setinline(&xdrs, &ops);
+    memset(out, 0, t->size);
+    if (!(*t->proc)(&xdrs, out)) {
+	fprintf(stderr, "xdrperf: cannot decode %s\n", t->name);
+	exit(1);
+    }
+    xdr_free(t->proc, out);
+}
+
+/* The server decodes the object and sends it straight back */
+static afs_int32
+echo(struct rx_call *call)
+{
+    XDR xdrs;
+    struct xdr_ops ops;
+    union xdrobj obj;
+    afs_int32 which;
+    struct xdrtype *t;
+
+    if (rx_Read32(call, &which) != sizeof(which))
+	return RX_PROTOCOL_ERROR;
+    which = ntohl(which);
+    if (which < 0 || which >= sizeof(types) / sizeof(types[0]))
+	return RX_PROTOCOL_ERROR;
+    t = &types[which];
+
+    memset(&obj, 0, sizeof(obj));
+    xdrrx_create(&xdrs, call, XDR_DECODE);
+    setinline(&xdrs, &ops);
+    if (!(*t->proc)(&xdrs, &obj))
+	return RX_PROTOCOL_ERROR;
+    xdrrx_create(&xdrs, call, XDR_ENCODE);
+    setinline(&xdrs, &ops);
+    if (!(*t->proc)(&xdrs, &obj))
+	return RX_PROTOCOL_ERROR;
+    xdr_free(t->proc, &obj);
+    return 0;
+}
+
+static void
+rxtrip(struct xdrtype *t, struct rx_connection *conn, void *out)
+{
+    struct rx_call *call;
+    XDR xdrs;
+    struct xdr_ops ops;
+    afs_int32 which = htonl(t - types);
+    afs_int32 code;
+
+    call = rx_NewCall(conn);
+    if (rx_Write32(call, &which) != sizeof(which))
+	goto fail;
+    xdrrx_create(&xdrs, call, XDR_ENCODE);
+    setinline(&xdrs, &ops);
+    if (!(*t->proc)(&xdrs, t->obj))
+	goto fail;
+    xdrrx_create(&xdrs, call, XDR_DECODE);
+    setinline(&xdrs, &ops);
+    memset(out, 0, t->size);
+    if (!(*t->proc)(&xdrs, out))
+	goto fail;
+    code = rx_EndCall(call, 0);
+    if (code) {
+	fprintf(stderr, "xdrperf: call failed; code %d\n", code);
+	exit(1);
+    }
+    xdr_free(t->proc, out);
+    return;
+
+  fail:
+    code = rx_EndCall(call, RX_PROTOCOL_ERROR);
+    fprintf(stderr, "xdrperf: cannot send %s; code %d\n", t->name, code);
+    exit(1);
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "usage: xdrperf [-e entries] [-n iterations] "
+	    "[-p port]\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    int entries = AFSCBMAX, iterations = 2000, port = 7010;
+    struct rx_securityClass *sc;
+    struct rx_service *service;
+    struct rx_connection *conn;
+    struct timeval start, end;
+    double usec[2];
+    union xdrobj out;
+    char *buf;
+    u_int buflen;
+    int i, n, rx, code;
+    struct xdrtype *t;
+
+    for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+	    entries = atoi(argv[++i]);
+	} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+	    iterations = atoi(argv[++i]);
+	} else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+	    port = atoi(argv[++i]);
+	} else {
+	    usage();
+	}
+    }
+    if (entries < 1 || entries > AFSCBMAX || iterations < 1)
+	usage();
+
+    fill(entries);
+    buflen = entries * sizeof(vldbentry) * 4 + 64;
+    buf = malloc(buflen);
+    if (buf == NULL) {
+	fprintf(stderr, "xdrperf: out of memory\n");
+	return 1;
+    }
+
+    code = rx_Init(htons(port));
+    if (code) {
+	fprintf(stderr, "xdrperf: rx_Init: code %d\n", code);
+	return 1;
+    }
+    sc = rxnull_NewServerSecurityObject();
+    service = rx_NewService(0, XDRPERF_SERVICE_ID, "xdrperf", &sc, 1, echo);
+    if (service == NULL) {
+	fprintf(stderr, "xdrperf: cannot create service\n");
+	return 1;
+    }
+    rx_StartServer(0);
+    conn = rx_NewConnection(htonl(INADDR_LOOPBACK), htons(port),
+			    XDRPERF_SERVICE_ID,
+			    rxnull_NewClientSecurityObject(), 0);
+
+    printf("%d entries, %d iterations\n", entries, iterations);
+    printf("%-14s %-6s %16s %16s %8s\n", "type", "stream", "per-field usec",
+	   "inline usec", "speedup");
+    for (t = types; t < types + sizeof(types) / sizeof(types[0]); t++) {
+	for (rx = 0; rx < 2; rx++) {
+	    for (useinline = 0; useinline < 2; useinline++) {
+		/* warm up */
+		if (rx)
+		    rxtrip(t, conn, &out);
+		else
+		    memtrip(t, buf, buflen, &out);
+		gettimeofday(&start, NULL);
+		for (n = 0; n < iterations; n++) {
+		    if (rx)
+			rxtrip(t, conn, &out);
+		    else
+			memtrip(t, buf, buflen, &out);
+		}
+		gettimeofday(&end, NULL);
+		usec[useinline] = ((end.tv_sec - start.tv_sec) * 1000000.0
+				   + (end.tv_usec - start.tv_usec)) / iterations;
+	    }
+	    printf("%-14s %-6s %16.2f %16.2f %7.2fx\n", t->name,
+		   rx ? "rx" : "memory", usec[0], usec[1],
+		   usec[1] > 0 ? usec[0] / usec[1] : 0);
+	    fflush(stdout);
+	}
+    }
+
+    rx_DestroyConnection(conn);
+    rx_Finalize();
+    return 0;
+}
@@ -385,15 +385,66 @@ SDISK_GetVersion(struct rx_call *rxcall,
     return 0;
 }
 
+/* State for copying a database file straight between disk and Rx packets */
+struct bulkfile {
+    struct ubik_dbase *dbase;
+    afs_int32 file;
+    afs_int32 offset;
+    int fd;
+    int pass;
+    int failed;			/* set if the disk I/O failed */
+};
+
+static int
+GetFileProc(void *rock, struct iovec *iov, int nio, int nbytes)
+{
+    struct bulkfile *bf = rock;
+    int i, code;
+
+    for (i = 0; i < nio; i++) {
+	code = (*bf->dbase->read) (bf->dbase, bf->file, iov[i].iov_base,
+				   bf->offset, iov[i].iov_len);
+	if (code != iov[i].iov_len) {
+	    ViceLog(0, ("read failed error=%d\n", code));
+	    bf->failed = 1;
+	    return UIOERROR;
+	}
+	bf->offset += iov[i].iov_len;
+    }
+    return 0;
+}
+
+static int
+SendFileProc(void *rock, struct iovec *iov, int nio, int nbytes)
+{
+    struct bulkfile *bf = rock;
+    int i, code;
+
+#if !defined(AFS_PTHREAD_ENV)
+    if (bf->pass % 4 == 0)
+	IOMGR_Poll();
+#endif
+    bf->pass++;
+    for (i = 0; i < nio; i++) {
+	code = write(bf->fd, iov[i].iov_base, iov[i].iov_len);
+	if (code != iov[i].iov_len) {
+	    ViceLog(0, ("write failed tlen=%d, error=%d\n",
+			(int)iov[i].iov_len, code));
+	    bf->failed = 1;
+	    return UIOERROR;
+	}
+    }
+    return 0;
+}
+
 afs_int32
 SDISK_GetFile(struct rx_call *rxcall, afs_int32 file,
 	      struct ubik_version *version)
 {
     afs_int32 code;
     struct ubik_dbase *dbase;
-    afs_int32 offset;
     struct ubik_stat ubikstat;
-    char tbuffer[256];
+    struct bulkfile bf;
     afs_int32 tlen;
     afs_int32 length;
     struct rx_peer *tpeer;
@@ -427,24 +478,16 @@ SDISK_GetFile(struct rx_call *rxcall, afs_int32 file,
 	code = BULK_ERROR;
 	goto failed;
     }
-    offset = 0;
-    while (length > 0) {
-	tlen = (length > sizeof(tbuffer) ? sizeof(tbuffer) : length);
-	code = (*dbase->read) (dbase, file, tbuffer, offset, tlen);
-	if (code != tlen) {
-	    ViceLog(0, ("read failed error=%d\n", code));
-	    code = UIOERROR;
-	    goto failed;
-	}
-	code = rx_Write(rxcall, tbuffer, tlen);
-	if (code != tlen) {
-	    ViceLog(0, ("Rx-write data error=%d\n", code));
-	    code = BULK_ERROR;
-	    goto failed;
-	}
-	length -= tlen;
-	offset += tlen;
+    memset(&bf, 0, sizeof(bf));
+    bf.dbase = dbase;
+    bf.file = file;
+    code = rx_WriteBulk(rxcall, length, GetFileProc, &bf, NULL);
+    if (code && !bf.failed) {
+	ViceLog(0, ("Rx-write data error=%d\n", code));
+	code = BULK_ERROR;
     }
+    if (code)
+	goto failed;
     code = (*dbase->getlabel) (dbase, file, version);	/* return the dbase, too */
     if (code)
 	ViceLog(0, ("getlabel error=%d\n", code));
@@ -473,7 +516,7 @@ SDISK_SendFile(struct rx_call *rxcall, afs_int32 file,
     struct ubik_dbase *dbase = NULL;
     char tbuffer[1024];
     struct ubik_version tversion;
-    int tlen;
+    struct bulkfile bf;
     struct rx_peer *tpeer;
     struct rx_connection *tconn;
     afs_uint32 syncHost = 0;
@@ -482,7 +525,6 @@ SDISK_SendFile(struct rx_call *rxcall, afs_int32 file,
     char pbuffer[1028];
     int fd = -1;
     afs_int32 epoch = 0;
-    afs_int32 pass;
 
     /* send the file back to the requester */
 
@@ -543,31 +585,18 @@ SDISK_SendFile(struct rx_call *rxcall, afs_int32 file,
 	close(fd);
 	goto failed_locked;
     }
-    pass = 0;
     memcpy(&ubik_dbase->version, &tversion, sizeof(struct ubik_version));
     UBIK_VERSION_UNLOCK;
-    while (length > 0) {
-	tlen = (length > sizeof(tbuffer) ? sizeof(tbuffer) : length);
-#if !defined(AFS_PTHREAD_ENV)
-	if (pass % 4 == 0)
-	    IOMGR_Poll();
-#endif
-	code = rx_Read(rxcall, tbuffer, tlen);
-	if (code != tlen) {
-	    ViceLog(0, ("Rx-read length error=%d\n", code));
-	    code = BULK_ERROR;
-	    close(fd);
-	    goto failed;
-	}
-	code = write(fd, tbuffer, tlen);
-	pass++;
-	if (code != tlen) {
-	    ViceLog(0, ("write failed tlen=%d, error=%d\n", tlen, code));
-	    code = UIOERROR;
-	    close(fd);
-	    goto failed;
-	}
-	length -= tlen;
+    memset(&bf, 0, sizeof(bf));
+    bf.fd = fd;
+    code = rx_ReadBulk(rxcall, length, SendFileProc, &bf, NULL);
+    if (code && !bf.failed) {
+	ViceLog(0, ("Rx-read length error=%d\n", code));
+	code = BULK_ERROR;
+    }
+    if (code) {
+	close(fd);
+	goto failed;
     }
     code = close(fd);
     if (code) {
@@ -2171,48 +2171,71 @@ SRXAFS_FsCmd(struct rx_call * acall, struct AFSFid * Fid,
     return code;
 }
 
-#ifndef HAVE_PIOV
-static struct afs_buffer {
-    struct afs_buffer *next;
-} *freeBufferList = 0;
-static int afs_buffersAlloced = 0;
+/*
+ * FetchData and StoreData move file data straight between the vnode's file
+ * and the call's packet buffers, with rx_WriteBulk and rx_ReadBulk.
+ */
+struct fileio_rock {
+    FdHandle_t *fdP;
+    afs_foff_t offset;		/* file offset of the next step */
+    int failed;			/* set if the file I/O failed */
+};
 
 static int
-FreeSendBuffer(struct afs_buffer *adata)
+FetchDataProc(void *rock, struct iovec *iov, int nio, int nbytes)
 {
-    FS_LOCK;
-    afs_buffersAlloced--;
-    adata->next = freeBufferList;
-    freeBufferList = adata;
-    FS_UNLOCK;
-    return 0;
+    struct fileio_rock *frock = rock;
+    ssize_t nBytes;
+#ifdef HAVE_PIOV
+    nBytes = FDH_PREADV(frock->fdP, iov, nio, frock->offset);
+#else /* HAVE_PIOV */
+    ssize_t n;
+    int i;
 
-}				/*FreeSendBuffer */
+    for (nBytes = 0, i = 0; i < nio; i++, nBytes += n) {
+	n = FDH_PREAD(frock->fdP, iov[i].iov_base, iov[i].iov_len,
+		      frock->offset + nBytes);
+	if (n != iov[i].iov_len) {
+	    nBytes = -1;
+	    break;
+	}
+    }
+#endif /* HAVE_PIOV */
+    if (nBytes != nbytes) {
+	frock->failed = 1;
+	return EIO;
+    }
+    frock->offset += nbytes;
+    return 0;
+}
 
-/* allocate space for sender */
-static char *
-AllocSendBuffer(void)
+static int
+StoreDataProc(void *rock, struct iovec *iov, int nio, int nbytes)
 {
-    struct afs_buffer *tp;
+    struct fileio_rock *frock = rock;
+    ssize_t nBytes;
+#ifdef HAVE_PIOV
+    nBytes = FDH_PWRITEV(frock->fdP, iov, nio, frock->offset);
+#else /* HAVE_PIOV */
+    ssize_t n;
+    int i;
 
-    FS_LOCK;
-    afs_buffersAlloced++;
-    if (!freeBufferList) {
-	char *tmp;
-	FS_UNLOCK;
-	tmp = malloc(sendBufSize);
-	if (!tmp) {
-	    ViceLogThenPanic(0, ("Failed malloc in AllocSendBuffer\n"));
+    for (nBytes = 0, i = 0; i < nio; i++, nBytes += n) {
+	n = FDH_PWRITE(frock->fdP, iov[i].iov_base, iov[i].iov_len,
+		       frock->offset + nBytes);
+	if (n != iov[i].iov_len) {
+	    nBytes = -1;
+	    break;
 	}
-	return tmp;
     }
-    tp = freeBufferList;
-    freeBufferList = tp->next;
-    FS_UNLOCK;
-    return (char *)tp;
-
-}				/*AllocSendBuffer */
 #endif /* HAVE_PIOV */
+    if (nBytes != nbytes) {
+	frock->failed = 1;
+	return VDISKFULL;
+    }
+    frock->offset += nbytes;
+    return 0;
+}
 
 /*
  * This routine returns the status info associated with the targetptr vnode
@@ -6194,14 +6217,10 @@ FetchData_RXStyle(Volume * volptr, Vnode * targetptr,
     struct timeval StartTime, StopTime;	/* used to calculate file  transfer rates */
     IHandle_t *ihP;
     FdHandle_t *fdP;
-#ifndef HAVE_PIOV
-    char *tbuffer;
-#else /* HAVE_PIOV */
-    struct iovec tiov[RX_MAXIOVECS];
-    int tnio;
-#endif /* HAVE_PIOV */
+    struct fileio_rock frock;
     afs_sfsize_t tlen;
-    afs_int32 optSize;
+    afs_int64 nBytes;
+    int code;
 
     /*
      * Initialize the byte count arguments.
@@ -6233,7 +6252,6 @@ FetchData_RXStyle(Volume * volptr, Vnode * targetptr,
 		    afs_printable_VolumeId_lu(volptr->hashid)));
 	return EIO;
     }
-    optSize = sendBufSize;
     tlen = FDH_SIZE(fdP);
     ViceLog(25,
 	    ("FetchData_RXStyle: file size %llu\n", (afs_uintmax_t) tlen));
@@ -6268,67 +6286,26 @@ FetchData_RXStyle(Volume * volptr, Vnode * targetptr,
 	rx_Write(Call, (char *)&low, sizeof(afs_int32));	/* send length on fetch */
     }
     (*a_bytesToFetchP) = Len;
-#ifndef HAVE_PIOV
-    tbuffer = AllocSendBuffer();
-#endif /* HAVE_PIOV */
-    while (Len > 0) {
-	size_t wlen;
-	ssize_t nBytes;
-	if (Len > optSize)
-	    wlen = optSize;
-	else
-	    wlen = Len;
-#ifndef HAVE_PIOV
-	nBytes = FDH_PREAD(fdP, tbuffer, wlen, Pos);
-	if (nBytes != wlen) {
-	    FDH_CLOSE(fdP);
-	    FreeSendBuffer((struct afs_buffer *)tbuffer);
-	    VTakeOffline(volptr);
-	    ViceLog(0, ("Volume %" AFS_VOLID_FMT " now offline, must be salvaged.\n",
-			afs_printable_VolumeId_lu(volptr->hashid)));
-	    return EIO;
-	}
-	nBytes = rx_Write(Call, tbuffer, wlen);
-#else /* HAVE_PIOV */
-	nBytes = rx_WritevAlloc(Call, tiov, &tnio, RX_MAXIOVECS, wlen);
-	if (nBytes <= 0) {
-	    FDH_CLOSE(fdP);
-	    return EIO;
-	}
-	wlen = nBytes;
-	nBytes = FDH_PREADV(fdP, tiov, tnio, Pos);
-	if (nBytes != wlen) {
-	    FDH_CLOSE(fdP);
+    frock.fdP = fdP;
+    frock.offset = Pos;
+    frock.failed = 0;
+    code = rx_WriteBulk(Call, Len, FetchDataProc, &frock, &nBytes);
+    (*a_bytesFetchedP) = nBytes;
+    if (code) {
+	afs_int32 err;
+	FDH_CLOSE(fdP);
+	if (frock.failed) {
 	    VTakeOffline(volptr);
 	    ViceLog(0, ("Volume %" AFS_VOLID_FMT " now offline, must be salvaged.\n",
 			afs_printable_VolumeId_lu(volptr->hashid)));
 	    return EIO;
 	}
-	nBytes = rx_Writev(Call, tiov, tnio, wlen);
-#endif /* HAVE_PIOV */
-	Pos += wlen;
-	/*
-	 * Bump the number of bytes actually sent by the number from this
-	 * latest iteration
-	 */
-	(*a_bytesFetchedP) += nBytes;
-	if (nBytes != wlen) {
-	    afs_int32 err;
-	    FDH_CLOSE(fdP);
-#ifndef HAVE_PIOV
-	    FreeSendBuffer((struct afs_buffer *)tbuffer);
-#endif /* HAVE_PIOV */
-	    err = VIsGoingOffline(volptr);
-	    if (err) {
-		return err;
-	    }
-	    return -31;
+	err = VIsGoingOffline(volptr);
+	if (err) {
+	    return err;
 	}
-	Len -= wlen;
+	return -31;
     }
-#ifndef HAVE_PIOV
-    FreeSendBuffer((struct afs_buffer *)tbuffer);
-#endif /* HAVE_PIOV */
     FDH_CLOSE(fdP);
     gettimeofday(&StopTime, 0);
 
@@ -6411,17 +6388,11 @@ StoreData_RXStyle(Volume * volptr, Vnode * targetptr, struct AFSFid * Fid,
 		  afs_sfsize_t * a_bytesToStoreP,
 		  afs_sfsize_t * a_bytesStoredP)
 {
-    afs_sfsize_t bytesTransfered;	/* number of bytes actually transfered */
     Error errorCode = 0;		/* Returned error code to caller */
-#ifndef HAVE_PIOV
-    char *tbuffer;	/* data copying buffer */
-#else /* HAVE_PIOV */
-    struct iovec tiov[RX_MAXIOVECS];	/* no data copying with iovec */
-    int tnio;			/* temp for iovec size */
-#endif /* HAVE_PIOV */
+    struct fileio_rock frock;	/* where the data goes in the file */
+    afs_int64 bytesStored;	/* bytes received from the call */
     afs_sfsize_t tlen;		/* temp for xfr length */
     Inode tinode;		/* inode for I/O */
-    afs_int32 optSize;		/* optimal transfer size */
     afs_sfsize_t DataLength = 0;	/* size of inode */
     afs_sfsize_t TruncatedLength;	/* size after ftruncate */
     afs_fsize_t NewLength;	/* size after this store completes */
@@ -6551,16 +6522,11 @@ StoreData_RXStyle(Volume * volptr, Vnode * targetptr, struct AFSFid * Fid,
     /* this bit means that the locks are set and protections are OK */
     rx_SetLocalStatus(Call, 1);
 
-    optSize = sendBufSize;
     ViceLog(25,
 	    ("StoreData_RXStyle: Pos %llu, DataLength %llu, FileLength %llu, Length %llu\n",
 	     (afs_uintmax_t) Pos, (afs_uintmax_t) DataLength,
 	     (afs_uintmax_t) FileLength, (afs_uintmax_t) Length));
 
-    bytesTransfered = 0;
-#ifndef HAVE_PIOV
-    tbuffer = AllocSendBuffer();
-#endif /* HAVE_PIOV */
     /* truncate the file iff it needs it (ftruncate is slow even when its a noop) */
     if (FileLength < DataLength) {
 	errorCode = FDH_TRUNC(fdP, FileLength);
@@ -6589,45 +6555,16 @@ StoreData_RXStyle(Volume * volptr, Vnode * targetptr, struct AFSFid * Fid,
     } else {
 	/* have some data to copy */
 	(*a_bytesToStoreP) = Length;
-	while (1) {
-	    int rlen;
-	    if (bytesTransfered >= Length) {
-		errorCode = 0;
-		break;
-	    }
-	    tlen = Length - bytesTransfered;	/* how much more to do */
-	    if (tlen > optSize)
-		rlen = optSize;	/* bound by buffer size */
-	    else
-		rlen = (int)tlen;
-#ifndef HAVE_PIOV
-	    errorCode = rx_Read(Call, tbuffer, rlen);
-#else /* HAVE_PIOV */
-	    errorCode = rx_Readv(Call, tiov, &tnio, RX_MAXIOVECS, rlen);
-#endif /* HAVE_PIOV */
-	    if (errorCode <= 0) {
-		errorCode = -32;
-		break;
-	    }
-	    (*a_bytesStoredP) += errorCode;
-	    rlen = errorCode;
-#ifndef HAVE_PIOV
-	    nBytes = FDH_PWRITE(fdP, tbuffer, rlen, Pos);
-#else /* HAVE_PIOV */
-	    nBytes = FDH_PWRITEV(fdP, tiov, tnio, Pos);
-#endif /* HAVE_PIOV */
-	    if (nBytes != rlen) {
-		errorCode = VDISKFULL;
-		break;
-	    }
-	    bytesTransfered += rlen;
-	    Pos += rlen;
-	}
+	frock.fdP = fdP;
+	frock.offset = Pos;
+	frock.failed = 0;
+	errorCode = rx_ReadBulk(Call, Length, StoreDataProc, &frock,
+				&bytesStored);
+	(*a_bytesStoredP) = bytesStored;
+	if (errorCode && !frock.failed)
+	    errorCode = -32;
     }
   done:
-#ifndef HAVE_PIOV
-    FreeSendBuffer((struct afs_buffer *)tbuffer);
-#endif /* HAVE_PIOV */
     if (sync) {
 	(void) FDH_SYNC(fdP);
     }
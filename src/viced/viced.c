@@ -654,6 +654,7 @@ PrintCounters(void)
     VPrintExtendedCacheStats(stats_flags);
 #endif
     VPrintCacheStats();
+    ih_PrintStats();
     VPrintDiskStats();
     DStat(&dirbuff, &dircall, &dirio);
     ViceLog(0,
@@ -918,6 +919,7 @@ enum optionsList {
     OPT_fs_state_dont_restore,
     OPT_fs_state_verify,
     OPT_vhashsize,
+    OPT_vnhashsize,
     OPT_vlrudisable,
     OPT_vlruthresh,
     OPT_vlruinterval,
@@ -1052,6 +1054,9 @@ ParseArgs(int argc, char *argv[])
     cmd_AddParmAtOffset(opts, OPT_vhashsize, "-vhashsize",
 			CMD_SINGLE, CMD_OPTIONAL,
 			"log(2) of # of volume hash buckets");
+    cmd_AddParmAtOffset(opts, OPT_vnhashsize, "-vnhashsize",
+			CMD_SINGLE, CMD_OPTIONAL,
+			"log(2) of # of vnode hash buckets");
 
 #ifdef AFS_DEMAND_ATTACH_FS
     /* dafs options */
@@ -1289,6 +1294,13 @@ ParseArgs(int argc, char *argv[])
 	    return -1;
 	}
     }
+    if (cmd_OptionAsInt(opts, OPT_vnhashsize, &optval) == 0) {
+	if (VSetVnodeHashSize(optval)) {
+	    fprintf(stderr, "specified -vnhashsize (%d) is invalid or out "
+		            "of range\n", optval);
+	    return -1;
+	}
+    }
 
 #ifdef AFS_DEMAND_ATTACH_FS
     if (cmd_OptionPresent(opts, OPT_fs_state_dont_save))
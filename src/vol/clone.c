@@ -109,17 +109,15 @@ ci_InitHead(struct clone_head *ah)
     return 0;
 }
 
-/* apply a function to all dudes in the set */
+/* apply a function to each block of dudes in the set */
 int
-ci_Apply(struct clone_head *ah, int (*aproc) (Inode,  void *), void *arock)
+ci_Apply(struct clone_head *ah, int (*aproc) (Inode *, int, void *),
+	 void *arock)
 {
     struct clone_items *ti;
-    int i;
 
     for (ti = ah->first; ti; ti = ti->next) {
-	for (i = 0; i < ti->nitems; i++) {
-	    (*aproc) (ti->data[i], arock);
-	}
+	(*aproc) (ti->data, ti->nitems, arock);
     }
     return 0;
 }
@@ -138,10 +136,10 @@ ci_Destroy(struct clone_head *ah)
 }
 
 static int
-IDecProc(Inode adata, void *arock)
+IDecProc(Inode *adata, int anitems, void *arock)
 {
     struct clone_rock *aparm = (struct clone_rock *)arock;
-    IH_DEC(aparm->h, adata, aparm->vol);
+    IH_DEC_MULTI(aparm->h, adata, anitems, aparm->vol);
     DOPOLL;
     return 0;
 }
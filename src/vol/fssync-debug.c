@@ -106,6 +106,7 @@ static int VGCScanAll(struct cmd_syndesc * as, void * rock);
 static void print_vol_stats_general(VolPkgStats * stats);
 static void print_vol_stats_viceP(struct DiskPartitionStats64 * stats);
 static void print_vol_stats_hash(struct VolumeHashChainStats * stats);
+static void print_vol_stats_vnode(struct VnodeCacheStats * stats);
 #ifdef AFS_DEMAND_ATTACH_FS
 static void print_vol_stats_hdr(struct volume_hdr_LRU_stats * stats);
 #endif
@@ -1015,7 +1016,7 @@ VnQuery(struct cmd_syndesc * as, void * rock)
 	printf("\thashNext        = %p\n", v.hashNext);
 	printf("\tlruNext         = %p\n", v.lruNext);
 	printf("\tlruPrev         = %p\n", v.lruPrev);
-	printf("\thashIndex       = %hu\n", v.hashIndex);
+	printf("\thashIndex       = %u\n", v.hashIndex);
 	printf("\tchanged_newTime = %u\n", (unsigned int) v.changed_newTime);
 	printf("\tchanged_oldTime = %u\n", (unsigned int) v.changed_oldTime);
 	printf("\tdelete          = %u\n", (unsigned int) v.delete);
@@ -1110,11 +1111,14 @@ StatsQuery(struct cmd_syndesc * as, void * rock)
 #endif
 	} else if (!strcasecmp(ti->data, "pkg")) {
 	    command = FSYNC_VOL_STATS_GENERAL;
+	} else if (!strcasecmp(ti->data, "vnode")) {
+	    command = FSYNC_VOL_STATS_VNODE;
 	} else if (!strcasecmp(ti->data, "help")) {
 	    fprintf(stderr, "fssync-debug stats subcommands:\n");
 	    fprintf(stderr, "\tpkg\tgeneral volume package stats\n");
 	    fprintf(stderr, "\tvicep\tvice partition stats\n");
 	    fprintf(stderr, "\thash\tvolume hash chain stats\n");
+	    fprintf(stderr, "\tvnode\tvnode cache stats\n");
 #ifdef AFS_DEMAND_ATTACH_FS
 	    fprintf(stderr, "\thdr\tvolume header cache stats\n");
 	    fprintf(stderr, "\tvlru\tvlru generation stats\n");
@@ -1199,6 +1203,13 @@ StatsQuery(struct cmd_syndesc * as, void * rock)
 		print_vol_stats_hash(&hash_stats);
 		break;
 	    }
+	case FSYNC_VOL_STATS_VNODE:
+	    {
+		struct VnodeCacheStats vnode_stats;
+		memcpy(&vnode_stats, res_buf, sizeof(vnode_stats));
+		print_vol_stats_vnode(&vnode_stats);
+		break;
+	    }
 #ifdef AFS_DEMAND_ATTACH_FS
 	case FSYNC_VOL_STATS_HDR:
 	    {
@@ -1287,6 +1298,28 @@ print_vol_stats_hash(struct VolumeHashChainStats * stats)
     printf("}\n");
 }
 
+static void
+print_vol_stats_vnode(struct VnodeCacheStats * stats)
+{
+    int i;
+
+    printf("VnodeCacheStats = {\n");
+    printf("\thash_size = %u\n", stats->hash_size);
+    printf("\thash_looks = %"AFS_UINT64_FMT"\n", stats->hash_looks);
+    for (i = 0; i < nVNODECLASSES; i++) {
+	printf("\tclass[%s] = {\n", (i == vLarge) ? "large" : "small");
+	printf("\t\tcache_size = %u\n", stats->classes[i].cache_size);
+	printf("\t\tgets = %u\n", stats->classes[i].gets);
+	printf("\t\thits = %u\n", stats->classes[i].hits);
+	printf("\t\treads = %u\n", stats->classes[i].reads);
+	printf("\t\trecycles = %u\n", stats->classes[i].recycles);
+	printf("\t\tallocs = %u\n", stats->classes[i].allocs);
+	printf("\t\twrites = %u\n", stats->classes[i].writes);
+	printf("\t}\n");
+    }
+    printf("}\n");
+}
+
 
 #ifdef AFS_DEMAND_ATTACH_FS
 static void
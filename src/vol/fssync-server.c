@@ -119,6 +119,10 @@ static struct {
 
 static void * FSYNC_salvageThread(void *);
 static void FSYNC_backgroundSalvage(Volume *vp);
+static int FSYNC_registerVolOff_r(Volume *vp, FSSYNC_VolOp_info *info,
+				  SYNC_response *res);
+static int FSYNC_deregisterVolOp_r(Volume *vp, FSSYNC_VolOp_command *vcom,
+				   SYNC_response *res);
 #endif /* AFS_DEMAND_ATTACH_FS */
 
 /* Forward declarations */
@@ -126,16 +130,23 @@ static void * FSYNC_sync(void *);
 static void FSYNC_newconnection(osi_socket afd);
 static void FSYNC_com(osi_socket fd);
 static void FSYNC_Drop(osi_socket fd);
-static void AcceptOn(void);
-static void AcceptOff(void);
+static void AcceptOn_r(void);
+static void AcceptOff_r(void);
 static void InitHandler(void);
-static int AddHandler(osi_socket fd, void (*aproc)(osi_socket));
+static int AddHandler_r(osi_socket fd, void (*aproc)(osi_socket));
 static int FindHandler(osi_socket afd);
 static int FindHandler_r(osi_socket afd);
-static int RemoveHandler(osi_socket afd);
+static int RemoveHandler_r(osi_socket afd);
+#ifdef AFS_DEMAND_ATTACH_FS
+static int FSYNC_disallowSalvsync(void);
+#endif
 #if defined(HAVE_POLL) && defined (AFS_PTHREAD_ENV)
 static void CallHandler(struct pollfd *fds, int nfds, int mask);
 static void GetHandler(struct pollfd *fds, int maxfds, int events, int *nfds);
+static void FSYNC_startWorkers(void);
+static void * FSYNC_workerThread(void *);
+static void FSYNC_queueCom(osi_socket fd);
+static void FSYNC_wakeup(void);
 #else
 static void CallHandler(fd_set * fdsetp);
 static void GetHandler(fd_set * fdsetp, int *maxfdp);
@@ -166,6 +177,7 @@ static afs_int32 FSYNC_com_VnQry(osi_socket fd, SYNC_command * com, SYNC_respons
 static afs_int32 FSYNC_com_StatsOp(osi_socket fd, SYNC_command * com, SYNC_response * res);
 
 static afs_int32 FSYNC_com_StatsOpGeneral(FSSYNC_StatsOp_command * scom, SYNC_response * res);
+static afs_int32 FSYNC_com_StatsOpVnode(FSSYNC_StatsOp_command * scom, SYNC_response * res);
 
 #ifdef AFS_DEMAND_ATTACH_FS
 static afs_int32 FSYNC_com_StatsOpViceP(FSSYNC_StatsOp_command * scom, SYNC_response * res);
@@ -216,7 +228,38 @@ FSYNC_fsInit(void)
 }
 
 #if defined(HAVE_POLL) && defined(AFS_PTHREAD_ENV)
-static struct pollfd FSYNC_readfds[MAXHANDLERS];
+/* one extra slot for the worker wakeup pipe */
+static struct pollfd FSYNC_readfds[MAXHANDLERS + 1];
+
+/*
+ * Commands are executed by a pool of worker threads, so that a command that
+ * has to wait for a volume (e.g. FSYNC_VOL_OFF on a volume that is in use)
+ * does not hold up the commands of the other clients.  FSYNC_sync only
+ * polls the listening socket and the idle client connections; when a client
+ * sends a command, its connection is marked busy and queued for a worker
+ * until the command has been answered.  Each connection is thus serviced by
+ * at most one worker at a time, and the commands of a client (and so the
+ * operations it requests on a given volume) are still processed in the
+ * order they were sent.
+ */
+#define FSYNC_WORKERS (MAXHANDLERS - 1)	/* one per possible client */
+
+/**
+ * a client connection waiting for a worker thread.
+ */
+struct fsync_work_node {
+    struct rx_queue q;
+    osi_socket fd;            /**< client connection */
+    afs_uint32 gen;           /**< handler slot generation when queued */
+};
+static struct {
+    struct rx_queue head;
+    pthread_mutex_t lock;
+    pthread_cond_t cv;
+    pthread_mutex_t res_lock; /**< serializes SYNC_putRes */
+    int wakeup[2];            /**< pipe to interrupt poll() in FSYNC_sync */
+    struct fsync_work_node nodes[MAXHANDLERS]; /**< one per handler slot */
+} fsync_work;
 #else
 static fd_set FSYNC_readfds;
 #endif
@@ -232,7 +275,6 @@ FSYNC_sync(void * args)
 #endif
     SYNC_server_state_t * state = &fssync_server_state;
 #ifdef AFS_DEMAND_ATTACH_FS
-    VThreadOptions_t * thread_opts;
     int min_vinit = 2;
 #else
     /*
@@ -282,31 +324,25 @@ FSYNC_sync(void * args)
     opr_Assert(!code);
 
 #ifdef AFS_DEMAND_ATTACH_FS
-    /*
-     * make sure the volume package is incapable of recursively executing
-     * salvsync calls on this thread, since there is a possibility of
-     * deadlock.
-     */
-    thread_opts = malloc(sizeof(VThreadOptions_t));
-    if (thread_opts == NULL) {
-	Log("failed to allocate memory for thread-specific volume package options structure\n");
+    if (FSYNC_disallowSalvsync())
 	return NULL;
-    }
-    memcpy(thread_opts, &VThread_defaults, sizeof(VThread_defaults));
-    thread_opts->disallow_salvsync = 1;
-    opr_Verify(pthread_setspecific(VThread_key, thread_opts) == 0);
 
     code = VVGCache_PkgInit();
     opr_Assert(code == 0);
 #endif
 
     InitHandler();
-    AcceptOn();
+    ObtainWriteLock(&FSYNC_handler_lock);
+    AcceptOn_r();
+    ReleaseWriteLock(&FSYNC_handler_lock);
+#if defined(HAVE_POLL) && defined(AFS_PTHREAD_ENV)
+    FSYNC_startWorkers();
+#endif
 
     for (;;) {
 #if defined(HAVE_POLL) && defined(AFS_PTHREAD_ENV)
         int nfds;
-        GetHandler(FSYNC_readfds, MAXHANDLERS, POLLIN|POLLPRI, &nfds);
+        GetHandler(FSYNC_readfds, MAXHANDLERS + 1, POLLIN|POLLPRI, &nfds);
         if (poll(FSYNC_readfds, nfds, -1) >=1)
 	    CallHandler(FSYNC_readfds, nfds, POLLIN|POLLPRI);
 #else
@@ -331,6 +367,37 @@ FSYNC_sync(void * args)
     AFS_UNREACHED(return(NULL)); /* hush now, little gcc */
 }
 
+#ifdef AFS_DEMAND_ATTACH_FS
+/**
+ * forbid SALVSYNC calls on the calling thread.
+ *
+ * Make sure the volume package is incapable of recursively executing
+ * salvsync calls on the FSSYNC threads, since there is a possibility of
+ * deadlock.
+ *
+ * @return operation status
+ *    @retval 0 success
+ *    @retval -1 out of memory
+ *
+ * @note DEMAND_ATTACH_FS only
+ */
+static int
+FSYNC_disallowSalvsync(void)
+{
+    VThreadOptions_t * thread_opts;
+
+    thread_opts = malloc(sizeof(VThreadOptions_t));
+    if (thread_opts == NULL) {
+	Log("failed to allocate memory for thread-specific volume package options structure\n");
+	return -1;
+    }
+    memcpy(thread_opts, &VThread_defaults, sizeof(VThread_defaults));
+    thread_opts->disallow_salvsync = 1;
+    opr_Verify(pthread_setspecific(VThread_key, thread_opts) == 0);
+    return 0;
+}
+#endif /* AFS_DEMAND_ATTACH_FS */
+
 #ifdef AFS_DEMAND_ATTACH_FS
 /**
  * thread for salvaging volumes in the background.
@@ -413,6 +480,78 @@ FSYNC_backgroundSalvage(Volume *vp)
     queue_Append(&fsync_salv.head, node);
     opr_cv_broadcast(&fsync_salv.cv);
 }
+
+/**
+ * register an offline volume operation with a volume.
+ *
+ * FSYNC_com_VolOff checks that nobody else has the volume checked out
+ * before it waits for the volume, and VOL_LOCK is dropped while it waits.
+ * Commands from other clients run concurrently on the FSSYNC worker
+ * threads, so check again before registering our op.
+ *
+ * @param[in]  vp    volume object pointer
+ * @param[in]  info  volume operation info
+ * @param[out] res   response, whose reason is set if the volume was taken
+ *
+ * @return operation status
+ *    @retval 0 volume op registered
+ *    @retval 1 another program checked out the volume first
+ *
+ * @pre VOL_LOCK held
+ *
+ * @note DEMAND_ATTACH_FS only
+ */
+static int
+FSYNC_registerVolOff_r(Volume *vp, FSSYNC_VolOp_info *info,
+		       SYNC_response *res)
+{
+    if (vp->pending_vol_op &&
+	vp->pending_vol_op->com.programType != info->com.programType) {
+	Log("volume %" AFS_VOLID_FMT " was checked out by programType id %d "
+	    "while we waited for it\n", afs_printable_VolumeId_lu(vp->hashid),
+	    vp->pending_vol_op->com.programType);
+	res->hdr.reason = FSYNC_EXCLUSIVE;
+	return 1;
+    }
+    VRegisterVolOp_r(vp, info);
+    return 0;
+}
+
+/**
+ * deregister the volume operation of the requesting program.
+ *
+ * FSYNC_com_VolOn checks that the volume is not checked out by another
+ * program before it waits for the volume, and VOL_LOCK is dropped while it
+ * waits.  Another client may check out the volume in the meantime, so check
+ * again before removing the pending op.
+ *
+ * @param[in]  vp    volume object pointer
+ * @param[in]  vcom  volume command object
+ * @param[out] res   response, whose reason is set if the volume was taken
+ *
+ * @return operation status
+ *    @retval 0 volume op deregistered
+ *    @retval 1 the volume is checked out by another program
+ *
+ * @pre VOL_LOCK held
+ *
+ * @note DEMAND_ATTACH_FS only
+ */
+static int
+FSYNC_deregisterVolOp_r(Volume *vp, FSSYNC_VolOp_command *vcom,
+			SYNC_response *res)
+{
+    if (vp->pending_vol_op &&
+	vp->pending_vol_op->com.programType != vcom->hdr->programType) {
+	Log("volume %" AFS_VOLID_FMT " was checked out by programType id %d "
+	    "while we waited for it\n", afs_printable_VolumeId_lu(vp->hashid),
+	    vp->pending_vol_op->com.programType);
+	res->hdr.reason = FSYNC_EXCLUSIVE;
+	return 1;
+    }
+    VDeregisterVolOp_r(vp);
+    return 0;
+}
 #endif /* AFS_DEMAND_ATTACH_FS */
 
 static void
@@ -430,10 +569,13 @@ FSYNC_newconnection(osi_socket afd)
     if (fd == OSI_NULLSOCKET) {
 	Log("FSYNC_newconnection:  accept failed, errno==%d\n", errno);
 	opr_abort();
-    } else if (!AddHandler(fd, FSYNC_com)) {
-	AcceptOff();
-	opr_Verify(AddHandler(fd, FSYNC_com));
     }
+    ObtainWriteLock(&FSYNC_handler_lock);
+    if (!AddHandler_r(fd, FSYNC_com)) {
+	AcceptOff_r();
+	opr_Verify(AddHandler_r(fd, FSYNC_com));
+    }
+    ReleaseWriteLock(&FSYNC_handler_lock);
 }
 
 /* this function processes commands from an fssync file descriptor (fd) */
@@ -524,6 +666,7 @@ FSYNC_com(osi_socket fd)
     case FSYNC_VOL_STATS_HASH:
     case FSYNC_VOL_STATS_HDR:
     case FSYNC_VOL_STATS_VLRU:
+    case FSYNC_VOL_STATS_VNODE:
 	res.hdr.response = FSYNC_com_StatsOp(fd, &com, &res);
 	break;
     case FSYNC_VOL_QUERY_VNODE:
@@ -549,7 +692,14 @@ FSYNC_com(osi_socket fd)
                   FSYNC_reason2string(res.hdr.reason)));
 
  respond:
+#if defined(HAVE_POLL) && defined(AFS_PTHREAD_ENV)
+    /* SYNC_putRes bumps the sequence numbers in fssync_server_state */
+    opr_mutex_enter(&fsync_work.res_lock);
+    SYNC_putRes(&fssync_server_state, fd, &res);
+    opr_mutex_exit(&fsync_work.res_lock);
+#else
     SYNC_putRes(&fssync_server_state, fd, &res);
+#endif
 
  done:
     if (res.hdr.flags & SYNC_FLAG_CHANNEL_SHUTDOWN) {
@@ -727,8 +877,11 @@ FSYNC_com_VolOn(FSSYNC_VolOp_command * vcom, SYNC_response * res)
 	    if (FSYNC_partMatch(vcom, vp, 1)) {
 		if ((V_attachState(vp) == VOL_STATE_UNATTACHED) ||
 		    (V_attachState(vp) == VOL_STATE_PREATTACHED)) {
-		    VChangeState_r(vp, VOL_STATE_UNATTACHED);
-		    VDeregisterVolOp_r(vp);
+		    if (FSYNC_deregisterVolOp_r(vp, vcom, res)) {
+			code = SYNC_DENIED;
+		    } else {
+			VChangeState_r(vp, VOL_STATE_UNATTACHED);
+		    }
 		} else {
 		    code = SYNC_DENIED;
 		    res->hdr.reason = FSYNC_BAD_STATE;
@@ -773,9 +926,14 @@ FSYNC_com_VolOn(FSSYNC_VolOp_command * vcom, SYNC_response * res)
     if (vp) {
 	VCreateReservation_r(vp);
 	VWaitExclusiveState_r(vp);
-	VDeregisterVolOp_r(vp);
+	if (FSYNC_deregisterVolOp_r(vp, vcom, res)) {
+	    code = SYNC_DENIED;
+	}
 	VCancelReservation_r(vp);
 	vp = NULL;
+	if (code != SYNC_OK) {
+	    goto done;
+	}
     }
 #else /* !AFS_DEMAND_ATTACH_FS */
     tvolName[0] = OS_DIRSEPC;
@@ -995,7 +1153,8 @@ FSYNC_com_VolOff(FSSYNC_VolOp_command * vcom, SYNC_response * res)
 	     * if the volume is currently pre-attached, attach2()
 	     * will evaluate the vol op metadata to determine whether
 	     * attaching the volume would be safe */
-	    VRegisterVolOp_r(vp, &info);
+	    if (FSYNC_registerVolOff_r(vp, &info, res))
+		goto deny;
 	    vp->pending_vol_op->vol_op_state = FSSYNC_VolOpRunningUnknown;
 	    goto done;
 
@@ -1025,7 +1184,8 @@ FSYNC_com_VolOff(FSSYNC_VolOp_command * vcom, SYNC_response * res)
                  * if the volume is currently pre-attached, attach2()
                  * will evaluate the vol op metadata to determine whether
                  * attaching the volume would be safe */
-                VRegisterVolOp_r(vp, &info);
+		if (FSYNC_registerVolOff_r(vp, &info, res))
+		    goto deny;
                 vp->pending_vol_op->vol_op_state = FSSYNC_VolOpRunningUnknown;
 		goto done;
 
@@ -1051,7 +1211,10 @@ FSYNC_com_VolOff(FSSYNC_VolOp_command * vcom, SYNC_response * res)
 	rvp = NULL;
 
 	/* register the volume operation metadata with the volume */
-	VRegisterVolOp_r(vp, &info);
+	if (FSYNC_registerVolOff_r(vp, &info, res)) {
+	    VPutVolume_r(vp);
+	    goto deny;
+	}
 
     }
 #endif /* AFS_DEMAND_ATTACH_FS */
@@ -1823,6 +1986,9 @@ FSYNC_com_StatsOp(osi_socket fd, SYNC_command * com, SYNC_response * res)
     case FSYNC_VOL_STATS_GENERAL:
 	code = FSYNC_com_StatsOpGeneral(&scom, res);
 	break;
+    case FSYNC_VOL_STATS_VNODE:
+	code = FSYNC_com_StatsOpVnode(&scom, res);
+	break;
 #ifdef AFS_DEMAND_ATTACH_FS
 	/* statistics for the following subsystems are only tracked
 	 * for demand attach fileservers */
@@ -1857,6 +2023,19 @@ FSYNC_com_StatsOpGeneral(FSSYNC_StatsOp_command * scom, SYNC_response * res)
     return code;
 }
 
+static afs_int32
+FSYNC_com_StatsOpVnode(FSSYNC_StatsOp_command * scom, SYNC_response * res)
+{
+    afs_int32 code = SYNC_OK;
+    struct VnodeCacheStats * stats;
+
+    stats = (struct VnodeCacheStats *) res->payload.buf;
+    VGetVnodeCacheStats_r(stats);
+    res->hdr.response_len += sizeof(struct VnodeCacheStats);
+
+    return code;
+}
+
 #ifdef AFS_DEMAND_ATTACH_FS
 static afs_int32
 FSYNC_com_StatsOpViceP(FSSYNC_StatsOp_command * scom, SYNC_response * res)
@@ -2019,27 +2198,31 @@ FSYNC_Drop(osi_socket fd)
 	}
     }
     VOL_UNLOCK;
-    RemoveHandler(fd);
+    ObtainWriteLock(&FSYNC_handler_lock);
+    RemoveHandler_r(fd);
+    AcceptOn_r();
+    ReleaseWriteLock(&FSYNC_handler_lock);
     rk_closesocket(fd);
-    AcceptOn();
 }
 
 static int AcceptHandler = -1;	/* handler id for accept, if turned on */
 
+/* Must be called with a write lock on FSYNC_handler_lock. */
 static void
-AcceptOn(void)
+AcceptOn_r(void)
 {
     if (AcceptHandler == -1) {
-	opr_Verify(AddHandler(fssync_server_state.fd, FSYNC_newconnection));
-	AcceptHandler = FindHandler(fssync_server_state.fd);
+	opr_Verify(AddHandler_r(fssync_server_state.fd, FSYNC_newconnection));
+	AcceptHandler = FindHandler_r(fssync_server_state.fd);
     }
 }
 
+/* Must be called with a write lock on FSYNC_handler_lock. */
 static void
-AcceptOff(void)
+AcceptOff_r(void)
 {
     if (AcceptHandler != -1) {
-	opr_Verify(RemoveHandler(fssync_server_state.fd));
+	opr_Verify(RemoveHandler_r(fssync_server_state.fd));
 	AcceptHandler = -1;
     }
 }
@@ -2048,6 +2231,8 @@ AcceptOff(void)
 
 static osi_socket HandlerFD[MAXHANDLERS];
 static void (*HandlerProc[MAXHANDLERS]) (osi_socket);
+static int HandlerBusy[MAXHANDLERS];	/* command being run by a worker */
+static afs_uint32 HandlerGen[MAXHANDLERS]; /* bumped when a slot is freed */
 
 static void
 InitHandler(void)
@@ -2070,9 +2255,18 @@ CallHandler(struct pollfd *fds, int nfds, int mask)
     ObtainReadLock(&FSYNC_handler_lock);
     for (i = 0; i < nfds; i++) {
         if (fds[i].revents & mask) {
+	    if (fds[i].fd == fsync_work.wakeup[0]) {
+		char buf[16];
+		while (read(fds[i].fd, buf, sizeof(buf)) > 0)
+		    continue;
+		continue;
+	    }
 	    handler = FindHandler_r(fds[i].fd);
             ReleaseReadLock(&FSYNC_handler_lock);
-            (*HandlerProc[handler]) (fds[i].fd);
+	    if (HandlerProc[handler] == FSYNC_com)
+		FSYNC_queueCom(fds[i].fd);
+	    else
+		(*HandlerProc[handler]) (fds[i].fd);
 	    ObtainReadLock(&FSYNC_handler_lock);
         }
     }
@@ -2095,21 +2289,20 @@ CallHandler(fd_set * fdsetp)
 }
 #endif
 
+/* Must be called with a write lock on FSYNC_handler_lock. */
 static int
-AddHandler(osi_socket afd, void (*aproc) (osi_socket))
+AddHandler_r(osi_socket afd, void (*aproc) (osi_socket))
 {
     int i;
-    ObtainWriteLock(&FSYNC_handler_lock);
     for (i = 0; i < MAXHANDLERS; i++)
 	if (HandlerFD[i] == OSI_NULLSOCKET)
 	    break;
     if (i >= MAXHANDLERS) {
-	ReleaseWriteLock(&FSYNC_handler_lock);
 	return 0;
     }
     HandlerFD[i] = afd;
     HandlerProc[i] = aproc;
-    ReleaseWriteLock(&FSYNC_handler_lock);
+    HandlerBusy[i] = 0;
     return 1;
 }
 
@@ -2140,12 +2333,14 @@ FindHandler_r(osi_socket afd)
     AFS_UNREACHED(return(-1));			/* satisfy compiler */
 }
 
+/* Must be called with a write lock on FSYNC_handler_lock. */
 static int
-RemoveHandler(osi_socket afd)
+RemoveHandler_r(osi_socket afd)
 {
-    ObtainWriteLock(&FSYNC_handler_lock);
-    HandlerFD[FindHandler_r(afd)] = OSI_NULLSOCKET;
-    ReleaseWriteLock(&FSYNC_handler_lock);
+    int i = FindHandler_r(afd);
+
+    HandlerFD[i] = OSI_NULLSOCKET;
+    HandlerGen[i]++;
     return 1;
 }
 
@@ -2157,13 +2352,18 @@ GetHandler(struct pollfd *fds, int maxfds, int events, int *nfds)
     int fdi = 0;
     ObtainReadLock(&FSYNC_handler_lock);
     for (i = 0; i < MAXHANDLERS; i++)
-	if (HandlerFD[i] != OSI_NULLSOCKET) {
+	if (HandlerFD[i] != OSI_NULLSOCKET && !HandlerBusy[i]) {
 	    opr_Assert(fdi<maxfds);
 	    fds[fdi].fd = HandlerFD[i];
 	    fds[fdi].events = events;
 	    fds[fdi].revents = 0;
 	    fdi++;
 	}
+    opr_Assert(fdi<maxfds);
+    fds[fdi].fd = fsync_work.wakeup[0];
+    fds[fdi].events = events;
+    fds[fdi].revents = 0;
+    fdi++;
     *nfds = fdi;
     ReleaseReadLock(&FSYNC_handler_lock);
 }
@@ -2189,4 +2389,124 @@ GetHandler(fd_set * fdsetp, int *maxfdp)
 }
 #endif /* HAVE_POLL && AFS_PTHREAD_ENV */
 
+#if defined(HAVE_POLL) && defined(AFS_PTHREAD_ENV)
+/**
+ * start the FSSYNC worker threads.
+ */
+static void
+FSYNC_startWorkers(void)
+{
+    pthread_t tid;
+    pthread_attr_t tattr;
+    int i;
+
+    queue_Init(&fsync_work.head);
+    opr_mutex_init(&fsync_work.lock);
+    opr_cv_init(&fsync_work.cv);
+    opr_mutex_init(&fsync_work.res_lock);
+    opr_Verify(pipe(fsync_work.wakeup) == 0);
+    for (i = 0; i < 2; i++) {
+	opr_Verify(fcntl(fsync_work.wakeup[i], F_SETFL,
+			 fcntl(fsync_work.wakeup[i], F_GETFL) | O_NONBLOCK) == 0);
+    }
+
+    opr_Verify(pthread_attr_init(&tattr) == 0);
+    opr_Verify(pthread_attr_setdetachstate(&tattr,
+					   PTHREAD_CREATE_DETACHED) == 0);
+    for (i = 0; i < FSYNC_WORKERS; i++) {
+	opr_Verify(pthread_create(&tid, &tattr, FSYNC_workerThread, NULL) == 0);
+    }
+}
+
+/**
+ * thread for executing FSSYNC commands.
+ *
+ * @param[in] args  unused
+ */
+static void *
+FSYNC_workerThread(void * args)
+{
+    struct fsync_work_node *node;
+    osi_socket fd;
+    afs_uint32 gen;
+    int slot;
+    int tid;
+
+    /* set our 'thread-id' so that the host hold table works */
+    tid = rx_SetThreadNum();
+    Log("Set thread id %d for FSYNC_worker\n", tid);
+    opr_threadname_set("FSYNC_worker");
+
+#ifdef AFS_DEMAND_ATTACH_FS
+    if (FSYNC_disallowSalvsync())
+	return NULL;
+#endif
+
+    for (;;) {
+	opr_mutex_enter(&fsync_work.lock);
+	while (queue_IsEmpty(&fsync_work.head)) {
+	    opr_cv_wait(&fsync_work.cv, &fsync_work.lock);
+	}
+	node = queue_First(&fsync_work.head, fsync_work_node);
+	queue_Remove(node);
+	slot = node - fsync_work.nodes;
+	fd = node->fd;
+	gen = node->gen;
+	opr_mutex_exit(&fsync_work.lock);
+
+	FSYNC_com(fd);
+
+	/*
+	 * Hand the connection back to FSYNC_sync, unless the command caused
+	 * it to be dropped; the slot may have been reused for a new
+	 * connection since then.
+	 */
+	ObtainWriteLock(&FSYNC_handler_lock);
+	if (HandlerGen[slot] == gen)
+	    HandlerBusy[slot] = 0;
+	ReleaseWriteLock(&FSYNC_handler_lock);
+	FSYNC_wakeup();
+    }
+    AFS_UNREACHED(return(NULL));
+}
+
+/**
+ * hand a client connection with a pending command to a worker thread.
+ *
+ * @param[in] fd  client connection
+ */
+static void
+FSYNC_queueCom(osi_socket fd)
+{
+    struct fsync_work_node *node;
+    int slot;
+
+    ObtainWriteLock(&FSYNC_handler_lock);
+    slot = FindHandler_r(fd);
+    HandlerBusy[slot] = 1;
+    node = &fsync_work.nodes[slot];
+    node->fd = fd;
+    node->gen = HandlerGen[slot];
+    ReleaseWriteLock(&FSYNC_handler_lock);
+
+    opr_mutex_enter(&fsync_work.lock);
+    queue_Append(&fsync_work.head, node);
+    opr_cv_signal(&fsync_work.cv);
+    opr_mutex_exit(&fsync_work.lock);
+}
+
+/**
+ * make FSYNC_sync rebuild its poll set.
+ */
+static void
+FSYNC_wakeup(void)
+{
+    char c = 0;
+
+    /* EAGAIN just means that FSYNC_sync already has a wakeup pending */
+    if (write(fsync_work.wakeup[1], &c, 1) < 0 && errno != EAGAIN)
+	Log("FSYNC_wakeup: write failed, errno==%d\n", errno);
+}
+#endif /* HAVE_POLL && AFS_PTHREAD_ENV */
+
 #endif /* FSSYNC_BUILD_SERVER */
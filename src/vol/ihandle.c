@@ -37,6 +37,7 @@
 #include "nfs.h"
 #include "ihandle.h"
 #include "viceinode.h"
+#include "common.h"
 
 #ifdef AFS_PTHREAD_ENV
 pthread_once_t ih_glock_once = PTHREAD_ONCE_INIT;
@@ -78,6 +79,9 @@ int fdInUseCount = 0;
 /* Hash table for inode handles */
 IHashBucket_t ihashTable[I_HANDLE_HASH_SIZE];
 
+/* fd cache and ih_glock statistics */
+struct ih_cache_stats ih_stats;
+
 static int _ih_release_r(IHandle_t * ihP);
 
 /* start-time configurable I/O limits */
@@ -106,8 +110,13 @@ ih_PkgDefaults(void)
     vol_io_params.fd_initial_cachesize = FD_DEFAULT_CACHESIZE;
 
     /* fd cache size that will be used if/when ih_UseLargeCache()
-     * is called */
+     * is called.  unless told otherwise, size it from the open file
+     * limit of the process. */
+#ifdef AFS_NT40_ENV
     vol_io_params.fd_max_cachesize = FD_MAX_CACHESIZE;
+#else
+    vol_io_params.fd_max_cachesize = FD_MAX_CACHESIZE_AUTO;
+#endif
 
     vol_io_params.sync_behavior = IH_SYNC_ONCLOSE;
     IH_UNLOCK;
@@ -178,7 +187,8 @@ ih_Initialize(void)
 	 */
 	fdMaxCacheSize /= 4;
 #endif
-	fdMaxCacheSize = min(fdMaxCacheSize, vol_io_params.fd_max_cachesize);
+	if (vol_io_params.fd_max_cachesize != FD_MAX_CACHESIZE_AUTO)
+	    fdMaxCacheSize = min(fdMaxCacheSize, vol_io_params.fd_max_cachesize);
 	opr_Assert(fdMaxCacheSize > 0);
     }
 #elif defined(AFS_HPUX_ENV)
@@ -186,9 +196,29 @@ ih_Initialize(void)
     fdMaxCacheSize = 0;
 #else
     {
-	long fdMax = max(sysconf(_SC_OPEN_MAX) - vol_io_params.fd_handle_setaside,
-					 0);
-	fdMaxCacheSize = (int)min(fdMax, vol_io_params.fd_max_cachesize);
+	long fdMax;
+	long fdLimit = vol_io_params.fd_max_cachesize;
+
+	if (fdLimit == FD_MAX_CACHESIZE_AUTO) {
+#ifdef HAVE_SYS_RESOURCE_H
+	    /* Raise the soft limit as far as we may, so a busy fileserver
+	     * can keep its working set of files open instead of closing
+	     * and reopening them. If this fails, we just live with the
+	     * current limit. */
+	    struct rlimit rlim;
+	    rlim_t want = FD_AUTO_CACHESIZE_LIMIT + vol_io_params.fd_handle_setaside;
+
+	    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur < want
+		&& rlim.rlim_cur < rlim.rlim_max) {
+		rlim.rlim_cur = min(rlim.rlim_max, want);
+		(void)setrlimit(RLIMIT_NOFILE, &rlim);
+	    }
+#endif
+	    fdLimit = FD_AUTO_CACHESIZE_LIMIT;
+	}
+	fdMax = max(sysconf(_SC_OPEN_MAX) - vol_io_params.fd_handle_setaside,
+		    0);
+	fdMaxCacheSize = (int)min(fdMax, fdLimit);
     }
 #endif
     fdCacheSize = min(fdMaxCacheSize, vol_io_params.fd_initial_cachesize);
@@ -215,6 +245,39 @@ ih_UseLargeCache(void)
     IH_UNLOCK;
 }
 
+/* Get a snapshot of the fd cache statistics */
+void
+ih_GetStats(struct ih_cache_stats *stats)
+{
+    IH_LOCK;
+    *stats = ih_stats;
+    IH_UNLOCK;
+}
+
+/* Log the fd cache statistics */
+void
+ih_PrintStats(void)
+{
+    struct ih_cache_stats stats;
+    int cacheSize, inUse;
+
+    IH_LOCK;
+    stats = ih_stats;
+    cacheSize = fdCacheSize;
+    inUse = fdInUseCount;
+    IH_UNLOCK;
+
+    Log("File descriptor cache, %d entries (max %d), %d open, "
+	"%"AFS_UINT64_FMT" opens, %"AFS_UINT64_FMT" hits, "
+	"%"AFS_UINT64_FMT" misses, %"AFS_UINT64_FMT" evictions, "
+	"%"AFS_UINT64_FMT" overflow closes, %"AFS_UINT64_FMT" EMFILE\n",
+	cacheSize, fdMaxCacheSize, inUse, stats.opens, stats.hits,
+	stats.misses, stats.evictions, stats.overflows, stats.emfiles);
+    Log("ihandle lock, %"AFS_UINT64_FMT" acquisitions, "
+	"%"AFS_UINT64_FMT" contended\n",
+	stats.lock_acquires, stats.lock_waits);
+}
+
 /* Allocate a chunk of inode handles */
 void
 iHandleAllocateChunk(void)
@@ -356,6 +419,7 @@ ih_attachfd_r(IHandle_t *ihP, FD_t fd)
 	DLL_DELETE(fdP, fdP->fd_ih->ih_fdhead, fdP->fd_ih->ih_fdtail,
 		   fd_ihnext, fd_ihprev);
 	closeFd = fdP->fd_fd;
+	ih_stats.evictions++;
 	if (fd == INVALID_FD) {
 	    fdCacheSize--;          /* reduce in order to not run into here too often */
 	    DLL_INSERT_TAIL(fdP, fdAvailHead, fdAvailTail, fd_next, fd_prev);
@@ -433,6 +497,7 @@ ih_open(IHandle_t * ihP)
 	return NULL;
 
     IH_LOCK;
+    ih_stats.opens++;
 
     /* Do we already have an open file handle for this Inode? */
     for (fdP = ihP->ih_fdtail; fdP != NULL; fdP = fdP->fd_ihprev) {
@@ -460,6 +525,7 @@ ih_open(IHandle_t * ihP)
 	    DLL_DELETE(fdP, fdLruHead, fdLruTail, fd_next, fd_prev);
 	}
 	ihP->ih_refcnt++;
+	ih_stats.hits++;
 	IH_UNLOCK;
 	return fdP;
     }
@@ -468,10 +534,13 @@ ih_open(IHandle_t * ihP)
      * Try to open the Inode, return NULL on error.
      */
     fdInUseCount += 1;
+    ih_stats.misses++;
     IH_UNLOCK;
 ih_open_retry:
     fd = OS_IOPEN(ihP);
     IH_LOCK;
+    if (fd == INVALID_FD && errno == EMFILE)
+	ih_stats.emfiles++;
     if (fd == INVALID_FD && (errno != EMFILE || fdLruHead == NULL) ) {
 	fdInUseCount -= 1;
 	IH_UNLOCK;
@@ -516,6 +585,8 @@ fd_close(FdHandle_t * fdP)
      */
     if (fdP->fd_status == FD_HANDLE_CLOSING ||
         ihP->ih_flags & IH_REALLY_CLOSED || fdInUseCount > fdCacheSize) {
+	if (fdInUseCount > fdCacheSize)
+	    ih_stats.overflows++;
 	IH_UNLOCK;
 	return fd_reallyclose(fdP);
     }
@@ -1085,6 +1156,21 @@ ih_icreate_init(IHandle_t *lh, int dev, char *part, Inode nearInode,
     IH_INIT(ihP, dev, p1, ino);
     return ihP;
 }
+
+/* Unix namei batches the link table updates for IH_DEC_MULTI; everyone else
+ * just decrements the inodes one at a time. */
+int
+ih_decmulti(IHandle_t *ih, Inode *inos, int ninos, int p1)
+{
+    int i;
+    int code = 0;
+
+    for (i = 0; i < ninos; i++) {
+	if (IH_DEC(ih, inos[i], p1) < 0)
+	    code = -1;
+    }
+    return code;
+}
 #endif
 
 afs_sfsize_t
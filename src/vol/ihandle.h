@@ -56,6 +56,7 @@
  *	file descriptor.
  * IH_IREAD/IH_IWRITE - read/write an Inode.
  * IH_INC/IH_DEC - increment/decrement the link count.
+ * IH_DEC_MULTI - decrement the link counts of an array of inodes.
  *
  * Replacements for C runtime file operations
  * FDH_CLOSE - return a file descriptor to the cache
@@ -86,7 +87,11 @@ extern pthread_mutex_t ih_glock_mutex;
 extern void ih_glock_init(void);
 # define IH_LOCK \
     do { opr_Verify(pthread_once(&ih_glock_once, ih_glock_init) == 0);	\
-	opr_mutex_enter(&ih_glock_mutex); \
+	if (!opr_mutex_tryenter(&ih_glock_mutex)) { \
+	    opr_mutex_enter(&ih_glock_mutex); \
+	    ih_stats.lock_waits++; \
+	} \
+	ih_stats.lock_acquires++; \
     } while (0)
 # define IH_UNLOCK opr_mutex_exit(&ih_glock_mutex)
 #else /* AFS_PTHREAD_ENV */
@@ -245,6 +250,20 @@ typedef struct ih_init_params
     int sync_behavior; /* one of the IH_SYNC_* constants */
 } ih_init_params;
 
+/* ihandle package statistics.  All counters are protected by IH_LOCK. */
+struct ih_cache_stats {
+    afs_uint64 opens;		/* ih_open calls */
+    afs_uint64 hits;		/* ih_opens satisfied by a cached fd */
+    afs_uint64 misses;		/* ih_opens that had to open the file */
+    afs_uint64 evictions;	/* cached fds closed to make room */
+    afs_uint64 overflows;	/* fds closed on fd_close because the
+				 * cache was full */
+    afs_uint64 emfiles;		/* opens that failed with EMFILE */
+    afs_uint64 lock_acquires;	/* IH_LOCK acquisitions */
+    afs_uint64 lock_waits;	/* IH_LOCK acquisitions that had to wait */
+};
+extern struct ih_cache_stats ih_stats;
+
 /* Number of file descriptors needed for non-cached I/O */
 #define FD_HANDLE_SETASIDE	128 /* Match to MAX_FILESERVER_THREAD */
 
@@ -264,6 +283,15 @@ typedef struct ih_init_params
  */
 #define FD_MAX_CACHESIZE (2000 - FD_HANDLE_SETASIDE)
 
+/* fd_max_cachesize value asking ih_Initialize to derive the limit from
+ * RLIMIT_NOFILE, raising the soft limit to the hard limit first.  This is
+ * the default on platforms where FD_MAX_CACHESIZE does not apply. */
+#define FD_MAX_CACHESIZE_AUTO 0
+
+/* Upper bound on an automatically derived cache size, for platforms
+ * reporting an unlimited RLIMIT_NOFILE. */
+#define FD_AUTO_CACHESIZE_LIMIT (1024 * 1024)
+
 /* On modern platforms, this is sized higher than the note implies.
  * For HP, see http://forums11.itrc.hp.com/service/forums/questionanswer.do?admit=109447626+1242508538748+28353475&threadId=302950
  * On AIX, it's said to be self-tuning (sar -v)
@@ -325,6 +353,8 @@ extern FD_t *ih_fdopen(FdHandle_t * h, char *fdperms);
 extern void ih_PkgDefaults(void);
 extern void ih_Initialize(void);
 extern void ih_UseLargeCache(void);
+extern void ih_GetStats(struct ih_cache_stats *stats);
+extern void ih_PrintStats(void);
 extern int ih_SetSyncBehavior(const char *behavior);
 extern IHandle_t *ih_init(int /*@alt Device@ */ dev, int /*@alt VolId@ */ vid,
 			  Inode ino);
@@ -430,6 +460,8 @@ extern int ih_isunlinked(FD_t fd);
 #if defined(AFS_NT40_ENV) || !defined(AFS_NAMEI_ENV)
 # define  IH_CREATE_INIT(H, D, P, N, P1, P2, P3, P4) \
          ih_icreate_init(H, D, P, N, P1, P2, P3, P4)
+extern int ih_decmulti(IHandle_t *ih, Inode *inos, int ninos, int p1);
+# define IH_DEC_MULTI(H, I, N, P) ih_decmulti(H, I, N, P)
 #endif
 
 #ifdef AFS_NAMEI_ENV
@@ -504,6 +536,9 @@ extern int OS_TRUNC(FD_t FD, OFFT L);
 # endif /* AFS_NT40_ENV */
 # define IH_INC(H, I, P) namei_inc(H, I, P)
 # define IH_DEC(H, I, P) namei_dec(H, I, P)
+# ifndef AFS_NT40_ENV
+#  define IH_DEC_MULTI(H, I, N, P) namei_decmulti(H, I, N, P)
+# endif
 # define IH_IREAD(H, O, B, S) namei_iread(H, O, B, S)
 # define IH_IWRITE(H, O, B, S) namei_iwrite(H, O, B, S)
 # define IH_CREATE(H, D, P, N, P1, P2, P3, P4) \
@@ -1736,6 +1736,195 @@ namei_UnlockLinkCount(FdHandle_t * fdP, Inode ino)
     FDH_UNLOCKFILE(fdP, offset);
 }
 
+#ifndef AFS_NT40_ENV
+/*
+ * Largest span of the link table, in bytes, that namei_decmulti reads and
+ * rewrites with a single pread/pwrite pair.
+ */
+#define NAMEI_DECMULTI_SPAN 8192
+
+struct namei_decent {
+    afs_foff_t offset;		/* link table row offset */
+    int index;			/* bit offset of our column within the row */
+    int unlink;			/* link count dropped to zero */
+    Inode ino;
+};
+
+static int
+namei_CompareDecEnt(const void *a, const void *b)
+{
+    const struct namei_decent *ea = a;
+    const struct namei_decent *eb = b;
+
+    if (ea->offset < eb->offset)
+	return -1;
+    if (ea->offset > eb->offset)
+	return 1;
+    return 0;
+}
+
+/**
+ * decrement the link counts of several inodes sharing a link table.
+ *
+ * Equivalent to calling namei_dec for each inode, but the link table is
+ * locked, read, written and synced once per batch instead of once per inode.
+ * Rows are read and rewritten in spans of at most NAMEI_DECMULTI_SPAN bytes,
+ * and files are only unlinked after the new counts have been synced to disk,
+ * as namei_dec does.
+ *
+ * @param[in] ih     link table handle
+ * @param[in] inos   inodes to decrement; may contain duplicates
+ * @param[in] ninos  number of entries in inos
+ * @param[in] p1     volume id; only used for special inodes
+ *
+ * @return operation status
+ *    @retval 0 success
+ *    @retval -1 one or more decrements failed
+ */
+int
+namei_decmulti(IHandle_t * ih, Inode * inos, int ninos, int p1)
+{
+    struct namei_decent *ents;
+    char *buf = NULL;
+    FdHandle_t *fdP;
+    namei_t name;
+    ssize_t rc;
+    int nents = 0;
+    int code = 0;
+    int i, start, end;
+
+    if (ninos <= 0)
+	return 0;
+
+    ents = calloc(ninos, sizeof(*ents));
+    buf = malloc(NAMEI_DECMULTI_SPAN);
+    if (ents == NULL || buf == NULL) {
+	free(ents);
+	free(buf);
+	goto fallback;
+    }
+
+    for (i = 0; i < ninos; i++) {
+	if ((inos[i] & NAMEI_INODESPECIAL) == NAMEI_INODESPECIAL) {
+	    /* special files are not counted in the link table rows */
+	    if (namei_dec(ih, inos[i], p1) < 0)
+		code = -1;
+	    continue;
+	}
+	namei_GetLCOffsetAndIndexFromIno(inos[i], &ents[nents].offset,
+					 &ents[nents].index);
+	ents[nents].ino = inos[i];
+	nents++;
+    }
+    if (nents == 0) {
+	free(buf);
+	free(ents);
+	return code;
+    }
+    qsort(ents, nents, sizeof(*ents), namei_CompareDecEnt);
+
+    fdP = IH_OPEN(ih);
+    if (fdP == NULL) {
+	free(buf);
+	free(ents);
+	return -1;
+    }
+    if (FDH_LOCKFILE(fdP, 0) != 0) {
+	FDH_REALLYCLOSE(fdP);
+	free(buf);
+	free(ents);
+	return -1;
+    }
+
+    /*
+     * Every writer of the link table holds the file lock while it modifies
+     * a row, so rewriting the rows in between ours is safe while we hold it.
+     */
+    for (start = 0; start < nents; start = end) {
+	afs_foff_t base = ents[start].offset;
+
+	for (end = start + 1; end < nents; end++) {
+	    if (ents[end].offset + LINKTABLE_WIDTH - base >
+		NAMEI_DECMULTI_SPAN)
+		break;
+	}
+
+	rc = FDH_PREAD(fdP, buf,
+		       ents[end - 1].offset + LINKTABLE_WIDTH - base,
+		       base);
+	if (rc < 0) {
+	    code = -1;
+	    break;
+	}
+
+	for (i = start; i < end; i++) {
+	    afs_foff_t off = ents[i].offset - base;
+	    unsigned short row;
+	    int count;
+
+	    if (off + LINKTABLE_WIDTH > rc) {
+		/* past the end of the link table */
+		code = -1;
+		continue;
+	    }
+	    memcpy(&row, buf + off, sizeof(row));
+	    count = (row >> ents[i].index) & NAMEI_TAGMASK;
+	    if (count == 0) {
+		IHandle_t *th;
+		IH_INIT(th, ih->ih_dev, ih->ih_vid, ents[i].ino);
+		Log("Warning: Lost ref on ihandle dev %d vid %" AFS_VOLID_FMT " ino %lld\n",
+		    th->ih_dev, afs_printable_VolumeId_lu(th->ih_vid), (afs_int64)th->ih_ino);
+		IH_RELEASE(th);
+		continue;
+	    }
+	    count--;
+	    row &= (unsigned short)~(NAMEI_TAGMASK << ents[i].index);
+	    row |= (unsigned short)(count << ents[i].index);
+	    memcpy(buf + off, &row, sizeof(row));
+	    if (count == 0)
+		ents[i].unlink = 1;
+	}
+
+	if (rc > 0 && FDH_PWRITE(fdP, buf, rc, base) != rc) {
+	    /* leave the files alone; the salvager will sort out the counts */
+	    for (i = start; i < end; i++)
+		ents[i].unlink = 0;
+	    code = -1;
+	    break;
+	}
+    }
+    (void)FDH_SYNC(fdP);
+    FDH_UNLOCKFILE(fdP, 0);
+
+    for (i = 0; i < nents; i++) {
+	IHandle_t *th;
+
+	if (!ents[i].unlink)
+	    continue;
+	IH_INIT(th, ih->ih_dev, ih->ih_vid, ents[i].ino);
+	namei_HandleToName(&name, th);
+	IH_RELEASE(th);
+	if (OS_UNLINK(name.n_path) < 0)
+	    code = -1;
+    }
+
+    if (code)
+	FDH_REALLYCLOSE(fdP);
+    else
+	FDH_CLOSE(fdP);
+    free(buf);
+    free(ents);
+    return code;
+
+  fallback:
+    for (i = 0; i < ninos; i++) {
+	if (namei_dec(ih, inos[i], p1) < 0)
+	    code = -1;
+    }
+    return code;
+}
+#endif /* !AFS_NT40_ENV */
+
 
 /* ListViceInodes - write inode data to a results file. */
 static int DecodeInode(char *dpath, char *name, struct ViceInodeInfo *info,
@@ -32,6 +32,9 @@ afs_sfsize_t namei_iread(IHandle_t * h, afs_foff_t offset, char *buf,
 afs_sfsize_t namei_iwrite(IHandle_t * h, afs_foff_t offset, char *buf,
 			  afs_fsize_t size);
 extern int namei_dec(IHandle_t * h, Inode ino, int p1);
+#ifndef AFS_NT40_ENV
+extern int namei_decmulti(IHandle_t * h, Inode * inos, int ninos, int p1);
+#endif
 extern int namei_inc(IHandle_t * h, Inode ino, int p1);
 extern int namei_GetLinkCount(FdHandle_t * h, Inode ino, int lockit, int fixup, int nowrite);
 extern int namei_SetLinkCount(FdHandle_t * h, Inode ino, int count, int locked);
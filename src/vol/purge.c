@@ -147,10 +147,8 @@ ObliterateRegion(Volume * avp, VnodeClass aclass, StreamHandle_t * afile,
     OS_SYNC(afile->str_fd);
 
     /* finally, do the idec's */
-    for (i = 0; i < iindex; i++) {
-	IH_DEC(V_linkHandle(avp), inodes[i], V_parentId(avp));
-	DOPOLL;
-    }
+    IH_DEC_MULTI(V_linkHandle(avp), inodes, iindex, V_parentId(avp));
+    DOPOLL;
 
     /* return the new offset */
     *aoffset = offset;
@@ -234,6 +234,19 @@ handleit(struct cmd_syndesc *as, void *arock)
 	    }
 	}
     }
+    if ((ti = as->parms[22].items)) {	/* -vgparallel # */
+	VGParallel = atoi(ti->data);
+	if (VGParallel < 1)
+	    VGParallel = 1;
+	if (VGParallel > MAXPARALLEL) {
+	    printf("Setting parallel volume group salvages to maximum of %d \n",
+		   MAXPARALLEL);
+	    VGParallel = MAXPARALLEL;
+	}
+    }
+    if ((ti = as->parms[23].items)) {	/* -vgmemory # */
+	VGMemoryLimit = (afs_uint64)atoi(ti->data) * 1024 * 1024;
+    }
     if ((ti = as->parms[11].items)) {	/* -tmpdir */
 	DIR *dirp;
 
@@ -540,6 +553,10 @@ main(int argc, char **argv)
 #endif /* FAST_RESTART */
     cmd_Seek(ts, 21); /* skip DontSalvage and forceDAFS if needed */
     cmd_AddParm(ts, "-f", CMD_FLAG, CMD_OPTIONAL, "Alias for -force");
+    cmd_AddParm(ts, "-vgparallel", CMD_SINGLE, CMD_OPTIONAL,
+		"# of max parallel volume group salvaging per partition");
+    cmd_AddParm(ts, "-vgmemory", CMD_SINGLE, CMD_OPTIONAL,
+		"MB of inode summaries for parallel volume group salvaging");
     err = cmd_Dispatch(argc, argv);
     Exit(err);
     AFS_UNREACHED(return 0);
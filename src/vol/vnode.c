@@ -86,16 +86,118 @@ VNLog(afs_int32 aop, afs_int32 anparms, ... )
  * with the volume ID as an initval because it's there.  (That will
  * make the same vnode number in different volumes hash to a different
  * value, which would probably not even be a big deal anyway.)
+ *
+ * The table is allocated when the vnode caches are initialized.  Unless
+ * an explicit size was requested with VSetVnodeHashSize, it is sized so
+ * that there is about one bucket per cached vnode; a fixed 2048 bucket
+ * table gives very long chains with the large -s/-l vnode caches used
+ * on busy fileservers, and every chain walk happens under VOL_LOCK.
  */
 
-#define VNODE_HASH_TABLE_BITS 11
-#define VNODE_HASH_TABLE_SIZE opr_jhash_size(VNODE_HASH_TABLE_BITS)
-#define VNODE_HASH_TABLE_MASK opr_jhash_mask(VNODE_HASH_TABLE_BITS)
-private Vnode *VnodeHashTable[VNODE_HASH_TABLE_SIZE];
+#define VNODE_HASH_TABLE_MIN_BITS 11
+#define VNODE_HASH_TABLE_MAX_AUTO_BITS 20
+private int VnodeHashBits = 0;		/* 0 means size from the vnode caches */
+private afs_uint32 VnodeHashSize = 0;
+private afs_uint32 VnodeHashMask = 0;
+private Vnode **VnodeHashTable = NULL;
+private afs_uint64 VnodeHashLooks = 0;	/* hash chain elements traversed */
 #define VNODE_HASH(volumeptr,vnodenumber)\
-    (opr_jhash_int((vnodenumber), V_id((volumeptr))) & VNODE_HASH_TABLE_MASK)
+    (opr_jhash_int((vnodenumber), V_id((volumeptr))) & VnodeHashMask)
+
+
+/**
+ * set size of vnode object hash table.
+ *
+ * @param[in] logsize   log(2) of desired hash table size
+ *
+ * @return operation status
+ *    @retval 0 success
+ *    @retval -1 failure
+ *
+ * @pre MUST be called prior to VInitVolumePackage2
+ *
+ * @post Vnode Hash Table will have 2^logsize buckets
+ */
+int
+VSetVnodeHashSize(int logsize)
+{
+    /* same range as the volume hash table */
+    if ((logsize < 6) || (logsize > 28)) {
+	return -1;
+    }
+
+    if (VnodeHashTable != NULL) {
+	/* chains are threaded through the vnodes themselves, so the
+	 * table cannot be resized once vnodes have been hashed */
+	return -1;
+    }
+    VnodeHashBits = logsize;
+    return 0;
+}
+
+/**
+ * initialize the vnode object hash table.
+ *
+ * @param[in] nVnodes  total number of vnodes in all vnode caches
+ *
+ * @post hash table is allocated.  If no size was configured with
+ *       VSetVnodeHashSize, the table has roughly one bucket per
+ *       cached vnode.
+ *
+ * @internal volume package internal use only
+ *
+ * @note generally called by VInitVolumePackage2
+ */
+void
+VInitVnodeHash(int nVnodes)
+{
+    int bits = VnodeHashBits;
 
+    if (VnodeHashTable != NULL)
+	return;
 
+    if (bits == 0) {
+	bits = VNODE_HASH_TABLE_MIN_BITS;
+	while (bits < VNODE_HASH_TABLE_MAX_AUTO_BITS
+	       && opr_jhash_size(bits) < nVnodes)
+	    bits++;
+    }
+
+    VnodeHashSize = opr_jhash_size(bits);
+    VnodeHashMask = opr_jhash_mask(bits);
+    VnodeHashTable = calloc(VnodeHashSize, sizeof(Vnode *));
+    opr_Assert(VnodeHashTable != NULL);
+}
+
+/**
+ * fill in vnode cache statistics.
+ *
+ * @param[out] stats  statistics structure to populate
+ *
+ * @pre VOL_LOCK held
+ *
+ * @internal volume package internal use only
+ */
+void
+VGetVnodeCacheStats_r(struct VnodeCacheStats *stats)
+{
+    int i;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->hash_size = VnodeHashSize;
+    stats->hash_looks = VnodeHashLooks;
+    for (i = 0; i < nVNODECLASSES; i++) {
+	struct VnodeClassInfo *vcp = &VnodeClassInfo[i];
+
+	stats->classes[i].cache_size = vcp->cacheSize;
+	stats->classes[i].gets = vcp->gets;
+	stats->classes[i].hits = vcp->hits;
+	stats->classes[i].reads = vcp->reads;
+	stats->classes[i].recycles = vcp->recycles;
+	stats->classes[i].allocs = vcp->allocs;
+	stats->classes[i].writes = vcp->writes;
+    }
+}
 
 #define BAD_IGET	-1000
 
@@ -326,6 +428,7 @@ VInitVnodes(VnodeClass class, int nVnodes)
     struct VnodeClassInfo *vcp = &VnodeClassInfo[class];
 
     vcp->allocs = vcp->gets = vcp->reads = vcp->writes = 0;
+    vcp->hits = vcp->recycles = 0;
     vcp->cacheSize = nVnodes;
     switch (class) {
     case vSmall:
@@ -353,6 +456,8 @@ VInitVnodes(VnodeClass class, int nVnodes)
     if (nVnodes == 0)
 	return 0;
 
+    VInitVnodeHash(nVnodes);
+
     va = (byte *) calloc(nVnodes, vcp->residentSize);
     opr_Assert(va != NULL);
     while (nVnodes--) {
@@ -440,6 +545,8 @@ VGetFreeVnode_r(struct VnodeClassInfo * vcp, struct Volume *vp,
 	Abort("VGetFreeVnode_r: locked vnode in lruq");
 #endif
     VNLog(1, 2, Vn_id(vnp), (intptr_t)vnp, 0, 0);
+    if (Vn_stateFlags(vnp) & VN_ON_HASH)
+	vcp->recycles++;	/* evicting a valid cache entry */
 
     /*
      * it's going to be overwritten soon enough.
@@ -520,7 +627,8 @@ VLookupVnode(Volume * vp, VnodeId vnodeId)
 	  ((Vn_id(vnp) != vnodeId) ||
 	   (Vn_volume(vnp) != vp) ||
 	   (vp->cacheCheck != Vn_cacheCheck(vnp))));
-	 vnp = vnp->hashNext);
+	 vnp = vnp->hashNext)
+	VnodeHashLooks++;
 
     return vnp;
 }
@@ -1213,6 +1321,7 @@ VGetVnode_r(Error * ec, Volume * vp, VnodeId vnodeNumber, int locktype)
 	/* vnode is in cache */
 
 	VNLog(101, 2, vnodeNumber, (intptr_t)vnp, 0, 0);
+	vcp->hits++;
 	VnCreateReservation_r(vnp);
 
 #ifdef AFS_DEMAND_ATTACH_FS
@@ -80,10 +80,33 @@ struct VnodeClassInfo {
     int gets, reads;		/* Number of VGetVnodes and corresponding
 				 * reads */
     int writes;			/* Number of vnode writes */
+    int hits;			/* Number of VGetVnodes satisfied from the
+				 * cache */
+    int recycles;		/* Number of cached vnodes evicted from the
+				 * lru to make room for another vnode */
 };
 
 extern struct VnodeClassInfo VnodeClassInfo[nVNODECLASSES];
 
+/**
+ * vnode cache statistics.
+ *
+ * @see FSYNC_VOL_STATS_VNODE
+ */
+struct VnodeCacheStats {
+    afs_uint32 hash_size;		/**< number of vnode hash buckets */
+    afs_uint64 hash_looks;		/**< hash chain elements traversed */
+    struct {
+	afs_uint32 cache_size;		/**< number of vnodes in this class */
+	afs_uint32 gets;		/**< VGetVnode requests */
+	afs_uint32 hits;		/**< VGetVnodes satisfied from the cache */
+	afs_uint32 reads;		/**< vnode reads from disk */
+	afs_uint32 recycles;		/**< valid cache entries evicted */
+	afs_uint32 allocs;		/**< vnode allocations */
+	afs_uint32 writes;		/**< vnode writes to disk */
+    } classes[nVNODECLASSES];
+};
+
 /**
  * Return the vnode class (large or small) of this vnode type.
  */
@@ -231,7 +254,7 @@ typedef struct Vnode {
     struct Vnode *lruPrev;	/* More recently used vnode than this one */
     /* The lruNext, lruPrev fields are not
      * meaningful if the vnode is in use */
-    bit16 hashIndex;		/* Hash table index */
+    bit32 hashIndex;		/* Hash table index */
 #ifdef	AFS_AIX_ENV
     unsigned changed_newTime:1;	/* 1 if vnode changed, write time */
     unsigned changed_oldTime:1;	/* 1 changed, don't update time. */
@@ -327,6 +350,9 @@ typedef struct Vnode {
 /*extern int VolumeHashOffset(); */
 extern int VolumeHashOffset_r(void);
 extern int VInitVnodes(VnodeClass class, int nVnodes);
+extern int VSetVnodeHashSize(int logsize);
+extern void VInitVnodeHash(int nVnodes);
+extern void VGetVnodeCacheStats_r(struct VnodeCacheStats *stats);
 /*extern VInitVnodes_r();*/
 extern Vnode *VGetVnode(Error * ec, struct Volume *vp, VnodeId vnodeNumber,
 			int locktype);
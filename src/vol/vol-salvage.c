@@ -215,6 +215,9 @@ int canfork = 1;
 
 #define	MAXPARALLEL	32
 
+int VGParallel = 1;		/* -vgparallel X flag */
+afs_uint64 VGMemoryLimit = DEFAULT_VGMEMORY; /* -vgmemory X flag, in bytes */
+
 int OKToZap;			/* -o flag */
 int ForceSalvage;		/* If salvage should occur despite the DONT_SALVAGE flag
 				 * in the volume header */
@@ -263,6 +266,14 @@ struct SalvInfo {
                                                 *   at */
     int useFSYNC; /**< 0 if the fileserver is unavailable; 1 if we should try
                    *   to contact the fileserver over FSYNC */
+
+    int nVGJobs;             /**< # of volume group salvage children running */
+    struct {
+	int pid;             /**< child salvaging the volume group */
+	VolumeId rwvid;      /**< read-write id of the volume group */
+	afs_uint64 bytes;    /**< size of the inode summary it loaded */
+    } vgJobs[MAXPARALLEL];
+    afs_uint64 vgJobBytes;   /**< total inode summary size of running children */
 };
 
 char *tmpdir = NULL;
@@ -277,6 +288,10 @@ static int AskVolumeSummary(struct SalvInfo *salvinfo,
                             VolumeId singleVolumeNumber);
 static void MaybeAskOnline(struct SalvInfo *salvinfo, VolumeId volumeId);
 static void AskError(struct SalvInfo *salvinfo, VolumeId volumeId);
+static int ForkVolumeGroup(struct SalvInfo *salvinfo, struct InodeSummary *isp,
+			   afs_uint64 bytes);
+static void WaitVolumeGroups(struct SalvInfo *salvinfo, int maxJobs,
+			     afs_uint64 bytes);
 
 #ifdef AFS_DEMAND_ATTACH_FS
 static int LockVolume(struct SalvInfo *salvinfo, VolumeId volumeId);
@@ -922,6 +937,7 @@ SalvageFileSys1(struct DiskPartition64 *partP, VolumeId singleVolumeNumber)
 #endif /* AFS_NT40_ENV */
 
     }
+    WaitVolumeGroups(salvinfo, 0, 0);
 
     /* Delete any additional volumes that were listed in the partition but which didn't have any corresponding inodes */
     for (; vsp < esp; vsp++) {
@@ -1996,21 +2012,20 @@ DoSalvageVolumeGroup(struct SalvInfo *salvinfo, struct InodeSummary *isp, int nV
     }
     if (ShowMounts && !haveRWvolume)
 	return;
-    if (canfork && !debug && Fork() != 0) {
-	(void)Wait("Salvage volume group");
-	return;
-    }
     for (i = 0, totalInodes = 0; i < nVols; i++)
 	totalInodes += isp[i].nInodes;
     size = totalInodes * sizeof(struct ViceInodeInfo);
+    if (canfork && !debug && ForkVolumeGroup(salvinfo, isp, size) != 0)
+	return;
     inodes = malloc(size);
     allInodes = inodes - isp->index;	/* this would the base of all the inodes
 					 * for the partition, if all the inodes
 					 * had been read into memory */
-    opr_Verify(OS_SEEK
-	   (salvinfo->inodeFd, isp->index * sizeof(struct ViceInodeInfo),
-	    SEEK_SET) != -1);
-    opr_Verify(OS_READ(salvinfo->inodeFd, inodes, size) == size);
+    /* other volume groups may be reading the inode file concurrently, so
+     * don't move its file offset */
+    opr_Verify(OS_PREAD
+	   (salvinfo->inodeFd, inodes, size,
+	    isp->index * sizeof(struct ViceInodeInfo)) == size);
 
     /* Don't try to salvage a read write volume if there isn't one on this
      * partition */
@@ -2207,6 +2222,83 @@ DoSalvageVolumeGroup(struct SalvInfo *salvinfo, struct InodeSummary *isp, int nV
     }
 }
 
+/**
+ * fork a child process to salvage a volume group.
+ *
+ * Up to VGParallel volume groups are salvaged concurrently, each by its own
+ * child process. Before forking, wait until a slot is free and until the
+ * inode summaries loaded by the running children, plus the one for this
+ * volume group, fit within VGMemoryLimit; a volume group is always salvaged
+ * when nothing else is running, however large its summary.
+ *
+ * @param[in] salvinfo  salvage job info
+ * @param[in] isp       inode summary of the volume group
+ * @param[in] bytes     size of the volume group's inode summary
+ *
+ * @return pid of the child in the parent, 0 in the child
+ */
+static int
+ForkVolumeGroup(struct SalvInfo *salvinfo, struct InodeSummary *isp,
+		afs_uint64 bytes)
+{
+    int pid;
+
+    WaitVolumeGroups(salvinfo, VGParallel - 1, bytes);
+
+    pid = Fork();
+    if (pid != 0) {
+	opr_Assert(salvinfo->nVGJobs < MAXPARALLEL);
+	salvinfo->vgJobs[salvinfo->nVGJobs].pid = pid;
+	salvinfo->vgJobs[salvinfo->nVGJobs].rwvid = isp->RWvolumeId;
+	salvinfo->vgJobs[salvinfo->nVGJobs].bytes = bytes;
+	salvinfo->nVGJobs++;
+	salvinfo->vgJobBytes += bytes;
+    }
+    return pid;
+}
+
+/**
+ * wait for volume group salvage children to finish.
+ *
+ * Reap children until at most maxJobs are still running and, if any are
+ * still running, another bytes worth of inode summary fits within
+ * VGMemoryLimit.
+ *
+ * @param[in] salvinfo  salvage job info
+ * @param[in] maxJobs   number of children that may keep running
+ * @param[in] bytes     inode summary size of the next volume group
+ */
+static void
+WaitVolumeGroups(struct SalvInfo *salvinfo, int maxJobs, afs_uint64 bytes)
+{
+    int status;
+    int pid;
+    int i;
+
+    while (salvinfo->nVGJobs > maxJobs
+	   || (salvinfo->nVGJobs > 0
+	       && salvinfo->vgJobBytes + bytes > VGMemoryLimit)) {
+	pid = wait(&status);
+	opr_Assert(pid != -1);
+	for (i = 0; i < salvinfo->nVGJobs; i++) {
+	    if (salvinfo->vgJobs[i].pid == pid)
+		break;
+	}
+	if (i == salvinfo->nVGJobs)
+	    continue;		/* not one of ours */
+
+	if (WCOREDUMP(status))
+	    Log("\"Salvage volume group\" core dumped!\n");
+	if (WIFSIGNALED(status) != 0 || WEXITSTATUS(status) != 0)
+	    Log("Salvage of volume group %" AFS_VOLID_FMT " failed\n",
+		afs_printable_VolumeId_lu(salvinfo->vgJobs[i].rwvid));
+
+	salvinfo->vgJobBytes -= salvinfo->vgJobs[i].bytes;
+	salvinfo->nVGJobs--;
+	salvinfo->vgJobs[i] = salvinfo->vgJobs[salvinfo->nVGJobs];
+    }
+}
+
 int
 QuickCheck(struct SalvInfo *salvinfo, struct InodeSummary *isp, int nVols)
 {
@@ -135,6 +135,10 @@ extern int Showmode;
 
 #define	MAXPARALLEL	32
 
+extern int VGParallel;			/* -vgparallel X flag */
+extern afs_uint64 VGMemoryLimit;	/* -vgmemory X flag, in bytes */
+#define DEFAULT_VGMEMORY (256 * 1024 * 1024)
+
 extern int OKToZap;			/* -o flag */
 extern int ForceSalvage;		/* If salvage should occur despite the DONT_SALVAGE flag
 					 * in the volume header */
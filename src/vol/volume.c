@@ -600,6 +600,7 @@ VInitVolumePackage2(ProgramType pt, VolumePackageOptions * opts)
 	VStats.hdr_cache_size = opts->volcache;
     VInitVolumeHeaderCache(VStats.hdr_cache_size);
 
+    VInitVnodeHash(opts->nLargeVnodes + opts->nSmallVnodes);
     VInitVnodes(vLarge, opts->nLargeVnodes);
     VInitVnodes(vSmall, opts->nSmallVnodes);
 
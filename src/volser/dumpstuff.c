@@ -700,6 +700,52 @@ DumpStandardTagLen(struct iod *iodp, char tag, afs_uint32 section,
     return 0;
 }
 
+/* State for sending a file's data straight into a single dump call */
+struct dumpfile_rock {
+    FdHandle_t *handleP;
+    int vnode;
+    afs_foff_t offset;
+};
+
+static int
+DumpFileProc(void *rock, struct iovec *iov, int nio, int nbytes)
+{
+    struct dumpfile_rock *drock = rock;
+    ssize_t n;
+    afs_ino_str_t stmp;
+#ifdef HAVE_PIOV
+    n = FDH_PREADV(drock->handleP, iov, nio, drock->offset);
+#else
+    ssize_t r;
+    int i;
+
+    for (n = 0, i = 0; i < nio; i++, n += r) {
+	r = FDH_PREAD(drock->handleP, iov[i].iov_base, iov[i].iov_len,
+		      drock->offset + n);
+	if (r < 0) {
+	    n = r;
+	    break;
+	} else if (r != iov[i].iov_len) {
+	    n += r;
+	    break;
+	}
+    }
+#endif
+
+    if (n < 0) {
+	Log("1 Volser: DumpFile: Error reading inode %s for vnode %d: %s\n",
+	    PrintInode(stmp, drock->handleP->fd_ih->ih_ino), drock->vnode,
+	    afs_error_message(errno));
+	return VOLSERDUMPERROR;
+    } else if (n != nbytes) {
+	Log("1 Volser: DumpFile: Premature EOF reading inode %s for vnode %d\n",
+	    PrintInode(stmp, drock->handleP->fd_ih->ih_ino), drock->vnode);
+	return VOLSERDUMPERROR;
+    }
+    drock->offset += n;
+    return 0;
+}
+
 static int
 DumpFile(struct iod *iodp, int vnode, FdHandle_t * handleP)
 {
@@ -728,6 +774,18 @@ DumpFile(struct iod *iodp, int vnode, FdHandle_t * handleP)
 	return VOLSERDUMPERROR;
     }
 
+    if (iodp->call) {
+	/* one destination, so read the file straight into its packets */
+	struct dumpfile_rock drock;
+
+	drock.handleP = handleP;
+	drock.vnode = vnode;
+	drock.offset = 0;
+	if (rx_WriteBulk(iodp->call, howBig, DumpFileProc, &drock, NULL))
+	    return VOLSERDUMPERROR;
+	return 0;
+    }
+
     p = malloc(howMany);
     if (!p) {
 	Log("1 Volser: DumpFile: not enough memory to allocate %u bytes\n", (unsigned)howMany);
@@ -260,6 +260,19 @@ PrintOverallPerfInfo(struct afs_stats_CMPerf *a_ovP)
     printf("\t%10u cacheBucket1_Discarded\n",  a_ovP->cacheBucket1_Discarded);
     printf("\t%10u cacheBucket2_Discarded\n",  a_ovP->cacheBucket2_Discarded);
 
+    printf("\t%10u storeRuns\n", a_ovP->storeRuns);
+    printf("\t%10u storeRunsParallel\n", a_ovP->storeRunsParallel);
+    printf("\t%10u storeKBytes\n", a_ovP->storeKBytes);
+    printf("\t%10u storeMsecs\n", a_ovP->storeMsecs);
+
+    printf("\t%10u dnlcLookups\n", a_ovP->dnlcLookups);
+    printf("\t%10u dnlcMisses\n", a_ovP->dnlcMisses);
+    printf("\t%10u dnlcEvictions\n", a_ovP->dnlcEvictions);
+    printf("\t%10u dnlcNegHits\n", a_ovP->dnlcNegHits);
+
+    printf("\t%10u dcacheFgEvictions\n", a_ovP->dcacheFgEvictions);
+    printf("\t%10u dcacheBgEvictions\n", a_ovP->dcacheBgEvictions);
+
     printf("\t%10u sysName_ID\n", a_ovP->sysName_ID);
 
     printf("\tFile Server up/downtimes, same cell:\n");
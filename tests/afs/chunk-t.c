@@ -0,0 +1,142 @@
+/*
+ * Tests of the cache manager's chunk layout, with and without chunk tiers
+ */
+
+#include <afsconfig.h>
+#include <afs/param.h>
+
+#include <roken.h>
+#include <afs/stds.h>
+
+#include <tests/tap/basic.h>
+
+/*
+ * Build the chunk module on its own, with just enough of the cache
+ * manager's environment for it, rather than all of libafs.
+ */
+#define __AFS_SYSINCLUDESH__ 1
+#define AFS_INCLUDES_H 1
+#define __OPENAFS_AFS_STATS_H__ 1
+
+typedef union {
+    afs_int32 mem;
+} afs_dcache_id_t;
+
+struct cell;
+struct dcache;
+struct osi_file;
+struct uio;
+struct vcache;
+struct volume;
+struct vrequest;
+
+#include "afs/afs_chunkops.h"
+
+extern afs_int32 afs_MaxLogChunk;
+extern void afs_InitChunkTiers(afs_int32 ablocks, int amemcache);
+
+#include "afs/afs_chunk.c"
+
+#define KB(n) ((afs_size_t)(n) << 10)
+#define MB(n) ((afs_size_t)(n) << 20)
+#define GB(n) ((afs_size_t)(n) << 30)
+
+/* Set up the chunks as afs_dcacheInit does for a cache of ablocks 1K blocks */
+static void
+setup(int logchunk, int maxlogchunk, afs_int32 ablocks, int amemcache)
+{
+    AFS_SETCHUNKSIZE(logchunk);
+    afs_MaxLogChunk = maxlogchunk;
+    afs_InitChunkTiers(ablocks, amemcache);
+}
+
+/* Check the chunk, base and size of one offset */
+static void
+check_offset(afs_size_t offset, afs_int32 chunk, afs_size_t base,
+	     afs_int32 size)
+{
+    ok(AFS_CHUNK(offset) == chunk && AFS_CHUNKBASE(offset) == base
+       && AFS_CHUNKSIZE(offset) == size
+       && AFS_CHUNKOFFSET(offset) == offset - base,
+       "offset %llu is in chunk %d of %d bytes at %llu",
+       (unsigned long long)offset, chunk, size, (unsigned long long)base);
+}
+
+/*
+ * Walk the first nchunks chunks and check that they cover the file without
+ * gaps or overlaps, and that every macro agrees about them.
+ */
+static int
+walk_chunks(afs_int32 nchunks)
+{
+    afs_size_t base = 0, end;
+    afs_int32 chunk, size;
+    int bad = 0;
+
+    for (chunk = 0; chunk < nchunks; chunk++) {
+	size = AFS_CHUNKTOSIZE(chunk);
+	end = base + size - 1;
+	if (AFS_CHUNKTOBASE(chunk) != base
+	    || AFS_CHUNK(base) != chunk || AFS_CHUNK(end) != chunk
+	    || AFS_CHUNKBASE(base) != base || AFS_CHUNKBASE(end) != base
+	    || AFS_CHUNKSIZE(base) != size || AFS_CHUNKSIZE(end) != size
+	    || AFS_CHUNKOFFSET(end) != size - 1) {
+	    diag("chunk %d at %llu of %d bytes is inconsistent", chunk,
+		 (unsigned long long)base, size);
+	    bad++;
+	}
+	base += size;
+    }
+    return bad;
+}
+
+int
+main(void)
+{
+    afs_size_t tier1;
+
+    plan(23);
+
+    /* Without tiers every chunk after the first is afs_OtherCSize */
+    setup(16, 0, 1 << 20, 0);
+    is_int(0, afs_ChunkTiers, "no tiers without a maximum chunk size");
+    check_offset(0, 0, 0, KB(64));
+    check_offset(KB(64) - 1, 0, 0, KB(64));
+    check_offset(KB(64), 1, KB(64), KB(64));
+    check_offset(GB(4) + 1, 65536, GB(4), KB(64));
+    is_int(0, walk_chunks(1000), "untiered chunks are consistent");
+
+    /* 64K chunks growing to 16M in a 1G cache */
+    setup(16, 24, 1 << 20, 0);
+    is_int(8, afs_ChunkTiers, "tiers up to the maximum chunk size");
+    is_int(MB(16), AFS_MAXCSIZE, "largest chunk is the maximum");
+    tier1 = KB(64) + 8 * KB(64);
+    check_offset(KB(64), 1, KB(64), KB(64));
+    check_offset(tier1 - 1, 8, tier1 - KB(64), KB(64));
+    check_offset(tier1, 9, tier1, KB(128));
+    check_offset(tier1 + KB(128), 10, tier1 + KB(128), KB(128));
+    check_offset(afs_ChunkTierBase[8] - 1, 64,
+		 afs_ChunkTierBase[8] - MB(8), MB(8));
+    check_offset(afs_ChunkTierBase[8], 65, afs_ChunkTierBase[8], MB(16));
+    is_int(314, AFS_CHUNK(GB(4) - 1) + 1, "a 4G file needs 314 chunks");
+    is_int(0, walk_chunks(100000), "tiered chunks are consistent");
+    ok(AFS_CHUNKTOBASE(99999) > GB(1024), "... well past 1T");
+
+    /* No chunk may be more than a sixteenth of the cache */
+    setup(16, 24, 16 * 1024, 0);
+    is_int(4, afs_ChunkTiers, "tiers are capped by the cache size");
+    is_int(MB(1), AFS_MAXCSIZE, "... to a sixteenth of it");
+    is_int(0, walk_chunks(10000), "capped chunks are consistent");
+
+    /* A memory cache keeps fixed size chunks */
+    setup(16, 24, 1 << 20, 1);
+    is_int(0, afs_ChunkTiers, "no tiers for a memory cache");
+
+    /* Setting the chunk size again drops the tiers */
+    setup(16, 24, 1 << 20, 0);
+    AFS_SETCHUNKSIZE(13);
+    is_int(0, afs_ChunkTiers, "AFS_SETCHUNKSIZE drops the tiers");
+    check_offset(KB(8), 1, KB(8), KB(8));
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+/* Tests of the rx bulk transfer interface, over a loopback connection */
+
+#include <afsconfig.h>
+#include <afs/param.h>
+
+#include <roken.h>
+
+#include <rx/rx.h>
+#include <rx/rx_null.h>
+#include <rx/rx_globals.h>
+
+#include <tests/tap/basic.h>
+
+#define TEST_SERVICE_ID 4
+#define TEST_SIZE ((1024 * 1024) + 13)
+#define TEST_PROC_ERROR 1234
+
+/* Each byte of test data is a function of its offset within the transfer */
+struct pattern {
+    afs_int64 offset;
+    afs_int64 failat;	/* fail the step which passes this offset, if >= 0 */
+    int steps;
+    int bad;
+};
+
+static void
+pattern_init(struct pattern *pat)
+{
+    memset(pat, 0, sizeof(*pat));
+    pat->failat = -1;
+}
+
+static int
+pattern_check(struct pattern *pat, int nbytes)
+{
+    pat->steps++;
+    if (pat->failat >= 0 && pat->offset + nbytes > pat->failat)
+	return TEST_PROC_ERROR;
+    return 0;
+}
+
+static int
+FillProc(void *rock, struct iovec *iov, int nio, int nbytes)
+{
+    struct pattern *pat = rock;
+    unsigned char *p;
+    int i, code;
+    size_t j;
+
+    code = pattern_check(pat, nbytes);
+    if (code)
+	return code;
+    for (i = 0; i < nio; i++) {
+	p = iov[i].iov_base;
+	for (j = 0; j < iov[i].iov_len; j++)
+	    p[j] = (pat->offset++) % 251;
+    }
+    return 0;
+}
+
+static int
+CheckProc(void *rock, struct iovec *iov, int nio, int nbytes)
+{
+    struct pattern *pat = rock;
+    unsigned char *p;
+    int i, code;
+    size_t j;
+
+    code = pattern_check(pat, nbytes);
+    if (code)
+	return code;
+    for (i = 0; i < nio; i++) {
+	p = iov[i].iov_base;
+	for (j = 0; j < iov[i].iov_len; j++)
+	    if (p[j] != (pat->offset++) % 251)
+		pat->bad++;
+    }
+    return 0;
+}
+
+/*
+ * The server reads a request size and a reply size, receives and checks
+ * the request, and sends back a reply of the size asked for.
+ */
+static afs_int32
+ExecuteRequest(struct rx_call *call)
+{
+    struct pattern pat;
+    afs_int32 nin, nout;
+    afs_int64 done;
+    int code;
+
+    if (rx_Read32(call, &nin) != sizeof(nin)
+	|| rx_Read32(call, &nout) != sizeof(nout))
+	return rx_Error(call) ? rx_Error(call) : RX_PROTOCOL_ERROR;
+    nin = ntohl(nin);
+    nout = ntohl(nout);
+
+    pattern_init(&pat);
+    code = rx_ReadBulk(call, nin, CheckProc, &pat, &done);
+    if (code)
+	return code;
+    if (pat.bad || done != nin)
+	return EIO;
+
+    pattern_init(&pat);
+    return rx_WriteBulk(call, nout, FillProc, &pat, NULL);
+}
+
+static struct rx_call *
+StartCall(struct rx_connection *conn, afs_int32 nin, afs_int32 nout)
+{
+    struct rx_call *call;
+
+    call = rx_NewCall(conn);
+    nin = htonl(nin);
+    nout = htonl(nout);
+    rx_Write32(call, &nin);
+    rx_Write32(call, &nout);
+    return call;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct rx_securityClass *secobj;
+    struct rx_service *service;
+    struct rx_connection *conn;
+    struct rx_call *call;
+    struct sockaddr_in sin;
+    socklen_t slen = sizeof(sin);
+    struct pattern pat;
+    afs_int64 done, total;
+    int code;
+
+    plan(23);
+
+    if (rx_Init(0) != 0)
+	bail("rx_Init failed");
+    if (getsockname(rx_socket, (struct sockaddr *)&sin, &slen) != 0)
+	sysbail("getsockname");
+
+    secobj = rxnull_NewServerSecurityObject();
+    service = rx_NewService(0, TEST_SERVICE_ID, "test", &secobj, 1,
+			    ExecuteRequest);
+    if (service == NULL)
+	bail("rx_NewService failed");
+    rx_SetMaxProcs(service, 2);
+    rx_StartServer(0);
+
+    conn = rx_NewConnection(htonl(INADDR_LOOPBACK), sin.sin_port,
+			    TEST_SERVICE_ID,
+			    rxnull_NewClientSecurityObject(), 0);
+
+    /* A whole transfer in each direction */
+    call = StartCall(conn, TEST_SIZE, TEST_SIZE);
+    pattern_init(&pat);
+    code = rx_WriteBulk(call, TEST_SIZE, FillProc, &pat, &done);
+    is_int(0, code, "rx_WriteBulk sends a whole request");
+    ok(done == TEST_SIZE, "... and reports all of it sent");
+    pattern_init(&pat);
+    code = rx_ReadBulk(call, TEST_SIZE, CheckProc, &pat, &done);
+    is_int(0, code, "rx_ReadBulk receives a whole reply");
+    ok(done == TEST_SIZE, "... and reports all of it received");
+    is_int(0, pat.bad, "... with the right contents");
+    ok(pat.steps > 1, "... over more than one step");
+    is_int(0, rx_EndCall(call, 0), "... and the server received it intact");
+
+    /* The same transfer split over several bulk calls */
+    call = StartCall(conn, TEST_SIZE, TEST_SIZE);
+    pattern_init(&pat);
+    total = 0;
+    code = rx_WriteBulk(call, 1, FillProc, &pat, &done);
+    total += done;
+    code |= rx_WriteBulk(call, 4000, FillProc, &pat, &done);
+    total += done;
+    code |= rx_WriteBulk(call, TEST_SIZE - 4001, FillProc, &pat, &done);
+    total += done;
+    is_int(0, code, "rx_WriteBulk sends a request in pieces");
+    ok(total == TEST_SIZE, "... and reports all of it sent");
+    pattern_init(&pat);
+    total = 0;
+    code = rx_ReadBulk(call, 7, CheckProc, &pat, &done);
+    total += done;
+    code |= rx_ReadBulk(call, TEST_SIZE - 7, CheckProc, &pat, &done);
+    total += done;
+    is_int(0, code, "rx_ReadBulk receives a reply in pieces");
+    ok(total == TEST_SIZE, "... and reports all of it received");
+    is_int(0, pat.bad, "... with the right contents");
+    is_int(0, rx_EndCall(call, 0), "... and the server received it intact");
+
+    /* A reply shorter than the reader asked for */
+    call = StartCall(conn, 0, TEST_SIZE / 2);
+    code = rx_WriteBulk(call, 0, FillProc, &pat, &done);
+    is_int(0, code, "rx_WriteBulk of nothing succeeds");
+    ok(done == 0, "... and reports nothing sent");
+    pattern_init(&pat);
+    code = rx_ReadBulk(call, TEST_SIZE, CheckProc, &pat, &done);
+    is_int(RX_PROTOCOL_ERROR, code, "rx_ReadBulk of a short reply fails");
+    ok(done == TEST_SIZE / 2, "... after receiving all that was sent");
+    is_int(0, pat.bad, "... with the right contents");
+    rx_EndCall(call, 0);
+
+    /* A proc which fails part way through the transfer */
+    call = StartCall(conn, TEST_SIZE, 0);
+    pattern_init(&pat);
+    pat.failat = 65536;
+    code = rx_WriteBulk(call, TEST_SIZE, FillProc, &pat, &done);
+    is_int(TEST_PROC_ERROR, code, "rx_WriteBulk stops when its proc fails");
+    ok(done == pat.offset && done <= 65536,
+       "... and reports only what was sent before the failure");
+    rx_EndCall(call, code);
+
+    call = StartCall(conn, 0, TEST_SIZE);
+    pattern_init(&pat);
+    pat.failat = 65536;
+    code = rx_ReadBulk(call, TEST_SIZE, CheckProc, &pat, &done);
+    is_int(TEST_PROC_ERROR, code, "rx_ReadBulk stops when its proc fails");
+    ok(done > pat.offset && pat.offset <= 65536,
+       "... and reports the step it was handed");
+    is_int(0, pat.bad, "... with the right contents");
+    rx_EndCall(call, code);
+
+    rx_DestroyConnection(conn);
+    rx_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * mkvol - create a damaged volume for the salvager tests.
+ *
+ * Creates a read/write volume on a vice partition, with a number of small
+ * files in it but no root directory, as if its root directory had been
+ * lost.  The salvager has to recreate the root directory and attach the
+ * files to it as orphans.
+ *
+ * usage: mkvol partition volumeid nfiles
+ *        mkvol -dirs
+ *
+ * With -dirs, prints the paths of the salvager's log file and lock file,
+ * whose directories have to exist for the salvager to run.
+ */
+
+#include <afsconfig.h>
+#include <afs/param.h>
+
+#include <roken.h>
+
+#include <rx/xdr.h>
+#include <rx/rx_queue.h>
+#include <afs/afsint.h>
+#include <afs/nfs.h>
+#include <lock.h>
+#include <afs/ihandle.h>
+#include <afs/vnode.h>
+#include <afs/volume.h>
+#include <afs/partition.h>
+#include <afs/dirpath.h>
+
+int VolumeChanged; /* to keep physio happy */
+
+/* Write the data and the vnode of small file number n */
+static int
+MakeFile(Volume *vp, FdHandle_t *indexfd, int n)
+{
+    char vnodeBuf[SIZEOF_SMALLDISKVNODE];
+    struct VnodeDiskObject *vnode = (struct VnodeDiskObject *)vnodeBuf;
+    VnodeId vnodeNumber = bitNumberToVnodeNumber(n, vSmall);
+    Unique unique = V_uniquifier(vp)++;
+    char data[64];
+    IHandle_t *h;
+    FdHandle_t *fdP;
+    Inode ino;
+    int len;
+
+    len = snprintf(data, sizeof(data), "file %d of volume %" AFS_VOLID_FMT
+		   "\n", n, afs_printable_VolumeId_lu(V_id(vp)));
+
+    ino = IH_CREATE(V_linkHandle(vp), V_device(vp),
+		    VPartitionPath(V_partition(vp)), 0, V_parentId(vp),
+		    vnodeNumber, unique, 1);
+    if (!VALID_INO(ino)) {
+	fprintf(stderr, "mkvol: cannot create file %d: %s\n", n,
+		strerror(errno));
+	return -1;
+    }
+    IH_INIT(h, V_device(vp), V_parentId(vp), ino);
+    fdP = IH_OPEN(h);
+    if (fdP == NULL || FDH_PWRITE(fdP, data, len, 0) != len) {
+	fprintf(stderr, "mkvol: cannot write file %d\n", n);
+	return -1;
+    }
+    FDH_CLOSE(fdP);
+    IH_RELEASE(h);
+
+    memset(vnodeBuf, 0, sizeof(vnodeBuf));
+    vnode->type = vFile;
+    vnode->modeBits = 0644;
+    vnode->linkCount = 1;
+    VNDISK_SET_LEN(vnode, len);
+    vnode->uniquifier = unique;
+    vnode->dataVersion = 1;
+    VNDISK_SET_INO(vnode, ino);
+    vnode->unixModifyTime = vnode->serverModifyTime = time(NULL);
+    vnode->parent = 1;
+    vnode->vnodeMagic = SMALLVNODEMAGIC;
+
+    if (FDH_PWRITE(indexfd, vnodeBuf, sizeof(vnodeBuf),
+		   vnodeIndexOffset(&VnodeClassInfo[vSmall], vnodeNumber))
+	!= sizeof(vnodeBuf)) {
+	fprintf(stderr, "mkvol: cannot write vnode %u\n", vnodeNumber);
+	return -1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    VolumePackageOptions opts;
+    VolumeId volumeId;
+    FdHandle_t *indexfd;
+    Volume *vp;
+    Error ec;
+    int i, nfiles;
+
+    if (argc == 2 && strcmp(argv[1], "-dirs") == 0) {
+	printf("%s\n%s\n", AFSDIR_SERVER_SLVGLOG_FILEPATH,
+	       AFSDIR_SERVER_SLVGLOCK_FILEPATH);
+	return 0;
+    }
+    if (argc != 4) {
+	fprintf(stderr, "usage: mkvol partition volumeid nfiles\n"
+		"       mkvol -dirs\n");
+	exit(1);
+    }
+    volumeId = strtoul(argv[2], NULL, 10);
+    nfiles = atoi(argv[3]);
+
+    VOptDefaults(salvager, &opts);
+    opts.canUseFSSYNC = 0;
+    if (VInitVolumePackage2(salvager, &opts)) {
+	fprintf(stderr, "mkvol: unable to initialize volume package\n");
+	exit(1);
+    }
+
+    vp = VCreateVolume(&ec, argv[1], volumeId, volumeId);
+    if (ec) {
+	fprintf(stderr, "mkvol: VCreateVolume failed: %d\n", ec);
+	exit(1);
+    }
+    V_uniquifier(vp) = 1;
+    V_updateDate(vp) = V_creationDate(vp) = V_copyDate(vp);
+    V_inService(vp) = V_blessed(vp) = 1;
+    V_destroyMe(vp) = 0;
+    V_type(vp) = readwriteVolume;
+    snprintf(V_name(vp), VNAMESIZE, "mkvol.%" AFS_VOLID_FMT,
+	     afs_printable_VolumeId_lu(volumeId));
+
+    indexfd = IH_OPEN(vp->vnodeIndex[vSmall].handle);
+    if (indexfd == NULL) {
+	fprintf(stderr, "mkvol: cannot open the small vnode index\n");
+	exit(1);
+    }
+    for (i = 0; i < nfiles; i++)
+	if (MakeFile(vp, indexfd, i))
+	    exit(1);
+    FDH_CLOSE(indexfd);
+
+    VUpdateVolume(&ec, vp);
+    if (ec) {
+	fprintf(stderr, "mkvol: VUpdateVolume failed: %d\n", ec);
+	exit(1);
+    }
+    VDetachVolume(&ec, vp);
+    return 0;
+}